@@ -0,0 +1,92 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of block-sparse (BSR) linear layers against dense ones on CPU.
+
+The weight of a linear layer is pruned to the given block sparsities, and the layer
+is compiled both dense and after `ConvertDenseToBSR`. With `--tune-trials`, the
+kernels of both are tuned with MetaSchedule before the comparison.
+
+Example:
+
+  python apps/benchmark/bsr_matmul.py --features 2048 --block-size 16 1 --tune-trials 256
+"""
+import argparse
+import tempfile
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_linear(args, weight):
+    x = relax.Var("x", relax.TensorStructInfo((args.num_tokens, args.features), "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            weight_t = bb.emit(relax.op.permute_dims(relax.const(weight)))
+            out = bb.emit_output(relax.op.matmul(x, weight_t))
+        bb.emit_func_output(out)
+    return bb.get()
+
+
+def compile_and_time(args, mod, x):
+    target = tvm.target.Target(args.target)
+    mod = relax.transform.LegalizeOps()(mod)
+    mod = relax.transform.FoldConstant()(mod)
+    if args.tune_trials > 0:
+        with tempfile.TemporaryDirectory() as work_dir, target:
+            mod = relax.transform.MetaScheduleTuneIRMod({}, work_dir, args.tune_trials)(mod)
+            mod = relax.transform.MetaScheduleApplyDatabase(work_dir)(mod)
+    vm = relax.VirtualMachine(tvm.compile(mod, target), tvm.cpu())
+    timer = vm.time_evaluator("main", tvm.cpu(), number=args.repeat, min_repeat_ms=200)
+    return timer(x).mean
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--features", type=int, default=2048)
+    parser.add_argument("--num-tokens", type=int, default=32)
+    parser.add_argument("--block-size", type=int, nargs=2, default=[16, 1])
+    parser.add_argument("--sparsity", type=float, nargs="+", default=[0.7, 0.8, 0.9])
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--tune-trials", type=int, default=0)
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    rng = np.random.default_rng(0)
+    bs_r, bs_c = args.block_size
+    features = args.features
+    x = tvm.nd.array(rng.standard_normal((args.num_tokens, features)).astype("float32"))
+    print(f"features={features} num_tokens={args.num_tokens} block_size=({bs_r}, {bs_c})")
+    for sparsity in args.sparsity:
+        mask = rng.random((features // bs_r, features // bs_c)) >= sparsity
+        mask = np.repeat(np.repeat(mask, bs_r, axis=0), bs_c, axis=1)
+        weight = (rng.standard_normal((features, features)) * mask).astype("float32")
+        mod = build_linear(args, weight)
+        dense = compile_and_time(args, mod, x)
+        sparse_mod = relax.transform.ConvertDenseToBSR((bs_r, bs_c), 0.0)(mod)
+        sparse = compile_and_time(args, sparse_mod, x)
+        print(
+            f"sparsity={sparsity:.2f}: dense {dense * 1e3:.3f} ms, bsr {sparse * 1e3:.3f} ms, "
+            f"speedup {dense / sparse:.2f}x"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the fused sampling builtin against the chain of separate builtins.
+
+The chain applies the repetition penalty, the presence and frequency penalties and
+the softmax with temperature, and then samples with top-p, one row at a time. The
+fused builtin does all of it for the whole batch in a single call. The latency is
+reported in microseconds per sampled token.
+
+Example:
+
+  python apps/benchmark/fused_sampling.py --vocab-size 150000 --batch-size 32 --top-p 0.9
+"""
+import argparse
+import time
+
+import numpy as np
+
+import tvm
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--vocab-size", type=int, default=150000)
+    parser.add_argument("--batch-size", type=int, default=32)
+    parser.add_argument("--temperature", type=float, default=0.7)
+    parser.add_argument("--top-p", type=float, default=0.9)
+    parser.add_argument("--top-k", type=int, default=0)
+    parser.add_argument("--repetition-penalty", type=float, default=1.1)
+    parser.add_argument("--presence-penalty", type=float, default=0.1)
+    parser.add_argument("--frequency-penalty", type=float, default=0.1)
+    parser.add_argument("--num-appeared", type=int, default=256)
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    f_fused = tvm.get_global_func("vm.builtin.fused_sample_from_logits")
+    f_repetition = tvm.get_global_func("vm.builtin.apply_repetition_penalty")
+    f_presence = tvm.get_global_func("vm.builtin.apply_presence_and_frequency_penalty")
+    f_softmax = tvm.get_global_func("vm.builtin.apply_softmax_with_temperature")
+    f_top_p = tvm.get_global_func("vm.builtin.sample_top_p_from_prob")
+
+    rng = np.random.default_rng(0)
+    batch_size, vocab_size = args.batch_size, args.vocab_size
+    logits_np = rng.normal(scale=3.0, size=(batch_size, vocab_size)).astype("float32")
+    token_ids_np = np.stack(
+        [rng.choice(vocab_size, args.num_appeared, replace=False) for _ in range(batch_size)]
+    ).astype("int32")
+    token_freqs_np = rng.integers(1, 4, size=token_ids_np.shape).astype("int32")
+    uniform_np = rng.random(batch_size).astype("float32")
+    params_np = np.tile(
+        np.array(
+            [
+                args.temperature,
+                args.top_p,
+                args.top_k,
+                args.repetition_penalty,
+                args.presence_penalty,
+                args.frequency_penalty,
+            ],
+            "float32",
+        ),
+        (batch_size, 1),
+    )
+
+    params = tvm.nd.array(params_np)
+    uniform = tvm.nd.array(uniform_np)
+    indptr = tvm.nd.array((np.arange(batch_size + 1) * args.num_appeared).astype("int32"))
+    token_ids = tvm.nd.array(token_ids_np.reshape(-1))
+    token_freqs = tvm.nd.array(token_freqs_np.reshape(-1))
+    row_ids = [tvm.nd.array(token_ids_np[i]) for i in range(batch_size)]
+    row_freqs = [tvm.nd.array(token_freqs_np[i]) for i in range(batch_size)]
+
+    fused_time = 0.0
+    chained_time = 0.0
+    for _ in range(args.repeat):
+        logits = tvm.nd.array(logits_np)
+        tic = time.perf_counter()
+        f_fused(logits, params, uniform, indptr, token_ids, token_freqs)
+        fused_time += time.perf_counter() - tic
+
+        rows = [tvm.nd.array(logits_np[i : i + 1]) for i in range(batch_size)]
+        tic = time.perf_counter()
+        for i, row in enumerate(rows):
+            f_repetition(row, row_ids[i], args.repetition_penalty)
+            f_presence(row, row_ids[i], row_freqs[i], args.presence_penalty, args.frequency_penalty)
+            f_softmax(row, args.temperature)
+            f_top_p(row, args.top_p, float(uniform_np[i]))
+        chained_time += time.perf_counter() - tic
+
+    num_tokens = args.repeat * batch_size
+    print(
+        f"vocab_size={vocab_size} batch_size={batch_size} temperature={args.temperature} "
+        f"top_p={args.top_p} top_k={args.top_k}\n"
+        f"fused:   {fused_time / num_tokens * 1e6:.1f} us/token\n"
+        f"chained: {chained_time / num_tokens * 1e6:.1f} us/token"
+    )
+
+
+if __name__ == "__main__":
+    main()
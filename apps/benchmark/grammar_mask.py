@@ -0,0 +1,114 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the token masks of grammar-constrained decoding.
+
+A synthetic vocabulary with all the single bytes and random multi-byte tokens is
+compiled into a token trie, and a batch of sequences decodes random allowed tokens
+under a JSON-like regular expression. The mask generation time per token is reported
+separately for the first pass, which computes the mask of each new grammar state, and
+for the second pass, where all the masks are cached.
+
+Example:
+
+  python apps/benchmark/grammar_mask.py --vocab-size 128000 --batch-size 16
+"""
+import argparse
+import string
+import time
+
+import numpy as np
+
+import tvm
+from tvm.runtime import ShapeTuple
+
+PATTERN = (
+    r'\{"name": "[a-zA-Z ]{1,40}", "age": (0|[1-9][0-9]{0,2}), '
+    r'"tags": \[("[a-z]+"(, "[a-z]+")*)?\]\}'
+)
+# The grammar state of a sequence without grammar, RegexGrammarObj::kUnconstrainedState.
+UNCONSTRAINED_STATE = -2
+
+
+def synthetic_vocab(vocab_size, rng):
+    chars = string.ascii_letters + string.digits
+    first_chars = chars + ' "{}[]:,.-_\n'
+    vocab = [""] + [bytes([b]) for b in range(256)]
+    while len(vocab) < vocab_size:
+        length = int(rng.integers(2, 11))
+        vocab.append(
+            rng.choice(list(first_chars)) + "".join(rng.choice(list(chars), length - 1))
+        )
+    return vocab
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--vocab-size", type=int, default=128000)
+    parser.add_argument("--batch-size", type=int, default=16)
+    parser.add_argument("--num-steps", type=int, default=100)
+    parser.add_argument("--pattern", type=str, default=PATTERN)
+    args = parser.parse_args()
+
+    f_trie_create = tvm.get_global_func("vm.builtin.token_trie_create")
+    f_grammar_create = tvm.get_global_func("vm.builtin.regex_grammar_create")
+    f_init_state = tvm.get_global_func("vm.builtin.regex_grammar_init_state")
+    f_accept_token = tvm.get_global_func("vm.builtin.regex_grammar_accept_token")
+    f_fill_bitmask = tvm.get_global_func("vm.builtin.regex_grammar_fill_next_token_bitmask")
+    f_num_states = tvm.get_global_func("vm.builtin.regex_grammar_num_states")
+
+    rng = np.random.default_rng(0)
+    vocab = synthetic_vocab(args.vocab_size, rng)
+    tic = time.perf_counter()
+    trie = f_trie_create(vocab)
+    trie_ms = (time.perf_counter() - tic) * 1e3
+    eos_token_id = 0
+    grammar = f_grammar_create(args.pattern, trie, ShapeTuple([eos_token_id]))
+
+    num_words = (len(vocab) + 31) // 32
+    bitmask = tvm.nd.empty((args.batch_size, num_words), "int32")
+    bit_ids = np.arange(num_words * 32)
+    for name in ["uncached", "cached"]:
+        step_rng = np.random.default_rng(1)
+        states = [f_init_state(grammar)] * args.batch_size
+        mask_time = 0.0
+        num_tokens = 0
+        for _ in range(args.num_steps):
+            tic = time.perf_counter()
+            f_fill_bitmask(grammar, ShapeTuple(states), bitmask)
+            mask_time += time.perf_counter() - tic
+            num_tokens += sum(state >= 0 for state in states)
+            words = bitmask.numpy().view("uint32")
+            for i, state in enumerate(states):
+                if state < 0:
+                    continue
+                allowed = bit_ids[((words[i][bit_ids // 32] >> (bit_ids % 32)) & 1) == 1]
+                allowed = allowed[allowed != eos_token_id]
+                if len(allowed) == 0:
+                    # The output is complete, so the sequence is unconstrained from now on.
+                    states[i] = UNCONSTRAINED_STATE
+                    continue
+                states[i] = f_accept_token(grammar, state, int(step_rng.choice(allowed)))
+        print(
+            f"{name}: {mask_time / num_tokens * 1e6:.2f} us/token for {num_tokens} tokens, "
+            f"{f_num_states(grammar)} grammar states"
+        )
+    print(f"token trie of {len(vocab)} tokens built in {trie_ms:.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
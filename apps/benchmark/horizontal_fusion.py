@@ -0,0 +1,126 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of HorizontalFuseTIR on the decode step of small transformer layers on CPU.
+
+At batch 1, the kernels of a small transformer layer are too small to amortize their
+parallel launch: the Q, K and V projections, the norms of Q and K, and the gate and
+up projections of the MLP are independent of each other. The layers are compiled
+with and without `HorizontalFuseTIR` after `FuseTIR`. With `--tune-trials`, the
+kernels are tuned with MetaSchedule before the horizontal fusion.
+
+Example:
+
+  python apps/benchmark/horizontal_fusion.py --hidden 256 --num-layers 8 --tune-trials 256
+"""
+import argparse
+import tempfile
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_model(args):
+    rng = np.random.default_rng(0)
+    hidden, ffn, context = args.hidden, 4 * args.hidden, args.context
+
+    def weight(*shape):
+        return relax.const((rng.standard_normal(shape) * 0.05).astype("float32"))
+
+    x = relax.Var("x", relax.TensorStructInfo((1, 1, hidden), "float32"))
+    kv = relax.Var("kv", relax.TensorStructInfo((1, context, hidden), "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x, kv]):
+        with bb.dataflow():
+            for _ in range(args.num_layers):
+                norm_weight = weight(hidden)
+                h = bb.emit(relax.op.nn.rms_norm(x, norm_weight, axes=[-1]))
+                q = bb.emit(relax.op.matmul(h, weight(hidden, hidden)))
+                k = bb.emit(relax.op.matmul(h, weight(hidden, hidden)))
+                v = bb.emit(relax.op.matmul(h, weight(hidden, hidden)))
+                q = bb.emit(relax.op.nn.rms_norm(q, norm_weight, axes=[-1]))
+                k = bb.emit(relax.op.nn.rms_norm(k, norm_weight, axes=[-1]))
+                keys = bb.emit(relax.op.concat([kv, k], axis=1))
+                values = bb.emit(relax.op.concat([kv, v], axis=1))
+                scores = bb.emit(relax.op.matmul(q, relax.op.permute_dims(keys, [0, 2, 1])))
+                probs = bb.emit(relax.op.nn.softmax(scores))
+                attn = bb.emit(relax.op.matmul(probs, values))
+                x = bb.emit(relax.op.add(x, relax.op.matmul(attn, weight(hidden, hidden))))
+                h = bb.emit(relax.op.nn.rms_norm(x, norm_weight, axes=[-1]))
+                gate = bb.emit(relax.op.nn.silu(relax.op.matmul(h, weight(hidden, ffn))))
+                up = bb.emit(relax.op.matmul(h, weight(hidden, ffn)))
+                down = relax.op.matmul(relax.op.multiply(gate, up), weight(ffn, hidden))
+                x = bb.emit(relax.op.add(x, down))
+            gv = bb.emit_output(x)
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+def compile_and_time(args, mod, horizontal_fusion):
+    target = tvm.target.Target(args.target)
+    passes = [
+        relax.transform.LegalizeOps(),
+        relax.transform.AnnotateTIROpPattern(),
+        relax.transform.FoldConstant(),
+        relax.transform.FuseOps(),
+        relax.transform.FuseTIR(),
+    ]
+    mod = tvm.transform.Sequential(passes)(mod)
+    if args.tune_trials > 0:
+        with tempfile.TemporaryDirectory() as work_dir, target:
+            mod = relax.transform.MetaScheduleTuneIRMod({}, work_dir, args.tune_trials)(mod)
+            mod = relax.transform.MetaScheduleApplyDatabase(work_dir)(mod)
+    if horizontal_fusion:
+        mod = relax.transform.HorizontalFuseTIR(args.max_work)(mod)
+    num_kernels = sum(
+        1
+        for block in mod["main"].body.blocks
+        for binding in block.bindings
+        if isinstance(binding.value, relax.Call) and binding.value.op.name == "relax.call_tir"
+    )
+    vm = relax.VirtualMachine(tvm.compile(mod, target), tvm.cpu())
+    rng = np.random.default_rng(1)
+    x = tvm.nd.array(rng.standard_normal((1, 1, args.hidden)).astype("float32"))
+    kv = tvm.nd.array(rng.standard_normal((1, args.context, args.hidden)).astype("float32"))
+    timer = vm.time_evaluator("main", tvm.cpu(), number=args.repeat, min_repeat_ms=200)
+    return timer(x, kv).mean, num_kernels
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hidden", type=int, default=256)
+    parser.add_argument("--context", type=int, default=128)
+    parser.add_argument("--num-layers", type=int, default=8)
+    parser.add_argument("--max-work", type=int, default=1 << 16)
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--tune-trials", type=int, default=0)
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    mod = build_model(args)
+    for horizontal_fusion in [False, True]:
+        elapsed, num_kernels = compile_and_time(args, mod, horizontal_fusion)
+        print(
+            f"horizontal_fusion={horizontal_fusion}: {num_kernels} kernels, "
+            f"{elapsed * 1e3:.3f} ms"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,182 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of restoring a saved PagedAttentionKVCache sequence against recomputing it.
+
+A sequence of the given context length is prefilled in chunks, which is the
+recompute baseline. Only the attention of the prefill runs, so the baseline
+underestimates the cost of a real model. The sequence is then saved to disk,
+removed, and restored, with and without compression of the saved file.
+
+Example:
+
+  python apps/benchmark/kv_cache_persistence.py --context 4096 --num-layers 8
+"""
+import argparse
+import os
+import tempfile
+import time
+
+import numpy as np
+
+import tvm
+from tvm import dlight as dl
+from tvm.relax.frontend.nn.llm.kv_cache import (
+    AttnKind,
+    _attention_decode_cpu,
+    _attention_prefill_cpu,
+    _attention_prefill_ragged_cpu,
+    _copy_single_page_cpu,
+    _kv_cache_debug_get_kv,
+    _kv_cache_transpose_append,
+    _merge_state_inplace_cpu,
+    llama_rope_with_position_map,
+)
+
+
+def build_kernels(args, device):
+    target = tvm.target.Target.from_device(device)
+    heads = (args.num_kv_heads, args.num_qo_heads, args.head_dim, args.dtype)
+    builts = []
+    for tir_func in [
+        _kv_cache_transpose_append(args.num_kv_heads, args.head_dim, args.dtype),
+        _kv_cache_debug_get_kv(args.num_layers, args.num_kv_heads, args.head_dim, args.dtype),
+        _attention_prefill_cpu(*heads, False, {}),
+        _attention_decode_cpu(*heads, False, {}),
+        _attention_prefill_ragged_cpu(
+            args.num_kv_heads, args.num_qo_heads, args.head_dim, args.head_dim, args.dtype, {}
+        ),
+        _merge_state_inplace_cpu(args.dtype),
+        llama_rope_with_position_map(
+            1e4, 1.0, args.head_dim, args.num_qo_heads, args.num_kv_heads, args.dtype, {}
+        ),
+        _copy_single_page_cpu(args.num_kv_heads, args.page_size, args.head_dim, args.dtype),
+    ]:
+        mod = tvm.IRModule({"main": tir_func})
+        with target:
+            mod = dl.ApplyDefaultSchedule(dl.gpu.Fallback())(mod)
+        builts.append(tvm.tir.build(mod["main"], target=target).entry_func)
+    return builts
+
+
+def create_kv_cache(args, device, kernels):
+    (
+        ftranspose_append,
+        fdebug_get_kv,
+        fattn_prefill,
+        fattn_decode,
+        fattn_prefill_ragged,
+        fmerge_state,
+        fsplit_rotary,
+        fcopy_single_page,
+    ) = kernels
+
+    def placeholder(*_args):
+        raise RuntimeError("The kernel is not expected to run in this benchmark")
+
+    fcreate = tvm.get_global_func("vm.builtin.paged_attention_kv_cache_create")
+    return fcreate(
+        tvm.runtime.ShapeTuple([1, args.context + args.page_size, 2048, args.page_size, 0]),
+        tvm.runtime.ShapeTuple([0, args.num_layers]),
+        args.num_qo_heads,
+        args.num_kv_heads,
+        args.head_dim,
+        args.head_dim,
+        tvm.runtime.ShapeTuple([int(AttnKind.MHA)] * args.num_layers),
+        False,  # enable_kv_transfer
+        1,  # rope_mode
+        1.0,
+        1e4,
+        None,  # rope_ext_factors
+        tvm.nd.empty((), args.dtype, device=device),
+        ftranspose_append,
+        None,  # f_transpose_append_mla
+        ["tir", fattn_prefill_ragged],
+        ["tir", fattn_prefill],
+        ["tir", fattn_decode],
+        ["tir", placeholder],
+        ["tir", placeholder],
+        ["tir", placeholder],
+        ["tir", placeholder],
+        [],  # f_mla_prefill
+        [fmerge_state],
+        fsplit_rotary,
+        fcopy_single_page,
+        fdebug_get_kv,
+        placeholder,
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--context", type=int, default=4096)
+    parser.add_argument("--prefill-chunk", type=int, default=2048)
+    parser.add_argument("--num-layers", type=int, default=8)
+    parser.add_argument("--num-qo-heads", type=int, default=32)
+    parser.add_argument("--num-kv-heads", type=int, default=8)
+    parser.add_argument("--head-dim", type=int, default=128)
+    parser.add_argument("--page-size", type=int, default=16)
+    parser.add_argument("--dtype", type=str, default="float16")
+    args = parser.parse_args()
+
+    device = tvm.cpu()
+    fadd_sequence = tvm.get_global_func("vm.builtin.kv_state_add_sequence")
+    fremove_sequence = tvm.get_global_func("vm.builtin.kv_state_remove_sequence")
+    fbegin_forward = tvm.get_global_func("vm.builtin.kv_state_begin_forward")
+    fend_forward = tvm.get_global_func("vm.builtin.kv_state_end_forward")
+    fattention = tvm.get_global_func("vm.builtin.attention_kv_cache_attention_with_fused_qkv")
+    fsave_sequence = tvm.get_global_func("vm.builtin.attention_kv_cache_save_sequence")
+    frestore_sequence = tvm.get_global_func("vm.builtin.attention_kv_cache_restore_sequence")
+
+    kv_cache = create_kv_cache(args, device, build_kernels(args, device))
+    num_heads = args.num_qo_heads + 2 * args.num_kv_heads
+    rng = np.random.default_rng(0)
+
+    fadd_sequence(kv_cache, 0)
+    elapsed = 0.0
+    for begin in range(0, args.context, args.prefill_chunk):
+        length = min(args.prefill_chunk, args.context - begin)
+        qkv = tvm.nd.array(
+            rng.standard_normal((length, num_heads, args.head_dim)).astype(args.dtype), device
+        )
+        out = tvm.nd.empty((length, args.num_qo_heads, args.head_dim), args.dtype, device)
+        tic = time.perf_counter()
+        fbegin_forward(kv_cache, tvm.runtime.ShapeTuple([0]), tvm.runtime.ShapeTuple([length]))
+        for layer_id in range(args.num_layers):
+            fattention(kv_cache, layer_id, 1.0, qkv, out)
+        fend_forward(kv_cache)
+        elapsed += time.perf_counter() - tic
+    print(f"context {args.context}: recompute (attention only) {elapsed * 1e3:.1f} ms")
+
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        for compress in [False, True]:
+            path = os.path.join(tmp_dir, f"seq_{int(compress)}.bin")
+            tic = time.perf_counter()
+            nbytes = fsave_sequence(kv_cache, 0, path, compress)
+            save = time.perf_counter() - tic
+            fremove_sequence(kv_cache, 0)
+            tic = time.perf_counter()
+            frestore_sequence(kv_cache, 0, path)
+            restore = time.perf_counter() - tic
+            print(
+                f"  compress {int(compress)}: save {save * 1e3:.1f} ms, "
+                f"restore {restore * 1e3:.1f} ms, file {nbytes / 1e6:.1f} MB"
+            )
+
+
+if __name__ == "__main__":
+    main()
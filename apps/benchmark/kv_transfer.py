@@ -0,0 +1,169 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the disaggregated KV transfer between two processes on one host.
+
+A prefill process holds a sequence of the given context length and sends its KV
+data with `vm.builtin.kv_cache_disagg_send_sequence`. The decode process receives
+it in the background and polls the receive between the BeginForward of a decode
+batch, and reports the transfer bandwidth and the end-to-end latency from the
+start of the receive to the sequence being ready.
+
+The attention kernels are never launched, so the KV data is left uninitialized.
+
+Example:
+
+  python apps/benchmark/kv_transfer.py --transport shm --context 4096
+"""
+import argparse
+import multiprocessing
+import os
+import time
+
+import tvm
+from tvm import dlight as dl
+from tvm.relax.frontend.nn.llm.kv_cache import AttnKind, _kv_cache_transpose_append
+
+
+def create_kv_cache(args, capacity):
+    fcreate = tvm.get_global_func("vm.builtin.paged_attention_kv_cache_create")
+    mod = tvm.IRModule(
+        {"main": _kv_cache_transpose_append(args.num_kv_heads, args.head_dim, args.dtype)}
+    )
+    target = tvm.target.Target("llvm")
+    with target:
+        mod = dl.ApplyDefaultSchedule(dl.gpu.Fallback())(mod)
+    ftranspose_append = tvm.tir.build(mod["main"], target=target).entry_func
+
+    def placeholder(*_args):
+        raise RuntimeError("The kernels are not expected to run in this benchmark")
+
+    backend = ["tir", placeholder]
+    return fcreate(
+        tvm.runtime.ShapeTuple([args.batch_size + 1, capacity, 2048, args.page_size, 0]),
+        tvm.runtime.ShapeTuple([0, args.num_layers]),
+        args.num_kv_heads,
+        args.num_kv_heads,
+        args.head_dim,
+        args.head_dim,
+        tvm.runtime.ShapeTuple([int(AttnKind.MHA)] * args.num_layers),
+        False,  # enable_kv_transfer
+        0,  # rope_mode
+        1.0,
+        1e4,
+        None,  # rope_ext_factors
+        tvm.nd.empty((), args.dtype, device=tvm.cpu()),
+        ftranspose_append,
+        None,  # f_transpose_append_mla
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        [],  # f_mla_prefill
+        [placeholder],
+        placeholder,
+        placeholder,
+        placeholder,
+        placeholder,
+    )
+
+
+def create_transport(args, is_recver):
+    if args.transport == "shm":
+        fshm = tvm.get_global_func("vm.builtin.kv_transport_shm")
+        return fshm(f"/tvm_kv_transfer_bench_{args.port}", args.shm_capacity, is_recver)
+    if is_recver:
+        return tvm.get_global_func("vm.builtin.kv_transport_tcp_listen")("127.0.0.1", args.port)
+    return tvm.get_global_func("vm.builtin.kv_transport_tcp_connect")("127.0.0.1", args.port)
+
+
+def run_prefill(args):
+    kv_cache = create_kv_cache(args, args.context + args.page_size)
+    tvm.get_global_func("vm.builtin.kv_state_add_sequence")(kv_cache, 0)
+    tvm.get_global_func("vm.builtin.kv_state_begin_forward")(
+        kv_cache, tvm.runtime.ShapeTuple([0]), tvm.runtime.ShapeTuple([args.context])
+    )
+    tvm.get_global_func("vm.builtin.kv_state_end_forward")(kv_cache)
+    transport = create_transport(args, is_recver=False)
+    tvm.get_global_func("vm.builtin.kv_cache_disagg_send_sequence")(kv_cache, 0, 0, transport)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--transport", choices=["shm", "tcp"], default="shm")
+    parser.add_argument("--context", type=int, default=4096)
+    parser.add_argument("--batch-size", type=int, default=32, help="decode batch of the receiver")
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--num-kv-heads", type=int, default=8)
+    parser.add_argument("--head-dim", type=int, default=128)
+    parser.add_argument("--page-size", type=int, default=16)
+    parser.add_argument("--dtype", type=str, default="float16")
+    parser.add_argument("--port", type=int, default=os.getpid() % 20000 + 20000)
+    parser.add_argument("--shm-capacity", type=int, default=64 << 20)
+    args = parser.parse_args()
+
+    fadd_sequence = tvm.get_global_func("vm.builtin.kv_state_add_sequence")
+    fbegin_forward = tvm.get_global_func("vm.builtin.kv_state_begin_forward")
+    fend_forward = tvm.get_global_func("vm.builtin.kv_state_end_forward")
+    fstart_recv = tvm.get_global_func("vm.builtin.kv_cache_disagg_start_recv")
+    fpoll_recv = tvm.get_global_func("vm.builtin.kv_cache_disagg_poll_recv")
+
+    capacity = args.context + (args.batch_size + 1) * (args.page_size + 1024)
+    kv_cache = create_kv_cache(args, capacity)
+    decode_ids = list(range(1, args.batch_size + 1))
+    for seq_id in decode_ids:
+        fadd_sequence(kv_cache, seq_id)
+    fbegin_forward(
+        kv_cache,
+        tvm.runtime.ShapeTuple(decode_ids),
+        tvm.runtime.ShapeTuple([16] * args.batch_size),
+    )
+    fend_forward(kv_cache)
+    fadd_sequence(kv_cache, 0)
+
+    transport = create_transport(args, is_recver=True)
+    sender = multiprocessing.Process(target=run_prefill, args=(args,))
+    sender.start()
+    tic = time.perf_counter()
+    fstart_recv(kv_cache, 0, transport)
+    steps = 0
+    while not fpoll_recv(kv_cache, 0):
+        # The decode batch keeps stepping while the KV data arrives.
+        fbegin_forward(
+            kv_cache,
+            tvm.runtime.ShapeTuple(decode_ids),
+            tvm.runtime.ShapeTuple([1] * args.batch_size),
+        )
+        fend_forward(kv_cache)
+        steps += 1
+    elapsed = time.perf_counter() - tic
+    sender.join()
+
+    elem_bytes = tvm.runtime.DataType(args.dtype).bits // 8
+    kv_bytes = 2 * args.num_layers * args.context * args.num_kv_heads * args.head_dim * elem_bytes
+    print(
+        f"{args.transport}: context {args.context}, {kv_bytes / 1e6:.1f} MB of KV data, "
+        f"end-to-end {elapsed * 1e3:.1f} ms, {kv_bytes / elapsed / 1e9:.2f} GB/s, "
+        f"{steps} decode steps overlapped"
+    )
+
+
+if __name__ == "__main__":
+    main()
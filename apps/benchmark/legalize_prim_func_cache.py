@@ -0,0 +1,97 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the compile time of LegalizeOps on a stack of transformer layers.
+
+The layers have the same shapes, as in a language model, so that the ops of each layer
+are legalized to the same PrimFuncs. The script times LegalizeOps with and without the
+cache of the PrimFuncs created from TE ("relax.LegalizeOps.cache_prim_funcs"), and
+reports the number of PrimFuncs in the module, which is the same in both cases since the
+block builder deduplicates the structurally equal PrimFuncs.
+
+Example:
+
+  python apps/benchmark/legalize_prim_func_cache.py --num-layers 32
+"""
+import argparse
+import time
+
+import tvm
+from tvm import relax
+
+
+def build_model(args):
+    hidden, ffn = args.hidden, 4 * args.hidden
+    x = relax.Var("x", relax.TensorStructInfo(("n", hidden), "float32"))
+    layer_shapes = [
+        (hidden,),
+        *[(hidden, hidden)] * 4,
+        (hidden,),
+        (hidden, ffn),
+        (ffn, hidden),
+    ]
+    params = [
+        relax.Var(f"w{i}_{j}", relax.TensorStructInfo(shape, "float32"))
+        for i in range(args.num_layers)
+        for j, shape in enumerate(layer_shapes)
+    ]
+
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x, *params]):
+        with bb.dataflow():
+            h = x
+            for i in range(args.num_layers):
+                w = params[i * len(layer_shapes) : (i + 1) * len(layer_shapes)]
+                norm = bb.emit(relax.op.nn.rms_norm(h, w[0], axes=[-1]))
+                q = bb.emit(relax.op.matmul(norm, w[1]))
+                k = bb.emit(relax.op.matmul(norm, w[2]))
+                v = bb.emit(relax.op.matmul(norm, w[3]))
+                scores = bb.emit(relax.op.matmul(q, relax.op.permute_dims(k)))
+                probs = bb.emit(relax.op.nn.softmax(scores))
+                attn = bb.emit(relax.op.matmul(probs, v))
+                h = bb.emit(relax.op.add(h, relax.op.matmul(attn, w[4])))
+                norm = bb.emit(relax.op.nn.rms_norm(h, w[5], axes=[-1]))
+                up = bb.emit(relax.op.nn.silu(relax.op.matmul(norm, w[6])))
+                h = bb.emit(relax.op.add(h, relax.op.matmul(up, w[7])))
+            gv = bb.emit_output(h)
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--repeat", type=int, default=3)
+    args = parser.parse_args()
+
+    mod = build_model(args)
+    for cache in [False, True]:
+        with tvm.transform.PassContext(config={"relax.LegalizeOps.cache_prim_funcs": cache}):
+            best = float("inf")
+            for _ in range(args.repeat):
+                start = time.perf_counter()
+                legalized = relax.transform.LegalizeOps()(mod)
+                best = min(best, time.perf_counter() - start)
+        num_prim_funcs = sum(
+            isinstance(func, tvm.tir.PrimFunc) for func in legalized.functions.values()
+        )
+        print(f"cache_prim_funcs={cache}: {best * 1e3:.1f} ms, {num_prim_funcs} PrimFuncs")
+
+
+if __name__ == "__main__":
+    main()
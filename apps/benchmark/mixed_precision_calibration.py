@@ -0,0 +1,117 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of mixed precision on CPU, with the dtypes of the ops chosen by calibration.
+
+The model is a stack of MLP blocks with layer norms and residual connections. For each
+low precision dtype, the script converts the model by `ToMixedPrecision` with the fixed
+policy of the ops, and by `CalibrateMixedPrecision` within the error budget, and reports
+the time of a run, the speedup over float32, and the relative L2 error of the output on
+an input other than the calibration one.
+
+Example:
+
+  python apps/benchmark/mixed_precision_calibration.py --hidden 1024 --error-budget 0.01
+"""
+import argparse
+import time
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_model(args):
+    rng = np.random.default_rng(0)
+    hidden, ffn = args.hidden, 4 * args.hidden
+
+    def weight(*shape, scale=1.0):
+        return relax.const((rng.standard_normal(shape) * scale).astype("float32"))
+
+    x = relax.Var("x", relax.TensorStructInfo((args.batch, hidden), "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            h = x
+            for _ in range(args.num_layers):
+                norm = bb.emit(
+                    relax.op.nn.layer_norm(h, weight(hidden), weight(hidden), axes=[-1])
+                )
+                up = bb.emit(relax.op.matmul(norm, weight(hidden, ffn, scale=hidden**-0.5)))
+                act = bb.emit(relax.op.nn.gelu(up))
+                down = bb.emit(relax.op.matmul(act, weight(ffn, hidden, scale=ffn**-0.5)))
+                h = bb.emit(relax.op.add(h, down))
+            gv = bb.emit_output(relax.op.nn.softmax(h))
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+def run(args, mod, x):
+    vm = relax.VirtualMachine(tvm.compile(mod, args.target), tvm.cpu())
+    out = vm["main"](x).numpy()
+    start = time.perf_counter()
+    for _ in range(args.repeat):
+        vm["main"](x)
+    return (time.perf_counter() - start) / args.repeat, out
+
+
+def relative_error(out, expected):
+    return np.linalg.norm(out - expected) / np.linalg.norm(expected)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--batch", type=int, default=32)
+    parser.add_argument("--num-layers", type=int, default=4)
+    parser.add_argument("--error-budget", type=float, default=0.01)
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--repeat", type=int, default=20)
+    args = parser.parse_args()
+
+    mod = build_model(args)
+    rng = np.random.default_rng(1)
+    calibration_input = rng.standard_normal((args.batch, args.hidden)).astype("float32")
+    x = tvm.nd.array(rng.standard_normal((args.batch, args.hidden)).astype("float32"))
+
+    fp32_time, expected = run(args, mod, x)
+    print(f"float32: {fp32_time * 1e3:.2f} ms")
+    for low_dtype in ["bfloat16", "float16"]:
+        calibrate = relax.transform.CalibrateMixedPrecision(
+            [calibration_input],
+            low_dtype=low_dtype,
+            error_budget=args.error_budget,
+            target=args.target,
+        )
+        converted = {
+            "fixed policy": relax.transform.ToMixedPrecision(low_dtype=low_dtype)(mod),
+            "calibrated": calibrate(mod),
+        }
+        num_low = sum(dtype == low_dtype for dtype in calibrate.op_dtypes.values())
+        for name, low_mod in converted.items():
+            low_time, out = run(args, low_mod, x)
+            print(
+                f"{low_dtype} {name}: {low_time * 1e3:.2f} ms, "
+                f"speedup {fp32_time / low_time:.2f}x, "
+                f"error {relative_error(out, expected):.2e}"
+            )
+        print(f"  calibrated {num_low} of {len(calibrate.op_dtypes)} ops to {low_dtype}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,102 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of serving many LoRA adapters in one batch with the segmented GEMM builtin.
+
+The adapters are hot-loaded into a pool from ndarray caches, and the tokens of the
+batch are spread evenly over the loaded adapters. The LoRA branch of one linear
+layer is applied to the whole batch in a single call, so the throughput should stay
+close to the one of a single adapter as the number of adapters grows.
+
+Example:
+
+  python apps/benchmark/multi_lora.py --features 4096 --rank 16 --num-tokens 256
+"""
+import argparse
+import tempfile
+import time
+
+import numpy as np
+
+import tvm
+from tvm.contrib import tvmjs
+from tvm.runtime import ShapeTuple
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--features", type=int, default=4096)
+    parser.add_argument("--rank", type=int, default=16)
+    parser.add_argument("--num-tokens", type=int, default=256)
+    parser.add_argument("--num-adapters", type=int, nargs="+", default=[1, 4, 16, 64])
+    parser.add_argument("--repeat", type=int, default=20)
+    args = parser.parse_args()
+
+    f_create = tvm.get_global_func("vm.builtin.lora_adapter_pool_create")
+    f_load = tvm.get_global_func("vm.builtin.lora_adapter_pool_load")
+    f_params = tvm.get_global_func("vm.builtin.lora_adapter_pool_get_params")
+    f_token_ids = tvm.get_global_func("vm.builtin.lora_adapter_pool_token_adapter_ids")
+    f_gemm = tvm.get_global_func("vm.builtin.lora_segmented_gemm")
+
+    rng = np.random.default_rng(0)
+    features, rank, num_tokens = args.features, args.rank, args.num_tokens
+    max_adapters = max(args.num_adapters)
+    pool = f_create(
+        ["proj.weight"],
+        [ShapeTuple([features, features])],
+        max_adapters,
+        rank,
+        "float32",
+        tvm.cpu(),
+    )
+    with tempfile.TemporaryDirectory() as cache_dir:
+        tvmjs.dump_ndarray_cache(
+            {
+                "proj.weight.lora_a": rng.normal(size=(rank, features)).astype("float32"),
+                "proj.weight.lora_b": rng.normal(size=(features, rank)).astype("float32"),
+            },
+            cache_dir,
+            encode_format="raw",
+            show_progress=False,
+        )
+        tic = time.perf_counter()
+        for i in range(max_adapters):
+            f_load(pool, f"adapter{i}", cache_dir, 2.0 * rank)
+        load_time = (time.perf_counter() - tic) / max_adapters
+    scaling, lora_a, lora_b = f_params(pool)
+    x = tvm.nd.array(rng.normal(size=(num_tokens, features)).astype("float32"))
+    out = tvm.nd.empty((num_tokens, features), "float32")
+
+    print(f"features={features} rank={rank} num_tokens={num_tokens}")
+    print(f"hot-load: {load_time * 1e3:.2f} ms/adapter")
+    for num_adapters in args.num_adapters:
+        # Interleave the adapters over the tokens, the worst case for the grouping.
+        names = [f"adapter{i % num_adapters}" for i in range(num_tokens)]
+        adapter_ids = f_token_ids(pool, names, ShapeTuple([1] * num_tokens))
+        f_gemm(x, lora_a, lora_b, scaling, adapter_ids, out)
+        tic = time.perf_counter()
+        for _ in range(args.repeat):
+            f_gemm(x, lora_a, lora_b, scaling, adapter_ids, out)
+        elapsed = (time.perf_counter() - tic) / args.repeat
+        print(
+            f"num_adapters={num_adapters:3d}: {elapsed * 1e3:.2f} ms/batch, "
+            f"{num_tokens / elapsed:.0f} tokens/s"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the memoization of a deterministic sub-function on CPU.
+
+The model runs an encoder over a prompt and a small head that combines the encoding
+with a per-call input, as in a pipeline that conditions on a fixed text prompt. The
+encoder is marked with the "relax.memoize" attribute, so that its outputs are cached
+by the VM keyed by the hash of the prompt. The model is timed with the same prompt
+in every call, with a fresh prompt in every call (the overhead of hashing on a
+miss), and without the attribute.
+
+Example:
+
+  python apps/benchmark/op_result_caching.py --hidden 512 --num-layers 8
+"""
+import argparse
+import time
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_model(args, memoize):
+    rng = np.random.default_rng(0)
+    hidden, seq_len = args.hidden, args.seq_len
+
+    def weight(*shape):
+        return relax.const((rng.standard_normal(shape) * 0.05).astype("float32"))
+
+    bb = relax.BlockBuilder()
+    prompt = relax.Var("prompt", relax.TensorStructInfo((seq_len, hidden), "float32"))
+    attrs = {"relax.memoize": args.capacity_mb << 20} if memoize else {}
+    with bb.function("encode", [prompt], attrs, private=True):
+        with bb.dataflow():
+            h = prompt
+            for _ in range(args.num_layers):
+                h = bb.emit(relax.op.nn.gelu(relax.op.matmul(h, weight(hidden, hidden))))
+            gv = bb.emit_output(h)
+        bb.emit_func_output(gv)
+    encode = bb.get().get_global_var("encode")
+
+    prompt = relax.Var("prompt", relax.TensorStructInfo((seq_len, hidden), "float32"))
+    x = relax.Var("x", relax.TensorStructInfo((1, hidden), "float32"))
+    with bb.function("main", [prompt, x]):
+        encoding = bb.emit(relax.Call(encode, [prompt]))
+        with bb.dataflow():
+            scores = bb.emit(relax.op.matmul(x, relax.op.permute_dims(encoding)))
+            probs = bb.emit(relax.op.nn.softmax(scores))
+            gv = bb.emit_output(relax.op.add(x, relax.op.matmul(probs, encoding)))
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+def time_calls(args, vm, prompts, x):
+    vm["main"](prompts[-1], x)
+    start = time.perf_counter()
+    for i in range(args.repeat):
+        vm["main"](prompts[i % len(prompts)], x)
+    return (time.perf_counter() - start) / args.repeat
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hidden", type=int, default=512)
+    parser.add_argument("--seq-len", type=int, default=77)
+    parser.add_argument("--num-layers", type=int, default=8)
+    parser.add_argument("--capacity-mb", type=int, default=64)
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--repeat", type=int, default=100)
+    args = parser.parse_args()
+
+    rng = np.random.default_rng(1)
+    x = tvm.nd.array(rng.standard_normal((1, args.hidden)).astype("float32"))
+    fresh_prompts = [
+        tvm.nd.array(rng.standard_normal((args.seq_len, args.hidden)).astype("float32"))
+        for _ in range(args.repeat + 2)
+    ]
+    for memoize in [False, True]:
+        mod = relax.transform.LegalizeOps()(build_model(args, memoize))
+        vm = relax.VirtualMachine(tvm.compile(mod, args.target), tvm.cpu())
+        repeated = time_calls(args, vm, fresh_prompts[:1], x)
+        fresh = time_calls(args, vm, fresh_prompts[1:], x)
+        print(
+            f"memoize={memoize}: repeated prompt {repeated * 1e3:.3f} ms, "
+            f"fresh prompt {fresh * 1e3:.3f} ms"
+        )
+
+
+if __name__ == "__main__":
+    main()
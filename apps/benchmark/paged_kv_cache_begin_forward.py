@@ -0,0 +1,118 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the host-side cost of PagedAttentionKVCache BeginForward in decode.
+
+A batch of sequences is prefilled and then decoded one token per step, timing
+`vm.builtin.kv_state_begin_forward` only. In the "steady" mode the same batch
+is decoded every step, which takes the incremental metadata path. In the
+"rebuild" mode the batch order is rotated every step, which forces the full
+rebuild of the auxiliary arrays and serves as the baseline.
+
+The attention kernels are never launched, so placeholders are passed for them.
+
+Example:
+
+  python apps/benchmark/paged_kv_cache_begin_forward.py --batch-size 256 --context 1024
+"""
+import argparse
+import time
+
+import tvm
+from tvm.relax.frontend.nn.llm.kv_cache import AttnKind
+
+
+def create_kv_cache(batch_size, total_length, page_size, num_heads, head_dim):
+    fcreate = tvm.get_global_func("vm.builtin.paged_attention_kv_cache_create")
+
+    def placeholder(*args):
+        raise RuntimeError("The kernels are not expected to run in this benchmark")
+
+    backend = ["tir", placeholder]
+    return fcreate(
+        tvm.runtime.ShapeTuple([batch_size, total_length, 2048, page_size, 0]),
+        tvm.runtime.ShapeTuple([0, 1]),
+        num_heads,
+        num_heads,
+        head_dim,
+        head_dim,
+        tvm.runtime.ShapeTuple([int(AttnKind.MHA)]),
+        False,  # enable_kv_transfer
+        0,  # rope_mode
+        1.0,
+        1e4,
+        None,  # rope_ext_factors
+        tvm.nd.empty((), "float16", device=tvm.cpu()),
+        placeholder,  # f_transpose_append
+        None,  # f_transpose_append_mla
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        backend,
+        [],  # f_mla_prefill
+        [placeholder],
+        placeholder,
+        placeholder,
+        placeholder,
+        placeholder,
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--batch-size", type=int, default=256)
+    parser.add_argument("--context", type=int, default=1024, help="prefill length per sequence")
+    parser.add_argument("--steps", type=int, default=512)
+    parser.add_argument("--page-size", type=int, default=16)
+    args = parser.parse_args()
+
+    fbegin_forward = tvm.get_global_func("vm.builtin.kv_state_begin_forward")
+    fend_forward = tvm.get_global_func("vm.builtin.kv_state_end_forward")
+    fadd_sequence = tvm.get_global_func("vm.builtin.kv_state_add_sequence")
+
+    for mode in ["rebuild", "steady"]:
+        total_length = args.batch_size * (args.context + args.steps + args.page_size)
+        kv_cache = create_kv_cache(args.batch_size, total_length, args.page_size, 1, 8)
+        seq_ids = list(range(args.batch_size))
+        for seq_id in seq_ids:
+            fadd_sequence(kv_cache, seq_id)
+            fbegin_forward(
+                kv_cache, tvm.runtime.ShapeTuple([seq_id]), tvm.runtime.ShapeTuple([args.context])
+            )
+            fend_forward(kv_cache)
+
+        append_lengths = tvm.runtime.ShapeTuple([1] * args.batch_size)
+        elapsed = 0.0
+        for _ in range(args.steps):
+            if mode == "rebuild":
+                seq_ids = seq_ids[1:] + seq_ids[:1]
+            ids = tvm.runtime.ShapeTuple(seq_ids)
+            tic = time.perf_counter()
+            fbegin_forward(kv_cache, ids, append_lengths)
+            elapsed += time.perf_counter() - tic
+            fend_forward(kv_cache)
+        print(
+            f"{mode:>8}: batch {args.batch_size}, BeginForward "
+            f"{elapsed / args.steps * 1e6:.1f} us/step"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of forking sequences of the RNN state used by space state models.
+
+A root sequence is prefilled, and then forked into many concurrent branches as in
+beam search or tree speculative decoding. The forks share the state storage of the
+root, so the fork latency does not depend on the state size, and the number of
+branches is only bounded by the reserved sequences once the branches diverge. A
+decode step over a subset of the branches is timed as well, which is the point
+where the diverging branches get their own storage.
+
+Example:
+
+  python apps/benchmark/rnn_state_fork.py --state-size 2048 --num-branches 64
+"""
+import argparse
+import time
+
+import numpy as np
+
+import tvm
+from tvm.runtime import ShapeTuple
+from tvm.script import tir as T
+
+
+def rnn_state_kernels(reserved_nseq, max_history, state_size):
+    # fmt: off
+    @T.prim_func
+    def get_state(
+        var_storage: T.handle,
+        var_seq_slot_ids: T.handle,
+        var_history_slot_ids: T.handle,
+        var_output: T.handle,
+    ):
+        batch_size = T.int32(is_size_var=True)
+        storage = T.match_buffer(var_storage, (reserved_nseq, max_history, state_size), "float32")
+        seq_slot_ids = T.match_buffer(var_seq_slot_ids, (batch_size,), "int32")
+        history_slot_ids = T.match_buffer(var_history_slot_ids, (batch_size,), "int32")
+        output = T.match_buffer(var_output, (batch_size, state_size), "float32")
+        for i, s in T.grid(batch_size, state_size):
+            with T.block("copy"):
+                vi, vs = T.axis.remap("SS", [i, s])
+                output[vi, vs] = storage[seq_slot_ids[vi], history_slot_ids[vi], vs]
+
+    @T.prim_func
+    def set_state(
+        var_storage: T.handle,
+        var_seq_slot_ids: T.handle,
+        var_history_slot_ids: T.handle,
+        var_data: T.handle,
+    ):
+        batch_size = T.int32(is_size_var=True)
+        storage = T.match_buffer(var_storage, (reserved_nseq, max_history, state_size), "float32")
+        seq_slot_ids = T.match_buffer(var_seq_slot_ids, (batch_size,), "int32")
+        history_slot_ids = T.match_buffer(var_history_slot_ids, (batch_size,), "int32")
+        data = T.match_buffer(var_data, (batch_size, state_size), "float32")
+        for i, s in T.grid(batch_size, state_size):
+            with T.block("copy"):
+                vi, vs = T.axis.remap("SS", [i, s])
+                history_id: T.int32 = (history_slot_ids[vi] + 1) % max_history
+                storage[seq_slot_ids[vi], history_id, vs] = data[vi, vs]
+    # fmt: on
+
+    return [tvm.tir.build(f, target="llvm").entry_func for f in [get_state, set_state]]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-layers", type=int, default=32)
+    parser.add_argument("--state-size", type=int, default=2048)
+    parser.add_argument("--max-history", type=int, default=4)
+    parser.add_argument("--reserved-seqs", type=int, default=16)
+    parser.add_argument("--num-branches", type=int, default=64)
+    parser.add_argument("--num-diverging", type=int, default=8)
+    args = parser.parse_args()
+
+    f_create = tvm.get_global_func("vm.builtin.rnn_state_create")
+    f_add_sequence = tvm.get_global_func("vm.builtin.kv_state_add_sequence")
+    f_fork_sequence = tvm.get_global_func("vm.builtin.kv_state_fork_sequence")
+    f_remove_sequence = tvm.get_global_func("vm.builtin.kv_state_remove_sequence")
+    f_begin_forward = tvm.get_global_func("vm.builtin.kv_state_begin_forward")
+    f_end_forward = tvm.get_global_func("vm.builtin.kv_state_end_forward")
+    f_get = tvm.get_global_func("vm.builtin.rnn_state_get")
+    f_set = tvm.get_global_func("vm.builtin.rnn_state_set")
+
+    device = tvm.cpu()
+    f_tir_get, f_tir_set = rnn_state_kernels(args.reserved_seqs, args.max_history, args.state_size)
+    init = tvm.nd.array(np.zeros((args.state_size,), "float32"), device=device)
+    state = f_create(
+        args.num_layers, args.reserved_seqs, args.max_history, [f_tir_get], [f_tir_set], [init]
+    )
+    storage_bytes = args.num_layers * args.reserved_seqs * args.max_history * args.state_size * 4
+
+    f_add_sequence(state, 0)
+    tic = time.perf_counter()
+    for seq_id in range(1, args.num_branches + 1):
+        f_fork_sequence(state, 0, seq_id, -1)
+    fork_us = (time.perf_counter() - tic) / args.num_branches * 1e6
+
+    num_diverging = min(args.num_diverging, args.num_branches, args.reserved_seqs - 1)
+    seq_ids = list(range(1, num_diverging + 1))
+    data = tvm.nd.array(np.ones((num_diverging, args.state_size), "float32"), device=device)
+    out = tvm.nd.empty((num_diverging, args.state_size), "float32", device=device)
+    tic = time.perf_counter()
+    f_begin_forward(state, ShapeTuple(seq_ids), ShapeTuple([1] * num_diverging))
+    for layer_id in range(args.num_layers):
+        f_get(state, layer_id, 0, out)
+        f_set(state, layer_id, 0, data)
+    f_end_forward(state)
+    step_ms = (time.perf_counter() - tic) * 1e3
+
+    for seq_id in range(args.num_branches + 1):
+        f_remove_sequence(state, seq_id)
+    print(
+        f"fork: {fork_us:.2f} us/branch for {args.num_branches} branches of "
+        f"{args.num_layers}x{args.state_size} float32 states\n"
+        f"storage: {storage_bytes / 2**20:.1f} MiB for {args.reserved_seqs} reserved sequences\n"
+        f"decode step diverging {num_diverging} branches: {step_ms:.3f} ms"
+    )
+
+
+if __name__ == "__main__":
+    main()
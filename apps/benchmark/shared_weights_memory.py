@@ -0,0 +1,112 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Memory used by N worker processes loading the same ndarray cache on CPU.
+
+Each worker either loads a private copy of the weights with
+`vm.builtin.ndarray_cache.load`, or maps them from a shared memory region with
+`vm.builtin.ndarray_cache.load_shared`. Once every worker holds its weights the
+script reports per-process RSS and the proportional set size (PSS), whose sum
+is the physical memory actually used by the group. Linux only.
+
+Example:
+
+  python apps/benchmark/shared_weights_memory.py --num-procs 8 --size-mb 512
+"""
+import argparse
+import multiprocessing as mp
+import os
+import tempfile
+
+import numpy as np
+
+
+def read_memory_kb():
+    """Return (rss, pss) of the calling process in KB."""
+    values = {}
+    with open("/proc/self/smaps_rollup") as f:
+        for line in f:
+            parts = line.split()
+            if parts[0] in ("Rss:", "Pss:"):
+                values[parts[0]] = int(parts[1])
+    return values["Rss:"], values["Pss:"]
+
+
+def worker(cache_dir, mode, shm_name, barrier, results):
+    import tvm  # pylint: disable=import-outside-toplevel
+
+    if mode == "private":
+        tvm.get_global_func("vm.builtin.ndarray_cache.load")(cache_dir, tvm.cpu().device_type, 0)
+    else:
+        tvm.get_global_func("vm.builtin.ndarray_cache.load_shared")(cache_dir, shm_name)
+    params = tvm.get_global_func("vm.builtin.param_array_from_cache")("param", -1)
+    # Touch every weight, as inference would.
+    checksum = sum(float(p.numpy().ravel()[-1]) for p in params)
+    barrier.wait()
+    results.put(read_memory_kb() + (checksum,))
+    barrier.wait()
+    tvm.get_global_func("vm.builtin.ndarray_cache.clear")()
+
+
+def run(cache_dir, mode, num_procs):
+    ctx = mp.get_context("spawn")
+    barrier = ctx.Barrier(num_procs)
+    results = ctx.Queue()
+    shm_name = f"/tvm_bench_weights_{os.getpid()}"
+    procs = [
+        ctx.Process(target=worker, args=(cache_dir, mode, shm_name, barrier, results))
+        for _ in range(num_procs)
+    ]
+    for proc in procs:
+        proc.start()
+    stats = [results.get() for _ in range(num_procs)]
+    for proc in procs:
+        proc.join()
+    rss = sum(s[0] for s in stats) / 1024
+    pss = sum(s[1] for s in stats) / 1024
+    assert len({round(s[2], 3) for s in stats}) == 1, "workers disagree on the weights"
+    print(
+        f"{mode:<8} {num_procs} procs  total RSS {rss:10.1f} MB  total PSS {pss:10.1f} MB  "
+        f"PSS/proc {pss / num_procs:8.1f} MB"
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--num-procs", type=int, default=8)
+    parser.add_argument("--size-mb", type=int, default=512, help="Total size of the weights.")
+    parser.add_argument("--num-params", type=int, default=64)
+    args = parser.parse_args()
+
+    from tvm.contrib import tvmjs  # pylint: disable=import-outside-toplevel
+
+    numel = args.size_mb * 1024 * 1024 // 4 // args.num_params
+    rng = np.random.default_rng(0)
+    with tempfile.TemporaryDirectory() as cache_dir:
+        params = {
+            f"param_{i}": rng.standard_normal(numel, dtype="float32")
+            for i in range(args.num_params)
+        }
+        tvmjs.dump_ndarray_cache(params, cache_dir, encode_format="raw", show_progress=False)
+        del params
+        print(f"{args.size_mb} MB of float32 weights in {args.num_params} tensors")
+        run(cache_dir, "private", args.num_procs)
+        run(cache_dir, "shared", args.num_procs)
+
+
+if __name__ == "__main__":
+    main()
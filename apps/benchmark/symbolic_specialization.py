@@ -0,0 +1,93 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of SpecializeSymbolicVars on the batch-1 decode step of a transformer MLP on CPU.
+
+The layers are compiled for a symbolic number of tokens `seq_len`, which is 1 at each
+decode step. The model is compiled once with its generic kernels, and once with the
+hot values of `--hot-values` specialized by `SpecializeSymbolicVars`. Both are timed at
+each of the hot values, and at `--cold-value` which runs the generic body in both.
+
+Example:
+
+  python apps/benchmark/symbolic_specialization.py --hidden 1024 --hot-values 1 16
+"""
+import argparse
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_model(args):
+    rng = np.random.default_rng(0)
+    hidden, ffn = args.hidden, 4 * args.hidden
+
+    def weight(*shape):
+        return relax.const((rng.standard_normal(shape) * 0.05).astype("float32"))
+
+    x = relax.Var("x", relax.TensorStructInfo((1, "seq_len", hidden), "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            for _ in range(args.num_layers):
+                h = bb.emit(relax.op.nn.rms_norm(x, weight(hidden), axes=[-1]))
+                gate = bb.emit(relax.op.nn.silu(relax.op.matmul(h, weight(hidden, ffn))))
+                up = bb.emit(relax.op.matmul(h, weight(hidden, ffn)))
+                down = relax.op.matmul(relax.op.multiply(gate, up), weight(ffn, hidden))
+                x = bb.emit(relax.op.add(x, down))
+            gv = bb.emit_output(x)
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+def compile_model(args, mod, hot_values):
+    if hot_values:
+        mod = relax.transform.SpecializeSymbolicVars({"seq_len": hot_values})(mod)
+    mod = relax.transform.LegalizeOps()(mod)
+    return relax.VirtualMachine(tvm.compile(mod, args.target), tvm.cpu())
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--num-layers", type=int, default=4)
+    parser.add_argument("--hot-values", type=int, nargs="+", default=[1])
+    parser.add_argument("--cold-value", type=int, default=7)
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    mod = build_model(args)
+    generic = compile_model(args, mod, [])
+    specialized = compile_model(args, mod, args.hot_values)
+    rng = np.random.default_rng(1)
+    for seq_len in [*args.hot_values, args.cold_value]:
+        x = tvm.nd.array(rng.standard_normal((1, seq_len, args.hidden)).astype("float32"))
+        times = [
+            vm.time_evaluator("main", tvm.cpu(), number=args.repeat, min_repeat_ms=200)(x).mean
+            for vm in [generic, specialized]
+        ]
+        print(
+            f"seq_len={seq_len}: generic {times[0] * 1e3:.3f} ms, "
+            f"specialized {times[1] * 1e3:.3f} ms, speedup {times[0] / times[1]:.2f}x"
+        )
+
+
+if __name__ == "__main__":
+    main()
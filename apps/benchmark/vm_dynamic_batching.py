@@ -0,0 +1,185 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the dynamic batching layer of the Relax VM on CPU.
+
+Requests of a single row arrive following a Poisson process and are served
+either one at a time by the VM, or through `vm.builtin.dynamic_batcher_*`
+which groups them into batches padded to power-of-two buckets. Both servers
+run the same MLP compiled once with a symbolic batch dimension.
+
+Example:
+
+  python apps/benchmark/vm_dynamic_batching.py --rate 2000 --num-requests 4000
+"""
+import argparse
+import queue
+import threading
+import time
+
+import numpy as np
+
+import tvm
+from tvm import relax
+from tvm.script import relax as R
+
+
+def build_mlp(hidden):
+    """Build a two layer MLP with a symbolic batch dimension."""
+
+    @tvm.script.ir_module
+    class MLP:
+        @R.function
+        def main(
+            x: R.Tensor(("n", hidden), "float32"),
+            w0: R.Tensor((hidden, hidden), "float32"),
+            w1: R.Tensor((hidden, hidden), "float32"),
+        ):
+            with R.dataflow():
+                h = R.nn.relu(R.matmul(x, w0))
+                y = R.matmul(h, w1)
+                R.output(y)
+            return y
+
+    ex = relax.build(MLP, target="llvm")
+    return relax.VirtualMachine(ex, tvm.cpu())
+
+
+def poisson_arrivals(rate, num_requests, seed):
+    rng = np.random.default_rng(seed)
+    return np.cumsum(rng.exponential(1.0 / rate, num_requests))
+
+
+def report(name, latencies, elapsed):
+    latencies = np.array(latencies) * 1e3
+    print(
+        f"{name:<12} throughput {len(latencies) / elapsed:10.1f} req/s  "
+        f"latency p50 {np.percentile(latencies, 50):8.3f} ms  "
+        f"p99 {np.percentile(latencies, 99):8.3f} ms  "
+        f"mean {latencies.mean():8.3f} ms"
+    )
+
+
+def drive(arrivals, inputs, submit, wait):
+    """Submit requests at their arrival times and wait for them in order."""
+    pending = queue.Queue()
+    latencies = []
+
+    def waiter():
+        for _ in range(len(arrivals)):
+            handle, arrive = pending.get()
+            wait(handle)
+            latencies.append(time.perf_counter() - arrive)
+
+    thread = threading.Thread(target=waiter)
+    thread.start()
+    start = time.perf_counter()
+    for arrival, x in zip(arrivals, inputs):
+        delay = start + arrival - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        pending.put((submit(x), time.perf_counter()))
+    thread.join()
+    return latencies, time.perf_counter() - start
+
+
+def bench_unbatched(vm, weights, arrivals, inputs):
+    """Serve the requests one at a time from a single server thread."""
+    requests = queue.Queue()
+
+    def server():
+        while True:
+            item = requests.get()
+            if item is None:
+                return
+            x, done = item
+            vm["main"](x, *weights)
+            done.set()
+
+    thread = threading.Thread(target=server)
+    thread.start()
+
+    def submit(x):
+        done = threading.Event()
+        requests.put((x, done))
+        return done
+
+    result = drive(arrivals, inputs, submit, lambda done: done.wait())
+    requests.put(None)
+    thread.join()
+    return result
+
+
+def bench_batched(vm, weights, arrivals, inputs, max_batch_size, timeout_us):
+    buckets = []
+    size = 1
+    while size < max_batch_size:
+        buckets.append(size)
+        size *= 2
+    buckets.append(max_batch_size)
+    batcher = tvm.get_global_func("vm.builtin.dynamic_batcher_create")(
+        vm["main"], weights, max_batch_size, timeout_us, tvm.runtime.ShapeTuple(buckets)
+    )
+    fsubmit = tvm.get_global_func("vm.builtin.dynamic_batcher_submit")
+    fwait = tvm.get_global_func("vm.builtin.batch_request_wait")
+    result = drive(arrivals, inputs, lambda x: fsubmit(batcher, [x]), fwait)
+    num_batches = tvm.get_global_func("vm.builtin.dynamic_batcher_num_batches")(batcher)
+    tvm.get_global_func("vm.builtin.dynamic_batcher_shutdown")(batcher)
+    return result, num_batches
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--hidden", type=int, default=512)
+    parser.add_argument("--rate", type=float, default=2000.0, help="Mean arrivals per second.")
+    parser.add_argument("--num-requests", type=int, default=2000)
+    parser.add_argument("--max-batch-size", type=int, default=32)
+    parser.add_argument("--timeout-us", type=int, default=2000)
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+
+    vm = build_mlp(args.hidden)
+    rng = np.random.default_rng(args.seed)
+    weights = [
+        tvm.nd.array(rng.standard_normal((args.hidden, args.hidden)).astype("float32") * 0.05)
+        for _ in range(2)
+    ]
+    inputs = [
+        tvm.nd.array(rng.standard_normal((1, args.hidden)).astype("float32"))
+        for _ in range(args.num_requests)
+    ]
+    arrivals = poisson_arrivals(args.rate, args.num_requests, args.seed)
+
+    # Warm up both paths on every bucket size.
+    for size in range(1, args.max_batch_size + 1):
+        vm["main"](tvm.nd.array(np.zeros((size, args.hidden), "float32")), *weights)
+
+    print(f"Poisson arrivals at {args.rate} req/s, {args.num_requests} requests")
+    latencies, elapsed = bench_unbatched(vm, weights, arrivals, inputs)
+    report("unbatched", latencies, elapsed)
+    (latencies, elapsed), num_batches = bench_batched(
+        vm, weights, arrivals, inputs, args.max_batch_size, args.timeout_us
+    )
+    report("batched", latencies, elapsed)
+    print(
+        f"batched run used {num_batches} batches, "
+        f"{args.num_requests / num_batches:.2f} req/batch"
+    )
+
+
+if __name__ == "__main__":
+    main()
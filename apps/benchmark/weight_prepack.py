@@ -0,0 +1,113 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""
+Benchmark of the compile-time weight prepacking of a tuned MLP on CPU.
+
+The MLP is tuned by `static_shape_tuning_pipeline` with `cpu_weight_prepack`, so
+that its matmuls read their weights in the layouts chosen by tuning. The weights
+are prepacked at compile time, being kept in the "params" attribute of the model.
+The script checks that no transform of the weights is left at runtime, and times
+the model against the one tuned without the layout rewrite.
+
+Example:
+
+  python apps/benchmark/weight_prepack.py --total-trials 256 --target "llvm -num-cores 8"
+"""
+import argparse
+import tempfile
+
+import numpy as np
+
+import tvm
+from tvm import relax
+
+
+def build_model(args):
+    rng = np.random.default_rng(0)
+    x = relax.Var("x", relax.TensorStructInfo((args.batch, args.hidden), "float32"))
+    weights = [
+        relax.Var(f"w{i}", relax.TensorStructInfo((args.hidden, args.hidden), "float32"))
+        for i in range(args.num_layers)
+    ]
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x, *weights], {"num_input": 1}):
+        with bb.dataflow():
+            y = x
+            for weight in weights:
+                y = bb.emit(relax.op.nn.relu(relax.op.matmul(y, weight)))
+            gv = bb.emit_output(y)
+        bb.emit_func_output(gv)
+    params = [
+        tvm.nd.array(rng.standard_normal((args.hidden, args.hidden)).astype("float32") * 0.05)
+        for _ in weights
+    ]
+    mod = bb.get()
+    mod["main"] = mod["main"].with_attr("params", params)
+    return mod
+
+
+def count_weight_transforms(mod):
+    """The number of the calls in main to the layout rewrites of the weights."""
+    return sum(
+        1
+        for block in mod["main"].body.blocks
+        for binding in block.bindings
+        if isinstance(binding.value, relax.Call)
+        and binding.value.op.name == "relax.call_tir"
+        and binding.value.args[0].name_hint.endswith("weight_prepack")
+    ) + int("main_transform_params" in mod)
+
+
+def compile_and_time(args, mod, prepack):
+    target = tvm.target.Target(args.target)
+    with tempfile.TemporaryDirectory() as work_dir:
+        mod = relax.get_pipeline(
+            "static_shape_tuning",
+            total_trials=args.total_trials,
+            target=target,
+            work_dir=work_dir,
+            cpu_weight_prepack=prepack,
+        )(mod)
+    num_transforms = count_weight_transforms(mod)
+    mod, params = relax.frontend.detach_params(mod)
+    ex = tvm.compile(mod, target)
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    x = tvm.nd.array(np.random.standard_normal((args.batch, args.hidden)).astype("float32"))
+    timer = vm.time_evaluator("main", tvm.cpu(), number=10, repeat=args.repeat)
+    return timer(x, *params["main"]).mean, num_transforms
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--num-layers", type=int, default=4)
+    parser.add_argument("--batch", type=int, default=64)
+    parser.add_argument("--hidden", type=int, default=1024)
+    parser.add_argument("--total-trials", type=int, default=64)
+    parser.add_argument("--target", type=str, default="llvm -num-cores 4")
+    parser.add_argument("--repeat", type=int, default=10)
+    args = parser.parse_args()
+
+    for prepack in [False, True]:
+        elapsed, num_transforms = compile_and_time(args, build_model(args), prepack)
+        print(
+            f"cpu_weight_prepack={prepack}: {elapsed * 1e3:.3f} ms, "
+            f"{num_transforms} runtime weight transforms"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -1056,6 +1056,13 @@ constexpr const char* kForcePure = "relax.force_pure";
  * arguments are assumed to be weights that are fixed across invocations.
  */
 constexpr const char* kNumInput = "num_input";
+
+/*!
+ * \brief Memoize the outputs of the calls to this function, keyed by the values of their inputs.
+ * The value is the capacity in bytes of the LRU cache of the outputs and the inputs kept to check
+ * the hits. The calls that hit the cache return copies of the cached outputs.
+ */
+constexpr const char* kMemoize = "relax.memoize";
 }  // namespace attr
 
 /*! \brief The extern function, which can represent packed function. */
@@ -216,6 +216,47 @@ TVM_DLL Pass BindParams(String func_name, Map<ObjectRef, ObjectRef> params);
 TVM_DLL Pass BindSymbolicVars(Map<ObjectRef, PrimExpr> binding_map,
                               Optional<String> func_name = std::nullopt);
 
+/*!
+ * \brief Multi-version functions for the hot values of their symbolic vars.
+ *
+ * For each combination of the hot values, the function is cloned with the symbolic
+ * vars bound as by BindSymbolicVars, and the PrimFuncs called by the clone are
+ * specialized for the static shapes of their arguments. The function dispatches on
+ * entry to the clone of the values of its arguments, and runs its generic body for
+ * the other values.
+ *
+ * \param hot_values The hot values of the symbolic variables, which must be defined
+ *      by the parameters of the functions. Keys may be either a `tir.Var` or a string
+ *      name of the variable, as in BindSymbolicVars.
+ *
+ * \param func_name The name of the function to multi-version.  If std::nullopt, all
+ *      functions within the module that use the variables are updated.
+ *
+ * \return The Pass.
+ */
+TVM_DLL Pass SpecializeSymbolicVars(Map<ObjectRef, Array<PrimExpr>> hot_values,
+                                    Optional<String> func_name = std::nullopt);
+
+/*!
+ * \brief Convert a function over a sequence into a function over the chunks of the sequence.
+ *
+ * The first parameter of the function is the sequence, along its last axis. The sequence
+ * may flow through causal nn.conv1d, nn.max_pool1d and nn.avg_pool1d, nn.pad of its start
+ * and element-wise ops. Each window op carries the last frames of its input over from a
+ * chunk to the next as a state, in place of its padding, so that the memory of the streaming
+ * function does not grow with the length of the sequence.
+ *
+ * The pass adds the function `<func_name>_stream` of signature
+ * (chunk, states..., params...) -> (output chunk, next states), and the function
+ * `<func_name>_stream_init` of signature (chunk) -> states, which returns the states
+ * before the first chunk.
+ *
+ * \param func_name The name of the function to convert.
+ * \param chunk_size The number of frames of the input chunks.
+ * \return The Pass.
+ */
+TVM_DLL Pass ConvertToStreaming(String func_name, int chunk_size);
+
 /*!
  * \brief Fold constant expressions within dataflow blocks.
  *
@@ -547,6 +588,17 @@ TVM_DLL Pass MergeCompositeFunctions();
  */
 TVM_DLL Pass FuseTIR();
 
+/*!
+ * \brief Fuse the independent small call_tir of the dataflow blocks into one PrimFunc that
+ * runs all of them in one parallel loop, to pay one parallel launch instead of one per
+ * kernel. Each kernel splits into tasks along its outermost spatial loop. Run after the
+ * kernels are scheduled, for CPU.
+ * \param max_work The maximum number of innermost loop iterations of a kernel to fuse.
+ * \param max_num_kernels The maximum number of kernels fused into one PrimFunc.
+ * \return The Pass.
+ */
+TVM_DLL Pass HorizontalFuseTIR(int64_t max_work, int max_num_kernels);
+
 /*!
  * \brief Run codegen.
  * \param target_options pairs of target name and compilation options
@@ -643,16 +695,22 @@ TVM_DLL Pass DataflowUseInplaceCalls();
 
 /*!
  * \brief Automatic mixed precision pass. Currently the pass assumes the input module to be fp32
- * only, and will automatically cast fp32 to fp16 for certain ops.
+ * only, and will automatically cast fp32 to fp16 (or bf16) for certain ops.
  * \param out_dtype The output data type of gemm/conv, which is the data type of the accumulator.
- * \param fp16_input_names The names of function parameters whose dtype should become fp16. The
- * function signature would change accordingly.
+ * \param fp16_input_names The names of function parameters whose dtype should become the low
+ * precision dtype. The function signature would change accordingly.
+ * \param low_dtype The low precision dtype, float16 or bfloat16.
+ * \param op_dtypes The dtypes chosen for op calls, e.g. by calibration, keyed by the name of the
+ * var each call is bound to. The value is float32 or the low precision dtype, and overrides the
+ * mixed precision policy of the op.
  * \return The Pass.
  *
  * \note Mainly operates within dataflow blocks. ConvertToDataflow may need to be called first.
  */
 TVM_DLL Pass ToMixedPrecision(const DataType& out_dtype,
-                              Optional<Array<String>> fp16_input_names = std::nullopt);
+                              Optional<Array<String>> fp16_input_names = std::nullopt,
+                              DataType low_dtype = DataType::Float(16),
+                              Optional<Map<String, String>> op_dtypes = std::nullopt);
 
 /*!
  * \brief Rewrite a Relax module for executing with CUDA graph. This pass identifies
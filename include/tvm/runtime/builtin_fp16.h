@@ -36,4 +36,25 @@ TVM_DLL uint16_t __truncdfhf2(double v);
 TVM_DLL float __extendhfsf2(uint16_t v);
 }
 
+namespace tvm {
+namespace runtime {
+
+/*!
+ * \brief Convert an array of float32 to IEEE float16, rounding like __gnu_f2h_ieee.
+ *  The conversion is vectorized, and split over the thread pool when large.
+ */
+TVM_DLL void Float32ToFloat16Array(const float* from, uint16_t* to, int64_t num_elems);
+
+/*! \brief Convert an array of IEEE float16 to float32, see Float32ToFloat16Array. */
+TVM_DLL void Float16ToFloat32Array(const uint16_t* from, float* to, int64_t num_elems);
+
+/*! \brief Convert an array of float32 to bfloat16, rounding to nearest even. */
+TVM_DLL void Float32ToBFloat16Array(const float* from, uint16_t* to, int64_t num_elems);
+
+/*! \brief Convert an array of bfloat16 to float32. */
+TVM_DLL void BFloat16ToFloat32Array(const uint16_t* from, float* to, int64_t num_elems);
+
+}  // namespace runtime
+}  // namespace tvm
+
 #endif  // TVM_RUNTIME_BUILTIN_FP16_H_
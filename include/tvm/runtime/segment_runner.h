@@ -14,16 +14,25 @@ namespace runtime {
 class SegmentRunner : public ffi::Object {
 public:
     SegmentRunner(const Module& exec, Device device);
+    ~SegmentRunner();
 
     std::string GetRuntimeSequence();
     int Load(const std::string runtime_sequence);
     void SetInput(std::vector<NDArray>& input);
     void SetInputWithParams(std::vector<NDArray>& input, std::vector<NDArray>& params);
+    // Stage copies of the input on a copy stream of the device and return immediately,
+    // so that the copies overlap with segments that are still running on the previous input.
+    void PrefetchInput(std::vector<NDArray>& input);
+    // Wait for the copies issued by PrefetchInput and set them as the input.
+    void SetPrefetchedInput();
     std::vector<NDArray> GetOutput();
     void Execute(const int segment_id);
     size_t GetLength();
 private:
     Module vm_module_;
+    Device device_;
+    TVMStreamHandle copy_stream_ = nullptr;
+    std::vector<NDArray> prefetched_input_;
     std::vector<std::vector<int64_t>> segment_list_;
     bool is_initialized_ = false;
 };
@@ -149,6 +149,13 @@ TVM_DLL void Configure(tvm::runtime::threading::ThreadGroup::AffinityMode mode,
  */
 TVM_DLL int32_t NumThreads();
 
+/*!
+ * \brief Whether the calling thread runs a task of a parallel job, where launching
+ *  another parallel job is not allowed.
+ * \return True on a worker of the thread pool, or on a thread inside TVMBackendParallelLaunch.
+ */
+TVM_DLL bool InParallelTask();
+
 }  // namespace threading
 
 /*!
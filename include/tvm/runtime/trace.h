@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/trace.h
+ * \brief Low-overhead event tracing for the runtime.
+ *
+ *  Each thread records events into its own fixed-size ring buffer without
+ *  taking locks, the oldest events are overwritten when the ring is full.
+ *  The collected events can be dumped as Chrome trace JSON through the
+ *  `runtime.TraceDumpJSON` global function.
+ *
+ *  Tracing is off by default and is turned on by `runtime.TraceSetEnabled`
+ *  or by setting the environment variable `TVM_TRACE=1`. When it is off an
+ *  instrumentation point costs a single relaxed load and branch.
+ *
+ *  Event names and categories are stored as raw pointers, so they must
+ *  outlive the trace. Use string literals, or TraceInternString for names
+ *  that are built at runtime.
+ */
+#ifndef TVM_RUNTIME_TRACE_H_
+#define TVM_RUNTIME_TRACE_H_
+
+#include <tvm/runtime/base.h>
+#include <tvm/runtime/object.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace tvm {
+namespace runtime {
+
+/*! \brief Global switch of the tracer, use TraceEnabled to read it. */
+TVM_DLL extern std::atomic<bool> trace_enabled_flag;
+
+/*! \return Whether tracing is currently enabled. */
+inline bool TraceEnabled() { return trace_enabled_flag.load(std::memory_order_relaxed); }
+
+/*! \brief Enable or disable tracing. */
+TVM_DLL void TraceSetEnabled(bool enabled);
+
+/*! \return The current trace timestamp in nanoseconds. */
+TVM_DLL uint64_t TraceNowNs();
+
+/*!
+ * \brief Record a complete event into the ring buffer of the calling thread.
+ * \param category The event category, e.g. "vm" or "alloc".
+ * \param name The event name.
+ * \param begin_ns The begin timestamp from TraceNowNs.
+ * \param end_ns The end timestamp from TraceNowNs.
+ * \param arg An integer argument attached to the event.
+ */
+TVM_DLL void TraceRecord(const char* category, const char* name, uint64_t begin_ns,
+                         uint64_t end_ns, int64_t arg);
+
+/*!
+ * \brief Record an instant event into the ring buffer of the calling thread.
+ * \param category The event category.
+ * \param name The event name.
+ * \param arg An integer argument attached to the event.
+ */
+TVM_DLL void TraceRecordInstant(const char* category, const char* name, int64_t arg);
+
+/*!
+ * \brief Intern a string so that it can be used as an event name.
+ * \param name The string to intern.
+ * \return A pointer that stays valid until the process exits.
+ */
+TVM_DLL const char* TraceInternString(const std::string& name);
+
+/*! \brief Drop all the events recorded so far. */
+TVM_DLL void TraceClear();
+
+/*! \return All the recorded events formatted as Chrome trace JSON. */
+TVM_DLL std::string TraceDumpJSON();
+
+/*!
+ * \brief RAII helper which records a complete event covering its lifetime.
+ *  Whether tracing is enabled is checked once on construction.
+ */
+class TraceScope {
+ public:
+  TraceScope(const char* category, const char* name, int64_t arg = 0) {
+    if (TraceEnabled()) {
+      Begin(category, name, arg);
+    }
+  }
+  TraceScope(const char* category, const std::string& name, int64_t arg = 0) {
+    if (TraceEnabled()) {
+      Begin(category, TraceInternString(name), arg);
+    }
+  }
+  ~TraceScope() {
+    if (begin_ns_ != 0) {
+      TraceRecord(category_, name_, begin_ns_, TraceNowNs(), arg_);
+    }
+  }
+  TraceScope(const TraceScope& other) = delete;
+  TraceScope(TraceScope&& other) = delete;
+  TraceScope& operator=(const TraceScope& other) = delete;
+  TraceScope& operator=(TraceScope&& other) = delete;
+
+ private:
+  void Begin(const char* category, const char* name, int64_t arg) {
+    category_ = category;
+    name_ = name;
+    arg_ = arg;
+    begin_ns_ = TraceNowNs();
+  }
+
+  const char* category_ = nullptr;
+  const char* name_ = nullptr;
+  int64_t arg_ = 0;
+  uint64_t begin_ns_ = 0;
+};
+
+/*! \brief Trace the enclosing scope as an event with the given category and name. */
+#define TVM_TRACE_SCOPE(category, name) \
+  ::tvm::runtime::TraceScope TVM_STR_CONCAT(_tvm_trace_scope_, __LINE__)(category, name)
+
+/*! \brief Same as TVM_TRACE_SCOPE with an integer argument attached to the event. */
+#define TVM_TRACE_SCOPE_ARG(category, name, arg) \
+  ::tvm::runtime::TraceScope TVM_STR_CONCAT(_tvm_trace_scope_, __LINE__)(category, name, arg)
+
+/*! \brief Record an instant event with an integer argument. */
+#define TVM_TRACE_INSTANT(category, name, arg)                  \
+  do {                                                         \
+    if (::tvm::runtime::TraceEnabled()) {                      \
+      ::tvm::runtime::TraceRecordInstant(category, name, arg); \
+    }                                                          \
+  } while (0)
+
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_TRACE_H_
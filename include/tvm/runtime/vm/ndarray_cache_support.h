@@ -49,6 +49,16 @@ struct NDArrayCacheMetadata {
       TVM_DLL NDArray Load(Device device, const std::string* raw_data,
                            Optional<NDArray>* staging_buffer = nullptr) const;
 
+      /*!
+       * \brief Load the parameter from raw data into an existing array.
+       * \param arr The destination array, with the shape and dtype of the parameter.
+       * \param raw_data The raw data stream
+       * \param staging_buffer The buffer to be used to avoid extra OpenCL copies. Pass in a nullptr
+       * in other cases
+       */
+      TVM_DLL void LoadInto(NDArray arr, const std::string* raw_data,
+                            Optional<NDArray>* staging_buffer = nullptr) const;
+
       /*! \brief Name of the parameter */
       std::string name;
       /*! \brief Shape of the parameter */
@@ -83,6 +93,19 @@ struct NDArrayCacheMetadata {
   /*! \brief The path to the `ndarray-cache.json` file */
   std::string path;
 
+  /*!
+   * \brief Load all the parameters into a named, read-only shared memory region on the CPU.
+   *
+   * The first process to use a given name creates the region and decodes the parameters
+   * into it, the other processes wait for it to be ready and map the same pages. The
+   * returned arrays are views that keep the mapping alive, and the region is unlinked
+   * once the last process releases it. Only supported on POSIX systems.
+   *
+   * \param shm_name The name of the shared memory region, e.g. "/tvm-llama-weights".
+   * \return The parameters in the order of the records.
+   */
+  TVM_DLL Array<NDArray> LoadShared(const std::string& shm_name) const;
+
   /*! \brief Load the metadata from a specific directory */
   TVM_DLL static NDArrayCacheMetadata Load(const std::string& path);
   /*! \brief Load the metadata from a given JSON string */
@@ -117,3 +117,6 @@ from . import utils
 from .vm_build import build, VMExecutable
 
 from .binding_rewrite import DataflowBlockRewrite
+
+# Streaming
+from .streaming import StreamingRunner
@@ -137,3 +137,34 @@ def outer(x1: Expr, x2: Expr) -> Expr:
         The resulting expression representing the outer product.
     """
     return _ffi_api.outer(x1, x2)
+
+
+def sparse_dense(x: Expr, weight_data: Expr, weight_indices: Expr, weight_indptr: Expr) -> Expr:
+    """Multiply a dense tensor by the transpose of a block-sparse (BSR) weight.
+
+    The weight of shape (N, K) is stored in the block compressed sparse row format:
+    block row `i` holds the blocks `weight_data[weight_indptr[i]:weight_indptr[i + 1]]`,
+    and the block `b` lies at the block column `weight_indices[b]`. The result is
+    `matmul(x, permute_dims(weight))`, the same as `linear(x, weight)` without bias.
+
+    Parameters
+    ----------
+    x : relax.Expr
+        The dense input tensor, whose last dimension has length K.
+
+    weight_data : relax.Expr
+        The nonzero blocks of the weight, of shape (nnz_blocks, bs_r, bs_c).
+
+    weight_indices : relax.Expr
+        The integer block column index of each nonzero block, of shape (nnz_blocks,).
+
+    weight_indptr : relax.Expr
+        The integer position of the first nonzero block of each block row, of shape
+        (N / bs_r + 1,).
+
+    Returns
+    -------
+    result : relax.Expr
+        The result of shape `x.shape[:-1] + (N,)`.
+    """
+    return _ffi_api.sparse_dense(x, weight_data, weight_indices, weight_indptr)  # type: ignore
@@ -153,6 +153,21 @@ def static_shape_tuning_pipeline(
 
         input_data = tvm.nd.array(np.random.randn(1, 3, 224, 224).astype("float32"))
         out = vm["main"](input_data, *params).numpy()
+
+    When the weights are kept in the "params" attribute of the function, e.g. by the
+    `keep_params_in_input` option of the frontends, they are prepacked at compile time
+    instead, and the function takes the prepacked weights with no transform at runtime:
+
+    .. code-block:: python
+
+        mod = relax.pipeline.static_shape_tuning_pipeline(
+            total_trials=1000, target=target, cpu_weight_prepack=True
+        )(mod)
+        mod, params = relax.frontend.detach_params(mod)
+
+        ex = tvm.compile(mod, target=target)
+        vm = relax.VirtualMachine(ex, device=tvm.cpu())
+        out = vm["main"](input_data, *params["main"]).numpy()
     """
 
     @tvm.transform.module_pass(opt_level=0)
@@ -160,8 +175,7 @@ def static_shape_tuning_pipeline(
         if cpu_weight_prepack:
             pre_tuning_layout_rewrite = [transform.AttachAttrLayoutFreeBuffers()]
             post_tuning_layout_rewrite = [
-                transform.SplitLayoutRewritePreproc(),
-                transform.LiftTransformParams(),
+                transform.PrepackWeights(),
                 transform.FoldConstant(),
             ]
         else:
@@ -0,0 +1,110 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""The runner of the streaming functions made by `relax.transform.ConvertToStreaming`."""
+from typing import Optional
+
+import numpy as np
+
+import tvm
+from tvm.runtime import Device, NDArray
+from tvm.runtime.vm import VirtualMachine
+
+
+class StreamingRunner:
+    """Feed a sequence chunk by chunk to a streaming function, carrying its states over.
+
+    Parameters
+    ----------
+    vm : tvm.relax.VirtualMachine
+        The VM of the module converted by `relax.transform.ConvertToStreaming`.
+
+    func_name : str
+        The name of the converted function.
+    """
+
+    def __init__(self, vm: VirtualMachine, func_name: str = "main"):
+        self._stream_func = vm[func_name + "_stream"]
+        self._init_func = vm[func_name + "_stream_init"]
+        self._states = None
+
+    def reset(self):
+        """Start a new sequence."""
+        self._states = None
+
+    def feed(self, chunk: NDArray, *params: NDArray) -> NDArray:
+        """Run the streaming function on the next chunk of the sequence.
+
+        Parameters
+        ----------
+        chunk : NDArray
+            The next chunk, of the chunk size given to `ConvertToStreaming`.
+
+        params : NDArray
+            The other parameters of the function, such as the weights.
+
+        Returns
+        -------
+        output : NDArray
+            The chunk of the output of the function.
+        """
+        if self._states is None:
+            self._states = list(self._init_func(chunk))
+        output, states = self._stream_func(chunk, *self._states, *params)
+        self._states = list(states)
+        return output
+
+    def run(
+        self,
+        sequence: np.ndarray,
+        chunk_size: int,
+        *params: NDArray,
+        device: Optional[Device] = None,
+    ) -> np.ndarray:
+        """Stream a whole sequence, from the start, and concatenate the output chunks.
+
+        Parameters
+        ----------
+        sequence : np.ndarray
+            The sequence along the last axis, whose length is a multiple of the chunk size.
+
+        chunk_size : int
+            The chunk size given to `ConvertToStreaming`.
+
+        params : NDArray
+            The other parameters of the function, such as the weights.
+
+        device : Optional[Device]
+            The device of the chunks. Defaults to the CPU.
+
+        Returns
+        -------
+        output : np.ndarray
+            The output of the function over the sequence.
+        """
+        length = sequence.shape[-1]
+        if length % chunk_size != 0:
+            raise ValueError(
+                f"The length of the sequence, {length}, is not a multiple of the chunk size, "
+                f"{chunk_size}"
+            )
+        device = device if device is not None else tvm.cpu()
+        self.reset()
+        outputs = []
+        for start in range(0, length, chunk_size):
+            chunk = tvm.nd.array(sequence[..., start : start + chunk_size], device)
+            outputs.append(self.feed(chunk, *params).numpy())
+        return np.concatenate(outputs, axis=-1)
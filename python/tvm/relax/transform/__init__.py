@@ -32,6 +32,7 @@ from .transform import (
     ComputePrimValue,
     ConvertLayout,
     ConvertToDataflow,
+    ConvertToStreaming,
     DataflowBlockPass,
     DataflowUseInplaceCalls,
     DeadCodeElimination,
@@ -46,6 +47,7 @@ from .transform import (
     FuseOps,
     FuseOpsByPattern,
     FuseTIR,
+    HorizontalFuseTIR,
     FusionPattern,
     Gradient,
     InlinePrivateFunctions,
@@ -73,6 +75,7 @@ from .transform import (
     RewriteCUDAGraph,
     RewriteDataflowReshape,
     RunCodegen,
+    SpecializeSymbolicVars,
     SplitCallTIRByPattern,
     SplitLayoutRewritePreproc,
     StaticPlanBlockMemory,
@@ -88,12 +91,16 @@ from .transform import (
 )
 
 from .attach_external_modules import AttachExternModules
+from .calibrate_mixed_precision import CalibrateMixedPrecision
+from .convert_dense_to_bsr import ConvertDenseToBSR
 from .fast_math import FastMathTransform
 from .fuse_transpose_matmul import FuseTransposeMatmul
+from .insert_lora_branch import InsertLoRABranch
 from .ipc_allreduce_rewrite import IPCAllReduceRewrite
 from .lazy_transform_params import LazyTransformParams
 from .lower_gpu_ipc_alloc_storage import LowerGPUIPCAllocStorage
 from .optimize_layout_transform import OptimizeLayoutTransform
+from .prepack_weights import PrepackWeights
 from .fold_batch_norm_to_conv2d_for_inference import FoldBatchnormToConv2D
 from .remove_redundant_reshape import RemoveRedundantReshape
 
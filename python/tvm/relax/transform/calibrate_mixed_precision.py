@@ -0,0 +1,186 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Choose the dtype of each op for mixed precision from the error measured on a sample input."""
+
+from typing import Dict, List, Optional, Union
+
+import numpy as np
+
+import tvm
+from tvm import relax
+from tvm.ir.module import IRModule
+
+# The values of MixedPrecisionPolicyKind in src/relax/transform/infer_amp_utils.h.
+_POLICY_ALWAYS = 0
+_POLICY_FOLLOW = 1
+
+
+@tvm.transform.module_pass(opt_level=0, name="CalibrateMixedPrecision")
+class CalibrateMixedPrecision:
+    """Convert a function to mixed precision, with the dtype of each op chosen by calibration.
+
+    The candidates are the calls in the dataflow blocks of the function to the ops whose
+    mixed precision policy is kAlways (e.g. matmul and conv) or kFollow (e.g. element-wise
+    ops and norms), with a float32 output. The function is run on the sample input in
+    float32 for reference, and once for each candidate with only the candidate in the low
+    precision dtype, giving the error of the candidate: the relative L2 error of the
+    outputs of the function.
+
+    The candidates are then moved to the low precision dtype by increasing error, while
+    the sum of their errors is within the error budget. The error of the chosen dtypes is
+    measured, and the candidates of the largest error are moved back to float32 until it
+    is within the budget. The function is converted by `ToMixedPrecision` with the chosen
+    dtypes, which are kept with the errors in the `op_dtypes`, `op_errors` and `error`
+    attributes of the pass.
+
+    The function is compiled and run once for each candidate. The dtypes are keyed by the
+    names of the vars the calls are bound to, which must be unique in the function, and
+    apply to the other functions of the module too.
+    """
+
+    def __init__(
+        self,
+        inputs: List[Union[tvm.nd.NDArray, np.ndarray]],
+        func_name: str = "main",
+        low_dtype: str = "bfloat16",
+        out_dtype: str = "float32",
+        error_budget: float = 1e-2,
+        target: Union[str, tvm.target.Target] = "llvm",
+        device: Optional[tvm.runtime.Device] = None,
+    ) -> None:
+        """Constructor
+
+        Parameters
+        ----------
+        inputs : List[Union[tvm.nd.NDArray, np.ndarray]]
+            The sample input of the function.
+
+        func_name : str
+            The name of the function to convert.
+
+        low_dtype : str
+            The low precision dtype, "float16" or "bfloat16".
+
+        out_dtype : str
+            The accumulator dtype of gemm/conv, as in `ToMixedPrecision`.
+
+        error_budget : float
+            The bound of the relative L2 error of the outputs of the function.
+
+        target : Union[str, tvm.target.Target]
+            The target to run the function on.
+
+        device : Optional[tvm.runtime.Device]
+            The device to run the function on, the CPU by default.
+        """
+        self.inputs = inputs
+        self.func_name = func_name
+        self.low_dtype = low_dtype
+        self.out_dtype = out_dtype
+        self.error_budget = error_budget
+        self.target = target
+        self.device = device if device is not None else tvm.cpu()
+        self.op_dtypes: Dict[str, str] = {}
+        self.op_errors: Dict[str, float] = {}
+        self.error = 0.0
+
+    def transform_module(self, mod: IRModule, _ctx: tvm.transform.PassContext) -> IRModule:
+        """IRModule-level transformation"""
+        candidates = _get_candidates(mod[self.func_name])
+        inputs = [
+            x if isinstance(x, tvm.nd.NDArray) else tvm.nd.array(x, self.device)
+            for x in self.inputs
+        ]
+        reference = self._run(mod, inputs)
+
+        def measure(low_ops):
+            op_dtypes = {
+                name: self.low_dtype if name in low_ops else "float32" for name in candidates
+            }
+            return _relative_error(self._run(self._convert(mod, op_dtypes), inputs), reference)
+
+        self.op_errors = {name: measure({name}) for name in candidates}
+        low_ops = []
+        total = 0.0
+        for name in sorted(candidates, key=lambda name: self.op_errors[name]):
+            if total + self.op_errors[name] > self.error_budget:
+                break
+            low_ops.append(name)
+            total += self.op_errors[name]
+
+        self.error = measure(set(low_ops)) if low_ops else 0.0
+        while self.error > self.error_budget:
+            low_ops.pop()
+            self.error = measure(set(low_ops)) if low_ops else 0.0
+
+        self.op_dtypes = {
+            name: self.low_dtype if name in low_ops else "float32" for name in candidates
+        }
+        return self._convert(mod, self.op_dtypes)
+
+    def _convert(self, mod: IRModule, op_dtypes: Dict[str, str]) -> IRModule:
+        return relax.transform.ToMixedPrecision(
+            self.out_dtype, low_dtype=self.low_dtype, op_dtypes=op_dtypes
+        )(mod)
+
+    def _run(self, mod: IRModule, inputs: List[tvm.nd.NDArray]) -> List[np.ndarray]:
+        vm = relax.VirtualMachine(tvm.compile(mod, self.target), self.device)
+        return [x.numpy().astype("float64") for x in _flatten(vm[self.func_name](*inputs))]
+
+
+def _get_candidates(func: relax.Function) -> List[str]:
+    candidates = []
+
+    def visit(binding):
+        call = binding.value
+        if not isinstance(call, relax.Call) or not isinstance(call.op, tvm.ir.Op):
+            return
+        if call.op.name == "relax.wrap_param" or not call.op.has_attr("TMixedPrecisionPolicy"):
+            return
+        if call.op.get_attr("TMixedPrecisionPolicy") not in [_POLICY_ALWAYS, _POLICY_FOLLOW]:
+            return
+        sinfo = binding.var.struct_info
+        if not isinstance(sinfo, relax.TensorStructInfo) or sinfo.dtype != "float32":
+            return
+        name = binding.var.name_hint
+        if name in candidates:
+            raise ValueError(f"CalibrateMixedPrecision expects unique var names, but got {name}")
+        candidates.append(name)
+
+    def visit_expr(expr):
+        if isinstance(expr, relax.SeqExpr):
+            for block in expr.blocks:
+                if isinstance(block, relax.DataflowBlock):
+                    for binding in block.bindings:
+                        visit(binding)
+
+    relax.analysis.post_order_visit(func.body, visit_expr)
+    return candidates
+
+
+def _flatten(value) -> List[tvm.nd.NDArray]:
+    if isinstance(value, tvm.nd.NDArray):
+        return [value]
+    if isinstance(value, (list, tuple, tvm.ir.Array)):
+        return [x for field in value for x in _flatten(field)]
+    return []
+
+
+def _relative_error(outputs: List[np.ndarray], reference: List[np.ndarray]) -> float:
+    diff = sum(float(np.sum((x - y) ** 2)) for x, y in zip(outputs, reference))
+    norm = sum(float(np.sum(y**2)) for y in reference)
+    return float(np.sqrt(diff / norm)) if norm > 0 else float(np.sqrt(diff))
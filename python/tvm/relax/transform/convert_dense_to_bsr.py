@@ -0,0 +1,151 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Convert the constant weights of block-sparse matmuls into the BSR format.
+The pass is written in Python for experiment, fast development.
+"""
+
+from typing import Optional, Tuple
+
+import numpy as np
+
+import tvm
+from tvm import relax
+from tvm.ir.module import IRModule
+from tvm.relax.expr_functor import PyExprMutator, mutator
+
+
+@tvm.transform.module_pass(opt_level=0, name="ConvertDenseToBSR")
+class ConvertDenseToBSR:
+    """Replace the matmuls by block-sparse constant weights with `R.sparse_dense`.
+
+    The pass rewrites `matmul(x, permute_dims(w))`, the linear layer of weight `w` of
+    shape (N, K), and `matmul(x, w_t)` with `w_t` of shape (K, N), when the weight is
+    a constant, e.g. a parameter bound by `BindParams`. The weight is cut into blocks
+    of the given shape, and when the fraction of the blocks that are all zero is at
+    least the threshold, the matmul becomes `sparse_dense(x, data, indices, indptr)`
+    with the BSR arrays of the weight as new constants. Run `LiftTransformParams`
+    or `DeadCodeElimination` afterwards to drop the dense weights left unused.
+    """
+
+    def __init__(
+        self, block_size: Tuple[int, int] = (16, 1), sparsity_threshold: float = 0.7
+    ) -> None:
+        """Constructor
+
+        Parameters
+        ----------
+        block_size : Tuple[int, int]
+            The block shape (bs_r, bs_c) of the BSR weights. The block rows go along the
+            output features N and the block columns along the reduction K.
+        sparsity_threshold : float
+            The minimum fraction of all-zero blocks for a weight to be converted.
+        """
+        self.block_size = tuple(int(size) for size in block_size)
+        self.sparsity_threshold = sparsity_threshold
+
+    def transform_module(self, mod: IRModule, _ctx: tvm.transform.PassContext) -> IRModule:
+        """IRModule-level transformation"""
+        converter = _BSRConverter(mod, self.block_size, self.sparsity_threshold)
+        for g_var, func in mod.functions_items():
+            if isinstance(func, relax.Function):
+                updated_func = converter.visit_expr(func)
+                converter.builder_.update_func(g_var, updated_func)
+        return converter.builder_.get()
+
+
+def dense_to_bsr(
+    weight: np.ndarray, block_size: Tuple[int, int]
+) -> Tuple[np.ndarray, np.ndarray, np.ndarray]:
+    """Convert a dense 2-D weight into its BSR data, indices and indptr.
+
+    Parameters
+    ----------
+    weight : np.ndarray
+        The weight of shape (N, K), with N and K multiples of the block shape.
+    block_size : Tuple[int, int]
+        The block shape (bs_r, bs_c).
+
+    Returns
+    -------
+    data, indices, indptr : Tuple[np.ndarray, np.ndarray, np.ndarray]
+        The nonzero blocks of shape (nnz_blocks, bs_r, bs_c), their int32 block columns
+        and the int32 block row pointers of shape (N / bs_r + 1,).
+    """
+    bs_r, bs_c = block_size
+    rows, cols = weight.shape
+    blocks = weight.reshape(rows // bs_r, bs_r, cols // bs_c, bs_c).transpose(0, 2, 1, 3)
+    nonzero = np.any(blocks != 0, axis=(2, 3))
+    block_rows, block_cols = np.nonzero(nonzero)
+    data = np.ascontiguousarray(blocks[block_rows, block_cols])
+    indptr = np.concatenate([[0], np.cumsum(nonzero.sum(axis=1))])
+    return data, block_cols.astype("int32"), indptr.astype("int32")
+
+
+@mutator
+class _BSRConverter(PyExprMutator):  # pylint: disable=abstract-method
+    def __init__(
+        self, mod: IRModule, block_size: Tuple[int, int], sparsity_threshold: float
+    ) -> None:
+        super().__init__(mod)
+        self.block_size = block_size
+        self.sparsity_threshold = sparsity_threshold
+
+    def _dense_weight(self, call: relax.Call) -> Optional[np.ndarray]:
+        """The constant weight of shape (N, K) of `matmul(x, ...)`, if any."""
+        rhs = call.args[1]
+        if isinstance(rhs, relax.Var):
+            rhs = self.lookup_binding(rhs) or rhs
+        if isinstance(rhs, relax.Constant) and rhs.data.ndim == 2:
+            return rhs.data.numpy().T
+        if not isinstance(rhs, relax.Call) or rhs.op != tvm.ir.Op.get("relax.permute_dims"):
+            return None
+        axes = rhs.attrs.axes
+        if axes is not None and [int(axis) for axis in axes] != [1, 0]:
+            return None
+        weight = rhs.args[0]
+        if isinstance(weight, relax.Var):
+            weight = self.lookup_binding(weight) or weight
+        if isinstance(weight, relax.Constant) and weight.data.ndim == 2:
+            return weight.data.numpy()
+        return None
+
+    def visit_call_(self, call: relax.Call) -> relax.Expr:
+        call = super().visit_call_(call)
+        if call.op != tvm.ir.Op.get("relax.matmul"):
+            return call
+        x_sinfo = call.args[0].struct_info
+        out_dtype = str(call.attrs.out_dtype)
+        if (
+            not isinstance(x_sinfo, relax.TensorStructInfo)
+            or x_sinfo.ndim < 1
+            or out_dtype not in ("", "void", x_sinfo.dtype)
+        ):
+            return call
+        weight = self._dense_weight(call)
+        if weight is None or weight.dtype != x_sinfo.dtype:
+            return call
+        bs_r, bs_c = self.block_size
+        if weight.shape[0] % bs_r != 0 or weight.shape[1] % bs_c != 0:
+            return call
+
+        data, indices, indptr = dense_to_bsr(weight, self.block_size)
+        num_blocks = (weight.shape[0] // bs_r) * (weight.shape[1] // bs_c)
+        if 1.0 - data.shape[0] / num_blocks < self.sparsity_threshold:
+            return call
+        return relax.op.sparse_dense(
+            call.args[0], relax.const(data), relax.const(indices), relax.const(indptr)
+        )
@@ -0,0 +1,202 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Insert the LoRA branch of multi-adapter serving after the target linear layers.
+The pass is written in Python for experiment, fast development.
+"""
+
+from typing import Dict, List, Optional, Tuple
+
+import tvm
+from tvm import relax, tir
+from tvm.ir.module import IRModule
+from tvm.relax.expr_functor import PyExprMutator, mutator
+
+
+@tvm.transform.module_pass(opt_level=0, name="InsertLoRABranch")
+class InsertLoRABranch:
+    """Add a LoRA branch to the linear layers of the target weights.
+
+    A linear layer `y = matmul(x, permute_dims(w))` whose 2-D weight `w` of shape
+    (out_features, in_features) is a target becomes
+    `y + call_dps_packed("vm.builtin.lora_segmented_gemm", x, w_lora_a, w_lora_b,
+    lora_scaling, lora_adapter_ids)`, which applies the adapter of each token from
+    the stacked adapter weights of a `vm.builtin.lora_adapter_pool_create` pool.
+
+    The rewritten functions take the following new parameters:
+
+    - `lora_adapter_ids`, the int32 adapter slot of each token, or -1 for the base
+      model. It is inserted after the inputs when the function has the `num_input`
+      attribute, and appended otherwise.
+    - `lora_scaling` of shape (num_slots,), appended.
+    - `<target>.lora_a` of shape (num_slots, max_rank, in_features) and
+      `<target>.lora_b` of shape (num_slots, out_features, max_rank) for each target
+      weight the function takes, appended in the order of `targets`.
+
+    The appended parameters are the arrays returned by
+    `vm.builtin.lora_adapter_pool_get_params` for a pool created with the same
+    targets. The pass must run while the weights are separate parameters, before
+    `BundleModelParams`.
+
+    The targets are selected by parameter name. `lora_segmented_gemm` only supports
+    float32, so the target weights must be float32.
+    """
+
+    def __init__(self, targets: List[str], num_slots: int, max_rank: int) -> None:
+        """Constructor
+
+        Parameters
+        ----------
+        targets : List[str]
+            The names of the weight parameters of the linear layers to adapt.
+        num_slots : int
+            The number of adapter slots of the pool.
+        max_rank : int
+            The maximum LoRA rank of the pool.
+        """
+        self.targets = list(targets)
+        self.num_slots = num_slots
+        self.max_rank = max_rank
+
+    def transform_module(self, mod: IRModule, _ctx: tvm.transform.PassContext) -> IRModule:
+        """IRModule-level transformation"""
+        inserter = _LoRABranchInserter(mod, self.num_slots, self.max_rank)
+        for g_var, func in mod.functions_items():
+            if isinstance(func, relax.Function):
+                updated_func = inserter.rewrite(func, self.targets)
+                if updated_func is not None:
+                    inserter.builder_.update_func(g_var, updated_func)
+        return inserter.builder_.get()
+
+
+@mutator
+class _LoRABranchInserter(PyExprMutator):  # pylint: disable=abstract-method
+    def __init__(self, mod: IRModule, num_slots: int, max_rank: int) -> None:
+        super().__init__(mod)
+        self.num_slots = num_slots
+        self.max_rank = max_rank
+        self.lora_params: Dict[relax.Var, Tuple[relax.Var, relax.Var]] = {}
+        self.bound_values: Dict[relax.Var, relax.Expr] = {}
+        self.scaling: Optional[relax.Var] = None
+        self.adapter_ids: Optional[relax.Var] = None
+
+    def rewrite(self, func: relax.Function, targets: List[str]) -> Optional[relax.Function]:
+        """Rewrite a function, or return None if it takes none of the targets."""
+        weights = {param.name_hint: param for param in func.params}
+        self.lora_params = {}
+        self.bound_values = {}
+        lora_params = []
+        for name in targets:
+            if name not in weights:
+                continue
+            weight = weights[name]
+            sinfo = weight.struct_info
+            if not isinstance(sinfo, relax.TensorStructInfo) or sinfo.ndim != 2:
+                raise ValueError(f"The LoRA target {name} must be a 2-D tensor, but got {sinfo}")
+            if sinfo.dtype != "float32":
+                raise ValueError(
+                    f"The LoRA target {name} must be float32, as vm.builtin.lora_segmented_gemm "
+                    f"only supports float32, but got {sinfo.dtype}"
+                )
+            out_features, in_features = sinfo.shape.values
+            lora_a = relax.Var(
+                f"{name}.lora_a",
+                relax.TensorStructInfo([self.num_slots, self.max_rank, in_features], sinfo.dtype),
+            )
+            lora_b = relax.Var(
+                f"{name}.lora_b",
+                relax.TensorStructInfo([self.num_slots, out_features, self.max_rank], sinfo.dtype),
+            )
+            self.lora_params[weight] = (lora_a, lora_b)
+            lora_params += [lora_a, lora_b]
+        if not self.lora_params:
+            return None
+
+        self.adapter_ids = relax.Var(
+            "lora_adapter_ids",
+            relax.TensorStructInfo([tir.Var("lora_num_tokens", "int64")], "int32"),
+        )
+        self.scaling = relax.Var(
+            "lora_scaling", relax.TensorStructInfo([self.num_slots], "float32")
+        )
+        params = list(func.params)
+        num_input = None
+        if func.attrs is not None and "num_input" in func.attrs.keys():
+            num_input = int(func.attrs["num_input"])
+            params.insert(num_input, self.adapter_ids)
+        else:
+            params.append(self.adapter_ids)
+        params += [self.scaling] + lora_params
+        func = relax.Function(
+            params, func.body, func.ret_struct_info, func.is_pure, func.attrs, func.span
+        )
+        if num_input is not None:
+            func = func.with_attr("num_input", num_input + 1)
+        return self.visit_expr(func)
+
+    def _target_weight(self, value: relax.Expr) -> Optional[relax.Var]:
+        """The target weight of a linear layer `matmul(x, permute_dims(w))`, if any."""
+        if not isinstance(value, relax.Call) or value.op != tvm.ir.Op.get("relax.matmul"):
+            return None
+        transposed = value.args[1]
+        if isinstance(transposed, relax.Var):
+            transposed = self.bound_values.get(transposed, transposed)
+        if (
+            not isinstance(transposed, relax.Call)
+            or transposed.op != tvm.ir.Op.get("relax.permute_dims")
+            or transposed.args[0] not in self.lora_params
+        ):
+            return None
+        axes = transposed.attrs.axes
+        if axes is not None and [int(axis) for axis in axes] != [1, 0]:
+            return None
+        return transposed.args[0]
+
+    def visit_var_binding_(self, binding: relax.VarBinding) -> None:
+        self.bound_values[binding.var] = binding.value
+        weight = self._target_weight(binding.value)
+        out_sinfo = binding.var.struct_info
+        if (
+            weight is None
+            or not isinstance(out_sinfo, relax.TensorStructInfo)
+            or out_sinfo.shape is None
+        ):
+            super().visit_var_binding_(binding)
+            return
+
+        base = self.builder_.emit(self.visit_expr(binding.value), "lora_base")
+        lora_a, lora_b = self.lora_params[weight]
+        delta = self.builder_.emit(
+            relax.call_dps_packed(
+                "vm.builtin.lora_segmented_gemm",
+                [
+                    self.visit_expr(binding.value.args[0]),
+                    lora_a,
+                    lora_b,
+                    self.scaling,
+                    self.adapter_ids,
+                ],
+                out_sinfo=base.struct_info,
+            ),
+            "lora_delta",
+        )
+        output = relax.op.add(base, delta)
+        in_dataflow = self.builder_.current_block_is_dataflow()
+        if isinstance(binding.var, relax.DataflowVar) or not in_dataflow:
+            new_var = self.builder_.emit(output, binding.var.name_hint)
+        else:
+            new_var = self.builder_.emit_output(output, binding.var.name_hint)
+        self.set_var_remap(binding.var.vid, new_var)
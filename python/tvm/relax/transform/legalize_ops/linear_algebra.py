@@ -16,7 +16,10 @@
 # under the License.
 # pylint: disable=invalid-name
 """Default legalization function for linear algebra operators."""
+import logging
+
 from tvm import topi, tir, relax, te
+from tvm.script import tir as T
 from ...block_builder import BlockBuilder
 from ...expr import Call, Expr, Var, Tuple, TupleGetItem
 from .common import register_legalize
@@ -134,3 +137,86 @@ def _outer(bb: BlockBuilder, call: Call) -> Expr:
 
     lhs, rhs = call.args
     return bb.call_te(te_outer, lhs, rhs, primfunc_name_hint="outer")
+
+
+def _sparse_dense_kernel(dtype: str, index_dtype: str, indptr_dtype: str, bs_r: int, bs_c: int):
+    """The kernel of sparse_dense on a 2-D input. The number of nonzero blocks of a block row
+    is only known at runtime, which a TE reduction cannot express, so the kernel is in TIR.
+
+    Each block computes `bs_r` consecutive outputs of a row, accumulating in registers over
+    the nonzero blocks of the block row. The loops over the rows and the block rows are
+    spatial, so that they can be tiled and parallelized by scheduling.
+    """
+
+    @T.prim_func(private=True)
+    def sparse_dense(
+        var_x: T.handle,
+        var_data: T.handle,
+        var_indices: T.handle,
+        var_indptr: T.handle,
+        var_out: T.handle,
+    ):
+        T.func_attr({"tir.noalias": True})
+        m, k, nnz, nb = T.int64(), T.int64(), T.int64(), T.int64()
+        x = T.match_buffer(var_x, (m, k), dtype)
+        data = T.match_buffer(var_data, (nnz, bs_r, bs_c), dtype)
+        indices = T.match_buffer(var_indices, (nnz,), index_dtype)
+        indptr = T.match_buffer(var_indptr, (nb + 1,), indptr_dtype)
+        out = T.match_buffer(var_out, (m, nb * bs_r), dtype)
+        for i, j in T.grid(m, nb):
+            with T.block("sparse_dense"):
+                vi, vj = T.axis.remap("SS", [i, j])
+                T.reads(
+                    x[vi, 0:k], data[0:nnz, 0:bs_r, 0:bs_c], indices[0:nnz], indptr[vj : vj + 2]
+                )
+                T.writes(out[vi, vj * bs_r : vj * bs_r + bs_r])
+                acc = T.alloc_buffer((bs_r,), dtype, scope="local")
+                for r in T.vectorized(bs_r):
+                    acc[r] = T.Cast(dtype, 0)
+                for b in T.serial(indptr[vj], indptr[vj + 1]):
+                    for c in T.unroll(bs_c):
+                        for r in T.vectorized(bs_r):
+                            acc[r] = acc[r] + (
+                                x[vi, T.Cast("int64", indices[b]) * bs_c + c] * data[b, r, c]
+                            )
+                for r in T.vectorized(bs_r):
+                    out[vi, vj * bs_r + r] = acc[r]
+
+    return sparse_dense
+
+
+@register_legalize("relax.sparse_dense")
+def _sparse_dense(bb: BlockBuilder, call: Call) -> Expr:
+    x, data, indices, indptr = call.args
+    out_sinfo = call.struct_info
+    if (
+        not isinstance(x.struct_info.shape, relax.ShapeExpr)
+        or not isinstance(out_sinfo.shape, relax.ShapeExpr)
+        or not isinstance(data.struct_info.shape, relax.ShapeExpr)
+        or not all(isinstance(dim, tir.IntImm) for dim in data.struct_info.shape.values[1:])
+    ):
+        logging.info("sparse_dense with unknown shapes or block size is not legalized.")
+        return call
+
+    bs_r, bs_c = (int(dim) for dim in data.struct_info.shape.values[1:])
+    kernel = _sparse_dense_kernel(
+        data.struct_info.dtype, indices.struct_info.dtype, indptr.struct_info.dtype, bs_r, bs_c
+    )
+    gvar = bb.add_func(kernel, "sparse_dense")
+
+    x_shape = list(x.struct_info.shape.values)
+    if len(x_shape) == 2:
+        return relax.call_tir(gvar, call.args, out_sinfo)
+    # Flatten the leading dimensions of the input, and restore them on the output.
+    m = 1
+    for dim in x_shape[:-1]:
+        m = m * dim
+    x_2d = bb.emit_te(topi.reshape, x, [m, x_shape[-1]])
+    out_2d = bb.emit(
+        relax.call_tir(
+            gvar,
+            [x_2d, data, indices, indptr],
+            relax.TensorStructInfo([m, out_sinfo.shape.values[-1]], out_sinfo.dtype),
+        )
+    )
+    return bb.call_te(topi.reshape, out_2d, out_sinfo.shape)
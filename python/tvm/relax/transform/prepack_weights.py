@@ -0,0 +1,96 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Prepack the model weights at compile time into the layouts chosen by tuning."""
+
+from typing import Dict, List, Optional
+
+import tvm
+from tvm import relax, tir
+from tvm.ir.module import IRModule
+
+
+@tvm.transform.module_pass(opt_level=0, name="PrepackWeights")
+class PrepackWeights:
+    """Move the weight layout rewrites of the tuned kernels from runtime to compile time.
+
+    With the layout free buffers attached by `AttachAttrLayoutFreeBuffers`, the
+    `rewrite_layout` postproc of MetaSchedule lets a tuned kernel read its weights in
+    the layout it wants, e.g. the panels of a blocked GEMM, behind a layout rewrite
+    block. The pass splits these blocks into PrimFuncs of their own with
+    `SplitLayoutRewritePreproc`, and lifts them with the other transforms of the
+    weights into `{func_name}_transform_params` with `LiftTransformParams`.
+
+    When the weights of a function are known, from its "params" attribute as kept by
+    the frontends or from the `params` argument, the transform function is compiled
+    for the host and run on them. The function is then left with no transform of its
+    weights: its "params" attribute holds the prepacked weights, to be detached with
+    `relax.frontend.detach_params`, and the transform function is removed. The
+    functions of unknown weights keep their transform function to run at runtime.
+    """
+
+    def __init__(self, params: Optional[Dict[str, List[tvm.nd.NDArray]]] = None) -> None:
+        """Constructor
+
+        Parameters
+        ----------
+        params : Optional[Dict[str, List[tvm.nd.NDArray]]]
+            The weights of the functions without the "params" attribute, keyed by the
+            function name, in the order of the function parameters after `num_input`.
+        """
+        self.params = params or {}
+
+    def transform_module(self, mod: IRModule, _ctx: tvm.transform.PassContext) -> IRModule:
+        """IRModule-level transformation"""
+        weights = {}
+        for g_var, func in mod.functions_items():
+            if isinstance(func, relax.Function) and "num_input" in func.attrs:
+                if "params" in func.attrs:
+                    weights[g_var.name_hint] = list(func.attrs["params"])
+                elif g_var.name_hint in self.params:
+                    weights[g_var.name_hint] = list(self.params[g_var.name_hint])
+
+        mod = relax.transform.SplitLayoutRewritePreproc()(mod)
+        mod = relax.transform.LiftTransformParams()(mod)
+        for func_name, params in weights.items():
+            transform_name = f"{func_name}_transform_params"
+            if transform_name not in mod:
+                continue
+            packed = _run_transform_params(mod, transform_name, params)
+            mod[func_name] = mod[func_name].with_attr("params", packed)
+            del mod[transform_name]
+        return relax.transform.DeadCodeElimination()(mod)
+
+
+def _run_transform_params(
+    mod: IRModule, transform_name: str, params: List[tvm.nd.NDArray]
+) -> List[tvm.nd.NDArray]:
+    """Compile the transform function of the weights for the host and run it."""
+    transform_mod = IRModule(
+        {
+            g_var: func
+            for g_var, func in mod.functions_items()
+            if isinstance(func, tir.PrimFunc) or g_var.name_hint == transform_name
+        },
+        attrs=mod.attrs,
+        global_infos=mod.global_infos,
+    )
+    transform_mod = relax.transform.DeadCodeElimination([transform_name])(transform_mod)
+    # The weights are prepacked on the build host, whatever the target of the model.
+    ex = tvm.compile(transform_mod, target=tvm.target.Target("llvm"))
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    host_params = [tvm.nd.array(param.numpy(), tvm.cpu()) for param in params]
+    return list(vm[transform_name](host_params))
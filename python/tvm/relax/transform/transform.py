@@ -695,6 +695,80 @@ def BindSymbolicVars(
     return _ffi_api.BindSymbolicVars(binding_map, func_name)  # type: ignore
 
 
+def SpecializeSymbolicVars(
+    hot_values: Mapping[Union[str, tvm.tir.Var], List[Union[int, tvm.tir.PrimExpr]]],
+    func_name: Optional[str] = None,
+) -> tvm.ir.transform.Pass:
+    """Multi-version functions for the hot values of their symbolic vars.
+
+    Kernels of symbolic shapes lose the unrolling, the vectorization and the constant
+    index math of static shapes. For each combination of the hot values, e.g. the
+    sequence lengths seen most in a profile, the function is cloned with the symbolic
+    vars bound as by `BindSymbolicVars`, and the PrimFuncs called by the clone are
+    specialized for the static shapes of their arguments. The function dispatches on
+    entry to the clone of the values of its arguments, and runs its generic body for
+    the other values.
+
+    Run before `LegalizeOps` for the clones to be legalized with static shapes, or
+    after it for the legalized PrimFuncs to be specialized.
+
+    Parameters
+    ----------
+    hot_values : Mapping[Union[str, tvm.tir.Var], List[Union[int, tvm.tir.PrimExpr]]]
+        The hot values of the symbolic vars, which must be defined by the parameters of
+        the functions. The clones are made for all the combinations of the values.
+
+    func_name : Optional[str]
+        The function to multi-version. If None (default), all the functions within the
+        module that use the vars are updated.
+
+    Returns
+    -------
+    ret: tvm.ir.transform.Pass
+    """
+    # Relax uses int64 for symbolic variables, but the FFI
+    # converts python integers into int32.
+    hot_values = {
+        key: [
+            tvm.tir.const(value, "int64") if isinstance(value, int) else value for value in values
+        ]
+        for key, values in hot_values.items()
+    }
+    return _ffi_api.SpecializeSymbolicVars(hot_values, func_name)  # type: ignore
+
+
+def ConvertToStreaming(func_name: str, chunk_size: int) -> tvm.ir.transform.Pass:
+    """Convert a function over a sequence into a function over the chunks of the sequence.
+
+    Audio and time-series models see the whole sequence at once, so that their memory
+    grows with its length. The first parameter of the function is the sequence, along
+    its last axis. The sequence may flow through causal `nn.conv1d`, `nn.max_pool1d`
+    and `nn.avg_pool1d` in the NCW layout, `nn.pad` of its start and element-wise ops.
+    Each window op carries the last frames of its input over from a chunk to the next
+    as a state, in place of its padding. The outputs of the chunks are those of the
+    whole sequence, bit for bit.
+
+    The pass adds the function `<func_name>_stream` of signature
+    `(chunk, states..., params...) -> (output chunk, next states)`, and the function
+    `<func_name>_stream_init` of signature `(chunk) -> states`, which returns the states
+    before the first chunk. `relax.StreamingRunner` feeds the chunks to them.
+
+    Parameters
+    ----------
+    func_name : str
+        The name of the function to convert.
+
+    chunk_size : int
+        The number of frames of the input chunks. The chunks must be divisible by the
+        strides of the window ops.
+
+    Returns
+    -------
+    ret: tvm.ir.transform.Pass
+    """
+    return _ffi_api.ConvertToStreaming(func_name, chunk_size)  # type: ignore
+
+
 def RunCodegen(
     target_options: Optional[dict] = None,
     entry_functions: Optional[List[str]] = None,
@@ -820,6 +894,36 @@ def FuseTIR() -> tvm.ir.transform.Pass:
     return _ffi_api.FuseTIR()  # type: ignore
 
 
+def HorizontalFuseTIR(max_work: int = 1 << 16, max_num_kernels: int = 16) -> tvm.ir.transform.Pass:
+    """Fuse the independent small call_tir of the dataflow blocks into one PrimFunc, for CPU.
+
+    Each kernel on CPU pays a parallel launch and a barrier, which small kernels cannot
+    amortize. The pass groups the call_tir whose PrimFuncs have static shapes and at most
+    `max_work` innermost loop iterations, and that do not depend on each other, into one
+    PrimFunc running all of them in one parallel loop. Each kernel is split into tasks
+    along its outermost spatial loop, or is a single task when it has none, e.g. a full
+    reduction. The bindings between the fused call_tir that use their results are moved
+    after the fused call.
+
+    The fused PrimFuncs are marked as scheduled, so run the pass after scheduling, e.g.
+    after `MetaScheduleApplyDatabase`, or after `FuseTIR` when the kernels are not tuned.
+
+    Parameters
+    ----------
+    max_work : int
+        The maximum number of innermost loop iterations of a kernel to fuse.
+
+    max_num_kernels : int
+        The maximum number of kernels fused into one PrimFunc.
+
+    Returns
+    -------
+    ret : tvm.transform.Pass
+        The registered pass for horizontal fusion.
+    """
+    return _ffi_api.HorizontalFuseTIR(max_work, max_num_kernels)  # type: ignore
+
+
 @tvm.ffi.register_object("relax.transform.PatternCheckContext")
 class PatternCheckContext(Object):
     """
@@ -1082,6 +1186,11 @@ def LegalizeOps(
     (`LegalizeFunc`). The default legalization function will be overridden by the customized
     one.
 
+    The PrimFuncs created from TE by `call_te` are cached on the structure of the TE graph
+    within the pass, so that the same op over the same shapes, e.g. in each layer of a model,
+    is converted to TensorIR once. The cache is disabled by the pass config
+    `"relax.LegalizeOps.cache_prim_funcs": False`.
+
     Parameters
     ----------
     customize_legalize_map : Optional[Dict[str, LegalizeFunc]]
@@ -1412,10 +1521,13 @@ def DeadCodeElimination(entry_functions: Optional[List[str]] = None) -> tvm.ir.t
 
 
 def ToMixedPrecision(
-    out_dtype="float32", fp16_input_names: Optional[List[str]] = None
+    out_dtype="float32",
+    fp16_input_names: Optional[List[str]] = None,
+    low_dtype: str = "float16",
+    op_dtypes: Optional[Dict[str, str]] = None,
 ) -> tvm.ir.transform.Pass:
     """Automatic mixed precision pass. Currently the pass assumes the input module to be fp32
-    only, and will automatically cast fp32 to fp16 for certain ops.
+    only, and will automatically cast fp32 to fp16 (or bf16) for certain ops.
 
     Note: Mainly operates within dataflow blocks. ConvertToDataflow may need to be called first.
 
@@ -1424,15 +1536,23 @@ def ToMixedPrecision(
     out_dtype : str
         The output data type of gemm/conv, which is the data type of the accumulator.
     fp16_input_names : List[str]
-        The names of function parameters whose dtype should become fp16. The  function signature
-        would change accordingly.
+        The names of function parameters whose dtype should become the low precision dtype.
+        The  function signature would change accordingly.
+    low_dtype : str
+        The low precision dtype, "float16" or "bfloat16".
+    op_dtypes : Optional[Dict[str, str]]
+        The dtypes chosen for op calls, keyed by the name of the var each call is bound to,
+        as given by `CalibrateMixedPrecision`. The dtype is "float32" or `low_dtype`, and
+        overrides the mixed precision policy of the op.
 
     Returns
     -------
     ret : tvm.transform.Pass
         The registered pass for mixed precision.
     """
-    return _ffi_api.ToMixedPrecision(out_dtype, fp16_input_names)  # type: ignore
+    return _ffi_api.ToMixedPrecision(  # type: ignore
+        out_dtype, fp16_input_names, low_dtype, op_dtypes
+    )
 
 
 def SplitCallTIRByPattern(patterns: List[PrimFunc], fcodegen: Callable) -> tvm.ir.transform.Pass:
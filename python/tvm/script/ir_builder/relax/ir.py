@@ -161,6 +161,7 @@ from tvm.relax.op import (
     sinh,
     slice_scatter,
     sort,
+    sparse_dense,
     split,
     sqrt,
     square,
@@ -863,6 +864,7 @@ __all__ = [
     "sinh",
     "slice_scatter",
     "sort",
+    "sparse_dense",
     "split",
     "square",
     "squeeze",
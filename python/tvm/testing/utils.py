@@ -1039,6 +1039,13 @@ requires_arm_dot = Feature(
 )
 
 
+requires_arm_i8mm = Feature(
+    "arm_i8mm",
+    "ARM int8 matrix multiply",
+    run_time_check=lambda: _has_cpu_feat("i8mm"),
+)
+
+
 requires_arm_fp16 = Feature(
     "arm_fp16",
     "Arm(R) Neon(TM) instructions for FP16",
@@ -1067,6 +1074,13 @@ requires_x86_vnni = Feature(
 )
 
 
+requires_x86_avxvnni = Feature(
+    "x86_avxvnni",
+    "x86 AVX-VNNI Extensions",
+    run_time_check=lambda: _has_cpu_feat("avxvnni"),
+)
+
+
 requires_x86_avx512 = Feature(
     "x86_avx512",
     "x86 AVX512 Extensions",
@@ -169,6 +169,74 @@ def get_dotprod_intrin(in_dtype, out_dtype):
     return dot_prod_desc, dot_prod_impl
 
 
+def get_i8mm_intrin(in_dtype, out_dtype):
+    """The 2x8 by 8x2 matrix multiply-accumulate of the I8MM extension (smmla/ummla).
+
+    The operands are 2x8 tiles of A and of the transposed B, accumulated into a 2x2 tile
+    of C. The rows of the tiles are loaded with the strides of their buffers, so that the
+    tiles of row-major matrices are tensorized without packing.
+    """
+    if in_dtype == "uint8":
+        instr = "ummla.v4i32.v16i8"
+    else:  # if in_dtype == "int8"
+        instr = "smmla.v4i32.v16i8"
+
+    in_dtype_x8 = f"{in_dtype}x8"
+    in_dtype_x16 = f"{in_dtype}x16"
+    out_dtype_x2 = f"{out_dtype}x2"
+    out_dtype_x4 = f"{out_dtype}x4"
+
+    @T.prim_func
+    def mmla_desc(a: T.handle, b: T.handle, c: T.handle) -> None:
+        A = T.match_buffer(a, (2, 8), dtype=in_dtype, offset_factor=1)
+        B = T.match_buffer(b, (2, 8), dtype=in_dtype, offset_factor=1)
+        C = T.match_buffer(c, (2, 2), dtype=out_dtype, offset_factor=1)
+        with T.block("root"):
+            T.reads(C[0:2, 0:2], A[0:2, 0:8], B[0:2, 0:8])
+            T.writes(C[0:2, 0:2])
+            for i, j, k in T.grid(2, 2, 8):
+                with T.block("update"):
+                    vi, vj, vk = T.axis.remap("SSR", [i, j, k])
+                    C[vi, vj] = C[vi, vj] + T.cast(A[vi, vk], dtype=out_dtype) * T.cast(
+                        B[vj, vk], dtype=out_dtype
+                    )
+
+    @T.prim_func
+    def mmla_impl(a: T.handle, b: T.handle, c: T.handle) -> None:
+        sa = T.int32()
+        sb = T.int32()
+        sc = T.int32()
+        A = T.match_buffer(a, (2, 8), dtype=in_dtype, offset_factor=1, strides=[sa, 1])
+        B = T.match_buffer(b, (2, 8), dtype=in_dtype, offset_factor=1, strides=[sb, 1])
+        C = T.match_buffer(c, (2, 2), dtype=out_dtype, offset_factor=1, strides=[sc, 1])
+        with T.block("root"):
+            T.reads(C[0:2, 0:2], A[0:2, 0:8], B[0:2, 0:8])
+            T.writes(C[0:2, 0:2])
+
+            vec_a = T.vectorcombine(
+                A.vload([0, 0], in_dtype_x8), A.vload([1, 0], in_dtype_x8), dtype=in_dtype_x16
+            )
+            vec_b = T.vectorcombine(
+                B.vload([0, 0], in_dtype_x8), B.vload([1, 0], in_dtype_x8), dtype=in_dtype_x16
+            )
+            vec_c = T.vectorcombine(
+                C.vload([0, 0], out_dtype_x2), C.vload([1, 0], out_dtype_x2), dtype=out_dtype_x4
+            )
+
+            vec_d = T.call_llvm_pure_intrin(
+                T.llvm_lookup_intrinsic_id(f"llvm.aarch64.neon.{instr}"),
+                T.uint32(3),
+                vec_c,
+                vec_a,
+                vec_b,
+                dtype=out_dtype_x4,
+            )
+            C[0, T.ramp(T.int32(0), 1, 2)] = T.vectorlow(vec_d, dtype=out_dtype_x2)
+            C[1, T.ramp(T.int32(0), 1, 2)] = T.vectorhigh(vec_d, dtype=out_dtype_x2)
+
+    return mmla_desc, mmla_impl
+
+
 def _create_ptrue_mask(dtype):
     """
     Creates a mask that enables all lanes of a scalable vector.
@@ -769,6 +837,12 @@ TensorIntrin.register(ARM_DOT_4x4_i8_SDOT_INTRIN, *get_dotprod_intrin("int8", "i
 TensorIntrin.register(ARM_DOT_4x4_u8_UDOT_INTRIN, *get_dotprod_intrin("uint8", "uint32"))
 TensorIntrin.register(ARM_DOT_4x4_u8_HDOT_INTRIN, *get_dotprod_intrin("uint8", "int32"))
 
+ARM_MMLA_2x2x8_i8_SMMLA_INTRIN = "mmla_2x2x8_i8i8s32_smmla"
+ARM_MMLA_2x2x8_u8_UMMLA_INTRIN = "mmla_2x2x8_u8u8u32_ummla"
+
+TensorIntrin.register(ARM_MMLA_2x2x8_i8_SMMLA_INTRIN, *get_i8mm_intrin("int8", "int32"))
+TensorIntrin.register(ARM_MMLA_2x2x8_u8_UMMLA_INTRIN, *get_i8mm_intrin("uint8", "uint32"))
+
 ARM_SME_INIT = "sme_init"
 ARM_SME_2SVLx2SVL_FP32_TRANSPOSE_INTERLEAVE = "sme_2svlx2svl_fp32_transpose_interleave"
 ARM_SME_BLOCK2_2SVLx1SVL_FP16_TRANSPOSE_INTERLEAVE = (
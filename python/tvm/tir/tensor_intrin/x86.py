@@ -101,6 +101,53 @@ def dot_product_16x4_u8i8i32_avx512(
         )
 
 
+# The 256-bit variant, for the CPUs with AVX-VNNI but without AVX512, e.g. Alder Lake.
+# LLVM selects the VEX-encoded vpdpbusd for the intrinsic when AVX512-VL is not available.
+
+
+@T.prim_func
+def dot_product_8x4_u8i8i32_desc(
+    A: T.Buffer((4,), "uint8", offset_factor=1),
+    B: T.Buffer((8, 4), "int8", offset_factor=1),
+    C: T.Buffer((8,), "int32", offset_factor=1),
+) -> None:
+    with T.block("root"):
+        T.reads(C[0:8], A[0:4], B[0:8, 0:4])
+        T.writes(C[0:8])
+        for i in T.serial(0, 8):
+            for k in T.serial(0, 4):
+                with T.block("update"):
+                    vi, vk = T.axis.remap("SR", [i, k])
+                    C[vi] = C[vi] + T.cast(A[vk], "int32") * T.cast(B[vi, vk], "int32")
+
+
+@T.prim_func
+def dot_product_8x4_u8i8i32_avxvnni(
+    A: T.Buffer((4,), "uint8", offset_factor=1),
+    B: T.Buffer((8, 4), "int8", offset_factor=1),
+    C: T.Buffer((8,), "int32", offset_factor=1),
+) -> None:
+    with T.block("root"):
+        T.reads(C[0:8], A[0:4], B[0:8, 0:4])
+        T.writes(C[0:8])
+
+        A_u8x4 = A.vload([0], "uint8x4")
+        A_i32 = T.reinterpret(A_u8x4, dtype="int32")
+
+        B_i8x32 = B.vload([0, 0], dtype="int8x32")
+        B_i32x8 = T.reinterpret(B_i8x32, dtype="int32x8")
+        C_i32x8 = C.vload([0], dtype="int32x8")
+
+        C[T.ramp(T.int32(0), 1, 8)] = T.call_llvm_pure_intrin(
+            T.llvm_lookup_intrinsic_id("llvm.x86.avx512.vpdpbusd.256"),
+            T.uint32(3),
+            C_i32x8,
+            T.broadcast(A_i32, 8),
+            B_i32x8,
+            dtype="int32x8",
+        )
+
+
 VNNI_DOT_16x4_INTRIN = "dot_16x4_vnni"
 
 TensorIntrin.register(
@@ -112,3 +159,9 @@ AVX512_DOT_16x4_INTRIN = "dot_16x4_avx512"
 TensorIntrin.register(
     AVX512_DOT_16x4_INTRIN, dot_product_16x4_u8i8i32_desc, dot_product_16x4_u8i8i32_avx512
 )
+
+AVXVNNI_DOT_8x4_INTRIN = "dot_8x4_avxvnni"
+
+TensorIntrin.register(
+    AVXVNNI_DOT_8x4_INTRIN, dot_product_8x4_u8i8i32_desc, dot_product_8x4_u8i8i32_avxvnni
+)
@@ -25,6 +25,94 @@
 namespace tvm {
 namespace meta_schedule {
 
+/*! \brief Check whether the region of a buffer is contiguous in memory. */
+bool IsContiguousRegion(const tir::BufferRegion& region, arith::Analyzer* analyzer) {
+  // All the dimensions after the first non-unit one must be fully covered.
+  bool found_non_unit = false;
+  for (size_t i = 0; i < region->region.size(); ++i) {
+    const PrimExpr& extent = region->region[i]->extent;
+    if (found_non_unit && !analyzer->CanProveEqual(extent, region->buffer->shape[i])) {
+      return false;
+    }
+    found_non_unit |= !analyzer->CanProveEqual(extent, 1);
+  }
+  return true;
+}
+
+/*!
+ * \brief Get the index map that packs a buffer into the tiles of a region of it, so that each
+ * tile is contiguous, e.g. (n, k) => (n // 16, k // 4, n % 16, k % 4) for a 16x4 tile.
+ * \return The index map, or std::nullopt if the region is not aligned to the tiles.
+ */
+Optional<tir::IndexMap> GetTilePackingIndexMap(const tir::BufferRegion& region,
+                                               arith::Analyzer* analyzer) {
+  std::vector<int64_t> tile;
+  for (size_t i = 0; i < region->region.size(); ++i) {
+    const auto* extent = region->region[i]->extent.as<IntImmNode>();
+    const auto* dim = region->buffer->shape[i].as<IntImmNode>();
+    if (!extent || !dim || dim->value % extent->value != 0 ||
+        !analyzer->CanProve(floormod(region->region[i]->min, extent->value) == 0)) {
+      return std::nullopt;
+    }
+    tile.push_back(extent->value);
+  }
+  return tir::IndexMap::FromFunc(tile.size(), [tile](Array<tir::Var> indices) {
+    Array<PrimExpr> outer, inner;
+    for (size_t i = 0; i < tile.size(); ++i) {
+      if (tile[i] == 1) {
+        outer.push_back(indices[i]);
+      } else {
+        outer.push_back(floordiv(indices[i], Integer(tile[i])));
+        inner.push_back(floormod(indices[i], Integer(tile[i])));
+      }
+    }
+    return Concat(outer, inner);
+  });
+}
+
+/*!
+ * \brief Pack the operands of the tensorized block whose tiles are not contiguous, since the
+ * CPU intrinsics load them as whole vectors, e.g. the 16x4 int8 tile of the weight of VNNI. The
+ * packing of a layout-free buffer is marked as a layout rewrite, to be done at compile time.
+ * \return Whether the operands of the intrinsic are contiguous.
+ */
+bool PackIntrinOperands(tir::Schedule sch, tir::BlockRV block, const std::string& intrin_name) {
+  tir::PrimFunc impl = tir::TensorIntrin::Get(intrin_name).value()->impl;
+  bool strided = std::all_of(impl->buffer_map.begin(), impl->buffer_map.end(),
+                             [](const auto& kv) { return !kv.second->strides.empty(); });
+  if (strided) {
+    // The intrinsic loads the tiles with the strides of the buffers.
+    return true;
+  }
+  std::unordered_set<const tir::BufferNode*> layout_free;
+  for (const auto& [g_var, base_func] : sch->mod()->functions) {
+    if (const auto* func = base_func.as<tir::PrimFuncNode>()) {
+      for (const Integer& index : func->GetAttr(tir::attr::layout_free_buffers,
+                                                Array<Integer>())
+                                      .value()) {
+        layout_free.insert(func->buffer_map.at(func->params[index->value]).get());
+      }
+    }
+  }
+  arith::Analyzer analyzer;
+  tir::Block block_stmt = sch->Get(block);
+  for (const tir::BufferRegion& region : block_stmt->writes) {
+    if (!IsContiguousRegion(region, &analyzer)) return false;
+  }
+  for (size_t i = 0; i < block_stmt->reads.size(); ++i) {
+    const tir::BufferRegion& region = block_stmt->reads[i];
+    if (IsContiguousRegion(region, &analyzer)) continue;
+    Optional<tir::IndexMap> index_map = GetTilePackingIndexMap(region, &analyzer);
+    if (!index_map) return false;
+    tir::BlockRV pack_block = sch->CacheRead(block, i, "global");
+    if (layout_free.count(region->buffer.get())) {
+      sch->Annotate(pack_block, tir::attr::meta_schedule_layout_rewrite_preproc, Bool(true));
+    }
+    sch->TransformLayout(block, i, tir::BufferIndexType::kRead, index_map.value(), std::nullopt);
+  }
+  return true;
+}
+
 /*!
  * \brief Tile a subset of loops in the block according to the given tensor intrinsic, and annotate
  * the tiled block for tensorization by postproc rewrite.
@@ -37,6 +125,9 @@ Optional<tir::BlockRV> TileForIntrin(tir::Schedule sch, tir::BlockRV block,
   }
   ICHECK(tiled_loop_rv.defined());
   tir::BlockRV outer_block = sch->Blockize(tiled_loop_rv.value());
+  if (!PackIntrinOperands(sch, outer_block, intrin_name)) {
+    return std::nullopt;
+  }
   sch->Annotate(outer_block, tir::attr::meta_schedule_auto_tensorize, String(intrin_name));
   return outer_block;
 }
@@ -87,6 +87,7 @@ Array<ScheduleRule> ScheduleRule::DefaultLLVM() {
 
 Array<ScheduleRule> ScheduleRule::DefaultX86(const String& type) {
   static const Map<String, String> intrins = {{"vnni", "dot_16x4_vnni"},
+                                              {"avxvnni", "dot_8x4_avxvnni"},
                                               {"avx512", "dot_16x4_avx512"}};
   return {
       ScheduleRule::ApplyCustomRule(),
@@ -356,6 +357,33 @@ Array<ScheduleRule> GetARMDotprodSpecificRules() {
   };
 }
 
+Array<ScheduleRule> GetARMI8mmSpecificRules() {
+  return {
+      ScheduleRule::MultiLevelTilingWithIntrin(
+          /*intrin_name=*/String("mmla_2x2x8_i8i8s32_smmla"),
+          /*structure=*/"SSRSRS",
+          /*tile_binds=*/std::nullopt,
+          /*max_innermost_factor=*/Integer(32),
+          /*vector_load_lens=*/std::nullopt,
+          /*reuse_read=*/std::nullopt,
+          /*reuse_write=*/
+          Map<String, ffi::Any>{{"req", String("may")},
+                                {"levels", Array<Integer>{1, 2}},
+                                {"scope", String("global")}}),
+      ScheduleRule::MultiLevelTilingWithIntrin(
+          /*intrin_name=*/String("mmla_2x2x8_u8u8u32_ummla"),
+          /*structure=*/"SSRSRS",
+          /*tile_binds=*/std::nullopt,
+          /*max_innermost_factor=*/Integer(32),
+          /*vector_load_lens=*/std::nullopt,
+          /*reuse_read=*/std::nullopt,
+          /*reuse_write=*/
+          Map<String, ffi::Any>{{"req", String("may")},
+                                {"levels", Array<Integer>{1, 2}},
+                                {"scope", String("global")}}),
+  };
+}
+
 Array<ScheduleRule> ScheduleRule::DefaultARM(const String& type) {
   return Array<ScheduleRule>::Agregate(
       ScheduleRule::ApplyCustomRule(), ScheduleRule::InlineConstantScalars(),
@@ -371,7 +399,8 @@ Array<ScheduleRule> ScheduleRule::DefaultARM(const String& type) {
           /*max_jobs_per_core=*/8,
           /*max_innermost_factor=*/Integer(32)),
       "neon" == type ? GetARMNeonSpecificRules() : Array<ScheduleRule>{},
-      "dotprod" == type ? GetARMDotprodSpecificRules() : Array<ScheduleRule>{},
+      "i8mm" == type ? GetARMI8mmSpecificRules() : Array<ScheduleRule>{},
+      "dotprod" == type || "i8mm" == type ? GetARMDotprodSpecificRules() : Array<ScheduleRule>{},
       ScheduleRule::MultiLevelTiling(
           /*structure=*/"SSRSRS",
           /*tile_binds=*/std::nullopt,
@@ -28,8 +28,11 @@ String GetRuleKindFromTarget(const Target& target) {
         tvm::ffi::Function::GetGlobalRequired("target.target_has_feature");
     bool have_avx512vnni = target_has_feature_fn_ptr("avx512vnni", target).cast<bool>();
     bool have_avxvnni = target_has_feature_fn_ptr("avxvnni", target).cast<bool>();
-    if (have_avx512vnni || have_avxvnni) {
+    if (have_avx512vnni) {
       return "vnni";
+    } else if (have_avxvnni) {
+      // AVX-VNNI without AVX512 only has the 256-bit vpdpbusd.
+      return "avxvnni";
     } else {
       bool have_avx512f = target_has_feature_fn_ptr("avx512f", target).cast<bool>();
       bool have_avx512bw = target_has_feature_fn_ptr("avx512bw", target).cast<bool>();
@@ -41,6 +44,9 @@ String GetRuleKindFromTarget(const Target& target) {
     TargetJSON target_json = target::parsers::aprofile::ParseTarget(target->Export());
     TargetFeatures afeatures = Downcast<TargetFeatures>(target_json.at("features"));
 
+    if (Downcast<Bool>(afeatures.at("has_matmul_i8"))) {
+      return "i8mm";
+    }
     if (Downcast<Bool>(afeatures.at("has_dotprod"))) {
       return "dotprod";
     }
@@ -111,6 +117,10 @@ void SpaceGeneratorNode::InitializeWithTuneContext(const TuneContext& context) {
       default_sch_rules = ScheduleRule::DefaultX86("vnni");
       default_postprocs = Postproc::DefaultCPUTensorization();
       default_mutator_probs = Mutator::DefaultLLVM();
+    } else if (kind == "avxvnni") {
+      default_sch_rules = ScheduleRule::DefaultX86("avxvnni");
+      default_postprocs = Postproc::DefaultCPUTensorization();
+      default_mutator_probs = Mutator::DefaultLLVM();
     } else if (kind == "avx512") {
       default_sch_rules = ScheduleRule::DefaultX86("avx512");
       default_postprocs = Postproc::DefaultCPUTensorization();
@@ -123,6 +133,10 @@ void SpaceGeneratorNode::InitializeWithTuneContext(const TuneContext& context) {
       default_sch_rules = ScheduleRule::DefaultARM("dotprod");
       default_postprocs = Postproc::DefaultCPUTensorization();
       default_mutator_probs = Mutator::DefaultLLVM();
+    } else if (kind == "i8mm") {
+      default_sch_rules = ScheduleRule::DefaultARM("i8mm");
+      default_postprocs = Postproc::DefaultCPUTensorization();
+      default_mutator_probs = Mutator::DefaultLLVM();
     } else {
       LOG(FATAL) << "Unsupported kind: " << kind;
       throw;
@@ -38,12 +38,18 @@ class LowerRuntimeBuiltinMutator : public ExprMutator {
  public:
   using ExprMutator::VisitExpr_;
 
+  explicit LowerRuntimeBuiltinMutator(Optional<IRModule> mod = std::nullopt) : mod_(mod) {}
+
   Expr VisitExpr_(const CallNode* call_node) final {
     static const auto& lower_builtin_fmap = Op::GetAttrMap<FLowerBuiltin>("FLowerBuiltin");
     // post-order mutation
     Call call = Downcast<Call>(VisitExprPostOrder_(call_node));
 
-    if (call->op == call_tir_dyn_op_) {
+    if (const auto* gvar = call->op.as<GlobalVarNode>()) {
+      if (Optional<Integer> capacity = GetMemoizeCapacity(GetRef<GlobalVar>(gvar))) {
+        return Memoize(call, capacity.value());
+      }
+    } else if (call->op == call_tir_dyn_op_) {
       return CallTIRDyn(call);
     } else if (call->op == reshape_op_) {
       return Reshape(call);
@@ -189,6 +195,30 @@ class LowerRuntimeBuiltinMutator : public ExprMutator {
                 {object_sinfo_});
   }
 
+  /*! \brief The LRU capacity of the callee if it is marked with attr::kMemoize. */
+  Optional<Integer> GetMemoizeCapacity(const GlobalVar& gvar) {
+    if (!mod_.defined() || !mod_.value()->functions.count(gvar)) {
+      return std::nullopt;
+    }
+    if (const auto* func = mod_.value()->Lookup(gvar).as<FunctionNode>()) {
+      return func->GetAttr<Integer>(attr::kMemoize);
+    }
+    return std::nullopt;
+  }
+
+  Expr Memoize(const Call& call_node, Integer capacity) {
+    Array<Expr> args;
+    args.push_back(call_node->op);
+    args.push_back(PrimValue::Int64(capacity->value));
+    for (Expr arg : call_node->args) {
+      args.push_back(arg);
+    }
+    return Call(call_builtin_with_ctx_op_, {builtin_memoize_call_, Tuple(args)}, Attrs(),
+                {GetStructInfo(call_node)});
+  }
+
+  /*! \brief The module of the function being lowered, to look up the attributes of callees. */
+  Optional<IRModule> mod_;
   const Op& call_builtin_with_ctx_op_ = Op::Get("relax.call_builtin_with_ctx");
   const StructInfo object_sinfo_ = ObjectStructInfo();
   const StructInfo void_sinfo_ = TupleStructInfo(Array<StructInfo>({}));
@@ -218,6 +248,7 @@ class LowerRuntimeBuiltinMutator : public ExprMutator {
   const ExternFunc builtin_to_device_{"vm.builtin.to_device"};
   const ExternFunc builtin_make_closure_{"vm.builtin.make_closure"};
   const ExternFunc builtin_invoke_closure_{"vm.builtin.invoke_closure"};
+  const ExternFunc builtin_memoize_call_{"vm.builtin.memoize.call"};
 };
 
 Expr LowerRuntimeBuiltin(const Expr& e) { return LowerRuntimeBuiltinMutator().VisitExpr(e); }
@@ -226,7 +257,7 @@ namespace transform {
 
 Pass LowerRuntimeBuiltin() {
   auto pass_func = [=](Function f, IRModule m, PassContext pc) {
-    return Downcast<Function>(LowerRuntimeBuiltin(f));
+    return Downcast<Function>(LowerRuntimeBuiltinMutator(m).VisitExpr(f));
   };
   return CreateFunctionPass(pass_func, 0, "LowerRuntimeBuiltin", {});
 }
@@ -294,5 +294,84 @@ TVM_REGISTER_OP("relax.outer")
     .set_attr<TMixedPrecisionPolicy>("TMixedPrecisionPolicy", MixedPrecisionPolicyKind::kAlways)
     .set_attr<Bool>("FPurity", Bool(true));
 
+/* relax.sparse_dense */
+
+Expr sparse_dense(Expr x, Expr weight_data, Expr weight_indices, Expr weight_indptr) {
+  static const Op& op = Op::Get("relax.sparse_dense");
+  return Call(op,
+              {std::move(x), std::move(weight_data), std::move(weight_indices),
+               std::move(weight_indptr)},
+              {});
+}
+
+TVM_FFI_REGISTER_GLOBAL("relax.op.sparse_dense").set_body_typed(sparse_dense);
+
+StructInfo InferStructInfoSparseDense(const Call& call, const BlockBuilder& ctx) {
+  Array<TensorStructInfo> input_sinfo = GetInputTensorStructInfo(call, ctx);
+  TensorStructInfo x_sinfo = input_sinfo[0];
+  TensorStructInfo data_sinfo = input_sinfo[1];
+
+  if (x_sinfo->ndim == 0) {
+    ctx->ReportFatal(Diagnostic::Error(call)
+                     << "SparseDense requires the dense input to have at least one dimension.  "
+                     << "However, the input " << call->args[0] << " has struct info " << x_sinfo);
+  }
+  if (!data_sinfo->IsUnknownNdim() && data_sinfo->ndim != 3) {
+    ctx->ReportFatal(Diagnostic::Error(call)
+                     << "SparseDense requires the BSR data to be 3-D (nnz_blocks, bs_r, bs_c).  "
+                     << "However, the data " << call->args[1] << " has struct info "
+                     << data_sinfo);
+  }
+  for (int i = 2; i < 4; ++i) {
+    const TensorStructInfo& index_sinfo = input_sinfo[i];
+    if ((!index_sinfo->IsUnknownNdim() && index_sinfo->ndim != 1) ||
+        (!index_sinfo->IsUnknownDtype() && !index_sinfo->dtype.is_int())) {
+      ctx->ReportFatal(Diagnostic::Error(call)
+                       << "SparseDense requires the BSR indices and indptr to be 1-D integer "
+                       << "tensors.  However, the argument " << call->args[i]
+                       << " has struct info " << index_sinfo);
+    }
+  }
+  if (!x_sinfo->IsUnknownDtype() && !data_sinfo->IsUnknownDtype() &&
+      x_sinfo->dtype != data_sinfo->dtype) {
+    ctx->ReportFatal(Diagnostic::Error(call)
+                     << "SparseDense requires the input and the BSR data to have the same dtype.  "
+                     << "However, the input has dtype " << x_sinfo->dtype
+                     << " while the data has dtype " << data_sinfo->dtype);
+  }
+
+  Optional<VDevice> vdev = x_sinfo->vdevice;
+  if (x_sinfo->IsUnknownNdim()) {
+    return TensorStructInfo(x_sinfo->dtype, kUnknownNDim, vdev);
+  }
+  const auto* x_shape = x_sinfo->shape.as<ShapeExprNode>();
+  const auto* data_shape = data_sinfo->shape.as<ShapeExprNode>();
+  const auto* indptr_shape = input_sinfo[3]->shape.as<ShapeExprNode>();
+  if (x_shape == nullptr || data_shape == nullptr || indptr_shape == nullptr) {
+    return TensorStructInfo(x_sinfo->dtype, x_sinfo->ndim, vdev);
+  }
+
+  arith::Analyzer* analyzer = ctx->GetAnalyzer();
+  PrimExpr reduction_length = x_shape->values.back();
+  PrimExpr block_cols = data_shape->values[2];
+  if (analyzer->CanProve(floormod(reduction_length, block_cols) != 0)) {
+    ctx->ReportFatal(Diagnostic::Error(call)
+                     << "SparseDense requires the reduction length " << reduction_length
+                     << " of the input to be a multiple of the BSR block width " << block_cols);
+  }
+  Array<PrimExpr> output_shape{x_shape->values.begin(), x_shape->values.end() - 1};
+  output_shape.push_back(analyzer->Simplify((indptr_shape->values[0] - 1) * data_shape->values[1]));
+  return TensorStructInfo(ShapeExpr(output_shape), x_sinfo->dtype, vdev);
+}
+
+TVM_REGISTER_OP("relax.sparse_dense")
+    .set_num_inputs(4)
+    .add_argument("x", "Tensor", "The dense input tensor.")
+    .add_argument("weight_data", "Tensor", "The nonzero blocks of the BSR weight.")
+    .add_argument("weight_indices", "Tensor", "The block column indices of the BSR weight.")
+    .add_argument("weight_indptr", "Tensor", "The block row pointers of the BSR weight.")
+    .set_attr<FInferStructInfo>("FInferStructInfo", InferStructInfoSparseDense)
+    .set_attr<Bool>("FPurity", Bool(true));
+
 }  // namespace relax
 }  // namespace tvm
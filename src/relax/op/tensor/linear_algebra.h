@@ -59,6 +59,18 @@ Expr einsum(Expr operands, String subscripts);
  */
 Expr outer(Expr x1, Expr x2);
 
+/*!
+ * \brief Multiply a dense tensor by the transpose of a block-sparse (BSR) matrix.
+ * The sparse weight of shape (N, K) is given by its BSR data, block column indices and
+ * block row pointers, and the result is `x @ weight.T` of shape `x.shape[:-1] + (N,)`.
+ * \param x The dense input tensor, whose last dimension has length K.
+ * \param weight_data The nonzero blocks of the weight, of shape (nnz_blocks, bs_r, bs_c).
+ * \param weight_indices The block column index of each nonzero block, of shape (nnz_blocks,).
+ * \param weight_indptr The first nonzero block of each block row, of shape (N / bs_r + 1,).
+ * \return The computed result.
+ */
+Expr sparse_dense(Expr x, Expr weight_data, Expr weight_indices, Expr weight_indptr);
+
 }  // namespace relax
 }  // namespace tvm
 
@@ -18,9 +18,12 @@
  */
 #include <tvm/relax/analysis.h>
 #include <tvm/relax/expr.h>
+#include <tvm/relax/expr_functor.h>
 #include <tvm/relax/struct_info.h>
 #include <tvm/relax/transform.h>
 #include <tvm/relax/type.h>
+#include <tvm/tir/function.h>
+#include <tvm/tir/op.h>
 
 #include <string>
 #include <unordered_map>
@@ -146,6 +149,234 @@ IRModule ModuleBindSymbolicVars(IRModule mod, Map<ObjectRef, PrimExpr> binding_m
   }
   return mod;
 }
+
+/*! \brief The name of a bound value, in the names of the specialized functions. */
+std::string ValueName(const PrimExpr& value) {
+  const auto* imm = value.as<IntImmNode>();
+  return imm ? std::to_string(imm->value) : "expr";
+}
+
+/*!
+ * \brief Multi-version the functions for the hot values of their symbolic vars.
+ *
+ * For each combination of the hot values of the symbolic vars defined by the parameters
+ * of a function, the function is cloned with the vars bound by FunctionBindSymbolicVars,
+ * and the PrimFuncs it calls are specialized for the static shapes of their arguments.
+ * The function then dispatches on entry to the clone of the values of its arguments,
+ * and falls back to its generic body for the other values.
+ */
+class SymbolicVarSpecializer : public ExprMutator {
+ public:
+  static IRModule Transform(IRModule mod, Map<ObjectRef, Array<PrimExpr>> hot_values,
+                            Optional<String> func_name) {
+    SymbolicVarSpecializer specializer(mod);
+    std::unordered_set<const Object*> used;
+    for (const auto& [gvar, base_func] : mod->functions) {
+      auto func = base_func.as<Function>();
+      if (!func || (func_name && gvar->name_hint != func_name.value())) continue;
+
+      // The hot values of the symbolic vars that are known on entry.
+      std::unordered_map<std::string, Array<tir::Var>> string_lookup;
+      std::unordered_set<const tir::VarNode*> entry_vars;
+      for (const Var& param : func.value()->params) {
+        for (const tir::Var& var : DefinableTIRVarsInStructInfo(GetStructInfo(param))) {
+          if (entry_vars.insert(var.get()).second) {
+            string_lookup[var->name_hint].push_back(var);
+          }
+        }
+      }
+      std::vector<std::pair<tir::Var, Array<PrimExpr>>> func_hot_values;
+      for (const auto& [key, values] : hot_values) {
+        Optional<tir::Var> var;
+        if (auto opt = key.as<String>()) {
+          auto it = string_lookup.find(opt.value());
+          if (it == string_lookup.end()) continue;
+          CHECK_EQ(it->second.size(), 1)
+              << "Function contains multiple symbolic variables with name \"" << opt.value()
+              << "\".  The TIR variables " << it->second << " are all named \"" << opt.value()
+              << "\"";
+          var = it->second[0];
+        } else if (auto opt = key.as<tir::Var>()) {
+          if (!entry_vars.count(opt.value().get())) continue;
+          var = opt.value();
+        } else {
+          LOG(FATAL) << "Expected symbolic variable to be a tir::Var "
+                     << "or a string name, but " << key << " was of type " << key->GetTypeKey();
+        }
+        used.insert(key.get());
+        func_hot_values.emplace_back(var.value(), values);
+      }
+      if (func_hot_values.empty()) continue;
+
+      Function updated = specializer.MultiVersion(gvar, func.value(), func_hot_values);
+      specializer.builder_->UpdateFunction(gvar, updated);
+    }
+
+    Array<ObjectRef> unused;
+    for (const auto& [key, values] : hot_values) {
+      if (!used.count(key.get())) {
+        unused.push_back(key);
+      }
+    }
+    CHECK_EQ(unused.size(), 0) << "Hot values contain keys " << unused
+                               << ", which did not correspond to any symbolic variables "
+                               << "defined by the parameters of the functions.";
+    return specializer.builder_->GetContextIRModule();
+  }
+
+ private:
+  explicit SymbolicVarSpecializer(IRModule mod) : ExprMutator(mod) {}
+
+  using ExprMutator::VisitExpr_;
+
+  Function MultiVersion(const GlobalVar& gvar, const Function& func,
+                        const std::vector<std::pair<tir::Var, Array<PrimExpr>>>& hot_values) {
+    // The combinations of the hot values.
+    std::vector<Map<tir::Var, PrimExpr>> versions{{}};
+    for (const auto& [var, values] : hot_values) {
+      std::vector<Map<tir::Var, PrimExpr>> extended;
+      for (const auto& version : versions) {
+        for (const PrimExpr& value : values) {
+          Map<tir::Var, PrimExpr> bound = version;
+          bound.Set(var, cast(var.dtype(), value));
+          extended.push_back(bound);
+        }
+      }
+      versions = std::move(extended);
+    }
+
+    Expr body = func->body;
+    for (auto it = versions.rbegin(); it != versions.rend(); ++it) {
+      const Map<tir::Var, PrimExpr>& version = *it;
+      std::string suffix;
+      PrimExpr cond = tir::const_true();
+      for (const auto& [var, value] : hot_values) {
+        suffix += "_" + std::string(var->name_hint) + "_" + ValueName(version.at(var));
+        cond = logical_and(cond, tir::EQ(var, version.at(var)));
+      }
+      Map<ObjectRef, PrimExpr> binding_map;
+      for (const auto& [var, value] : version) {
+        binding_map.Set(var, value);
+      }
+      Function clone = FunctionBindSymbolicVars(func, binding_map);
+      clone = WithoutAttr(Downcast<Function>(VisitExpr(clone)), tvm::attr::kGlobalSymbol);
+      GlobalVar clone_gvar = builder_->AddFunction(clone, gvar->name_hint + suffix);
+
+      // if (cond) { return clone(match_cast(params)) } else { <the next version> }
+      Array<Binding> bindings;
+      Array<Expr> args;
+      for (size_t i = 0; i < func->params.size(); ++i) {
+        Var arg(func->params[i]->name_hint(), GetStructInfo(clone->params[i]));
+        bindings.push_back(MatchCast(arg, func->params[i], GetStructInfo(clone->params[i])));
+        args.push_back(arg);
+      }
+      Var result("result", clone->ret_struct_info);
+      bindings.push_back(VarBinding(result, Call(clone_gvar, args)));
+      Var output("output", func->ret_struct_info);
+      bindings.push_back(MatchCast(output, result, func->ret_struct_info));
+      body = If(PrimValue(cond), SeqExpr({BindingBlock(bindings)}, output), body);
+    }
+    Function updated = func;
+    updated.CopyOnWrite()->body = SeqExpr({}, body);
+    return Downcast<Function>(builder_->Normalize(updated));
+  }
+
+  Expr VisitExpr_(const CallNode* op) final {
+    static const Op& call_tir_op = Op::Get("relax.call_tir");
+    Call call = Downcast<Call>(ExprMutator::VisitExpr_(op));
+    if (!call->op.same_as(call_tir_op)) return call;
+    GlobalVar gvar = Downcast<GlobalVar>(call->args[0]);
+    auto base_func = builder_->GetContextIRModule()->functions.Get(gvar);
+    if (!base_func || !base_func.value()->IsInstance<tir::PrimFuncNode>()) return call;
+    tir::PrimFunc func = Downcast<tir::PrimFunc>(base_func.value());
+
+    // The static shapes of the inputs and outputs, in the order of the buffer params.
+    Array<StructInfo> buffer_sinfo;
+    for (const Expr& arg : Downcast<Tuple>(call->args[1])->fields) {
+      buffer_sinfo.push_back(GetStructInfo(arg));
+    }
+    if (const auto* tuple = call->sinfo_args[0].as<TupleStructInfoNode>()) {
+      buffer_sinfo.insert(buffer_sinfo.end(), tuple->fields.begin(), tuple->fields.end());
+    } else {
+      buffer_sinfo.push_back(call->sinfo_args[0]);
+    }
+    if (buffer_sinfo.size() > func->params.size()) return call;
+
+    Map<tir::Var, PrimExpr> var_values;
+    std::string key = gvar->name_hint;
+    for (size_t i = 0; i < buffer_sinfo.size(); ++i) {
+      auto buffer = func->buffer_map.Get(func->params[i]);
+      const auto* sinfo = buffer_sinfo[i].as<TensorStructInfoNode>();
+      auto shape = sinfo ? sinfo->GetShape() : std::nullopt;
+      if (!buffer || !shape || shape.value().size() != buffer.value()->shape.size()) continue;
+      for (size_t j = 0; j < shape.value().size(); ++j) {
+        auto var = buffer.value()->shape[j].as<tir::Var>();
+        if (var && shape.value()[j]->IsInstance<IntImmNode>() && !var_values.count(var.value())) {
+          var_values.Set(var.value(), cast(var.value().dtype(), shape.value()[j]));
+          key += "_" + std::string(var.value()->name_hint) + "_" + ValueName(shape.value()[j]);
+        }
+      }
+    }
+    Map<tir::Var, Variant<tir::Buffer, PrimExpr>> param_map;
+    if (call->args.size() > 2) {
+      Array<PrimExpr> tir_vars = Downcast<ShapeExpr>(call->args[2])->values;
+      for (size_t i = 0; i < tir_vars.size(); ++i) {
+        const tir::Var& param = func->params[buffer_sinfo.size() + i];
+        if (tir_vars[i]->IsInstance<IntImmNode>()) {
+          param_map.Set(param, cast(param.dtype(), tir_vars[i]));
+          key += "_" + std::string(param->name_hint) + "_" + ValueName(tir_vars[i]);
+        }
+      }
+    }
+    // Specialize each buffer param on the values of the vars of its shape.
+    for (size_t i = 0; i < buffer_sinfo.size(); ++i) {
+      auto buffer = func->buffer_map.Get(func->params[i]);
+      if (!buffer) continue;
+      Array<PrimExpr> shape = buffer.value()->shape.Map([&](const PrimExpr& dim) -> PrimExpr {
+        auto var = dim.as<tir::Var>();
+        return var && var_values.count(var.value()) ? var_values.at(var.value()) : dim;
+      });
+      if (!shape.same_as(buffer.value()->shape)) {
+        tir::Buffer specific = buffer.value();
+        specific.CopyOnWrite()->shape = shape;
+        param_map.Set(func->params[i], specific);
+      }
+    }
+    if (param_map.empty()) return call;
+
+    auto it = specialized_.find(key);
+    if (it == specialized_.end()) {
+      // The specialized PrimFunc is internal, and keeping the symbol of a public PrimFunc
+      // would define the symbol twice.
+      tir::PrimFunc specialized =
+          WithoutAttr(tir::Specialize(func, param_map), tvm::attr::kGlobalSymbol);
+      GlobalVar specialized_gvar = builder_->AddFunction(specialized, key);
+      it = specialized_.emplace(key, std::make_pair(specialized_gvar, specialized)).first;
+    }
+    const auto& [specialized_gvar, specialized] = it->second;
+
+    Array<Expr> args{specialized_gvar, call->args[1]};
+    if (call->args.size() > 2) {
+      // The tir vars of the params left by the specialization.
+      std::unordered_set<const tir::VarNode*> remaining;
+      for (const tir::Var& param : specialized->params) remaining.insert(param.get());
+      Array<PrimExpr> tir_vars;
+      Array<PrimExpr> old_tir_vars = Downcast<ShapeExpr>(call->args[2])->values;
+      for (size_t i = 0; i < old_tir_vars.size(); ++i) {
+        if (remaining.count(func->params[buffer_sinfo.size() + i].get())) {
+          tir_vars.push_back(old_tir_vars[i]);
+        }
+      }
+      if (!tir_vars.empty()) args.push_back(ShapeExpr(tir_vars));
+    }
+    Call updated = call;
+    updated.CopyOnWrite()->args = args;
+    return updated;
+  }
+
+  /*! \brief The specialized PrimFuncs, by the name of the PrimFunc and the bound values. */
+  std::unordered_map<std::string, std::pair<GlobalVar, tir::PrimFunc>> specialized_;
+};
 }  // namespace
 
 TVM_FFI_REGISTER_GLOBAL("relax.FunctionBindSymbolicVars").set_body_typed(FunctionBindSymbolicVars);
@@ -172,6 +403,17 @@ Pass BindSymbolicVars(Map<ObjectRef, PrimExpr> binding_map, Optional<String> fun
 
 TVM_FFI_REGISTER_GLOBAL("relax.transform.BindSymbolicVars").set_body_typed(BindSymbolicVars);
 
+Pass SpecializeSymbolicVars(Map<ObjectRef, Array<PrimExpr>> hot_values,
+                            Optional<String> func_name) {
+  auto pass_func = [=](IRModule mod, PassContext context) -> IRModule {
+    return SymbolicVarSpecializer::Transform(mod, hot_values, func_name);
+  };
+  return tvm::transform::CreateModulePass(pass_func, 1, "relax.SpecializeSymbolicVars", {});
+}
+
+TVM_FFI_REGISTER_GLOBAL("relax.transform.SpecializeSymbolicVars")
+    .set_body_typed(SpecializeSymbolicVars);
+
 }  // namespace transform
 }  // namespace relax
 }  // namespace tvm
@@ -0,0 +1,399 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/relax/transform/convert_to_streaming.cc
+ * \brief Convert a function of causal convolutions and poolings over a sequence into a function
+ * that processes the sequence chunk by chunk, carrying its state over from a chunk to the next.
+ */
+#include <tvm/relax/analysis.h>
+#include <tvm/relax/attrs/nn.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/struct_info.h>
+#include <tvm/relax/transform.h>
+#include <tvm/relax/utils.h>
+#include <tvm/tir/op.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../op/tensor/create.h"
+#include "../op/tensor/index.h"
+#include "../op/tensor/manipulate.h"
+#include "utils.h"
+
+namespace tvm {
+namespace relax {
+
+namespace {
+
+/*! \brief A run of padding frames at the start of the sequence. */
+struct PadSegment {
+  int64_t num_frames;
+  double value;
+};
+
+/*! \brief A value over the sequence, as computed chunk by chunk by the streaming function. */
+struct StreamedValue {
+  /*! \brief The chunk of the value. */
+  Expr chunk;
+  /*! \brief The number of frames of the chunk. */
+  int64_t chunk_len;
+  /*!
+   * \brief The padding of the start of the sequence by nn.pad, outermost first. It is not
+   * materialized in the chunks, but folded into the initial state of the consumer.
+   */
+  std::vector<PadSegment> pending_pad;
+};
+
+/*! \brief The frames carried over from a chunk to the next one by a window op. */
+struct StreamState {
+  /*! \brief The parameter of the streaming function holding the state. */
+  Var param;
+  /*! \brief The state after the chunk. */
+  Expr next;
+  /*! \brief The initial state, which is the padding of the start of the sequence. */
+  std::vector<PadSegment> init;
+};
+
+/*! \brief The element-wise ops, which compute each frame of the sequence independently. */
+bool IsElementwise(const Op& op) {
+  static const std::unordered_set<std::string> elementwise_ops = {
+      "relax.abs",      "relax.add",          "relax.astype",       "relax.clip",
+      "relax.divide",   "relax.exp",          "relax.log",          "relax.maximum",
+      "relax.minimum",  "relax.multiply",     "relax.negative",     "relax.power",
+      "relax.rsqrt",    "relax.sigmoid",      "relax.sqrt",         "relax.square",
+      "relax.subtract", "relax.tanh",         "relax.nn.gelu",      "relax.nn.gelu_tanh",
+      "relax.nn.relu",  "relax.nn.leakyrelu", "relax.nn.silu"};
+  return elementwise_ops.count(op->name);
+}
+
+class StreamingConverter {
+ public:
+  explicit StreamingConverter(int64_t chunk_size) : chunk_size_(chunk_size) {}
+
+  /*!
+   * \brief Convert the function.
+   * \return The streaming function, of signature (chunk, states..., params...) -> (output chunk,
+   * next states), and the function of signature (chunk) -> states, which creates the initial
+   * states for the chunks of the shape.
+   */
+  std::pair<Function, Function> Convert(const Function& func) {
+    CHECK(!func->params.empty()) << "ConvertToStreaming requires the function to have the "
+                                 << "sequence as its first parameter";
+    Var input = func->params[0];
+    const auto* input_sinfo = GetStructInfoAs<TensorStructInfoNode>(input);
+    CHECK(input_sinfo && input_sinfo->shape.defined() && input_sinfo->ndim >= 1)
+        << "ConvertToStreaming requires the first parameter of the function to be a tensor of "
+        << "known shape, whose last axis is the sequence.  However, its struct info is "
+        << GetStructInfo(input);
+    Array<PrimExpr> chunk_shape = input_sinfo->GetShape().value();
+    chunk_shape.Set(chunk_shape.size() - 1, IntImm(DataType::Int(64), chunk_size_));
+    chunk_sinfo_ = TensorStructInfo(ShapeExpr(chunk_shape), input_sinfo->dtype,
+                                    input_sinfo->vdevice);
+    Var chunk(input->name_hint() + "_chunk", chunk_sinfo_);
+    streamed_[input.get()] = StreamedValue{chunk, chunk_size_, {}};
+
+    const auto* seq = func->body.as<SeqExprNode>();
+    CHECK(seq) << "ConvertToStreaming requires the body of the function to be normalized";
+    builder_->BeginBindingBlock();
+    for (const BindingBlock& block : seq->blocks) {
+      for (const Binding& binding : block->bindings) {
+        VisitBinding(binding);
+      }
+    }
+    auto it = streamed_.find(seq->body.as<VarNode>());
+    CHECK(it != streamed_.end() && it->second.pending_pad.empty())
+        << "ConvertToStreaming requires the output of the function to be a value over the "
+        << "sequence, but got " << seq->body;
+
+    Array<Var> params{chunk};
+    Array<Expr> next_states;
+    for (const StreamState& state : states_) {
+      params.push_back(state.param);
+      next_states.push_back(state.next);
+    }
+    params.insert(params.end(), func->params.begin() + 1, func->params.end());
+    Expr output = builder_->Normalize(Tuple({it->second.chunk, Tuple(next_states)}));
+    Expr body = builder_->Normalize(SeqExpr({builder_->EndBlock()}, output));
+
+    Function stream_func(params, body, std::nullopt, func->is_pure, func->attrs);
+    if (auto num_input = func->GetAttr<Integer>(attr::kNumInput)) {
+      int64_t stream_num_input = num_input.value()->value + static_cast<int64_t>(states_.size());
+      stream_func = WithAttr(std::move(stream_func), attr::kNumInput, Integer(stream_num_input));
+    }
+    return {stream_func, CreateInitFunction(input->name_hint() + "_chunk")};
+  }
+
+ private:
+  void VisitBinding(const Binding& binding) {
+    Expr value = GetBoundValue(binding);
+    bool is_streamed = false;
+    for (const Var& var : FreeVars(value)) {
+      is_streamed = is_streamed || streamed_.count(var.get());
+    }
+    if (!is_streamed) {
+      // The weights and the other values that do not depend on the sequence.
+      value = Bind(value, var_remap_);
+      if (const auto* match_cast = binding.as<MatchCastNode>()) {
+        var_remap_.Set(binding->var, builder_->EmitMatchCast(value, match_cast->struct_info,
+                                                             binding->var->name_hint()));
+      } else {
+        var_remap_.Set(binding->var, builder_->Emit(value, binding->var->name_hint()));
+      }
+      return;
+    }
+
+    std::optional<StreamedValue> streamed;
+    if (binding->IsInstance<VarBindingNode>()) {
+      if (const auto* var = value.as<VarNode>()) {
+        streamed = streamed_.at(var);
+      } else if (const auto* call = value.as<CallNode>()) {
+        if (const auto* op = call->op.as<OpNode>()) {
+          streamed = VisitCall(GetRef<Call>(call), GetRef<Op>(op), binding->var->name_hint());
+        }
+      }
+    }
+    CHECK(streamed) << "ConvertToStreaming cannot stream " << binding->var << " = " << value
+                    << ".  Only causal nn.conv1d, nn.max_pool1d and nn.avg_pool1d in the NCW "
+                    << "layout, nn.pad of the start of the sequence and element-wise ops are "
+                    << "supported over the sequence";
+    streamed_[binding->var.get()] = streamed.value();
+  }
+
+  std::optional<StreamedValue> VisitCall(const Call& call, const Op& op, const String& name) {
+    static const Op& conv1d_op = Op::Get("relax.nn.conv1d");
+    static const Op& max_pool1d_op = Op::Get("relax.nn.max_pool1d");
+    static const Op& avg_pool1d_op = Op::Get("relax.nn.avg_pool1d");
+    static const Op& pad_op = Op::Get("relax.nn.pad");
+
+    if (op.same_as(conv1d_op)) {
+      const auto* attrs = call->attrs.as<Conv1DAttrs>();
+      if (!streamed_.count(call->args[0].get()) || attrs->data_layout != "NCW" ||
+          attrs->out_layout != "NCW") {
+        return std::nullopt;
+      }
+      const auto* weight_sinfo = GetStructInfoAs<TensorStructInfoNode>(call->args[1]);
+      size_t kernel_axis = std::string(attrs->kernel_layout).find('W');
+      const auto* kernel = weight_sinfo->GetShape().value()[kernel_axis].as<IntImmNode>();
+      CHECK(kernel) << "ConvertToStreaming requires the kernel of " << call << " to be static";
+      auto new_attrs = make_object<Conv1DAttrs>(*attrs);
+      new_attrs->padding = {IntImm(DataType::Int(64), 0), IntImm(DataType::Int(64), 0)};
+      return EmitWindow(call, Attrs(new_attrs), name, kernel->value, attrs->strides[0]->value,
+                        attrs->dilation[0]->value, attrs->padding, 0.0);
+    }
+    if (op.same_as(max_pool1d_op) || op.same_as(avg_pool1d_op)) {
+      const auto* attrs = call->attrs.as<Pool1DAttrs>();
+      const auto* sinfo = GetStructInfoAs<TensorStructInfoNode>(call->args[0]);
+      if (attrs->layout != "NCW" || attrs->out_layout != "NCW" || attrs->ceil_mode) {
+        return std::nullopt;
+      }
+      // The padding of the average is counted in by the window over the state.
+      if (op.same_as(avg_pool1d_op) && !attrs->count_include_pad &&
+          attrs->padding[0]->value > 0) {
+        return std::nullopt;
+      }
+      double pad_value = 0.0;
+      if (op.same_as(max_pool1d_op)) {
+        PrimExpr min_value = tvm::min_value(sinfo->dtype);
+        if (const auto* float_imm = min_value.as<FloatImmNode>()) {
+          pad_value = float_imm->value;
+        } else {
+          pad_value = static_cast<double>(Downcast<IntImm>(min_value)->value);
+        }
+      }
+      auto new_attrs = make_object<Pool1DAttrs>(*attrs);
+      new_attrs->padding = {IntImm(DataType::Int(64), 0), IntImm(DataType::Int(64), 0)};
+      return EmitWindow(call, Attrs(new_attrs), name, attrs->pool_size[0]->value,
+                        attrs->strides[0]->value, attrs->dilation[0]->value, attrs->padding,
+                        pad_value);
+    }
+    if (op.same_as(pad_op)) {
+      const auto* attrs = call->attrs.as<PadAttrs>();
+      auto it = streamed_.find(call->args[0].get());
+      if (it == streamed_.end() || attrs->pad_mode != "constant") {
+        return std::nullopt;
+      }
+      size_t time_axis = attrs->pad_width.size() / 2 - 1;
+      for (size_t i = 0; i < attrs->pad_width.size(); ++i) {
+        if (i != 2 * time_axis && attrs->pad_width[i]->value != 0) {
+          return std::nullopt;
+        }
+      }
+      StreamedValue padded = it->second;
+      padded.pending_pad.insert(padded.pending_pad.begin(),
+                                PadSegment{attrs->pad_width[2 * time_axis]->value,
+                                           attrs->pad_value});
+      return padded;
+    }
+    if (IsElementwise(op)) {
+      return EmitElementwise(call, name);
+    }
+    return std::nullopt;
+  }
+
+  /*!
+   * \brief Emit a window op over the sequence. The window over a chunk starts with the state,
+   * which holds the last frames of the input before the chunk, so that the op runs unpadded.
+   */
+  std::optional<StreamedValue> EmitWindow(const Call& call, Attrs new_attrs, const String& name,
+                                          int64_t kernel, int64_t stride, int64_t dilation,
+                                          const Array<IntImm>& padding, double pad_value) {
+    const StreamedValue& data = streamed_.at(call->args[0].get());
+    std::vector<PadSegment> init{PadSegment{padding[0]->value, pad_value}};
+    init.insert(init.end(), data.pending_pad.begin(), data.pending_pad.end());
+    int64_t num_state_frames = 0;
+    for (const PadSegment& segment : init) {
+      num_state_frames += segment.num_frames;
+    }
+    int64_t window = (kernel - 1) * dilation + 1;
+    CHECK(padding[1]->value == 0 && num_state_frames == window - stride)
+        << "ConvertToStreaming requires " << call << " to be causal, with " << window - stride
+        << " frames of padding at the start of the sequence and none at its end";
+    CHECK_EQ(data.chunk_len % stride, 0)
+        << "ConvertToStreaming requires the chunks of " << call->args[0] << ", of "
+        << data.chunk_len << " frames, to be a multiple of the stride of " << call;
+
+    Expr input = data.chunk;
+    if (num_state_frames > 0) {
+      const auto* sinfo = GetStructInfoAs<TensorStructInfoNode>(data.chunk);
+      Array<PrimExpr> state_shape = sinfo->GetShape().value();
+      int64_t time_axis = sinfo->ndim - 1;
+      state_shape.Set(time_axis, IntImm(DataType::Int(64), num_state_frames));
+      Var state(name + "_state",
+                TensorStructInfo(ShapeExpr(state_shape), sinfo->dtype, sinfo->vdevice));
+      input = builder_->Emit(concat(Tuple({state, data.chunk}), time_axis), name + "_window");
+      auto prim_tuple = [](int64_t value) { return Tuple({PrimValue::Int64(value)}); };
+      Expr next = builder_->Emit(
+          strided_slice(input, prim_tuple(time_axis), prim_tuple(data.chunk_len),
+                        prim_tuple(data.chunk_len + num_state_frames)),
+          name + "_next_state");
+      states_.push_back(StreamState{state, next, init});
+    }
+    Array<Expr> args{input};
+    for (size_t i = 1; i < call->args.size(); ++i) {
+      args.push_back(Bind(call->args[i], var_remap_));
+    }
+    Expr output = builder_->Emit(Call(call->op, args, new_attrs, call->sinfo_args), name);
+    return StreamedValue{output, data.chunk_len / stride, {}};
+  }
+
+  /*! \brief Emit an element-wise op, whose other operands are broadcast over the sequence. */
+  std::optional<StreamedValue> EmitElementwise(const Call& call, const String& name) {
+    int64_t chunk_len = -1;
+    int ndim = -1;
+    Array<Expr> args;
+    for (const Expr& arg : call->args) {
+      auto it = streamed_.find(arg.get());
+      if (it == streamed_.end()) {
+        args.push_back(Bind(arg, var_remap_));
+        continue;
+      }
+      CHECK(it->second.pending_pad.empty())
+          << "ConvertToStreaming requires the padding of " << arg
+          << " by nn.pad to be consumed by a window op, but it is used by " << call;
+      if (chunk_len != -1 && chunk_len != it->second.chunk_len) {
+        return std::nullopt;
+      }
+      chunk_len = it->second.chunk_len;
+      ndim = GetStructInfoAs<TensorStructInfoNode>(arg)->ndim;
+      args.push_back(it->second.chunk);
+    }
+    // The other operands must not extend over the sequence.
+    for (const Expr& arg : call->args) {
+      const auto* sinfo = GetStructInfoAs<TensorStructInfoNode>(arg);
+      if (streamed_.count(arg.get()) || !sinfo || sinfo->ndim == 0) {
+        continue;
+      }
+      Optional<Array<PrimExpr>> shape = sinfo->GetShape();
+      if (sinfo->ndim == kUnknownNDim || sinfo->ndim > ndim || !shape ||
+          !tir::is_one(shape.value().back())) {
+        return std::nullopt;
+      }
+    }
+    Expr output = builder_->Emit(Call(call->op, args, call->attrs, call->sinfo_args), name);
+    return StreamedValue{output, chunk_len, {}};
+  }
+
+  /*! \brief Create the function which returns the initial states, the padding of the start. */
+  Function CreateInitFunction(const String& chunk_name) {
+    BlockBuilder builder = BlockBuilder::Create(std::nullopt);
+    Var chunk(chunk_name, chunk_sinfo_);
+    builder->BeginBindingBlock();
+    Array<Expr> states;
+    for (const StreamState& state : states_) {
+      const auto* sinfo = GetStructInfoAs<TensorStructInfoNode>(state.param);
+      Array<PrimExpr> shape = sinfo->GetShape().value();
+      Array<Expr> segments;
+      for (const PadSegment& segment : state.init) {
+        if (segment.num_frames == 0) {
+          continue;
+        }
+        shape.Set(shape.size() - 1, IntImm(DataType::Int(64), segment.num_frames));
+        segments.push_back(full(shape, MakeConstantScalar(segment.value, sinfo->dtype),
+                                sinfo->dtype));
+      }
+      Expr init = segments.size() == 1 ? segments[0] : concat(Tuple(segments), sinfo->ndim - 1);
+      states.push_back(builder->Emit(init, state.param->name_hint()));
+    }
+    Expr output = builder->Normalize(Tuple(states));
+    Expr body = builder->Normalize(SeqExpr({builder->EndBlock()}, output));
+    return Function({chunk}, body, std::nullopt, /*is_pure=*/true);
+  }
+
+  BlockBuilder builder_ = BlockBuilder::Create(std::nullopt);
+  int64_t chunk_size_;
+  TensorStructInfo chunk_sinfo_;
+  /*! \brief The values over the sequence. */
+  std::unordered_map<const Object*, StreamedValue> streamed_;
+  /*! \brief The other values, as re-emitted in the streaming function. */
+  Map<Var, Expr> var_remap_;
+  std::vector<StreamState> states_;
+};
+
+}  // namespace
+
+namespace transform {
+
+Pass ConvertToStreaming(String func_name, int chunk_size) {
+  auto pass_func = [=](IRModule mod, PassContext context) -> IRModule {
+    CHECK_GT(chunk_size, 0) << "ConvertToStreaming requires a positive chunk size";
+    auto func = Downcast<Function>(mod->Lookup(func_name));
+    auto [stream_func, init_func] = StreamingConverter(chunk_size).Convert(func);
+
+    auto write_ptr = mod.CopyOnWrite();
+    for (auto [name, new_func] : {std::pair{func_name + "_stream", stream_func},
+                                  std::pair{func_name + "_stream_init", init_func}}) {
+      new_func = WithAttr(std::move(new_func), tvm::attr::kGlobalSymbol, name);
+      GlobalVar gvar(name);
+      UpdateStructInfo(gvar, GetStructInfo(new_func));
+      write_ptr->Add(gvar, new_func);
+    }
+    return mod;
+  };
+  return tvm::transform::CreateModulePass(pass_func, 0, "relax.ConvertToStreaming", {});
+}
+
+TVM_FFI_REGISTER_GLOBAL("relax.transform.ConvertToStreaming").set_body_typed(ConvertToStreaming);
+
+}  // namespace transform
+}  // namespace relax
+}  // namespace tvm
@@ -0,0 +1,461 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/relax/transform/horizontal_fuse_tir.cc
+ * \brief Fuse independent small call_tir into one PrimFunc with a combined parallel loop.
+ */
+
+#include <tvm/relax/analysis.h>
+#include <tvm/relax/expr_functor.h>
+#include <tvm/relax/transform.h>
+#include <tvm/tir/analysis.h>
+#include <tvm/tir/op.h>
+#include <tvm/tir/stmt_functor.h>
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace tvm {
+namespace tir {
+
+/*!
+ * \brief A kernel that can run as a part of a horizontally fused PrimFunc.
+ *
+ * The kernel is split into tasks along its outermost loop when the loop is
+ * spatial, and is a single task otherwise.
+ */
+struct HorizontalKernel {
+  /*! \brief The kernel, with its own vars and buffers. */
+  PrimFunc func;
+  /*! \brief The body of the root block of the kernel. */
+  Stmt body;
+  /*! \brief The buffers allocated in the root block of the kernel. */
+  Array<Buffer> alloc_buffers;
+  /*! \brief The outermost loop the tasks iterate over, if the kernel splits into tasks. */
+  Optional<For> task_loop;
+  /*! \brief The number of tasks of the kernel. */
+  int64_t num_tasks = 1;
+  /*! \brief The estimated number of innermost loop iterations of the kernel. */
+  int64_t work = 0;
+};
+
+/*! \brief Estimate the number of innermost loop iterations of a statement. */
+class KernelWorkEstimator : public StmtVisitor {
+ public:
+  /*! \return The estimated work, or -1 if a loop extent is not constant. */
+  static int64_t Estimate(const Stmt& stmt) {
+    KernelWorkEstimator estimator;
+    estimator(stmt);
+    return estimator.dynamic_ ? -1 : estimator.work_;
+  }
+
+ private:
+  void VisitStmt_(const ForNode* op) final {
+    const auto* extent = op->extent.as<IntImmNode>();
+    if (extent == nullptr) {
+      dynamic_ = true;
+      return;
+    }
+    int64_t multiplier = multiplier_;
+    multiplier_ = SaturatingMul(multiplier_, std::max<int64_t>(extent->value, 0));
+    StmtVisitor::VisitStmt_(op);
+    multiplier_ = multiplier;
+  }
+
+  void VisitStmt_(const BufferStoreNode* op) final {
+    work_ = std::min(work_ + multiplier_, kMaxWork);
+  }
+
+  static int64_t SaturatingMul(int64_t a, int64_t b) {
+    return (b != 0 && a > kMaxWork / b) ? kMaxWork : a * b;
+  }
+
+  static constexpr int64_t kMaxWork = std::numeric_limits<int64_t>::max() / 2;
+  int64_t multiplier_ = 1;
+  int64_t work_ = 0;
+  bool dynamic_ = false;
+};
+
+/*!
+ * \brief Check that the iterations of a loop are independent: the loop var is
+ * only bound to spatial block iterators, or used in block predicates.
+ */
+class SpatialLoopChecker : public StmtExprVisitor {
+ public:
+  static bool Check(const For& loop) {
+    SpatialLoopChecker checker(loop->loop_var);
+    checker(loop->body);
+    return checker.spatial_;
+  }
+
+ private:
+  explicit SpatialLoopChecker(const Var& loop_var) : loop_var_(loop_var.get()) {}
+
+  void VisitStmt_(const BlockRealizeNode* op) final {
+    for (size_t i = 0; i < op->iter_values.size(); ++i) {
+      bool uses_loop_var =
+          UsesVar(op->iter_values[i], [this](const VarNode* var) { return var == loop_var_; });
+      if (uses_loop_var && op->block->iter_vars[i]->iter_type != kDataPar) {
+        spatial_ = false;
+      }
+    }
+    VisitStmt(op->block);
+  }
+
+  void VisitExpr_(const VarNode* op) final {
+    if (op == loop_var_) spatial_ = false;
+  }
+
+  const VarNode* loop_var_;
+  bool spatial_ = true;
+};
+
+/*! \brief Run the parallel loops of a kernel serially, in the task of the fused loop. */
+class ParallelLoopSerializer : public StmtMutator {
+ private:
+  Stmt VisitStmt_(const ForNode* op) final {
+    For loop = Downcast<For>(StmtMutator::VisitStmt_(op));
+    if (loop->kind == ForKind::kParallel) {
+      loop.CopyOnWrite()->kind = ForKind::kSerial;
+    }
+    return loop;
+  }
+};
+
+/*!
+ * \brief Analyze whether a PrimFunc can be fused horizontally.
+ * \return The kernel, or std::nullopt if the PrimFunc has symbolic shapes or loop extents,
+ * thread bindings, non-buffer parameters or no root block.
+ */
+std::optional<HorizontalKernel> AnalyzeHorizontalKernel(const PrimFunc& original) {
+  PrimFunc func = RenewDefs(original);
+  for (const Var& param : func->params) {
+    auto it = func->buffer_map.find(param);
+    if (it == func->buffer_map.end()) return std::nullopt;
+    for (const PrimExpr& dim : (*it).second->shape) {
+      if (!dim->IsInstance<IntImmNode>()) return std::nullopt;
+    }
+  }
+  const auto* realize = func->body.as<BlockRealizeNode>();
+  if (realize == nullptr || !realize->block->iter_vars.empty() ||
+      !realize->block->match_buffers.empty() || realize->block->init.defined()) {
+    return std::nullopt;
+  }
+  bool has_thread_binding = false;
+  PostOrderVisit(realize->block->body, [&](const ObjectRef& obj) {
+    if (const auto* loop = obj.as<ForNode>()) {
+      has_thread_binding |= loop->kind == ForKind::kThreadBinding;
+    } else if (const auto* attr = obj.as<AttrStmtNode>()) {
+      has_thread_binding |= attr->attr_key == attr::thread_extent;
+    }
+  });
+  if (has_thread_binding) return std::nullopt;
+
+  HorizontalKernel kernel;
+  kernel.func = func;
+  kernel.body = ParallelLoopSerializer()(realize->block->body);
+  kernel.alloc_buffers = realize->block->alloc_buffers;
+  kernel.work = KernelWorkEstimator::Estimate(kernel.body);
+  if (kernel.work < 0) return std::nullopt;
+  // Peel the outermost unit loops, e.g. of the batch 1, to split along the next loop.
+  while (const auto* loop = kernel.body.as<ForNode>()) {
+    if (!is_zero(loop->min) || !is_one(loop->extent)) break;
+    kernel.body = Substitute(loop->body, {{loop->loop_var, make_zero(loop->loop_var.dtype())}});
+  }
+  // The root buffers may be shared by the iterations of the outermost loop, so
+  // only the kernels with none are split into tasks.
+  if (const auto* loop = kernel.body.as<ForNode>()) {
+    const auto* min = loop->min.as<IntImmNode>();
+    const auto* extent = loop->extent.as<IntImmNode>();
+    if (kernel.alloc_buffers.empty() && min != nullptr && min->value == 0 && extent != nullptr &&
+        extent->value > 0 && SpatialLoopChecker::Check(GetRef<For>(loop))) {
+      kernel.task_loop = GetRef<For>(loop);
+      kernel.num_tasks = extent->value;
+    }
+  }
+  return kernel;
+}
+
+/*!
+ * \brief Fuse the kernels into one PrimFunc running all their tasks in one parallel loop.
+ *
+ * The fused PrimFunc takes the inputs of all the kernels, followed by the outputs of
+ * all the kernels.
+ * \param kernels The kernels to fuse.
+ * \param num_inputs The number of inputs of each kernel.
+ */
+PrimFunc FuseHorizontally(const std::vector<HorizontalKernel>& kernels,
+                          const std::vector<size_t>& num_inputs) {
+  Array<Var> params;
+  Map<Var, Buffer> buffer_map;
+  auto f_add_params = [&](const HorizontalKernel& kernel, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      params.push_back(kernel.func->params[i]);
+      buffer_map.Set(kernel.func->params[i], kernel.func->buffer_map.at(kernel.func->params[i]));
+    }
+  };
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    f_add_params(kernels[i], 0, num_inputs[i]);
+  }
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    f_add_params(kernels[i], num_inputs[i], kernels[i].func->params.size());
+  }
+
+  Var task("task", DataType::Int(64));
+  std::vector<int64_t> task_end;
+  int64_t num_tasks = 0;
+  for (const HorizontalKernel& kernel : kernels) {
+    num_tasks += kernel.num_tasks;
+    task_end.push_back(num_tasks);
+  }
+  // Dispatch the task to its kernel: if (task < end_0) {kernel_0} else if ...
+  Stmt body;
+  Array<Buffer> alloc_buffers;
+  for (int i = static_cast<int>(kernels.size()) - 1; i >= 0; --i) {
+    const HorizontalKernel& kernel = kernels[i];
+    Stmt kernel_body = kernel.body;
+    if (kernel.task_loop.defined()) {
+      const For& loop = kernel.task_loop.value();
+      PrimExpr begin = IntImm(DataType::Int(64), task_end[i] - kernel.num_tasks);
+      PrimExpr index = cast(loop->loop_var.dtype(), task - begin);
+      kernel_body = Substitute(loop->body, {{loop->loop_var, index}});
+    }
+    body = body.defined()
+               ? IfThenElse(task < IntImm(DataType::Int(64), task_end[i]), kernel_body, body)
+               : kernel_body;
+    alloc_buffers.insert(alloc_buffers.begin(), kernel.alloc_buffers.begin(),
+                         kernel.alloc_buffers.end());
+  }
+  body = For(task, IntImm(DataType::Int(64), 0), IntImm(DataType::Int(64), num_tasks),
+             ForKind::kParallel, body);
+  body = BlockRealize({}, const_true(),
+                      Block({}, {}, {}, "root", body, std::nullopt, alloc_buffers));
+  // The fused loop is the parallelization of the kernels, which is not to be scheduled again.
+  return PrimFunc(params, body, VoidType(), buffer_map,
+                  DictAttrs({{"tir.noalias", Bool(true)}, {"tir.is_scheduled", Bool(true)}}));
+}
+
+}  // namespace tir
+
+namespace relax {
+
+/*!
+ * \brief Fuse the independent small call_tir of the dataflow blocks horizontally.
+ *
+ * A call_tir is a candidate when its PrimFunc has static shapes and its work, the
+ * number of innermost loop iterations, is at most `max_work`: below that, a parallel
+ * launch and barrier of its own costs more than running it in the task of a thread.
+ * Candidates that do not depend on each other are grouped, up to `max_num_kernels`
+ * per group, and each group becomes one call_tir of the fused PrimFunc at the place of
+ * its last member. The bindings between the members that use their results are moved
+ * after the fused call.
+ */
+class HorizontalTIRFuser : public ExprMutator {
+ public:
+  static IRModule Transform(IRModule mod, int64_t max_work, int max_num_kernels) {
+    HorizontalTIRFuser fuser(mod, max_work, max_num_kernels);
+    for (const auto& [gvar, func] : mod->functions) {
+      if (const auto* relax_func = func.as<FunctionNode>()) {
+        Function updated = Downcast<Function>(fuser.VisitExpr(GetRef<Function>(relax_func)));
+        if (!updated.same_as(func)) {
+          fuser.builder_->UpdateFunction(gvar, updated);
+        }
+      }
+    }
+    return fuser.builder_->GetContextIRModule();
+  }
+
+ private:
+  HorizontalTIRFuser(IRModule mod, int64_t max_work, int max_num_kernels)
+      : ExprMutator(mod), mod_(mod), max_work_(max_work), max_num_kernels_(max_num_kernels) {}
+
+  using ExprMutator::VisitBindingBlock_;
+
+  BindingBlock VisitBindingBlock_(const DataflowBlockNode* block) final {
+    Array<Binding> bindings = block->bindings;
+    while (FuseOneGroup(&bindings)) {
+    }
+    if (bindings.same_as(block->bindings)) {
+      return ExprMutator::VisitBindingBlock_(block);
+    }
+    DataflowBlock updated(bindings, block->span);
+    return ExprMutator::VisitBindingBlock_(updated.get());
+  }
+
+  /*! \brief The kernel of a call_tir binding, if it is a candidate of the fusion. */
+  const tir::HorizontalKernel* GetCandidate(const Binding& binding) {
+    static const Op& call_tir_op = Op::Get("relax.call_tir");
+    const auto* var_binding = binding.as<VarBindingNode>();
+    const auto* call = var_binding ? var_binding->value.as<CallNode>() : nullptr;
+    if (call == nullptr || !call->op.same_as(call_tir_op) || call->args.size() != 2 ||
+        !call->args[1]->IsInstance<TupleNode>()) {
+      return nullptr;
+    }
+    const auto* gvar = call->args[0].as<GlobalVarNode>();
+    if (gvar == nullptr || fused_gvars_.count(gvar)) return nullptr;
+    auto it = kernels_.find(gvar);
+    if (it == kernels_.end()) {
+      std::optional<tir::HorizontalKernel> kernel;
+      auto func = mod_->functions.Get(GetRef<GlobalVar>(gvar));
+      if (func.has_value() && func.value()->IsInstance<tir::PrimFuncNode>()) {
+        kernel = tir::AnalyzeHorizontalKernel(Downcast<tir::PrimFunc>(func.value()));
+      }
+      it = kernels_.emplace(gvar, std::move(kernel)).first;
+    }
+    if (!it->second.has_value() || it->second->work > max_work_) return nullptr;
+    size_t num_inputs = Downcast<Tuple>(call->args[1])->fields.size();
+    size_t num_outputs = NumOutputs(call->sinfo_args[0]);
+    if (num_outputs == 0 || num_inputs + num_outputs != it->second->func->params.size()) {
+      return nullptr;
+    }
+    return &it->second.value();
+  }
+
+  /*! \brief The number of tensors output by call_tir, or 0 if the outputs are not tensors. */
+  static size_t NumOutputs(const StructInfo& out_sinfo) {
+    if (out_sinfo->IsInstance<TensorStructInfoNode>()) return 1;
+    const auto* tuple = out_sinfo.as<TupleStructInfoNode>();
+    if (tuple == nullptr) return 0;
+    for (const StructInfo& field : tuple->fields) {
+      if (!field->IsInstance<TensorStructInfoNode>()) return 0;
+    }
+    return tuple->fields.size();
+  }
+
+  /*! \brief Fuse the first group of independent candidates of the bindings, if any. */
+  bool FuseOneGroup(Array<Binding>* bindings) {
+    std::vector<size_t> group;
+    std::vector<const tir::HorizontalKernel*> kernels;
+    // The vars that depend on the results of the group.
+    std::unordered_set<const VarNode*> dependent;
+    std::vector<bool> is_dependent(bindings->size(), false);
+    for (size_t i = 0; i < bindings->size(); ++i) {
+      const Binding& binding = (*bindings)[i];
+      Expr value = binding.as<VarBindingNode>() ? binding.as<VarBindingNode>()->value
+                                                : binding.as<MatchCastNode>()->value;
+      bool uses_group = false;
+      for (const Var& var : FreeVars(value)) {
+        uses_group |= dependent.count(var.get()) > 0;
+      }
+      const tir::HorizontalKernel* kernel = nullptr;
+      if (!uses_group && static_cast<int>(group.size()) < max_num_kernels_) {
+        kernel = GetCandidate(binding);
+      }
+      if (kernel != nullptr) {
+        group.push_back(i);
+        kernels.push_back(kernel);
+      }
+      if (kernel != nullptr || uses_group) {
+        dependent.insert(binding->var.get());
+        is_dependent[i] = true;
+      }
+    }
+    if (group.size() < 2) return false;
+
+    static const Op& call_tir_op = Op::Get("relax.call_tir");
+    std::vector<tir::HorizontalKernel> fused_kernels;
+    std::vector<size_t> num_inputs;
+    Array<Expr> args;
+    Array<StructInfo> out_sinfo;
+    for (size_t i = 0; i < group.size(); ++i) {
+      Call call = Downcast<Call>((*bindings)[group[i]].as<VarBindingNode>()->value);
+      Array<Expr> inputs = Downcast<Tuple>(call->args[1])->fields;
+      args.insert(args.end(), inputs.begin(), inputs.end());
+      if (const auto* tuple = call->sinfo_args[0].as<TupleStructInfoNode>()) {
+        out_sinfo.insert(out_sinfo.end(), tuple->fields.begin(), tuple->fields.end());
+      } else {
+        out_sinfo.push_back(call->sinfo_args[0]);
+      }
+      // Each use of a kernel takes its own copy of the vars and buffers, so that the
+      // fused PrimFuncs share none, even when a kernel is called more than once.
+      fused_kernels.push_back(tir::AnalyzeHorizontalKernel(kernels[i]->func).value());
+      num_inputs.push_back(inputs.size());
+    }
+    tir::PrimFunc fused_func = tir::FuseHorizontally(fused_kernels, num_inputs);
+    GlobalVar fused_gvar = builder_->AddFunction(fused_func, "horizontal_fused");
+    fused_gvars_.insert(fused_gvar.get());
+    mod_ = builder_->GetContextIRModule();
+
+    DataflowVar fused_var("horizontal_fused", TupleStructInfo(out_sinfo));
+    Array<Binding> fused_bindings{VarBinding(
+        fused_var, Call(call_tir_op, {fused_gvar, Tuple(args)}, {}, {TupleStructInfo(out_sinfo)}))};
+    int output_index = 0;
+    for (size_t index : group) {
+      const auto* binding = (*bindings)[index].as<VarBindingNode>();
+      size_t num_outputs = NumOutputs(Downcast<Call>(binding->value)->sinfo_args[0]);
+      if (binding->var->struct_info_->IsInstance<TensorStructInfoNode>()) {
+        fused_bindings.push_back(VarBinding(binding->var, TupleGetItem(fused_var, output_index)));
+      } else {
+        Array<Expr> fields;
+        for (size_t j = 0; j < num_outputs; ++j) {
+          fields.push_back(TupleGetItem(fused_var, output_index + j));
+        }
+        fused_bindings.push_back(VarBinding(binding->var, Tuple(fields)));
+      }
+      output_index += num_outputs;
+    }
+
+    Array<Binding> updated;
+    Array<Binding> deferred;
+    std::unordered_set<size_t> members(group.begin(), group.end());
+    for (size_t i = 0; i < bindings->size(); ++i) {
+      if (members.count(i) == 0) {
+        if (i > group.front() && i < group.back() && is_dependent[i]) {
+          deferred.push_back((*bindings)[i]);
+        } else {
+          updated.push_back((*bindings)[i]);
+        }
+      }
+      if (i == group.back()) {
+        updated.insert(updated.end(), fused_bindings.begin(), fused_bindings.end());
+        updated.insert(updated.end(), deferred.begin(), deferred.end());
+      }
+    }
+    *bindings = updated;
+    return true;
+  }
+
+  IRModule mod_;
+  int64_t max_work_;
+  int max_num_kernels_;
+  std::unordered_map<const GlobalVarNode*, std::optional<tir::HorizontalKernel>> kernels_;
+  std::unordered_set<const GlobalVarNode*> fused_gvars_;
+};
+
+namespace transform {
+
+Pass HorizontalFuseTIR(int64_t max_work, int max_num_kernels) {
+  auto pass_func = [=](IRModule mod, PassContext pc) {
+    return relax::HorizontalTIRFuser::Transform(mod, max_work, max_num_kernels);
+  };
+  auto pass = CreateModulePass(pass_func, 0, "HorizontalFuseTIR", {});
+  return tvm::transform::Sequential({pass, relax::transform::DeadCodeElimination()},
+                                    "HorizontalFuseTIR");
+}
+
+TVM_FFI_REGISTER_GLOBAL("relax.transform.HorizontalFuseTIR").set_body_typed(HorizontalFuseTIR);
+
+}  // namespace transform
+}  // namespace relax
+}  // namespace tvm
@@ -30,10 +30,15 @@
 #include <tvm/relax/transform.h>
 #include <tvm/tir/transform.h>
 
+#include <optional>
+
+#include "../../te/operation/create_primfunc.h"
+
 namespace tvm {
 namespace relax {
 
 TVM_REGISTER_PASS_CONFIG_OPTION("relax.transform.apply_legalize_ops", Bool);
+TVM_REGISTER_PASS_CONFIG_OPTION("relax.LegalizeOps.cache_prim_funcs", Bool);
 
 /*!
  * \brief Check if a given Tensor/Shape/TupleStructInfo contains shapes whose
@@ -394,6 +399,12 @@ Pass LegalizeOps(Optional<Map<String, ffi::Function>> cmap, bool enable_warning)
     bool apply_legalize_ops =
         pc->GetConfig<Bool>("relax.transform.apply_legalize_ops").value_or(Bool(true))->value;
     if (apply_legalize_ops) {
+      // The same op over the same shapes, e.g. in each layer of a model, is converted from TE
+      // to TensorIR once.
+      std::optional<tir::CreatePrimFuncCacheScope> cache_scope;
+      if (pc->GetConfig<Bool>("relax.LegalizeOps.cache_prim_funcs").value_or(Bool(true))->value) {
+        cache_scope.emplace();
+      }
       mod = LegalizeMutator(mod, cmap, enable_warning).Transform();
     }
     return mod;
@@ -49,7 +49,49 @@ int GetMixedPrecisionInfo(const CallNode* call_node) {
 }
 
 /*!
- * \brief Main logic to automatically cast fp32 input modules to fp16 for certain ops.
+ * \brief The dtypes of the op calls chosen by the user, e.g. by calibration, keyed by the name of
+ * the var they are bound to. They override the TMixedPrecisionPolicy of the ops.
+ */
+class OpDTypeOverrides {
+ public:
+  OpDTypeOverrides(DataType low_dtype, Optional<Map<String, String>> op_dtypes)
+      : low_dtype_(low_dtype) {
+    if (!op_dtypes) return;
+    for (const auto& [name, dtype_str] : op_dtypes.value()) {
+      DataType dtype(StringToDLDataType(dtype_str));
+      CHECK(dtype == low_dtype || dtype == DataType::Float(32))
+          << "ToMixedPrecision expects the dtype of op " << name << " to be float32 or "
+          << low_dtype << ", but got " << dtype;
+      op_dtypes_[name] = dtype;
+    }
+  }
+
+  /*!
+   * \brief Get the policy of the call bound to the var: kAlways if the call is chosen to run in
+   * the low precision dtype, kNever if it is chosen to run in float32, or the policy of the op
+   * otherwise.
+   */
+  int GetPolicy(const Var& var, const CallNode* call_node) const {
+    int policy = GetMixedPrecisionInfo(call_node);
+    auto it = op_dtypes_.find(var->name_hint());
+    if (policy == -1 || it == op_dtypes_.end() || call_node->op.same_as(wrap_param_op_)) {
+      return policy;
+    }
+    CHECK(Op::GetAttrMap<TMixedPrecisionPolicy>("TMixedPrecisionPolicy")
+              .count(Downcast<Op>(call_node->op)))
+        << "ToMixedPrecision cannot choose the dtype of " << var->name_hint() << ", since op "
+        << call_node->op << " has no TMixedPrecisionPolicy";
+    return it->second == low_dtype_ ? kAlways : kNever;
+  }
+
+ private:
+  DataType low_dtype_;
+  std::unordered_map<std::string, DataType> op_dtypes_;
+  const Op& wrap_param_op_ = Op::Get("relax.wrap_param");
+};
+
+/*!
+ * \brief Main logic to automatically cast fp32 input modules to fp16 (or bf16) for certain ops.
  *
  * Structurally speaking, a Relax function is composed of a series of VarBinding and
  * MatchCast. And a specific class of VarBindings is the basic unit we want to rewrite.
@@ -96,6 +138,11 @@ int GetMixedPrecisionInfo(const CallNode* call_node) {
  *   be more friendly to inlining and operator fusion. We will store the var to fp16 if it's only
  *   used in kAlways ops, otherwise we will store it as the natural output dtype of the op.
  *
+ * The low precision dtype is fp16 by default, and can be set to bf16, in which case the fp16 above
+ * reads bf16. The policy of each call can be overridden by OpDTypeOverrides, with the dtype chosen
+ * for it, e.g. by calibration: a call chosen to run in the low precision dtype is treated as
+ * kAlways, and one chosen to run in fp32 as kNever.
+ *
  * The information of each op is registered in the
  * Op::GetAttr<FInferMixedPrecision>("FInferMixedPrecision"). The registered function has signature:
  * FInferMixedPrecision. We will call the registered function with the original call and the global
@@ -114,10 +161,13 @@ int GetMixedPrecisionInfo(const CallNode* call_node) {
  */
 class DTypeDecisionCollector : public ExprVisitor {
  public:
-  explicit DTypeDecisionCollector(DataType output_dtype) : output_dtype_(output_dtype) {}
+  explicit DTypeDecisionCollector(DataType output_dtype, DataType low_dtype,
+                                  const OpDTypeOverrides* overrides)
+      : low_dtype_(low_dtype), output_dtype_(output_dtype), overrides_(overrides) {}
 
-  static VarDTypeMap Collect(Function func, DataType output_dtype) {
-    DTypeDecisionCollector collector(output_dtype);
+  static VarDTypeMap Collect(Function func, DataType output_dtype, DataType low_dtype,
+                             const OpDTypeOverrides* overrides) {
+    DTypeDecisionCollector collector(output_dtype, low_dtype, overrides);
     collector.VisitExpr(func);
     return std::move(collector.only_fp16_map_);
   }
@@ -189,14 +239,14 @@ class DTypeDecisionCollector : public ExprVisitor {
   void VisitExpr_(const VarNode* op) final { VisitVars_(op); }
 
   void VisitBinding_(const VarBindingNode* binding, const CallNode* call_node) final {
-    auto policy = GetMixedPrecisionInfo(call_node);
+    auto policy = overrides_->GetPolicy(binding->var, call_node);
     if (policy == -1) {
       ExprVisitor::VisitBinding_(binding, call_node);
       return;
     }
     if (policy == kAlways) {
       // require inputs to be fp16
-      RequireArgsToType(call_node->args, fp16_);
+      RequireArgsToType(call_node->args, low_dtype_);
     } else if (policy == kFollow || policy == kNever) {
       // require inputs to be fp32 (the original dtype)
       RequireArgsToType(call_node->args, fp32_);
@@ -262,19 +312,24 @@ class DTypeDecisionCollector : public ExprVisitor {
   }
 
   DataType unknown_ = DataType(DataType::TypeCode::kFloat, 0, 1);
-  DataType fp16_ = DataType(DataType::TypeCode::kFloat, 16, 1);
   DataType fp32_ = DataType(DataType::TypeCode::kFloat, 32, 1);
+  DataType low_dtype_;
   DataType output_dtype_;
+  const OpDTypeOverrides* overrides_;
   VarDTypeMap only_fp16_map_;
 };
 
 class ToMixedPrecisionRewriter : public ExprMutator {
  public:
   explicit ToMixedPrecisionRewriter(const VarDTypeMap* only_fp16_map, DataType output_dtype,
-                                    const std::unordered_set<std::string>& fp16_input_names)
+                                    DataType low_dtype,
+                                    const std::unordered_set<std::string>& fp16_input_names,
+                                    const OpDTypeOverrides* overrides)
       : only_fp16_map_(only_fp16_map),
+        fp16_(low_dtype),
         output_dtype_(output_dtype),
-        fp16_input_names_(fp16_input_names) {}
+        fp16_input_names_(fp16_input_names),
+        overrides_(overrides) {}
 
  private:
   Var GetRemapped(const Var& var) {
@@ -289,7 +344,7 @@ class ToMixedPrecisionRewriter : public ExprMutator {
           if (tensor_sinfo->vdevice.defined()) {
             vdev = tensor_sinfo->vdevice.value();
           }
-          TensorStructInfo fp16_sinfo(tensor_sinfo->shape.value(), DataType::Float(16), vdev,
+          TensorStructInfo fp16_sinfo(tensor_sinfo->shape.value(), fp16_, vdev,
                                       tensor_sinfo->span);
           Var fp16_var(var->vid, fp16_sinfo, var->span);
           var_remap_[var->vid] = fp16_var;
@@ -344,9 +399,9 @@ class ToMixedPrecisionRewriter : public ExprMutator {
   }
 
   bool AllFP16Castable(const Array<Expr>& args) {
-    auto is_fp16 = [](StructInfo sinfo) {
+    auto is_fp16 = [this](StructInfo sinfo) {
       if (auto tensor_sinfo = sinfo.as<TensorStructInfoNode>();
-          tensor_sinfo && tensor_sinfo->dtype == DataType::Float(16)) {
+          tensor_sinfo && tensor_sinfo->dtype == fp16_) {
         return true;
       }
       return false;
@@ -359,7 +414,8 @@ class ToMixedPrecisionRewriter : public ExprMutator {
         return false;
       }
 
-      if (data.DataType() == DataType::Float(16)) {
+      if (data.DataType() == fp16_ || fp16_.is_bfloat16()) {
+        // bf16 has the range of fp32.
         return true;
       }
 
@@ -412,8 +468,9 @@ class ToMixedPrecisionRewriter : public ExprMutator {
     auto it = only_fp16_map_->find(var);
     if (it == only_fp16_map_->end()) return;
     // Get the to dtype, cast to fp16 if the var is fp16 only, otherwise do nothing
-    auto fcombine = [](const String& from, const String& required) -> String {
-      return required == "float16" ? required : from;
+    String fp16_str = DLDataTypeToString(fp16_);
+    auto fcombine = [&fp16_str](const String& from, const String& required) -> String {
+      return required == fp16_str ? required : from;
     };
     NType from = NTypeFrom(cur_var);
     NType to = CombineNestedMsg<String>(from, it->second, fcombine);
@@ -454,7 +511,7 @@ class ToMixedPrecisionRewriter : public ExprMutator {
       ExprMutator::VisitBinding_(binding, call_node);
       return;
     }
-    auto policy = GetMixedPrecisionInfo(call_node);
+    auto policy = overrides_->GetPolicy(binding->var, call_node);
     if (policy == -1) {
       // not an op call
       ExprMutator::VisitBinding_(binding, call_node);
@@ -481,8 +538,11 @@ class ToMixedPrecisionRewriter : public ExprMutator {
     if (policy == kAlways) {
       opt_new_dtype = fp16_;
       auto attr_map = Op::GetAttrMap<FInferMixedPrecision>("FInferMixedPrecision");
-      ICHECK(attr_map.count(op));
-      new_call = attr_map[op](new_call, output_dtype_);
+      // The ops that are not kAlways by their policy, but are chosen to run in the low precision
+      // dtype, have no accumulator dtype to set.
+      if (attr_map.count(op)) {
+        new_call = attr_map[op](new_call, output_dtype_);
+      }
     } else if (policy == kFollow) {
       opt_new_dtype = AllFP16Castable(new_call->args) ? fp16_ : fp32_;
     } else if (policy == kNever) {
@@ -589,31 +649,42 @@ class ToMixedPrecisionRewriter : public ExprMutator {
 
   const VarDTypeMap* only_fp16_map_;
 
-  DataType fp16_ = DataType(DataType::TypeCode::kFloat, 16, 1);
+  // The low precision dtype, fp16 or bf16.
+  DataType fp16_;
   DataType fp32_ = DataType(DataType::TypeCode::kFloat, 32, 1);
   DataType output_dtype_;
   Array<Var> params_;
   std::unordered_set<std::string> fp16_input_names_;
+  const OpDTypeOverrides* overrides_;
 
   const Op& wrap_param_op = Op::Get("relax.wrap_param");
 };
 
 Expr ToMixedPrecision(const Function& f, const DataType& out_dtype,
-                      Optional<Array<String>> fp16_input_names) {
-  VarDTypeMap only_fp16_map = std::move(DTypeDecisionCollector::Collect(f, out_dtype));
+                      Optional<Array<String>> fp16_input_names, DataType low_dtype,
+                      Optional<Map<String, String>> op_dtypes) {
+  CHECK(low_dtype == DataType::Float(16) || low_dtype == DataType::BFloat(16))
+      << "ToMixedPrecision expects the low precision dtype to be float16 or bfloat16, but got "
+      << low_dtype;
+  OpDTypeOverrides overrides(low_dtype, op_dtypes);
+  VarDTypeMap only_fp16_map =
+      std::move(DTypeDecisionCollector::Collect(f, out_dtype, low_dtype, &overrides));
   std::unordered_set<std::string> fp16_input_names_set;
   if (fp16_input_names) {
     fp16_input_names_set.insert(fp16_input_names.value().begin(), fp16_input_names.value().end());
   }
-  ToMixedPrecisionRewriter mutator(&only_fp16_map, out_dtype, fp16_input_names_set);
+  ToMixedPrecisionRewriter mutator(&only_fp16_map, out_dtype, low_dtype, fp16_input_names_set,
+                                   &overrides);
   return mutator(f);
 }
 
 namespace transform {
 
-Pass ToMixedPrecision(const DataType& out_dtype, Optional<Array<String>> fp16_input_names) {
+Pass ToMixedPrecision(const DataType& out_dtype, Optional<Array<String>> fp16_input_names,
+                      DataType low_dtype, Optional<Map<String, String>> op_dtypes) {
   auto pass_func = [=](Function f, IRModule m, PassContext pc) {
-    return Downcast<Function>(ToMixedPrecision(f, out_dtype, fp16_input_names));
+    return Downcast<Function>(
+        ToMixedPrecision(f, out_dtype, fp16_input_names, low_dtype, op_dtypes));
   };
   return CreateFunctionPass(pass_func, 0, "ToMixedPrecision", {});
 }
@@ -23,6 +23,9 @@
  */
 #include <builtin_fp16.h>
 #include <tvm/runtime/base.h>
+#include <tvm/runtime/builtin_fp16.h>
+
+#include "cpu_copy_kernels.h"
 
 extern "C" {
 
@@ -57,3 +60,26 @@ TVM_DLL uint16_t __truncdfhf2(double a) {
 
 #endif
 }
+
+namespace tvm {
+namespace runtime {
+
+// The scalar functions above stay scalar: they are the tail of the vectorized kernels.
+void Float32ToFloat16Array(const float* from, uint16_t* to, int64_t num_elems) {
+  ConvertFloat32ToFloat16(from, to, num_elems);
+}
+
+void Float16ToFloat32Array(const uint16_t* from, float* to, int64_t num_elems) {
+  ConvertFloat16ToFloat32(from, to, num_elems);
+}
+
+void Float32ToBFloat16Array(const float* from, uint16_t* to, int64_t num_elems) {
+  ConvertFloat32ToBFloat16(from, to, num_elems);
+}
+
+void BFloat16ToFloat32Array(const uint16_t* from, float* to, int64_t num_elems) {
+  ConvertBFloat16ToFloat32(from, to, num_elems);
+}
+
+}  // namespace runtime
+}  // namespace tvm
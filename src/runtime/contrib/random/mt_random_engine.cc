@@ -21,6 +21,7 @@
  * \file random/mt_random_engine.cc
  * \brief mt19937 random engine
  */
+#include <tvm/runtime/builtin_fp16.h>
 #include <tvm/runtime/c_backend_api.h>
 #include <tvm/runtime/device_api.h>
 #include <tvm/runtime/logging.h>
@@ -31,8 +32,7 @@
 #include <ctime>
 #include <random>
 #include <thread>
-
-#include "../3rdparty/compiler-rt/builtin_fp16.h"
+#include <vector>
 
 namespace tvm {
 namespace contrib {
@@ -160,10 +160,9 @@ class RandomEngine {
       std::generate_n(static_cast<uint8_t*>(data) + st, ed - st,
                       [&]() { return dist(rnd_engine_); });
     } else if (dtype.bits == 16) {
-      std::generate_n(static_cast<uint16_t*>(data) + st, ed - st, [&]() {
-        return __truncXfYf2__<float, uint32_t, 23, uint16_t, uint16_t, 10>(
-            static_cast<float>(dist(rnd_engine_)));
-      });
+      std::vector<float> values(ed - st);
+      std::generate(values.begin(), values.end(), [&]() { return dist(rnd_engine_); });
+      runtime::Float32ToFloat16Array(values.data(), static_cast<uint16_t*>(data) + st, ed - st);
     } else if (dtype.bits == 32) {
       std::generate_n(static_cast<float*>(data) + st, ed - st, [&]() { return dist(rnd_engine_); });
     } else if (dtype.bits == 64) {
@@ -0,0 +1,657 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cpu_copy_kernels.cc
+ * \brief Host-side copy and dtype-conversion kernels.
+ */
+#include "cpu_copy_kernels.h"
+
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/builtin_fp16.h>
+#include <tvm/runtime/data_type.h>
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/threading_backend.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TVM_CPU_COPY_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define TVM_CPU_COPY_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace tvm {
+namespace runtime {
+
+namespace {
+
+/*! \brief Copies smaller than this are done with a single memcpy. */
+constexpr size_t kParallelCopyMinBytes = 4 << 20;
+/*! \brief The number of bytes each task copies in a parallel memcpy. */
+constexpr size_t kParallelCopyChunkBytes = 1 << 20;
+/*! \brief Conversions with fewer elements than this run on the calling thread. */
+constexpr int64_t kParallelConvertMinElems = 1 << 18;
+/*! \brief The number of elements each task converts. */
+constexpr int64_t kParallelConvertChunkElems = 1 << 16;
+/*! \brief The tile edge of the transposed inner block of a strided copy. */
+constexpr int64_t kStridedCopyTile = 32;
+
+int64_t NumElements(const DLTensor& arr) {
+  int64_t num_elems = 1;
+  for (int i = 0; i < arr.ndim; ++i) num_elems *= arr.shape[i];
+  return num_elems;
+}
+
+/*!
+ * \brief Whether a kernel may split its work over the thread pool, which is not the case
+ *  inside a task of a parallel job, e.g. NDArray::CopyFrom in parallel_for_with_threading_backend.
+ */
+inline bool CanUseThreadPool() {
+  return threading::MaxConcurrency() > 1 && !threading::InParallelTask();
+}
+
+/*!
+ * \brief Run `fchunk(begin, end)` over [0, num_elems), split over the thread pool when large.
+ */
+template <typename FChunk>
+void ParallelChunks(int64_t num_elems, int64_t min_parallel_elems, int64_t chunk_elems,
+                    FChunk fchunk) {
+  if (num_elems < min_parallel_elems || !CanUseThreadPool()) {
+    fchunk(0, num_elems);
+    return;
+  }
+  int64_t num_chunks = (num_elems + chunk_elems - 1) / chunk_elems;
+  parallel_for_with_threading_backend(
+      [&fchunk, num_elems, chunk_elems](int64_t i) {
+        int64_t begin = i * chunk_elems;
+        fchunk(begin, std::min(begin + chunk_elems, num_elems));
+      },
+      0, num_chunks);
+}
+
+//---------------------------------------------
+// Scalar kernels
+//---------------------------------------------
+inline uint16_t Float32ToBFloat16Scalar(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffffU) > 0x7f800000U) {
+    // Keep NaN a (quiet) NaN instead of letting the rounding carry into the exponent.
+    return static_cast<uint16_t>((bits | 0x400000U) >> 16);
+  }
+  bits += 0x7fffU + ((bits >> 16) & 1U);
+  return static_cast<uint16_t>(bits >> 16);
+}
+
+inline float BFloat16ToFloat32Scalar(uint16_t value) {
+  uint32_t bits = static_cast<uint32_t>(value) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void Float32ToFloat16Scalar(const float* from, uint16_t* to, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) to[i] = __gnu_f2h_ieee(from[i]);
+}
+
+void Float16ToFloat32Scalar(const uint16_t* from, float* to, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) to[i] = __gnu_h2f_ieee(from[i]);
+}
+
+void Float32ToBFloat16Scalar(const float* from, uint16_t* to, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) to[i] = Float32ToBFloat16Scalar(from[i]);
+}
+
+void BFloat16ToFloat32Scalar(const uint16_t* from, float* to, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) to[i] = BFloat16ToFloat32Scalar(from[i]);
+}
+
+void DequantizeInt8Scalar(const int8_t* from, float* to, int64_t n, float scale,
+                          int32_t zero_point) {
+  for (int64_t i = 0; i < n; ++i) {
+    to[i] = static_cast<float>(static_cast<int32_t>(from[i]) - zero_point) * scale;
+  }
+}
+
+#if TVM_CPU_COPY_KERNELS_X86
+//---------------------------------------------
+// x86 kernels, selected at runtime
+//---------------------------------------------
+enum class X86ISA : int { kScalar, kAVX2, kAVX512 };
+
+X86ISA GetX86ISA() {
+  static const X86ISA isa = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return X86ISA::kAVX512;
+    // Every AVX2 capable core also implements F16C.
+    if (__builtin_cpu_supports("avx2")) return X86ISA::kAVX2;
+    return X86ISA::kScalar;
+  }();
+  return isa;
+}
+
+__attribute__((target("avx2,f16c"))) void Float32ToFloat16AVX2(const float* from, uint16_t* to,
+                                                               int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(from + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), h);
+  }
+  Float32ToFloat16Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx2,f16c"))) void Float16ToFloat32AVX2(const uint16_t* from, float* to,
+                                                               int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+    _mm256_storeu_ps(to + i, _mm256_cvtph_ps(h));
+  }
+  Float16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx2"))) void Float32ToBFloat16AVX2(const float* from, uint16_t* to,
+                                                           int64_t n) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i abs_mask = _mm256_set1_epi32(0x7fffffff);
+  const __m256i inf = _mm256_set1_epi32(0x7f800000);
+  const __m256i quiet = _mm256_set1_epi32(0x400000);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+    __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb));
+    __m256i is_nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, abs_mask), inf);
+    __m256i res = _mm256_blendv_epi8(rounded, _mm256_or_si256(bits, quiet), is_nan);
+    res = _mm256_srli_epi32(res, 16);
+    __m128i packed =
+        _mm_packus_epi32(_mm256_castsi256_si128(res), _mm256_extracti128_si256(res, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), packed);
+  }
+  Float32ToBFloat16Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx2"))) void BFloat16ToFloat32AVX2(const uint16_t* from, float* to,
+                                                           int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+    __m256i bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(to + i), bits);
+  }
+  BFloat16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx2"))) void DequantizeInt8AVX2(const int8_t* from, float* to, int64_t n,
+                                                        float scale, int32_t zero_point) {
+  const __m256i zp = _mm256_set1_epi32(zero_point);
+  const __m256 s = _mm256_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i q = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(from + i));
+    __m256i x = _mm256_sub_epi32(_mm256_cvtepi8_epi32(q), zp);
+    _mm256_storeu_ps(to + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), s));
+  }
+  DequantizeInt8Scalar(from + i, to + i, n - i, scale, zero_point);
+}
+
+__attribute__((target("avx512f"))) void Float32ToFloat16AVX512(const float* from, uint16_t* to,
+                                                               int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(from + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(to + i), h);
+  }
+  Float32ToFloat16Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Float16ToFloat32AVX512(const uint16_t* from, float* to,
+                                                               int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+    _mm512_storeu_ps(to + i, _mm512_cvtph_ps(h));
+  }
+  Float16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void Float32ToBFloat16AVX512(const float* from, uint16_t* to,
+                                                                int64_t n) {
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i bias = _mm512_set1_epi32(0x7fff);
+  const __m512i abs_mask = _mm512_set1_epi32(0x7fffffff);
+  const __m512i inf = _mm512_set1_epi32(0x7f800000);
+  const __m512i quiet = _mm512_set1_epi32(0x400000);
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i bits = _mm512_loadu_si512(from + i);
+    __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), one);
+    __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(bias, lsb));
+    __mmask16 is_nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(bits, abs_mask), inf);
+    __m512i res = _mm512_mask_mov_epi32(rounded, is_nan, _mm512_or_si512(bits, quiet));
+    res = _mm512_srli_epi32(res, 16);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(to + i), _mm512_cvtepi32_epi16(res));
+  }
+  Float32ToBFloat16Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void BFloat16ToFloat32AVX512(const uint16_t* from, float* to,
+                                                                int64_t n) {
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+    _mm512_storeu_si512(to + i, _mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16));
+  }
+  BFloat16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void DequantizeInt8AVX512(const int8_t* from, float* to,
+                                                             int64_t n, float scale,
+                                                             int32_t zero_point) {
+  const __m512i zp = _mm512_set1_epi32(zero_point);
+  const __m512 s = _mm512_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+    __m512i x = _mm512_sub_epi32(_mm512_cvtepi8_epi32(q), zp);
+    _mm512_storeu_ps(to + i, _mm512_mul_ps(_mm512_cvtepi32_ps(x), s));
+  }
+  DequantizeInt8Scalar(from + i, to + i, n - i, scale, zero_point);
+}
+#endif  // TVM_CPU_COPY_KERNELS_X86
+
+#if TVM_CPU_COPY_KERNELS_NEON
+//---------------------------------------------
+// AArch64 NEON kernels
+//---------------------------------------------
+void Float32ToFloat16NEON(const float* from, uint16_t* to, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1_u16(to + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(from + i))));
+  }
+  Float32ToFloat16Scalar(from + i, to + i, n - i);
+}
+
+void Float16ToFloat32NEON(const uint16_t* from, float* to, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(to + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(from + i))));
+  }
+  Float16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+void Float32ToBFloat16NEON(const float* from, uint16_t* to, int64_t n) {
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t bias = vdupq_n_u32(0x7fff);
+  const uint32x4_t abs_mask = vdupq_n_u32(0x7fffffff);
+  const uint32x4_t inf = vdupq_n_u32(0x7f800000);
+  const uint32x4_t quiet = vdupq_n_u32(0x400000);
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(from + i));
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), one);
+    uint32x4_t rounded = vaddq_u32(bits, vaddq_u32(bias, lsb));
+    uint32x4_t is_nan = vcgtq_u32(vandq_u32(bits, abs_mask), inf);
+    uint32x4_t res = vbslq_u32(is_nan, vorrq_u32(bits, quiet), rounded);
+    vst1_u16(to + i, vshrn_n_u32(res, 16));
+  }
+  Float32ToBFloat16Scalar(from + i, to + i, n - i);
+}
+
+void BFloat16ToFloat32NEON(const uint16_t* from, float* to, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(to + i, vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(from + i), 16)));
+  }
+  BFloat16ToFloat32Scalar(from + i, to + i, n - i);
+}
+
+void DequantizeInt8NEON(const int8_t* from, float* to, int64_t n, float scale,
+                        int32_t zero_point) {
+  const int32x4_t zp = vdupq_n_s32(zero_point);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t x = vmovl_s8(vld1_s8(from + i));
+    int32x4_t lo = vsubq_s32(vmovl_s16(vget_low_s16(x)), zp);
+    int32x4_t hi = vsubq_s32(vmovl_s16(vget_high_s16(x)), zp);
+    vst1q_f32(to + i, vmulq_n_f32(vcvtq_f32_s32(lo), scale));
+    vst1q_f32(to + i + 4, vmulq_n_f32(vcvtq_f32_s32(hi), scale));
+  }
+  DequantizeInt8Scalar(from + i, to + i, n - i, scale, zero_point);
+}
+#endif  // TVM_CPU_COPY_KERNELS_NEON
+
+/*!
+ * \brief Pick the best kernel of a conversion for the host.
+ * Expands to a block that returns after calling the selected kernel.
+ */
+#if TVM_CPU_COPY_KERNELS_X86
+#define TVM_DISPATCH_CONVERT_KERNEL(Name, ...)       \
+  switch (GetX86ISA()) {                             \
+    case X86ISA::kAVX512:                            \
+      return Name##AVX512(__VA_ARGS__);              \
+    case X86ISA::kAVX2:                              \
+      return Name##AVX2(__VA_ARGS__);                \
+    default:                                         \
+      return Name##Scalar(__VA_ARGS__);              \
+  }
+#elif TVM_CPU_COPY_KERNELS_NEON
+#define TVM_DISPATCH_CONVERT_KERNEL(Name, ...) return Name##NEON(__VA_ARGS__);
+#else
+#define TVM_DISPATCH_CONVERT_KERNEL(Name, ...) return Name##Scalar(__VA_ARGS__);
+#endif
+
+void Float32ToFloat16Kernel(const float* from, uint16_t* to, int64_t n) {
+  TVM_DISPATCH_CONVERT_KERNEL(Float32ToFloat16, from, to, n);
+}
+
+void Float16ToFloat32Kernel(const uint16_t* from, float* to, int64_t n) {
+  TVM_DISPATCH_CONVERT_KERNEL(Float16ToFloat32, from, to, n);
+}
+
+void Float32ToBFloat16Kernel(const float* from, uint16_t* to, int64_t n) {
+  TVM_DISPATCH_CONVERT_KERNEL(Float32ToBFloat16, from, to, n);
+}
+
+void BFloat16ToFloat32Kernel(const uint16_t* from, float* to, int64_t n) {
+  TVM_DISPATCH_CONVERT_KERNEL(BFloat16ToFloat32, from, to, n);
+}
+
+void DequantizeInt8Kernel(const int8_t* from, float* to, int64_t n, float scale,
+                          int32_t zero_point) {
+  TVM_DISPATCH_CONVERT_KERNEL(DequantizeInt8, from, to, n, scale, zero_point);
+}
+
+#undef TVM_DISPATCH_CONVERT_KERNEL
+
+//---------------------------------------------
+// Strided copy
+//---------------------------------------------
+/*! \brief A dimension of a strided copy, with strides in bytes. */
+struct StridedDim {
+  int64_t extent;
+  int64_t src_stride;
+  int64_t dst_stride;
+};
+
+/*!
+ * \brief Copy a `rows x cols` block of elements in tiles, so that both the reads and the
+ *  writes of a transposed block stay within a few cache lines.
+ */
+template <typename FCopyElem>
+void CopyTiledBlock(const char* src, char* dst, int64_t row_begin, int64_t row_end, int64_t cols,
+                    const StridedDim& row, const StridedDim& col, FCopyElem fcopy_elem) {
+  for (int64_t r0 = row_begin; r0 < row_end; r0 += kStridedCopyTile) {
+    int64_t r1 = std::min(r0 + kStridedCopyTile, row_end);
+    for (int64_t c0 = 0; c0 < cols; c0 += kStridedCopyTile) {
+      int64_t c1 = std::min(c0 + kStridedCopyTile, cols);
+      for (int64_t r = r0; r < r1; ++r) {
+        const char* src_row = src + r * row.src_stride;
+        char* dst_row = dst + r * row.dst_stride;
+        for (int64_t c = c0; c < c1; ++c) {
+          fcopy_elem(src_row + c * col.src_stride, dst_row + c * col.dst_stride);
+        }
+      }
+    }
+  }
+}
+
+template <typename T>
+void CopyTiledBlockTyped(const char* src, char* dst, int64_t row_begin, int64_t row_end,
+                         int64_t cols, const StridedDim& row, const StridedDim& col) {
+  CopyTiledBlock(src, dst, row_begin, row_end, cols, row, col, [](const char* from, char* to) {
+    *reinterpret_cast<T*>(to) = *reinterpret_cast<const T*>(from);
+  });
+}
+
+void CopyStridedHostImpl(const DLTensor* from, DLTensor* to, bool allow_parallel) {
+  ICHECK_EQ(from->ndim, to->ndim) << "CopyStridedHost: ndim mismatch";
+  ICHECK(DataType(from->dtype) == DataType(to->dtype)) << "CopyStridedHost: dtype mismatch";
+  ICHECK_EQ(from->dtype.bits % 8, 0) << "CopyStridedHost does not support sub-byte dtypes";
+  int64_t elem_bytes = from->dtype.bits / 8 * from->dtype.lanes;
+
+  // Collect the non-unit dimensions with their strides in bytes.
+  std::vector<StridedDim> dims;
+  int64_t src_compact = elem_bytes;
+  int64_t dst_compact = elem_bytes;
+  for (int i = from->ndim - 1; i >= 0; --i) {
+    ICHECK_EQ(from->shape[i], to->shape[i]) << "CopyStridedHost: shape mismatch";
+    int64_t extent = from->shape[i];
+    if (extent == 0) return;
+    int64_t src_stride = from->strides != nullptr ? from->strides[i] * elem_bytes : src_compact;
+    int64_t dst_stride = to->strides != nullptr ? to->strides[i] * elem_bytes : dst_compact;
+    src_compact *= extent;
+    dst_compact *= extent;
+    if (extent != 1) dims.push_back({extent, src_stride, dst_stride});
+  }
+  std::reverse(dims.begin(), dims.end());
+  // Walk the destination in memory order, which turns transposes into strided reads.
+  std::stable_sort(dims.begin(), dims.end(), [](const StridedDim& lhs, const StridedDim& rhs) {
+    return lhs.dst_stride > rhs.dst_stride;
+  });
+
+  // Fold the innermost dimensions that are contiguous on both sides into one element.
+  int64_t inner_bytes = elem_bytes;
+  while (!dims.empty() && dims.back().src_stride == inner_bytes &&
+         dims.back().dst_stride == inner_bytes) {
+    inner_bytes *= dims.back().extent;
+    dims.pop_back();
+  }
+
+  const char* src_base = static_cast<const char*>(from->data) + from->byte_offset;
+  char* dst_base = static_cast<char*>(to->data) + to->byte_offset;
+  if (dims.empty()) {
+    if (allow_parallel) {
+      ParallelMemcpy(dst_base, src_base, inner_bytes);
+    } else {
+      std::memcpy(dst_base, src_base, inner_bytes);
+    }
+    return;
+  }
+  while (dims.size() < 2) {
+    dims.insert(dims.begin(), StridedDim{1, 0, 0});
+  }
+
+  // The two innermost dimensions form a tiled block, the outer ones are flattened.
+  const StridedDim row = dims[dims.size() - 2];
+  const StridedDim col = dims[dims.size() - 1];
+  dims.resize(dims.size() - 2);
+  int64_t num_outer = 1;
+  for (const StridedDim& dim : dims) num_outer *= dim.extent;
+  int64_t num_row_tiles = (row.extent + kStridedCopyTile - 1) / kStridedCopyTile;
+
+  auto fcopy_task = [&](int64_t task) {
+    int64_t outer = task / num_row_tiles;
+    int64_t row_begin = (task % num_row_tiles) * kStridedCopyTile;
+    int64_t row_end = std::min(row_begin + kStridedCopyTile, row.extent);
+    const char* src = src_base;
+    char* dst = dst_base;
+    for (int i = static_cast<int>(dims.size()) - 1; i >= 0; --i) {
+      int64_t index = outer % dims[i].extent;
+      outer /= dims[i].extent;
+      src += index * dims[i].src_stride;
+      dst += index * dims[i].dst_stride;
+    }
+    switch (inner_bytes) {
+      case 1:
+        return CopyTiledBlockTyped<uint8_t>(src, dst, row_begin, row_end, col.extent, row, col);
+      case 2:
+        return CopyTiledBlockTyped<uint16_t>(src, dst, row_begin, row_end, col.extent, row, col);
+      case 4:
+        return CopyTiledBlockTyped<uint32_t>(src, dst, row_begin, row_end, col.extent, row, col);
+      case 8:
+        return CopyTiledBlockTyped<uint64_t>(src, dst, row_begin, row_end, col.extent, row, col);
+      default:
+        return CopyTiledBlock(src, dst, row_begin, row_end, col.extent, row, col,
+                              [inner_bytes](const char* from, char* to) {
+                                std::memcpy(to, from, inner_bytes);
+                              });
+    }
+  };
+
+  int64_t num_tasks = num_outer * num_row_tiles;
+  int64_t total_bytes = num_outer * row.extent * col.extent * inner_bytes;
+  if (!allow_parallel || num_tasks == 1 ||
+      total_bytes < static_cast<int64_t>(kParallelCopyMinBytes) || !CanUseThreadPool()) {
+    for (int64_t task = 0; task < num_tasks; ++task) fcopy_task(task);
+  } else {
+    parallel_for_with_threading_backend(fcopy_task, 0, num_tasks);
+  }
+}
+
+}  // namespace
+
+void ParallelMemcpy(void* to, const void* from, size_t size) {
+  if (size < kParallelCopyMinBytes || !CanUseThreadPool()) {
+    std::memcpy(to, from, size);
+    return;
+  }
+  ParallelChunks(static_cast<int64_t>(size), 0, static_cast<int64_t>(kParallelCopyChunkBytes),
+                 [to, from](int64_t begin, int64_t end) {
+                   std::memcpy(static_cast<char*>(to) + begin,
+                               static_cast<const char*>(from) + begin, end - begin);
+                 });
+}
+
+void ConvertFloat32ToFloat16(const float* from, uint16_t* to, int64_t num_elems) {
+  ParallelChunks(num_elems, kParallelConvertMinElems, kParallelConvertChunkElems,
+                 [from, to](int64_t begin, int64_t end) {
+                   Float32ToFloat16Kernel(from + begin, to + begin, end - begin);
+                 });
+}
+
+void ConvertFloat16ToFloat32(const uint16_t* from, float* to, int64_t num_elems) {
+  ParallelChunks(num_elems, kParallelConvertMinElems, kParallelConvertChunkElems,
+                 [from, to](int64_t begin, int64_t end) {
+                   Float16ToFloat32Kernel(from + begin, to + begin, end - begin);
+                 });
+}
+
+void ConvertFloat32ToBFloat16(const float* from, uint16_t* to, int64_t num_elems) {
+  ParallelChunks(num_elems, kParallelConvertMinElems, kParallelConvertChunkElems,
+                 [from, to](int64_t begin, int64_t end) {
+                   Float32ToBFloat16Kernel(from + begin, to + begin, end - begin);
+                 });
+}
+
+void ConvertBFloat16ToFloat32(const uint16_t* from, float* to, int64_t num_elems) {
+  ParallelChunks(num_elems, kParallelConvertMinElems, kParallelConvertChunkElems,
+                 [from, to](int64_t begin, int64_t end) {
+                   BFloat16ToFloat32Kernel(from + begin, to + begin, end - begin);
+                 });
+}
+
+void DequantizeInt8ToFloat32(const int8_t* from, float* to, int64_t num_elems, float scale,
+                             int32_t zero_point) {
+  ParallelChunks(num_elems, kParallelConvertMinElems, kParallelConvertChunkElems,
+                 [from, to, scale, zero_point](int64_t begin, int64_t end) {
+                   DequantizeInt8Kernel(from + begin, to + begin, end - begin, scale,
+                                        zero_point);
+                 });
+}
+
+void ConvertDTypeHost(const DLTensor* from, DLTensor* to) {
+  ICHECK(ffi::IsContiguous(*from) && ffi::IsContiguous(*to))
+      << "ConvertDTypeHost only supports contiguous arrays";
+  ICHECK_EQ(from->dtype.lanes, to->dtype.lanes) << "ConvertDTypeHost: the number of lanes mismatch";
+  int64_t num_elems = NumElements(*from) * from->dtype.lanes;
+  ICHECK_EQ(num_elems, NumElements(*to) * to->dtype.lanes)
+      << "ConvertDTypeHost: the number of elements mismatch";
+  const void* src = static_cast<const char*>(from->data) + from->byte_offset;
+  void* dst = static_cast<char*>(to->data) + to->byte_offset;
+  DataType from_dtype(from->dtype);
+  DataType to_dtype(to->dtype);
+  if (from_dtype == to_dtype) {
+    ParallelMemcpy(dst, src, ffi::GetDataSize(*from));
+  } else if (from_dtype == DataType::Float(32) && to_dtype == DataType::Float(16)) {
+    ConvertFloat32ToFloat16(static_cast<const float*>(src), static_cast<uint16_t*>(dst),
+                            num_elems);
+  } else if (from_dtype == DataType::Float(16) && to_dtype == DataType::Float(32)) {
+    ConvertFloat16ToFloat32(static_cast<const uint16_t*>(src), static_cast<float*>(dst),
+                            num_elems);
+  } else if (from_dtype == DataType::Float(32) && to_dtype == DataType::BFloat(16)) {
+    ConvertFloat32ToBFloat16(static_cast<const float*>(src), static_cast<uint16_t*>(dst),
+                             num_elems);
+  } else if (from_dtype == DataType::BFloat(16) && to_dtype == DataType::Float(32)) {
+    ConvertBFloat16ToFloat32(static_cast<const uint16_t*>(src), static_cast<float*>(dst),
+                             num_elems);
+  } else {
+    LOG(FATAL) << "ConvertDTypeHost does not support converting " << from_dtype << " to "
+               << to_dtype;
+  }
+}
+
+void CopyStridedHost(const DLTensor* from, DLTensor* to) {
+  CopyStridedHostImpl(from, to, /*allow_parallel=*/true);
+}
+
+void CopyStridedHostSerial(const DLTensor* from, DLTensor* to) {
+  CopyStridedHostImpl(from, to, /*allow_parallel=*/false);
+}
+
+TVM_FFI_REGISTER_GLOBAL("runtime.NDArrayConvertDType").set_body_typed([](NDArray from, NDArray to) {
+  CHECK(from->device.device_type == kDLCPU && to->device.device_type == kDLCPU)
+      << "ValueError: runtime.NDArrayConvertDType only supports CPU arrays";
+  CHECK(from.IsContiguous() && to.IsContiguous())
+      << "ValueError: runtime.NDArrayConvertDType only supports contiguous arrays";
+  CHECK_EQ(from->dtype.lanes, to->dtype.lanes)
+      << "ValueError: runtime.NDArrayConvertDType: the number of lanes mismatch, "
+      << from.DataType() << " vs " << to.DataType();
+  CHECK_EQ(NumElements(*from.get()), NumElements(*to.get()))
+      << "ValueError: runtime.NDArrayConvertDType: the number of elements mismatch, "
+      << from.Shape() << " vs " << to.Shape();
+  DataType from_dtype = from.DataType();
+  DataType to_dtype = to.DataType();
+  CHECK(from_dtype == to_dtype ||
+        (from_dtype == DataType::Float(32) &&
+         (to_dtype == DataType::Float(16) || to_dtype == DataType::BFloat(16))) ||
+        (to_dtype == DataType::Float(32) &&
+         (from_dtype == DataType::Float(16) || from_dtype == DataType::BFloat(16))))
+      << "ValueError: runtime.NDArrayConvertDType does not support converting " << from_dtype
+      << " to " << to_dtype;
+  ConvertDTypeHost(from.get(), const_cast<ffi::NDArrayObj*>(to.get()));
+});
+
+TVM_FFI_REGISTER_GLOBAL("runtime.NDArrayDequantizeInt8")
+    .set_body_typed([](NDArray from, NDArray to, double scale, int zero_point) {
+      CHECK(from->device.device_type == kDLCPU && to->device.device_type == kDLCPU)
+          << "ValueError: runtime.NDArrayDequantizeInt8 only supports CPU arrays";
+      CHECK(from.IsContiguous() && to.IsContiguous())
+          << "ValueError: runtime.NDArrayDequantizeInt8 only supports contiguous arrays";
+      CHECK(DataType(from->dtype) == DataType::Int(8) &&
+            DataType(to->dtype) == DataType::Float(32))
+          << "ValueError: runtime.NDArrayDequantizeInt8 expects int8 input and float32 output";
+      int64_t num_elems = NumElements(*from.get());
+      CHECK_EQ(num_elems, NumElements(*to.get()))
+          << "ValueError: runtime.NDArrayDequantizeInt8: the number of elements mismatch";
+      DequantizeInt8ToFloat32(static_cast<const int8_t*>(from->data) + from->byte_offset,
+                              reinterpret_cast<float*>(static_cast<char*>(to->data) +
+                                                       to->byte_offset),
+                              num_elems, static_cast<float>(scale), zero_point);
+    });
+
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file cpu_copy_kernels.h
+ * \brief Host-side copy kernels shared by the runtime: parallel memcpy,
+ *  vectorized dtype conversions and strided NDArray copies.
+ *
+ *  The conversions pick an AVX-512/AVX2 implementation at runtime when the
+ *  host supports it, use NEON on AArch64 and fall back to scalar code
+ *  elsewhere. All the kernels split large inputs over the runtime thread pool,
+ *  and run serially when called from a task of a parallel job.
+ */
+#ifndef TVM_RUNTIME_CPU_COPY_KERNELS_H_
+#define TVM_RUNTIME_CPU_COPY_KERNELS_H_
+
+#include <dlpack/dlpack.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tvm {
+namespace runtime {
+
+/*!
+ * \brief Host memcpy which splits large copies into chunks over the runtime thread pool.
+ * \param to The destination buffer.
+ * \param from The source buffer.
+ * \param size The number of bytes to copy.
+ */
+void ParallelMemcpy(void* to, const void* from, size_t size);
+
+/*! \brief Convert float32 to IEEE float16, rounding to nearest even. */
+void ConvertFloat32ToFloat16(const float* from, uint16_t* to, int64_t num_elems);
+
+/*! \brief Convert IEEE float16 to float32. */
+void ConvertFloat16ToFloat32(const uint16_t* from, float* to, int64_t num_elems);
+
+/*! \brief Convert float32 to bfloat16, rounding to nearest even and keeping NaNs quiet. */
+void ConvertFloat32ToBFloat16(const float* from, uint16_t* to, int64_t num_elems);
+
+/*! \brief Convert bfloat16 to float32. */
+void ConvertBFloat16ToFloat32(const uint16_t* from, float* to, int64_t num_elems);
+
+/*!
+ * \brief Dequantize int8 to float32 as `(from[i] - zero_point) * scale`.
+ */
+void DequantizeInt8ToFloat32(const int8_t* from, float* to, int64_t num_elems, float scale,
+                             int32_t zero_point);
+
+/*!
+ * \brief Convert the elements of a contiguous host tensor into another dtype.
+ * \param from The source tensor.
+ * \param to The destination tensor of the same shape.
+ * \note Supports float32 <-> float16/bfloat16 and same-dtype copies.
+ */
+void ConvertDTypeHost(const DLTensor* from, DLTensor* to);
+
+/*!
+ * \brief Copy between two host tensors of the same shape and dtype with arbitrary strides.
+ *
+ * Dimensions are reordered by the destination strides and coalesced before the copy,
+ * contiguous inner runs are copied with memcpy and transposed inner blocks are copied
+ * in cache-sized tiles.
+ *
+ * \param from The source tensor.
+ * \param to The destination tensor.
+ */
+void CopyStridedHost(const DLTensor* from, DLTensor* to);
+
+/*!
+ * \brief Same as CopyStridedHost but never launches on the runtime thread pool,
+ *  for use from threads other than the thread pool owner such as stream workers.
+ */
+void CopyStridedHostSerial(const DLTensor* from, DLTensor* to);
+
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_CPU_COPY_KERNELS_H_
@@ -24,10 +24,21 @@
 #include <tvm/ffi/function.h>
 #include <tvm/runtime/device_api.h>
 #include <tvm/runtime/logging.h>
+#include <tvm/runtime/ndarray.h>
 
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "cpu_copy_kernels.h"
 #include "workspace_pool.h"
 
 #ifdef __ANDROID__
@@ -49,6 +60,114 @@
 
 namespace tvm {
 namespace runtime {
+
+/*!
+ * \brief A CPU stream: an in-order queue of host tasks drained by a dedicated worker thread.
+ *
+ * Work pushed to a stream runs asynchronously to the pushing thread, in push order.
+ * The completion progress is shared, so that an event recorded on a stream stays
+ * valid even if the stream is freed before the event is waited on.
+ */
+class CPUStream {
+ public:
+  /*! \brief The completion progress of a stream. */
+  struct Progress {
+    std::mutex mutex;
+    std::condition_variable cv;
+    /*! \brief The number of tasks that finished. */
+    uint64_t num_done{0};
+
+    /*! \brief Block until the task with the given ticket finished. */
+    void Wait(uint64_t ticket) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this, ticket]() { return num_done >= ticket; });
+    }
+  };
+
+  /*! \brief An event recorded on a stream, fired when all tasks pushed before it finished. */
+  struct Event {
+    std::shared_ptr<Progress> progress;
+    uint64_t ticket;
+
+    void Wait() const { progress->Wait(ticket); }
+  };
+
+  CPUStream() : progress_(std::make_shared<Progress>()), worker_([this]() { this->Run(); }) {}
+
+  ~CPUStream() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+  }
+
+  /*! \brief Push a task to the end of the stream. */
+  void Push(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(task));
+      ++num_pushed_;
+    }
+    cv_.notify_one();
+  }
+
+  /*! \brief Record an event covering all the tasks pushed so far. */
+  Event Record() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Event{progress_, num_pushed_};
+  }
+
+  /*! \brief Block until all the pushed tasks finished, rethrowing the first task error. */
+  void Sync() {
+    Record().Wait();
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::swap(error, error_);
+    }
+    if (error != nullptr) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return shutdown_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        task = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_ == nullptr) error_ = std::current_exception();
+      }
+      {
+        std::lock_guard<std::mutex> lock(progress_->mutex);
+        ++progress_->num_done;
+      }
+      progress_->cv.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+  uint64_t num_pushed_{0};
+  bool shutdown_{false};
+  std::exception_ptr error_{nullptr};
+  std::shared_ptr<Progress> progress_;
+  // NOTE: the worker is declared last so that it starts after all the other fields.
+  std::thread worker_;
+};
+
 class CPUDeviceAPI final : public DeviceAPI {
  public:
   void SetDevice(Device dev) final {}
@@ -116,7 +235,70 @@ class CPUDeviceAPI final : public DeviceAPI {
 #endif
   }
 
-  void StreamSync(Device dev, TVMStreamHandle stream) final {}
+  TVMStreamHandle CreateStream(Device dev) final { return new CPUStream(); }
+
+  void FreeStream(Device dev, TVMStreamHandle stream) final {
+    if (stream == nullptr) return;
+    CPUStream* cpu_stream = static_cast<CPUStream*>(stream);
+    if (current_stream_ == cpu_stream) current_stream_ = nullptr;
+    // The destructor drains the pending tasks before joining the worker.
+    delete cpu_stream;
+  }
+
+  void StreamSync(Device dev, TVMStreamHandle stream) final {
+    if (stream != nullptr) {
+      static_cast<CPUStream*>(stream)->Sync();
+    }
+  }
+
+  void SyncStreamFromTo(Device dev, TVMStreamHandle event_src, TVMStreamHandle event_dst) final {
+    // The null stream is synchronous, so everything issued on it has already finished.
+    if (event_src == nullptr || event_src == event_dst) return;
+    CPUStream::Event event = static_cast<CPUStream*>(event_src)->Record();
+    if (event_dst == nullptr) {
+      event.Wait();
+    } else {
+      static_cast<CPUStream*>(event_dst)->Push([event]() { event.Wait(); });
+    }
+  }
+
+  void SetStream(Device dev, TVMStreamHandle stream) final {
+    current_stream_ = static_cast<CPUStream*>(stream);
+  }
+
+  TVMStreamHandle GetCurrentStream(Device dev) final { return current_stream_; }
+
+  void CopyDataFromTo(DLTensor* from, DLTensor* to, TVMStreamHandle stream) final {
+    if (ffi::IsContiguous(*from) && ffi::IsContiguous(*to)) {
+      DeviceAPI::CopyDataFromTo(from, to, stream);
+      return;
+    }
+    if (stream == nullptr) {
+      CopyStridedHost(from, to);
+      return;
+    }
+    // The stream runs the copy later, so it owns a snapshot of the shapes and strides.
+    struct OwnedTensor {
+      DLTensor tensor;
+      std::vector<int64_t> shape;
+      std::vector<int64_t> strides;
+
+      explicit OwnedTensor(const DLTensor* src)
+          : tensor(*src), shape(src->shape, src->shape + src->ndim) {
+        if (src->strides != nullptr) strides.assign(src->strides, src->strides + src->ndim);
+      }
+
+      DLTensor* get() {
+        tensor.shape = shape.data();
+        tensor.strides = strides.empty() ? nullptr : strides.data();
+        return &tensor;
+      }
+    };
+    auto task = std::make_shared<std::pair<OwnedTensor, OwnedTensor>>(OwnedTensor(from),
+                                                                      OwnedTensor(to));
+    static_cast<CPUStream*>(stream)->Push(
+        [task]() { CopyStridedHostSerial(task->first.get(), task->second.get()); });
+  }
 
   void* AllocWorkspace(Device dev, size_t size, DLDataType type_hint) final;
   void FreeWorkspace(Device dev, void* data) final;
@@ -134,10 +316,25 @@ class CPUDeviceAPI final : public DeviceAPI {
   void CopyDataFromTo(const void* from, size_t from_offset, void* to, size_t to_offset, size_t size,
                       Device dev_from, Device dev_to, DLDataType type_hint,
                       TVMStreamHandle stream) final {
-    memcpy(static_cast<char*>(to) + to_offset, static_cast<const char*>(from) + from_offset, size);
+    char* dst = static_cast<char*>(to) + to_offset;
+    const char* src = static_cast<const char*>(from) + from_offset;
+    if (stream == nullptr) {
+      ParallelMemcpy(dst, src, size);
+    } else {
+      // The stream worker copies with a plain memcpy: launching on the runtime thread
+      // pool from it would spin up a second pool that contends with the compute threads.
+      // The caller keeps both buffers alive until the stream is synchronized.
+      static_cast<CPUStream*>(stream)->Push([dst, src, size]() { memcpy(dst, src, size); });
+    }
   }
+
+ private:
+  /*! \brief The stream set by SetStream on the calling thread. */
+  static thread_local CPUStream* current_stream_;
 };
 
+thread_local CPUStream* CPUDeviceAPI::current_stream_ = nullptr;
+
 struct CPUWorkspacePool : public WorkspacePool {
   CPUWorkspacePool() : WorkspacePool(kDLCPU, CPUDeviceAPI::Global()) {}
 };
@@ -20,6 +20,7 @@
 #include <tvm/runtime/disco/builtin.h>
 #include <tvm/runtime/disco/disco_worker.h>
 #include <tvm/runtime/disco/session.h>
+#include <tvm/runtime/trace.h>
 
 #include "../../support/process_id.h"
 #include "./protocol.h"
@@ -46,6 +47,31 @@ void DiscoWorker::SetRegister(int reg_id, ffi::AnyView value) {
   }
 }
 
+/*! \brief Static event names of the Disco actions, used by the tracer. */
+inline const char* DiscoActionTraceName(DiscoAction action) {
+  switch (action) {
+    case DiscoAction::kShutDown:
+      return "kShutDown";
+    case DiscoAction::kKillReg:
+      return "kKillReg";
+    case DiscoAction::kGetGlobalFunc:
+      return "kGetGlobalFunc";
+    case DiscoAction::kCallPacked:
+      return "kCallPacked";
+    case DiscoAction::kSyncWorker:
+      return "kSyncWorker";
+    case DiscoAction::kCopyFromWorker0:
+      return "kCopyFromWorker0";
+    case DiscoAction::kCopyToWorker0:
+      return "kCopyToWorker0";
+    case DiscoAction::kDebugGetFromRemote:
+      return "kDebugGetFromRemote";
+    case DiscoAction::kDebugSetRegister:
+      return "kDebugSetRegister";
+  }
+  return "kUnknown";
+}
+
 struct DiscoWorker::Impl {
   static void MainLoop(DiscoWorker* self) {
     ThreadLocalDiscoWorker::Get()->worker = self;
@@ -54,6 +80,7 @@ struct DiscoWorker::Impl {
       ffi::PackedArgs args = self->channel->Recv();
       DiscoAction action = static_cast<DiscoAction>(args[0].cast<int>());
       int64_t reg_id = args[1].cast<int64_t>();
+      TVM_TRACE_SCOPE_ARG("disco", DiscoActionTraceName(action), reg_id);
       switch (action) {
         case DiscoAction::kShutDown: {
           Shutdown(self);
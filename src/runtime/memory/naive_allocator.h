@@ -25,6 +25,7 @@
 
 #include <tvm/runtime/device_api.h>
 #include <tvm/runtime/memory/memory_manager.h>
+#include <tvm/runtime/trace.h>
 
 #include <atomic>
 #include <string>
@@ -38,6 +39,7 @@ class NaiveAllocator final : public Allocator {
   explicit NaiveAllocator() : Allocator(kNaive), used_memory_(0) {}
 
   Buffer Alloc(Device dev, size_t nbytes, size_t alignment, DLDataType type_hint) final {
+    TVM_TRACE_SCOPE_ARG("alloc", "NaiveAllocator::Alloc", nbytes);
     Buffer buf;
     buf.device = dev;
     buf.size = nbytes;
@@ -65,6 +67,7 @@ class NaiveAllocator final : public Allocator {
       return buf;
     }
 
+    TVM_TRACE_SCOPE_ARG("alloc", "NaiveAllocator::Alloc", nbytes);
     buf.size = nbytes;
     buf.data = DeviceAPI::Get(dev)->AllocDataSpace(dev, shape.size(), shape.data(), type_hint,
                                                    String(mem_scope));
@@ -75,6 +78,7 @@ class NaiveAllocator final : public Allocator {
   }
 
   void Free(const Buffer& buffer) override {
+    TVM_TRACE_SCOPE_ARG("alloc", "NaiveAllocator::Free", buffer.size);
     DeviceAPI::Get(buffer.device)->FreeDataSpace(buffer.device, buffer.data);
     used_memory_.fetch_sub(buffer.size, std::memory_order_relaxed);
     DLOG(INFO) << "free " << buffer.size << " B, used memory " << used_memory_ << " B";
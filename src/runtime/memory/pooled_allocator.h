@@ -25,6 +25,7 @@
 
 #include <tvm/runtime/device_api.h>
 #include <tvm/runtime/memory/memory_manager.h>
+#include <tvm/runtime/trace.h>
 
 #include <atomic>
 #include <mutex>
@@ -53,8 +54,10 @@ class PooledAllocator : public Allocator {
       auto&& pool = it->second;
       auto ret = pool.back();
       pool.pop_back();
+      TVM_TRACE_INSTANT("alloc", "PooledAllocator::PoolHit", size);
       return ret;
     }
+    TVM_TRACE_SCOPE_ARG("alloc", "PooledAllocator::DeviceAlloc", size);
     Buffer buf;
     buf.device = dev;
     buf.size = size;
@@ -88,6 +91,7 @@ class PooledAllocator : public Allocator {
       memory_pool_.emplace(buffer.size, std::vector<Buffer>{});
     }
     memory_pool_.at(buffer.size).push_back(buffer);
+    TVM_TRACE_INSTANT("alloc", "PooledAllocator::Free", buffer.size);
     VLOG(1) << "reclaim buffer " << buffer.size;
   }
 
@@ -13,7 +13,7 @@
 namespace tvm {
 namespace runtime {
 
-SegmentRunner::SegmentRunner(const Module& exec, Device device){
+SegmentRunner::SegmentRunner(const Module& exec, Device device) : device_(device){
   // HayeonP: TODO - Support multiple devices
   std::vector<Device> devices;
   devices.push_back(device);
@@ -55,6 +55,12 @@ SegmentRunner::SegmentRunner(const Module& exec, Device device){
   return;
 }
 
+SegmentRunner::~SegmentRunner(){
+  if(copy_stream_ != nullptr){
+    DeviceAPI::Get(device_)->FreeStream(device_, copy_stream_);
+  }
+}
+
 std::string SegmentRunner::GetRuntimeSequence(){  
   ffi::Function get_runtime_sequence_func = vm_module_->GetFunction("get_runtime_sequence", false);
 
@@ -179,6 +185,36 @@ void SegmentRunner::SetInputWithParams(std::vector<NDArray>& input, std::vector<
   return;
 }
 
+void SegmentRunner::PrefetchInput(std::vector<NDArray>& input){
+  if(copy_stream_ == nullptr){
+    copy_stream_ = DeviceAPI::Get(device_)->CreateStream(device_);
+  }
+
+  // NOTE: Always stage into fresh buffers. The buffers of the previous prefetch may still
+  // be bound to the persistent frame and read by the running segments.
+  prefetched_input_.clear();
+  for(auto& input_v : input){
+    NDArray staged = NDArray::Empty(input_v.Shape(), input_v->dtype, device_);
+    NDArray::CopyFromTo(input_v.get(), const_cast<ffi::NDArrayObj*>(staged.get()), copy_stream_);
+    prefetched_input_.push_back(staged);
+  }
+
+  return;
+}
+
+void SegmentRunner::SetPrefetchedInput(){
+  if(copy_stream_ == nullptr){
+    std::cout<<"SegmentRunnerError: No input is prefetched"<<std::endl;
+    return;
+  }
+
+  DeviceAPI::Get(device_)->StreamSync(device_, copy_stream_);
+  this->SetInput(prefetched_input_);
+  prefetched_input_.clear();
+
+  return;
+}
+
 void SegmentRunner::Execute(const int segment_id){
   static int prev_segment_id = -1;  
 
@@ -28,6 +28,7 @@
 #include <tvm/runtime/c_backend_api.h>
 #include <tvm/runtime/logging.h>
 #include <tvm/runtime/threading_backend.h>
+#include <tvm/runtime/trace.h>
 #if TVM_THREADPOOL_USE_OPENMP
 #include <omp.h>
 #endif
@@ -469,11 +470,29 @@ TVM_DLL void Configure(tvm::runtime::threading::ThreadGroup::AffinityMode mode,
 #endif
 }
 int32_t NumThreads() { return tvm::runtime::ThreadPool::ThreadLocal()->NumThreads(); }
+
+/*! \brief The number of parallel jobs launched by the calling thread and not finished yet. */
+thread_local int parallel_launch_depth = 0;
+
+bool InParallelTask() {
+#if TVM_THREADPOOL_USE_OPENMP
+  if (omp_in_parallel()) return true;
+#else
+  if (ParallelLauncher::ThreadLocal()->is_worker) return true;
+#endif
+  return parallel_launch_depth != 0;
+}
 }  // namespace threading
 }  // namespace runtime
 }  // namespace tvm
 
 int TVMBackendParallelLaunch(FTVMParallelLambda flambda, void* cdata, int num_task) {
+  TVM_TRACE_SCOPE_ARG("thread_pool", "ParallelLaunch", num_task);
+  // The caller runs a task of the job too, mark it so that InParallelTask holds there.
+  struct LaunchDepthGuard {
+    LaunchDepthGuard() { ++tvm::runtime::threading::parallel_launch_depth; }
+    ~LaunchDepthGuard() { --tvm::runtime::threading::parallel_launch_depth; }
+  } depth_guard;
   int num_workers = tvm::runtime::threading::MaxConcurrency();
   if (num_workers == 1) {
     std::atomic<int32_t> sync_counter{0};
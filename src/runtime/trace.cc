@@ -0,0 +1,257 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file trace.cc
+ * \brief Per-thread ring buffers behind tvm/runtime/trace.h.
+ */
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+
+namespace {
+
+bool TraceEnabledByEnv() {
+  const char* val = getenv("TVM_TRACE");
+  return val != nullptr && std::strcmp(val, "0") != 0 && val[0] != '\0';
+}
+
+/*! \brief Number of events kept per thread, overridable by TVM_TRACE_BUFFER_SIZE. */
+size_t TraceBufferCapacity() {
+  size_t capacity = 1 << 16;
+  if (const char* val = getenv("TVM_TRACE_BUFFER_SIZE")) {
+    int64_t requested = atoll(val);
+    if (requested > 0) {
+      capacity = 1;
+      while (capacity < static_cast<size_t>(requested)) capacity <<= 1;
+    }
+  }
+  return capacity;
+}
+
+/*! \brief A single recorded event, end_ns == 0 marks an instant event. */
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  int64_t arg;
+};
+
+/*!
+ * \brief Single-producer ring of events owned by one thread.
+ *
+ *  The owner writes a slot and then publishes it by bumping head_. Readers
+ *  copy the slots below head_ and re-read head_ afterwards to drop the slots
+ *  the owner may have overwritten meanwhile, including the one it may be
+ *  writing, like the readers of a seqlock.
+ */
+class ThreadTraceBuffer {
+ public:
+  ThreadTraceBuffer(int tid, size_t capacity)
+      : tid_(tid), mask_(capacity - 1), events_(capacity) {}
+
+  void Push(const TraceEvent& event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    // Keep the write of the slot after the publication of the previous event, which
+    // is how readers tell that the slot may be overwritten.
+    std::atomic_thread_fence(std::memory_order_release);
+    events_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  void Clear() { cleared_.store(head_.load(std::memory_order_acquire), std::memory_order_relaxed); }
+
+  void Collect(std::vector<std::pair<int, TraceEvent>>* out) const {
+    uint64_t capacity = mask_ + 1;
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t begin = std::max(cleared_.load(std::memory_order_relaxed),
+                              head > capacity ? head - capacity : 0);
+    size_t offset = out->size();
+    for (uint64_t i = begin; i < head; ++i) {
+      out->emplace_back(tid_, events_[i & mask_]);
+    }
+    // Drop the slots that were overwritten while copying, and the slot of event new_head,
+    // which the owner may be writing. The fence keeps the copies before the reload.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t new_head = head_.load(std::memory_order_relaxed);
+    if (new_head + 1 > begin + capacity) {
+      uint64_t num_stale = std::min(new_head + 1 - capacity - begin, head - begin);
+      out->erase(out->begin() + offset, out->begin() + offset + num_stale);
+    }
+  }
+
+ private:
+  int tid_;
+  uint64_t mask_;
+  std::vector<TraceEvent> events_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> cleared_{0};
+};
+
+/*! \brief Registry of all thread buffers, which outlive their threads. */
+class TraceRegistry {
+ public:
+  static TraceRegistry* Global() {
+    // Leaked on purpose so that threads exiting late can still record.
+    static TraceRegistry* inst = new TraceRegistry();
+    return inst;
+  }
+
+  ThreadTraceBuffer* ThreadLocalBuffer() {
+    thread_local std::shared_ptr<ThreadTraceBuffer> buffer;
+    if (buffer == nullptr) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffer = std::make_shared<ThreadTraceBuffer>(static_cast<int>(buffers_.size()), capacity_);
+      buffers_.push_back(buffer);
+    }
+    return buffer.get();
+  }
+
+  const char* Intern(const std::string& name) {
+    thread_local std::unordered_map<std::string, const char*> cache;
+    auto it = cache.find(name);
+    if (it != cache.end()) return it->second;
+    const char* ret;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ret = strings_.insert(name).first->c_str();
+    }
+    cache.emplace(name, ret);
+    return ret;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_) buffer->Clear();
+  }
+
+  std::vector<std::pair<int, TraceEvent>> Collect() {
+    std::vector<std::pair<int, TraceEvent>> events;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_) buffer->Collect(&events);
+    return events;
+  }
+
+ private:
+  size_t capacity_ = TraceBufferCapacity();
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers_;
+  std::unordered_set<std::string> strings_;
+};
+
+void WriteJSONString(std::ostream& os, const char* str) {
+  os << '"';
+  for (const char* p = str; *p != '\0'; ++p) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\') {
+      os << '\\' << *p;
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      os << buf;
+    } else {
+      os << *p;
+    }
+  }
+  os << '"';
+}
+
+}  // namespace
+
+std::atomic<bool> trace_enabled_flag{TraceEnabledByEnv()};
+
+void TraceSetEnabled(bool enabled) {
+  trace_enabled_flag.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t TraceNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void TraceRecord(const char* category, const char* name, uint64_t begin_ns, uint64_t end_ns,
+                 int64_t arg) {
+  // Complete events are distinguished from instants by a non-zero end.
+  end_ns = std::max(end_ns, begin_ns + 1);
+  TraceRegistry::Global()->ThreadLocalBuffer()->Push({category, name, begin_ns, end_ns, arg});
+}
+
+void TraceRecordInstant(const char* category, const char* name, int64_t arg) {
+  TraceRegistry::Global()->ThreadLocalBuffer()->Push({category, name, TraceNowNs(), 0, arg});
+}
+
+const char* TraceInternString(const std::string& name) {
+  return TraceRegistry::Global()->Intern(name);
+}
+
+void TraceClear() { TraceRegistry::Global()->Clear(); }
+
+std::string TraceDumpJSON() {
+  std::vector<std::pair<int, TraceEvent>> events = TraceRegistry::Global()->Collect();
+  std::sort(events.begin(), events.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.second.begin_ns < rhs.second.begin_ns;
+  });
+  uint64_t base_ns = events.empty() ? 0 : events.front().second.begin_ns;
+  std::ostringstream os;
+  os.precision(3);
+  os << std::fixed << "{\"traceEvents\":[";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent& event = events[i].second;
+    if (i != 0) os << ',';
+    os << "\n{\"name\":";
+    WriteJSONString(os, event.name);
+    os << ",\"cat\":";
+    WriteJSONString(os, event.category);
+    // Chrome trace timestamps are in microseconds.
+    os << ",\"ts\":" << (event.begin_ns - base_ns) / 1000.0;
+    if (event.end_ns != 0) {
+      os << ",\"ph\":\"X\",\"dur\":" << (event.end_ns - event.begin_ns) / 1000.0;
+    } else {
+      os << ",\"ph\":\"i\",\"s\":\"t\"";
+    }
+    os << ",\"pid\":0,\"tid\":" << events[i].first << ",\"args\":{\"arg\":" << event.arg << "}}";
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}";
+  return os.str();
+}
+
+TVM_FFI_REGISTER_GLOBAL("runtime.TraceSetEnabled").set_body_typed(TraceSetEnabled);
+
+TVM_FFI_REGISTER_GLOBAL("runtime.TraceClear").set_body_typed(TraceClear);
+
+TVM_FFI_REGISTER_GLOBAL("runtime.TraceDumpJSON").set_body_typed(TraceDumpJSON);
+
+}  // namespace runtime
+}  // namespace tvm
@@ -43,6 +43,10 @@ std::unique_ptr<PagedPrefillFunc> ConvertPagedPrefillFunc(Array<ObjectRef> args,
     return std::make_unique<FlashInferPagedPrefillFunc>(std::move(attn_func), std::move(plan_func),
                                                         attn_kind);
   }
+  if (backend_name == "cpu") {
+    CHECK_EQ(args.size(), 1);
+    return std::make_unique<CPUPagedPrefillFunc>(attn_kind);
+  }
   LOG(FATAL) << "Cannot reach here";
   throw;
 }
@@ -65,6 +69,10 @@ std::unique_ptr<RaggedPrefillFunc> ConvertRaggedPrefillFunc(Array<ObjectRef> arg
     return std::make_unique<FlashInferRaggedPrefillFunc>(std::move(attn_func), std::move(plan_func),
                                                          attn_kind);
   }
+  if (backend_name == "cpu") {
+    CHECK_EQ(args.size(), 1);
+    return std::make_unique<CPURaggedPrefillFunc>(attn_kind);
+  }
   LOG(FATAL) << "Cannot reach here";
   throw;
 }
@@ -86,6 +94,10 @@ std::unique_ptr<PagedDecodeFunc> ConvertPagedDecodeFunc(Array<ObjectRef> args, A
     return std::make_unique<FlashInferPagedDecodeFunc>(std::move(attn_func), std::move(plan_func),
                                                        attn_kind);
   }
+  if (backend_name == "cpu") {
+    CHECK_EQ(args.size(), 1);
+    return std::make_unique<CPUPagedDecodeFunc>(attn_kind);
+  }
   LOG(FATAL) << "Cannot reach here";
   throw;
 }
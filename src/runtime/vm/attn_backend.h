@@ -45,6 +45,7 @@ namespace vm {
 enum class AttnBackendKind : int {
   kTIR = 0,
   kFlashInfer = 1,
+  kCPU = 2,
 };
 
 /*! \brief The base class of attention backends. */
@@ -200,6 +201,22 @@ class FlashInferPagedPrefillFunc : public PagedPrefillFunc {
   std::vector<std::tuple<NDArray, NDArray, NDArray, IntTuple>> cached_buffers_;
 };
 
+/*!
+ * \brief The CPU-native paged prefill attention function class.
+ * It computes the attention directly on the host memory (see attn_backend_cpu.cc).
+ */
+class CPUPagedPrefillFunc : public PagedPrefillFunc {
+ public:
+  explicit CPUPagedPrefillFunc(AttnKind attn_kind)
+      : PagedPrefillFunc(ffi::Function(nullptr), attn_kind, AttnBackendKind::kCPU) {}
+
+  void MHA(int depth, NDArray q, NDArray qo_indptr, NDArray pages, NDArray page_indptr,
+           NDArray page_indices, NDArray length_info, NDArray q_rope_position,
+           NDArray k_rope_pos_offset, bool causal, RoPEMode rope_mode, double rotary_scale,
+           double rotary_theta, double sm_scale, NDArray attn_output, NDArray attn_lse,
+           TVMStreamHandle compute_stream) final;
+};
+
 /*! \brief The ragged prefill attention function base class. */
 class RaggedPrefillFunc : public AttnBackendFunc {
  public:
@@ -293,6 +310,21 @@ class FlashInferRaggedPrefillFunc : public RaggedPrefillFunc {
   IntTuple plan_info_vec_;
 };
 
+/*!
+ * \brief The CPU-native ragged prefill attention function class.
+ * It computes the attention directly on the host memory (see attn_backend_cpu.cc).
+ */
+class CPURaggedPrefillFunc : public RaggedPrefillFunc {
+ public:
+  explicit CPURaggedPrefillFunc(AttnKind attn_kind)
+      : RaggedPrefillFunc(ffi::Function(nullptr), attn_kind, AttnBackendKind::kCPU) {}
+
+  void MHA(NDArray q, NDArray k, NDArray v, NDArray qo_indptr, NDArray kv_indptr,
+           NDArray q_rope_position, NDArray k_rope_pos_offset, bool causal, RoPEMode rope_mode,
+           double rotary_scale, double rotary_theta, double sm_scale, NDArray attn_output,
+           NDArray attn_lse, TVMStreamHandle compute_stream) final;
+};
+
 /*! \brief The paged decode attention function base class. */
 class PagedDecodeFunc : public AttnBackendFunc {
  public:
@@ -397,6 +429,21 @@ class FlashInferPagedDecodeFunc : public PagedDecodeFunc {
   std::vector<std::tuple<NDArray, NDArray, NDArray, IntTuple>> cached_buffers_;
 };
 
+/*!
+ * \brief The CPU-native paged decode attention function class.
+ * It computes the attention directly on the host memory (see attn_backend_cpu.cc).
+ */
+class CPUPagedDecodeFunc : public PagedDecodeFunc {
+ public:
+  explicit CPUPagedDecodeFunc(AttnKind attn_kind)
+      : PagedDecodeFunc(ffi::Function(nullptr), attn_kind, AttnBackendKind::kCPU) {}
+
+  void MHA(int depth, NDArray q, NDArray pages, NDArray page_indptr, NDArray page_indices,
+           NDArray length_info, NDArray k_rope_pos_offset, NDArray q_rope_position,
+           RoPEMode rope_mode, double rotary_scale, double rotary_theta, double sm_scale,
+           NDArray attn_output, NDArray attn_lse, TVMStreamHandle compute_stream) final;
+};
+
 /*! \brief The paged prefill with tree mask attention function base class. */
 class PagedPrefillTreeMaskFunc : public AttnBackendFunc {
  public:
@@ -0,0 +1,711 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/runtime/vm/attn_backend_cpu.cc
+ * \brief The CPU-native attention backend of the KV cache.
+ *
+ * The kernels follow the semantics of the TIR CPU attention kernels in
+ * python/tvm/relax/frontend/nn/llm/kv_cache.py: scores and the returned LSE are
+ * in base 2, inline RoPE rotates the two halves of the head dimension, and a
+ * query row without any visible key outputs zeros with an LSE of -5e4.
+ *
+ * The work is split into tasks of (sequence, KV head, chunk of query rows).
+ * A task computes all the query heads sharing the KV head at once, so each key
+ * and value row is loaded (and converted / rotated) once per task, and runs
+ * the online softmax over tiles of kKVTile keys. Tasks are sorted by their KV
+ * length and scheduled dynamically over the thread pool, since the sequence
+ * lengths of a batch are usually far from uniform.
+ */
+#include <tvm/runtime/data_type.h>
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/threading_backend.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "../cpu_copy_kernels.h"
+#include "attn_backend.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TVM_ATTN_CPU_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define TVM_ATTN_CPU_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+/*! \brief The number of keys processed by one step of the online softmax. */
+constexpr int64_t kKVTile = 32;
+/*! \brief The number of query rows of a sequence handled by one task. */
+constexpr int64_t kQueryChunk = 16;
+constexpr float kLog2e = 1.4426950408889634f;
+/*! \brief The LSE of a query row which attends to no key, as in the TIR kernels. */
+constexpr float kEmptyLSE = -5e4f;
+
+//---------------------------------------------
+// Vector primitives
+//---------------------------------------------
+float DotScalar(const float* a, const float* b, int64_t n) {
+  float result = 0.0f;
+  for (int64_t i = 0; i < n; ++i) result += a[i] * b[i];
+  return result;
+}
+
+void AxpyScalar(float alpha, const float* x, float* y, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) y[i] += alpha * x[i];
+}
+
+#if TVM_ATTN_CPU_X86
+__attribute__((target("avx2,fma"))) float DotAVX2(const float* a, const float* b, int64_t n) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int64_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  acc0 = _mm256_add_ps(acc0, acc1);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+  sum = _mm_hadd_ps(sum, sum);
+  sum = _mm_hadd_ps(sum, sum);
+  return _mm_cvtss_f32(sum) + DotScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void AxpyAVX2(float alpha, const float* x, float* y,
+                                                   int64_t n) {
+  __m256 valpha = _mm256_set1_ps(alpha);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 vy = _mm256_fmadd_ps(valpha, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i));
+    _mm256_storeu_ps(y + i, vy);
+  }
+  AxpyScalar(alpha, x + i, y + i, n - i);
+}
+#endif  // TVM_ATTN_CPU_X86
+
+#if TVM_ATTN_CPU_NEON
+float DotNEON(const float* a, const float* b, int64_t n) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  for (; i + 4 <= n; i += 4) {
+    acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1)) + DotScalar(a + i, b + i, n - i);
+}
+
+void AxpyNEON(float alpha, const float* x, float* y, int64_t n) {
+  float32x4_t valpha = vdupq_n_f32(alpha);
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), valpha, vld1q_f32(x + i)));
+  }
+  AxpyScalar(alpha, x + i, y + i, n - i);
+}
+#endif  // TVM_ATTN_CPU_NEON
+
+/*! \brief The vector primitives selected for the host. */
+struct VectorOps {
+  float (*dot)(const float* a, const float* b, int64_t n);
+  void (*axpy)(float alpha, const float* x, float* y, int64_t n);
+};
+
+const VectorOps& GetVectorOps() {
+  static const VectorOps ops = []() -> VectorOps {
+#if TVM_ATTN_CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return {DotAVX2, AxpyAVX2};
+    }
+#elif TVM_ATTN_CPU_NEON
+    return {DotNEON, AxpyNEON};
+#endif
+    return {DotScalar, AxpyScalar};
+  }();
+  return ops;
+}
+
+//---------------------------------------------
+// Element access
+//---------------------------------------------
+enum class ElemKind : int { kFloat32, kFloat16, kBFloat16 };
+
+ElemKind GetElemKind(DLDataType dtype, const char* name) {
+  if (dtype.lanes == 1 && dtype.bits == 32 && dtype.code == kDLFloat) return ElemKind::kFloat32;
+  if (dtype.lanes == 1 && dtype.bits == 16 && dtype.code == kDLFloat) return ElemKind::kFloat16;
+  if (dtype.lanes == 1 && dtype.bits == 16 && dtype.code == kDLBfloat) return ElemKind::kBFloat16;
+  LOG(FATAL) << "ValueError: The CPU attention backend does not support " << name << " dtype "
+             << DataType(dtype);
+  throw;
+}
+
+inline int64_t ElemBytes(ElemKind kind) { return kind == ElemKind::kFloat32 ? 4 : 2; }
+
+void LoadRow(ElemKind kind, const void* src, float* dst, int64_t n) {
+  switch (kind) {
+    case ElemKind::kFloat32:
+      std::memcpy(dst, src, n * sizeof(float));
+      return;
+    case ElemKind::kFloat16:
+      ConvertFloat16ToFloat32(static_cast<const uint16_t*>(src), dst, n);
+      return;
+    case ElemKind::kBFloat16:
+      ConvertBFloat16ToFloat32(static_cast<const uint16_t*>(src), dst, n);
+      return;
+  }
+}
+
+void StoreRow(ElemKind kind, const float* src, void* dst, int64_t n) {
+  switch (kind) {
+    case ElemKind::kFloat32:
+      std::memcpy(dst, src, n * sizeof(float));
+      return;
+    case ElemKind::kFloat16:
+      ConvertFloat32ToFloat16(src, static_cast<uint16_t*>(dst), n);
+      return;
+    case ElemKind::kBFloat16:
+      ConvertFloat32ToBFloat16(src, static_cast<uint16_t*>(dst), n);
+      return;
+  }
+}
+
+template <typename T>
+T* DataPtr(const NDArray& arr) {
+  return reinterpret_cast<T*>(static_cast<char*>(arr->data) + arr->byte_offset);
+}
+
+void CheckAuxArray(const NDArray& arr, const char* name) {
+  CHECK(arr->dtype.code == kDLInt && arr->dtype.bits == 32 && arr->dtype.lanes == 1)
+      << "ValueError: The CPU attention backend expects int32 " << name << ", but got "
+      << DataType(arr->dtype);
+}
+
+void CheckOnCPU(const NDArray& arr, const char* name) {
+  CHECK_EQ(arr->device.device_type, kDLCPU)
+      << "ValueError: The CPU attention backend expects " << name << " on CPU, but got "
+      << arr->device;
+}
+
+//---------------------------------------------
+// RoPE
+//---------------------------------------------
+/*!
+ * \brief The default rotary embedding over the whole head dimension,
+ * rotating dimension i together with dimension i + head_dim / 2.
+ */
+class RoPE {
+ public:
+  RoPE(int64_t head_dim, double scale, double theta) : half_(head_dim / 2), scale_(scale) {
+    CHECK_EQ(head_dim % 2, 0) << "ValueError: Inline RoPE requires an even head dimension, but got "
+                              << head_dim;
+    inv_freq_.resize(half_);
+    for (int64_t i = 0; i < half_; ++i) {
+      inv_freq_[i] = 1.0f / std::pow(static_cast<float>(theta),
+                                     static_cast<float>(2 * i) / static_cast<float>(head_dim));
+    }
+  }
+
+  /*! \brief Rotate `x` in place as the embedding of position `pos`. */
+  void Apply(float* x, int64_t pos) const {
+    float s = static_cast<float>(pos * scale_);
+    for (int64_t i = 0; i < half_; ++i) {
+      float freq = s * inv_freq_[i];
+      float cos_freq = std::cos(freq);
+      float sin_freq = std::sin(freq);
+      float x0 = x[i];
+      float x1 = x[i + half_];
+      x[i] = cos_freq * x0 - sin_freq * x1;
+      x[i + half_] = cos_freq * x1 + sin_freq * x0;
+    }
+  }
+
+ private:
+  int64_t half_;
+  double scale_;
+  std::vector<float> inv_freq_;
+};
+
+//---------------------------------------------
+// KV access
+//---------------------------------------------
+/*! \brief The keys and values of one sequence stored in the paged KV cache. */
+class PagedKVRows {
+ public:
+  PagedKVRows(const char* pages, const int32_t* page_ids, int64_t num_kv_heads, int64_t page_size,
+              int64_t head_dim, int64_t elem_bytes, int64_t sliding_window_offset,
+              int64_t sink_size)
+      : pages_(pages),
+        page_ids_(page_ids),
+        page_size_(page_size),
+        sliding_window_offset_(sliding_window_offset),
+        sink_size_(sink_size) {
+    row_bytes_ = head_dim * elem_bytes;
+    head_bytes_ = page_size * row_bytes_;
+    page_bytes_ = 2 * num_kv_heads * head_bytes_;
+    value_bytes_ = num_kv_heads * head_bytes_;
+  }
+
+  const void* K(int64_t kv_head, int64_t pos) const { return Row(kv_head, pos); }
+  const void* V(int64_t kv_head, int64_t pos) const {
+    return static_cast<const char*>(Row(kv_head, pos)) + value_bytes_;
+  }
+
+ private:
+  const void* Row(int64_t kv_head, int64_t pos) const {
+    // The attention sink is kept in front of the sliding window.
+    int64_t offset = pos < sink_size_ ? pos : pos - sink_size_ + sliding_window_offset_;
+    return pages_ + page_ids_[offset / page_size_] * page_bytes_ + kv_head * head_bytes_ +
+           (offset % page_size_) * row_bytes_;
+  }
+
+  const char* pages_;
+  const int32_t* page_ids_;
+  int64_t page_size_;
+  int64_t sliding_window_offset_;
+  int64_t sink_size_;
+  int64_t row_bytes_;
+  int64_t head_bytes_;
+  int64_t page_bytes_;
+  int64_t value_bytes_;
+};
+
+/*! \brief The keys and values of one sequence stored in ragged [len, num_kv_heads, dim] arrays. */
+class RaggedKVRows {
+ public:
+  RaggedKVRows(const char* k, const char* v, int64_t num_kv_heads, int64_t qk_head_dim,
+               int64_t v_head_dim, int64_t elem_bytes)
+      : k_(k), v_(v) {
+    k_head_bytes_ = qk_head_dim * elem_bytes;
+    v_head_bytes_ = v_head_dim * elem_bytes;
+    k_row_bytes_ = num_kv_heads * k_head_bytes_;
+    v_row_bytes_ = num_kv_heads * v_head_bytes_;
+  }
+
+  const void* K(int64_t kv_head, int64_t pos) const {
+    return k_ + pos * k_row_bytes_ + kv_head * k_head_bytes_;
+  }
+  const void* V(int64_t kv_head, int64_t pos) const {
+    return v_ + pos * v_row_bytes_ + kv_head * v_head_bytes_;
+  }
+
+ private:
+  const char* k_;
+  const char* v_;
+  int64_t k_head_bytes_;
+  int64_t v_head_bytes_;
+  int64_t k_row_bytes_;
+  int64_t v_row_bytes_;
+};
+
+//---------------------------------------------
+// Kernel
+//---------------------------------------------
+/*! \brief The problem shared by all the tasks of an attention call. */
+struct AttnProblem {
+  int64_t num_qo_heads;
+  int64_t num_kv_heads;
+  int64_t qk_head_dim;
+  int64_t v_head_dim;
+  ElemKind q_kind;
+  ElemKind kv_kind;
+  ElemKind o_kind;
+  const char* q;
+  char* output;
+  float* lse;
+  const int32_t* q_rope_position;
+  const int32_t* k_rope_pos_offset;
+  /*! \brief The RoPE applied inline, or nullptr. */
+  const RoPE* rope;
+  bool causal;
+  float sm_scale;
+};
+
+/*! \brief One unit of work: a chunk of query rows of a sequence against one KV head. */
+template <typename KVRows>
+struct AttnTask {
+  KVRows kv;
+  int64_t seq;
+  int64_t kv_head;
+  /*! \brief The global index of the first query row of the sequence. */
+  int64_t q_base;
+  int64_t qo_len;
+  int64_t kv_len;
+  int64_t row_begin;
+  int64_t row_end;
+};
+
+/*! \brief The scratch memory of a worker thread. */
+struct AttnWorkspace {
+  std::vector<float> q;
+  std::vector<float> acc;
+  std::vector<float> m;
+  std::vector<float> l;
+  std::vector<float> k_tile;
+  std::vector<float> v_tile;
+  std::vector<const float*> k_ptrs;
+  std::vector<const float*> v_ptrs;
+  std::vector<float> scores;
+
+  void Init(const AttnProblem& p) {
+    int64_t group_size = p.num_qo_heads / p.num_kv_heads;
+    int64_t num_vecs = kQueryChunk * group_size;
+    q.resize(num_vecs * p.qk_head_dim);
+    acc.resize(num_vecs * p.v_head_dim);
+    m.resize(num_vecs);
+    l.resize(num_vecs);
+    k_tile.resize(kKVTile * p.qk_head_dim);
+    v_tile.resize(kKVTile * p.v_head_dim);
+    k_ptrs.resize(kKVTile);
+    v_ptrs.resize(kKVTile);
+    scores.resize(kKVTile);
+  }
+};
+
+template <typename KVRows>
+void RunAttnTask(const AttnProblem& p, const AttnTask<KVRows>& task, AttnWorkspace* ws) {
+  const VectorOps& ops = GetVectorOps();
+  const int64_t group_size = p.num_qo_heads / p.num_kv_heads;
+  const int64_t dqk = p.qk_head_dim;
+  const int64_t dv = p.v_head_dim;
+  const int64_t num_rows = task.row_end - task.row_begin;
+  const int64_t num_vecs = num_rows * group_size;
+  const int64_t q_elem_bytes = ElemBytes(p.q_kind);
+  // Scale the queries once so that the scores come out in base 2.
+  const float q_scale = p.sm_scale * kLog2e;
+
+  // Vector v = r * group_size + g is query row `row_begin + r` of head `kv_head * group_size + g`.
+  for (int64_t r = 0; r < num_rows; ++r) {
+    int64_t token = task.q_base + task.row_begin + r;
+    for (int64_t g = 0; g < group_size; ++g) {
+      int64_t head = task.kv_head * group_size + g;
+      float* q = ws->q.data() + (r * group_size + g) * dqk;
+      LoadRow(p.q_kind, p.q + (token * p.num_qo_heads + head) * dqk * q_elem_bytes, q, dqk);
+      if (p.rope != nullptr) p.rope->Apply(q, p.q_rope_position[token]);
+      for (int64_t i = 0; i < dqk; ++i) q[i] *= q_scale;
+    }
+  }
+  std::fill(ws->acc.begin(), ws->acc.begin() + num_vecs * dv, 0.0f);
+  std::fill(ws->m.begin(), ws->m.begin() + num_vecs, -std::numeric_limits<float>::infinity());
+  std::fill(ws->l.begin(), ws->l.begin() + num_vecs, 0.0f);
+
+  // Query row r sees the keys [0, kv_len - qo_len + r] when causal.
+  int64_t kv_end = task.kv_len;
+  if (p.causal) {
+    kv_end = std::min(kv_end, std::max<int64_t>(task.kv_len - task.qo_len + task.row_end, 0));
+  }
+  // Rows in float32 without RoPE are read in place, others are converted into the tiles.
+  const bool direct_k = p.kv_kind == ElemKind::kFloat32 && p.rope == nullptr;
+  const bool direct_v = p.kv_kind == ElemKind::kFloat32;
+  for (int64_t tile_begin = 0; tile_begin < kv_end; tile_begin += kKVTile) {
+    int64_t tile_len = std::min(kKVTile, kv_end - tile_begin);
+    for (int64_t j = 0; j < tile_len; ++j) {
+      int64_t pos = tile_begin + j;
+      const void* k_row = task.kv.K(task.kv_head, pos);
+      const void* v_row = task.kv.V(task.kv_head, pos);
+      if (direct_k) {
+        ws->k_ptrs[j] = static_cast<const float*>(k_row);
+      } else {
+        float* k = ws->k_tile.data() + j * dqk;
+        LoadRow(p.kv_kind, k_row, k, dqk);
+        if (p.rope != nullptr) p.rope->Apply(k, p.k_rope_pos_offset[task.seq] + pos);
+        ws->k_ptrs[j] = k;
+      }
+      if (direct_v) {
+        ws->v_ptrs[j] = static_cast<const float*>(v_row);
+      } else {
+        float* v = ws->v_tile.data() + j * dv;
+        LoadRow(p.kv_kind, v_row, v, dv);
+        ws->v_ptrs[j] = v;
+      }
+    }
+
+    for (int64_t r = 0; r < num_rows; ++r) {
+      int64_t visible = tile_len;
+      if (p.causal) {
+        int64_t row_kv_end = task.kv_len - task.qo_len + task.row_begin + r + 1;
+        visible = std::min(tile_len, row_kv_end - tile_begin);
+      }
+      if (visible <= 0) continue;
+      for (int64_t g = 0; g < group_size; ++g) {
+        int64_t vec = r * group_size + g;
+        const float* q = ws->q.data() + vec * dqk;
+        float* scores = ws->scores.data();
+        float tile_max = -std::numeric_limits<float>::infinity();
+        for (int64_t j = 0; j < visible; ++j) {
+          scores[j] = ops.dot(q, ws->k_ptrs[j], dqk);
+          tile_max = std::max(tile_max, scores[j]);
+        }
+        float m_new = std::max(ws->m[vec], tile_max);
+        float rescale = std::exp2(ws->m[vec] - m_new);
+        float* acc = ws->acc.data() + vec * dv;
+        if (rescale != 1.0f) {
+          for (int64_t i = 0; i < dv; ++i) acc[i] *= rescale;
+        }
+        float l = ws->l[vec] * rescale;
+        for (int64_t j = 0; j < visible; ++j) {
+          float prob = std::exp2(scores[j] - m_new);
+          l += prob;
+          ops.axpy(prob, ws->v_ptrs[j], acc, dv);
+        }
+        ws->m[vec] = m_new;
+        ws->l[vec] = l;
+      }
+    }
+  }
+
+  const int64_t o_elem_bytes = ElemBytes(p.o_kind);
+  for (int64_t r = 0; r < num_rows; ++r) {
+    int64_t token = task.q_base + task.row_begin + r;
+    for (int64_t g = 0; g < group_size; ++g) {
+      int64_t vec = r * group_size + g;
+      int64_t head = task.kv_head * group_size + g;
+      float* acc = ws->acc.data() + vec * dv;
+      float l = ws->l[vec];
+      float inv_l = l > 0.0f ? 1.0f / l : 0.0f;
+      for (int64_t i = 0; i < dv; ++i) acc[i] *= inv_l;
+      StoreRow(p.o_kind, acc, p.output + (token * p.num_qo_heads + head) * dv * o_elem_bytes, dv);
+      p.lse[token * p.num_qo_heads + head] = l > 0.0f ? ws->m[vec] + std::log2(l) : kEmptyLSE;
+    }
+  }
+}
+
+/*! \brief Run the tasks over the thread pool, longest KV first and scheduled dynamically. */
+template <typename KVRows>
+void RunAttnTasks(const AttnProblem& p, std::vector<AttnTask<KVRows>>* tasks) {
+  if (tasks->empty()) return;
+  std::stable_sort(tasks->begin(), tasks->end(),
+                   [](const AttnTask<KVRows>& a, const AttnTask<KVRows>& b) {
+                     return a.kv_len * (a.row_end - a.row_begin) >
+                            b.kv_len * (b.row_end - b.row_begin);
+                   });
+  int64_t num_tasks = static_cast<int64_t>(tasks->size());
+  int64_t num_workers = std::min<int64_t>(std::max(threading::MaxConcurrency(), 1), num_tasks);
+  std::atomic<int64_t> next_task{0};
+  parallel_for_with_threading_backend(
+      [&](int64_t worker) {
+        AttnWorkspace ws;
+        ws.Init(p);
+        for (int64_t i = next_task.fetch_add(1, std::memory_order_relaxed); i < num_tasks;
+             i = next_task.fetch_add(1, std::memory_order_relaxed)) {
+          RunAttnTask(p, (*tasks)[i], &ws);
+        }
+      },
+      0, num_workers);
+}
+
+/*! \brief Append the tasks of one sequence, splitting its query rows into chunks. */
+template <typename KVRows>
+void AddSequenceTasks(const AttnProblem& p, const KVRows& kv, int64_t seq, int64_t q_base,
+                      int64_t qo_len, int64_t kv_len, std::vector<AttnTask<KVRows>>* tasks) {
+  for (int64_t row_begin = 0; row_begin < qo_len; row_begin += kQueryChunk) {
+    int64_t row_end = std::min(row_begin + kQueryChunk, qo_len);
+    for (int64_t h = 0; h < p.num_kv_heads; ++h) {
+      tasks->push_back({kv, seq, h, q_base, qo_len, kv_len, row_begin, row_end});
+    }
+  }
+}
+
+/*! \brief Fill in the problem fields shared by all attention kinds. */
+AttnProblem MakeProblem(const NDArray& q, int64_t num_kv_heads, int64_t v_head_dim,
+                        DLDataType kv_dtype, const NDArray& q_rope_position,
+                        const NDArray& k_rope_pos_offset, bool causal, RoPEMode rope_mode,
+                        const RoPE* rope, double sm_scale, const NDArray& attn_output,
+                        const NDArray& attn_lse) {
+  CheckOnCPU(q, "q");
+  CheckOnCPU(attn_output, "attention output");
+  CHECK_EQ(q->ndim, 3) << "ValueError: The query must be [total_len, num_qo_heads, head_dim]";
+  AttnProblem p;
+  p.num_qo_heads = q->shape[1];
+  p.num_kv_heads = num_kv_heads;
+  p.qk_head_dim = q->shape[2];
+  p.v_head_dim = v_head_dim;
+  CHECK(num_kv_heads > 0 && p.num_qo_heads % num_kv_heads == 0)
+      << "ValueError: The number of query heads " << p.num_qo_heads
+      << " must be a multiple of the number of KV heads " << num_kv_heads;
+  p.q_kind = GetElemKind(q->dtype, "query");
+  p.kv_kind = GetElemKind(kv_dtype, "KV");
+  p.o_kind = GetElemKind(attn_output->dtype, "output");
+  CHECK(attn_output->ndim == 3 && attn_output->shape[0] >= q->shape[0] &&
+        attn_output->shape[1] == p.num_qo_heads && attn_output->shape[2] == v_head_dim)
+      << "ValueError: Mismatched attention output shape " << attn_output.Shape();
+  CHECK(attn_lse.DataType() == DataType::Float(32) && attn_lse->ndim == 2 &&
+        attn_lse->shape[0] >= q->shape[0] && attn_lse->shape[1] == p.num_qo_heads)
+      << "ValueError: The attention LSE must be float32 [total_len, num_qo_heads], but got "
+      << attn_lse.Shape() << " " << DataType(attn_lse->dtype);
+  p.q = DataPtr<const char>(q);
+  p.output = DataPtr<char>(attn_output);
+  p.lse = DataPtr<float>(attn_lse);
+  p.rope = rope_mode == RoPEMode::kInline ? rope : nullptr;
+  if (p.rope != nullptr) {
+    CheckAuxArray(q_rope_position, "q_rope_position");
+    CheckAuxArray(k_rope_pos_offset, "k_rope_pos_offset");
+    p.q_rope_position = DataPtr<const int32_t>(q_rope_position);
+    p.k_rope_pos_offset = DataPtr<const int32_t>(k_rope_pos_offset);
+  } else {
+    p.q_rope_position = nullptr;
+    p.k_rope_pos_offset = nullptr;
+  }
+  p.causal = causal;
+  p.sm_scale = static_cast<float>(sm_scale);
+  return p;
+}
+
+/*! \brief Attention of every query sequence against its pages in the KV cache. */
+void PagedAttention(NDArray q, const int32_t* qo_indptr, int64_t batch_size, NDArray pages,
+                    NDArray page_indptr, NDArray page_indices, NDArray length_info,
+                    NDArray q_rope_position, NDArray k_rope_pos_offset, bool causal,
+                    RoPEMode rope_mode, double rotary_scale, double rotary_theta, double sm_scale,
+                    NDArray attn_output, NDArray attn_lse) {
+  CheckOnCPU(pages, "pages");
+  CHECK_EQ(pages->ndim, 5)
+      << "ValueError: The pages must be [num_pages, 2, num_kv_heads, page_size, head_dim]";
+  CheckAuxArray(page_indptr, "page_indptr");
+  CheckAuxArray(page_indices, "page_indices");
+  CheckAuxArray(length_info, "length_info");
+  const int64_t num_kv_heads = pages->shape[2];
+  const int64_t page_size = pages->shape[3];
+  const int64_t head_dim = pages->shape[4];
+  CHECK_EQ(q->shape[2], head_dim) << "ValueError: Mismatched query and KV head dimensions";
+  // length_info is [batch_size] last page lengths, or with sliding window
+  // [3, batch_size] of last page lengths, sliding window offsets and sink sizes.
+  const bool sliding_window = length_info->ndim == 2;
+  CHECK(sliding_window ? length_info->shape[0] == 3 && length_info->shape[1] >= batch_size
+                       : length_info->shape[0] >= batch_size)
+      << "ValueError: Mismatched length_info shape " << length_info.Shape();
+  const int32_t* lengths = DataPtr<const int32_t>(length_info);
+  const int64_t length_stride = sliding_window ? length_info->shape[1] : 0;
+  const int32_t* page_indptr_data = DataPtr<const int32_t>(page_indptr);
+  const int32_t* page_indices_data = DataPtr<const int32_t>(page_indices);
+
+  RoPE rope(rope_mode == RoPEMode::kInline ? head_dim : 0, rotary_scale, rotary_theta);
+  AttnProblem p = MakeProblem(q, num_kv_heads, head_dim, pages->dtype, q_rope_position,
+                              k_rope_pos_offset, causal, rope_mode, &rope, sm_scale, attn_output,
+                              attn_lse);
+  const char* pages_data = DataPtr<const char>(pages);
+  const int64_t elem_bytes = ElemBytes(p.kv_kind);
+
+  std::vector<AttnTask<PagedKVRows>> tasks;
+  for (int64_t b = 0; b < batch_size; ++b) {
+    int64_t qo_len = qo_indptr[b + 1] - qo_indptr[b];
+    int64_t num_pages = page_indptr_data[b + 1] - page_indptr_data[b];
+    int64_t last_page_len = lengths[b];
+    int64_t sliding_window_offset = sliding_window ? lengths[length_stride + b] : 0;
+    int64_t sink_size = sliding_window ? lengths[2 * length_stride + b] : 0;
+    int64_t kv_len = num_pages == 0 ? 0
+                                    : (num_pages - 1) * page_size + last_page_len -
+                                          sliding_window_offset + sink_size;
+    PagedKVRows kv(pages_data, page_indices_data + page_indptr_data[b], num_kv_heads, page_size,
+                   head_dim, elem_bytes, sliding_window_offset, sink_size);
+    AddSequenceTasks(p, kv, b, qo_indptr[b], qo_len, kv_len, &tasks);
+  }
+  RunAttnTasks(p, &tasks);
+}
+
+}  // namespace
+
+void CPUPagedPrefillFunc::MHA(int depth, NDArray q, NDArray qo_indptr, NDArray pages,
+                              NDArray page_indptr, NDArray page_indices, NDArray length_info,
+                              NDArray q_rope_position, NDArray k_rope_pos_offset, bool causal,
+                              RoPEMode rope_mode, double rotary_scale, double rotary_theta,
+                              double sm_scale, NDArray attn_output, NDArray attn_lse,
+                              TVMStreamHandle compute_stream) {
+  CheckAuxArray(qo_indptr, "qo_indptr");
+  int64_t batch_size = qo_indptr->shape[0] - 1;
+  PagedAttention(q, DataPtr<const int32_t>(qo_indptr), batch_size, pages, page_indptr,
+                 page_indices, length_info, q_rope_position, k_rope_pos_offset, causal, rope_mode,
+                 rotary_scale, rotary_theta, sm_scale, attn_output, attn_lse);
+}
+
+void CPUPagedDecodeFunc::MHA(int depth, NDArray q, NDArray pages, NDArray page_indptr,
+                             NDArray page_indices, NDArray length_info, NDArray k_rope_pos_offset,
+                             NDArray q_rope_position, RoPEMode rope_mode, double rotary_scale,
+                             double rotary_theta, double sm_scale, NDArray attn_output,
+                             NDArray attn_lse, TVMStreamHandle compute_stream) {
+  // Each sequence has exactly one query row, the one at its batch index.
+  int64_t batch_size = page_indptr->shape[0] - 1;
+  std::vector<int32_t> qo_indptr(batch_size + 1);
+  for (int64_t b = 0; b <= batch_size; ++b) qo_indptr[b] = static_cast<int32_t>(b);
+  PagedAttention(q, qo_indptr.data(), batch_size, pages, page_indptr, page_indices, length_info,
+                 q_rope_position, k_rope_pos_offset, /*causal=*/false, rope_mode, rotary_scale,
+                 rotary_theta, sm_scale, attn_output, attn_lse);
+}
+
+void CPURaggedPrefillFunc::MHA(NDArray q, NDArray k, NDArray v, NDArray qo_indptr,
+                               NDArray kv_indptr, NDArray q_rope_position,
+                               NDArray k_rope_pos_offset, bool causal, RoPEMode rope_mode,
+                               double rotary_scale, double rotary_theta, double sm_scale,
+                               NDArray attn_output, NDArray attn_lse,
+                               TVMStreamHandle compute_stream) {
+  CheckOnCPU(k, "k");
+  CheckOnCPU(v, "v");
+  CHECK(k->ndim == 3 && v->ndim == 3 && k->shape[1] == v->shape[1] && k->shape[2] == q->shape[2] &&
+        k.DataType() == v.DataType())
+      << "ValueError: The keys and values must be [total_len, num_kv_heads, head_dim] of the "
+      << "same dtype, but got " << k.Shape() << " " << DataType(k->dtype) << " and "
+      << v.Shape() << " " << DataType(v->dtype);
+  CheckAuxArray(qo_indptr, "qo_indptr");
+  CheckAuxArray(kv_indptr, "kv_indptr");
+  CHECK_EQ(qo_indptr->shape[0], kv_indptr->shape[0])
+      << "ValueError: Mismatched qo_indptr and kv_indptr lengths";
+  const int64_t num_kv_heads = k->shape[1];
+  const int64_t v_head_dim = v->shape[2];
+
+  RoPE rope(rope_mode == RoPEMode::kInline ? q->shape[2] : 0, rotary_scale, rotary_theta);
+  AttnProblem p = MakeProblem(q, num_kv_heads, v_head_dim, k->dtype, q_rope_position,
+                              k_rope_pos_offset, causal, rope_mode, &rope, sm_scale, attn_output,
+                              attn_lse);
+  const int64_t elem_bytes = ElemBytes(p.kv_kind);
+  const int32_t* qo_indptr_data = DataPtr<const int32_t>(qo_indptr);
+  const int32_t* kv_indptr_data = DataPtr<const int32_t>(kv_indptr);
+  const char* k_data = DataPtr<const char>(k);
+  const char* v_data = DataPtr<const char>(v);
+
+  std::vector<AttnTask<RaggedKVRows>> tasks;
+  int64_t batch_size = qo_indptr->shape[0] - 1;
+  for (int64_t b = 0; b < batch_size; ++b) {
+    int64_t kv_begin = kv_indptr_data[b];
+    RaggedKVRows kv(k_data + kv_begin * num_kv_heads * p.qk_head_dim * elem_bytes,
+                    v_data + kv_begin * num_kv_heads * v_head_dim * elem_bytes, num_kv_heads,
+                    p.qk_head_dim, v_head_dim, elem_bytes);
+    AddSequenceTasks(p, kv, b, qo_indptr_data[b], qo_indptr_data[b + 1] - qo_indptr_data[b],
+                     kv_indptr_data[b + 1] - kv_begin, &tasks);
+  }
+  RunAttnTasks(p, &tasks);
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
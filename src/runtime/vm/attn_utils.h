@@ -27,6 +27,7 @@
 #include <tvm/runtime/ndarray.h>
 
 #include <algorithm>
+#include <cstring>
 #include <limits>
 #include <utility>
 #include <vector>
@@ -386,6 +387,13 @@ class HostMemoryVector {
 
   void clear() { current_size_ = 0; }
 
+  /*! \brief Shrink the vector to the given size, keeping its leading elements. */
+  void resize(int64_t new_size) {
+    ICHECK_GE(new_size, 0);
+    ICHECK_LE(new_size, current_size_) << "HostMemoryVector can only be shrunk by resize";
+    current_size_ = new_size;
+  }
+
   /*! \brief Return the vector as an NDArray. */
   NDArray as_ndarray() { return data_.CreateView({current_size_}, data_->dtype); }
 
@@ -1024,6 +1032,110 @@ class CachedPagedKVCacheAuxDataManager : public PagedKVCacheAuxDataManager {
   NDArray merged_compact_kv_aux_data_device_;
 };
 
+/*!
+ * \brief The host auxiliary data manager class, used when the KV cache lives on CPU.
+ * The "device" is the host itself, so it returns views of the host vectors
+ * instead of copying them. Only the arrays which stack several host vectors
+ * are gathered into a staging buffer.
+ */
+class HostPagedKVCacheAuxDataManager : public PagedKVCacheAuxDataManager {
+ public:
+  explicit HostPagedKVCacheAuxDataManager(int64_t reserved_num_seqs, int64_t prefill_chunk_size,
+                                          DLDataType dtype_aux, Device device,
+                                          Device preferred_host_device)
+      : PagedKVCacheAuxDataManager(dtype_aux, device, preferred_host_device,
+                                   /*copy_stream=*/nullptr) {
+    ICHECK_EQ(device.device_type, kDLCPU);
+    for (int d = 0; d < kPagedKVCacheMaxBlockDepth; ++d) {
+      length_info_on_depths_.push_back(NDArray::Empty({3, reserved_num_seqs}, dtype_aux_, device));
+    }
+    commit_copy_src_dst_pos_in_page_table_ =
+        NDArray::Empty({2, std::min(kTreeAttnMaxTreeSize * reserved_num_seqs, prefill_chunk_size)},
+                       dtype_aux_, device);
+  }
+
+  void ResetAttnAuxDataCopy() final {}
+  NDArray CopyQOIndptrOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyPageIndptrOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyPageIndicesOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyLastPageLenOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyKRoPEPosOffsetOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyCurAppendLengthIndptrAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyKRaggedRoPEPosOffsetAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyQRoPEPosMapAsync(HostMemoryVector* data) final { return data->as_ndarray(); }
+  NDArray CopyAppendPositionMapAsync(HostMemoryVector* data) final { return data->as_ndarray(); }
+  NDArray CopyKVTransferRemotePositionMapAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyKVTransferRecverIDAsync(HostMemoryVector* data) final { return data->as_ndarray(); }
+  NDArray CopyKVTransferPage2PageLocalPositionMapAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyKVTransferPage2PageRemotePositionMapAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyKVTransferPage2PageRecverIDAsync(HostMemoryVector* data) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyTreeAttnMaskOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+  NDArray CopyTreeAttnMNIndptrOnDepthAsync(HostMemoryVector* data, int depth) final {
+    return data->as_ndarray();
+  }
+
+  NDArray CopyLengthInfoOnDepthAsync(HostMemoryVector* last_page_len,
+                                     HostMemoryVector* sliding_window_offset,
+                                     HostMemoryVector* sink_size, int depth) final {
+    int64_t n_elem = last_page_len->size();
+    ICHECK_GT(n_elem, 0);
+    ICHECK_LE(n_elem, length_info_on_depths_[depth]->shape[1]);
+    NDArray view = length_info_on_depths_[depth].CreateView({3, n_elem}, dtype_aux_);
+    int32_t* dst = static_cast<int32_t*>(view->data);
+    std::memcpy(dst, last_page_len->data(), n_elem * sizeof(int32_t));
+    std::memcpy(dst + n_elem, sliding_window_offset->data(), n_elem * sizeof(int32_t));
+    std::memcpy(dst + 2 * n_elem, sink_size->data(), n_elem * sizeof(int32_t));
+    return view;
+  }
+
+  void CommitAttnAuxDataCopy() final {}
+
+  void ResetCompactKVAuxDataCopy() final {}
+
+  NDArray CopyCommitLengthIndptrAsync(HostMemoryVector* data) final { return data->as_ndarray(); }
+  NDArray CopyCommitSrcDstPosInPageTableAsync(HostMemoryVector* src_data,
+                                              HostMemoryVector* dst_data) final {
+    int64_t n_elem = src_data->size();
+    ICHECK_GT(n_elem, 0);
+    ICHECK_LE(n_elem, commit_copy_src_dst_pos_in_page_table_->shape[1]);
+    NDArray view = commit_copy_src_dst_pos_in_page_table_.CreateView({2, n_elem}, dtype_aux_);
+    int32_t* dst = static_cast<int32_t*>(view->data);
+    std::memcpy(dst, src_data->data(), n_elem * sizeof(int32_t));
+    std::memcpy(dst + n_elem, dst_data->data(), n_elem * sizeof(int32_t));
+    return view;
+  }
+
+  void CommitCompactKVAuxDataCopy() final {}
+
+ private:
+  std::vector<NDArray> length_info_on_depths_;
+  NDArray commit_copy_src_dst_pos_in_page_table_;
+};
+
 }  // namespace vm
 }  // namespace runtime
 }  // namespace tvm
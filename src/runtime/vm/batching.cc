@@ -0,0 +1,334 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/batching.cc
+ * \brief Dynamic batching of independent requests over a VM function.
+ */
+#include "batching.h"
+
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/trace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <utility>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+/*! \brief The number of bytes of one row along the leading dimension. */
+int64_t RowBytes(const NDArray& arr) {
+  int64_t row_elems = 1;
+  for (int i = 1; i < arr->ndim; ++i) row_elems *= arr->shape[i];
+  return ffi::GetDataSize(row_elems, arr->dtype);
+}
+
+}  // namespace
+
+TVM_REGISTER_OBJECT_TYPE(BatchRequestObj);
+TVM_REGISTER_OBJECT_TYPE(DynamicBatcherObj);
+
+//-------------------------------------------------
+//  BatchRequest
+//-------------------------------------------------
+
+Array<NDArray> BatchRequestObj::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return done_; });
+  if (error_ != nullptr) {
+    std::rethrow_exception(error_);
+  }
+  return outputs_;
+}
+
+bool BatchRequestObj::Ready() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return done_;
+}
+
+void BatchRequestObj::SetOutputs(Array<NDArray> outputs) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_ = std::move(outputs);
+    done_ = true;
+  }
+  cv_.notify_all();
+}
+
+void BatchRequestObj::SetError(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = std::move(error);
+    done_ = true;
+  }
+  cv_.notify_all();
+}
+
+//-------------------------------------------------
+//  DynamicBatcher
+//-------------------------------------------------
+
+struct DynamicBatcherObj::State {
+  ffi::Function func;
+  Array<Any> static_args;
+  int64_t max_batch_size;
+  std::chrono::microseconds timeout;
+  std::vector<int64_t> buckets;
+  std::atomic<int64_t> num_batches{0};
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<BatchRequest> pending;
+  int64_t pending_rows = 0;
+  bool shutdown = false;
+
+  /*! \brief Let the collector thread exit once the pending requests are run. */
+  void RequestShutdown();
+  /*! \brief The main loop of the collector thread. */
+  void CollectorLoop();
+  /*! \brief Run one batch of requests and fulfill them. */
+  void RunBatch(const std::vector<BatchRequest>& batch, int64_t num_rows);
+  /*! \return The padded size of a batch of the given number of rows. */
+  int64_t PaddedBatchSize(int64_t num_rows) const;
+};
+
+DynamicBatcherObj::DynamicBatcherObj(ffi::Function func, Array<Any> static_args,
+                                     int64_t max_batch_size, int64_t timeout_us,
+                                     std::vector<int64_t> buckets)
+    : state_(std::make_shared<State>()) {
+  CHECK(func != nullptr) << "ValueError: The batched function is undefined";
+  CHECK_GT(max_batch_size, 0) << "ValueError: The max batch size must be positive";
+  CHECK_GE(timeout_us, 0) << "ValueError: The batching timeout must not be negative";
+  CHECK(std::is_sorted(buckets.begin(), buckets.end()))
+      << "ValueError: The batch size buckets must be in increasing order";
+  CHECK(buckets.empty() || buckets.back() >= max_batch_size)
+      << "ValueError: The largest batch size bucket " << buckets.back()
+      << " cannot hold a full batch of " << max_batch_size;
+  state_->func = std::move(func);
+  state_->static_args = std::move(static_args);
+  state_->max_batch_size = max_batch_size;
+  state_->timeout = std::chrono::microseconds(timeout_us);
+  state_->buckets = std::move(buckets);
+  // The collector thread co-owns the state, so that it can be detached by the destructor.
+  collector_ = std::thread([state = state_] { state->CollectorLoop(); });
+}
+
+DynamicBatcherObj::~DynamicBatcherObj() {
+  state_->RequestShutdown();
+  if (collector_.joinable()) {
+    collector_.detach();
+  }
+}
+
+BatchRequest DynamicBatcherObj::Submit(Array<NDArray> inputs) {
+  CHECK(!inputs.empty()) << "ValueError: A batched request needs at least one input";
+  int64_t batch_size = -1;
+  for (const NDArray& input : inputs) {
+    CHECK_GE(input->ndim, 1) << "ValueError: Batched inputs need a leading batch dimension";
+    CHECK(batch_size == -1 || input->shape[0] == batch_size)
+        << "ValueError: All inputs of a request must have the same batch size, got "
+        << batch_size << " and " << input->shape[0];
+    batch_size = input->shape[0];
+  }
+  CHECK_GT(batch_size, 0) << "ValueError: The batch size of a request must be positive";
+  CHECK_LE(batch_size, state_->max_batch_size)
+      << "ValueError: The request batch size " << batch_size << " exceeds the max batch size "
+      << state_->max_batch_size;
+
+  ObjectPtr<BatchRequestObj> n = make_object<BatchRequestObj>();
+  n->inputs = std::move(inputs);
+  n->batch_size = batch_size;
+  n->submit_time = std::chrono::steady_clock::now();
+  BatchRequest request(n);
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    CHECK(!state_->shutdown) << "ValueError: Cannot submit requests to a batcher that is shut down";
+    state_->pending.push_back(request);
+    state_->pending_rows += batch_size;
+  }
+  state_->cv.notify_one();
+  return request;
+}
+
+void DynamicBatcherObj::Shutdown() {
+  CHECK(std::this_thread::get_id() != collector_.get_id())
+      << "ValueError: The batched function cannot shut down its own batcher";
+  state_->RequestShutdown();
+  if (collector_.joinable()) {
+    collector_.join();
+  }
+}
+
+int64_t DynamicBatcherObj::NumBatches() const {
+  return state_->num_batches.load(std::memory_order_relaxed);
+}
+
+void DynamicBatcherObj::State::RequestShutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown = true;
+  }
+  cv.notify_one();
+}
+
+int64_t DynamicBatcherObj::State::PaddedBatchSize(int64_t num_rows) const {
+  auto it = std::lower_bound(buckets.begin(), buckets.end(), num_rows);
+  return it == buckets.end() ? num_rows : *it;
+}
+
+void DynamicBatcherObj::State::CollectorLoop() {
+  while (true) {
+    std::vector<BatchRequest> batch;
+    int64_t num_rows = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this] { return shutdown || !pending.empty(); });
+      if (pending.empty()) return;
+      // Wait for the batch to fill up until the oldest request times out.
+      // Pending requests are flushed right away on shutdown.
+      auto deadline = pending.front()->submit_time + timeout;
+      cv.wait_until(lock, deadline, [this] { return shutdown || pending_rows >= max_batch_size; });
+      while (!pending.empty() && num_rows + pending.front()->batch_size <= max_batch_size) {
+        num_rows += pending.front()->batch_size;
+        batch.push_back(std::move(pending.front()));
+        pending.pop_front();
+      }
+      pending_rows -= num_rows;
+    }
+    RunBatch(batch, num_rows);
+  }
+}
+
+void DynamicBatcherObj::State::RunBatch(const std::vector<BatchRequest>& batch, int64_t num_rows) {
+  TVM_TRACE_SCOPE_ARG("batching", "DynamicBatcher::RunBatch", num_rows);
+  try {
+    int64_t padded_rows = PaddedBatchSize(num_rows);
+    const Array<NDArray>& first_inputs = batch[0]->inputs;
+    std::vector<NDArray> batched_inputs;
+    batched_inputs.reserve(first_inputs.size());
+    for (size_t i = 0; i < first_inputs.size(); ++i) {
+      const NDArray& proto = first_inputs[i];
+      std::vector<int64_t> shape(proto->shape, proto->shape + proto->ndim);
+      shape[0] = padded_rows;
+      NDArray batched = NDArray::Empty(ffi::Shape(shape), proto->dtype, proto->device);
+      int64_t row_bytes = RowBytes(proto);
+
+      // Concatenate the inputs of all the requests along the batch dimension.
+      int64_t offset = 0;
+      for (const BatchRequest& request : batch) {
+        CHECK_EQ(request->inputs.size(), first_inputs.size())
+            << "ValueError: Batched requests must have the same number of inputs";
+        const NDArray& input = request->inputs[i];
+        CHECK(input->ndim == proto->ndim && input.DataType() == proto.DataType() &&
+              std::equal(input->shape + 1, input->shape + input->ndim, proto->shape + 1))
+            << "ValueError: Input " << i << " of the batched requests has mismatched "
+            << "shapes or dtypes: " << input.Shape() << " " << input.DataType() << " vs "
+            << proto.Shape() << " " << proto.DataType();
+        batched.CreateView(input.Shape(), input->dtype, offset * row_bytes).CopyFrom(input);
+        offset += input->shape[0];
+      }
+
+      // Zero the padding rows so that padded lanes compute on defined values.
+      if (padded_rows > num_rows) {
+        shape[0] = padded_rows - num_rows;
+        NDArray padding = batched.CreateView(ffi::Shape(shape), proto->dtype, num_rows * row_bytes);
+        size_t padding_bytes = (padded_rows - num_rows) * row_bytes;
+        if (proto->device.device_type == kDLCPU) {
+          std::memset(static_cast<char*>(padding->data) + padding->byte_offset, 0, padding_bytes);
+        } else {
+          NDArray zeros = NDArray::Empty(ffi::Shape(shape), proto->dtype, Device{kDLCPU, 0});
+          std::memset(zeros->data, 0, padding_bytes);
+          padding.CopyFrom(zeros);
+        }
+      }
+      batched_inputs.push_back(std::move(batched));
+    }
+
+    std::vector<ffi::AnyView> args;
+    args.reserve(batched_inputs.size() + static_args.size());
+    for (const NDArray& input : batched_inputs) args.push_back(input);
+    for (const Any& arg : static_args) args.push_back(arg);
+    ffi::Any rv;
+    func.CallPacked(args.data(), static_cast<int32_t>(args.size()), &rv);
+
+    Array<NDArray> outputs;
+    if (auto opt_output = rv.as<NDArray>()) {
+      outputs.push_back(opt_output.value());
+    } else {
+      outputs = rv.cast<Array<NDArray>>();
+    }
+
+    // Split the outputs back into views for each request.
+    std::vector<Array<NDArray>> request_outputs(batch.size());
+    for (const NDArray& output : outputs) {
+      CHECK(output->ndim >= 1 && output->shape[0] == padded_rows)
+          << "ValueError: Batched outputs must have the padded batch size " << padded_rows
+          << " as the leading dimension, but got shape " << output.Shape();
+      std::vector<int64_t> shape(output->shape, output->shape + output->ndim);
+      int64_t row_bytes = RowBytes(output);
+      int64_t offset = 0;
+      for (size_t j = 0; j < batch.size(); ++j) {
+        shape[0] = batch[j]->batch_size;
+        request_outputs[j].push_back(
+            output.CreateView(ffi::Shape(shape), output->dtype, offset * row_bytes));
+        offset += batch[j]->batch_size;
+      }
+    }
+    num_batches.fetch_add(1, std::memory_order_relaxed);
+    for (size_t j = 0; j < batch.size(); ++j) {
+      batch[j]->SetOutputs(std::move(request_outputs[j]));
+    }
+  } catch (...) {
+    std::exception_ptr error = std::current_exception();
+    for (const BatchRequest& request : batch) {
+      request->SetError(error);
+    }
+  }
+}
+
+//-------------------------------------------------
+//  Register runtime functions
+//-------------------------------------------------
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.dynamic_batcher_create")
+    .set_body_typed([](ffi::Function func, Array<Any> static_args, int64_t max_batch_size,
+                       int64_t timeout_us, ffi::Shape buckets) {
+      ObjectPtr<DynamicBatcherObj> n = make_object<DynamicBatcherObj>(
+          std::move(func), std::move(static_args), max_batch_size, timeout_us,
+          std::vector<int64_t>(buckets.begin(), buckets.end()));
+      return DynamicBatcher(n);
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.dynamic_batcher_submit")
+    .set_body_method(&DynamicBatcherObj::Submit);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.dynamic_batcher_shutdown")
+    .set_body_method(&DynamicBatcherObj::Shutdown);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.dynamic_batcher_num_batches")
+    .set_body_method(&DynamicBatcherObj::NumBatches);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.batch_request_wait").set_body_method(&BatchRequestObj::Wait);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.batch_request_ready").set_body_method(&BatchRequestObj::Ready);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
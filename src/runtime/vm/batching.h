@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/batching.h
+ * \brief Dynamic batching of independent requests over a VM function.
+ *
+ *  Callers submit requests whose inputs carry a leading batch dimension. A
+ *  collector thread groups pending requests until the batch is full or the
+ *  oldest request has waited for the timeout, concatenates the inputs along
+ *  the batch dimension, pads the batch up to the next shape bucket and calls
+ *  the function once. The function is expected to be compiled with a symbolic
+ *  batch dimension, so that every bucket runs the same compiled code. Each
+ *  output is then split back along the batch dimension into views which are
+ *  handed to the requests.
+ */
+#ifndef TVM_RUNTIME_VM_BATCHING_H_
+#define TVM_RUNTIME_VM_BATCHING_H_
+
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/object.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*! \brief A single request submitted to a DynamicBatcher, which acts as its future. */
+class BatchRequestObj : public Object {
+ public:
+  /*! \brief The inputs of the request, each with the same leading batch dimension. */
+  Array<NDArray> inputs;
+  /*! \brief The size of the leading batch dimension of the inputs. */
+  int64_t batch_size;
+  /*! \brief The time the request was submitted. */
+  std::chrono::steady_clock::time_point submit_time;
+
+  /*! \brief Block until the request finishes and return its outputs. */
+  Array<NDArray> Wait();
+
+  /*! \return Whether the request has finished. */
+  bool Ready();
+
+  /*! \brief Fulfill the request. */
+  void SetOutputs(Array<NDArray> outputs);
+
+  /*! \brief Fail the request, Wait rethrows the error. */
+  void SetError(std::exception_ptr error);
+
+  static constexpr const char* _type_key = "relax.vm.BatchRequest";
+  TVM_DECLARE_FINAL_OBJECT_INFO(BatchRequestObj, Object);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool done_ = false;
+  Array<NDArray> outputs_;
+  std::exception_ptr error_;
+};
+
+class BatchRequest : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(BatchRequest, ObjectRef, BatchRequestObj);
+};
+
+/*!
+ * \brief Collects requests into batches and runs them through a single function.
+ *
+ *  Threading: Submit may be called from any thread, but the function runs on the collector
+ *  thread, one batch at a time. A function wrapping a VM, e.g. `vm["main"]`, therefore takes
+ *  the VM over: the VM and its module must not be used from other threads while the batcher
+ *  is running, since the VM is not thread-safe.
+ *
+ *  Shutdown stops the batcher and waits for the collector thread, so it must not be called
+ *  with a lock the function needs, e.g. the Python GIL held by a Python function. The
+ *  destructor does not wait: the last reference may be dropped under such a lock. It only
+ *  stops the batcher, and the detached collector thread finishes the pending requests on its
+ *  own. Call Shutdown explicitly to know when the function is no longer used.
+ */
+class DynamicBatcherObj : public Object {
+ public:
+  /*!
+   * \brief Create a batcher and start its collector thread.
+   * \param func The function to batch over. It takes the batched inputs followed by
+   *  `static_args` and returns an NDArray or an array of NDArrays whose leading
+   *  dimension is the padded batch size. It is called on the collector thread.
+   * \param static_args The arguments appended after the batched inputs on every call.
+   * \param max_batch_size The maximum number of rows in a batch.
+   * \param timeout_us The longest time the oldest pending request waits for the
+   *  batch to fill up, in microseconds.
+   * \param buckets The padded batch sizes in increasing order. A batch is padded to
+   *  the smallest bucket that fits it, or not padded if the list is empty.
+   */
+  DynamicBatcherObj(ffi::Function func, Array<Any> static_args, int64_t max_batch_size,
+                    int64_t timeout_us, std::vector<int64_t> buckets);
+
+  /*! \brief Stop the batcher without waiting for the collector thread. */
+  ~DynamicBatcherObj();
+
+  /*!
+   * \brief Enqueue a request.
+   * \param inputs The inputs of the request, which share the leading batch dimension.
+   * \return The request, whose Wait method returns the outputs.
+   */
+  BatchRequest Submit(Array<NDArray> inputs);
+
+  /*! \brief Stop the collector thread after running the pending requests, and wait for it. */
+  void Shutdown();
+
+  /*! \return The number of batches run so far. */
+  int64_t NumBatches() const;
+
+  static constexpr const char* _type_key = "relax.vm.DynamicBatcher";
+  TVM_DECLARE_FINAL_OBJECT_INFO(DynamicBatcherObj, Object);
+
+ private:
+  /*! \brief The state of the batcher, shared with the collector thread which may outlive it. */
+  struct State;
+
+  std::shared_ptr<State> state_;
+  std::thread collector_;
+};
+
+class DynamicBatcher : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(DynamicBatcher, ObjectRef, DynamicBatcherObj);
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_BATCHING_H_
@@ -0,0 +1,262 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/byte_plane_codec.h
+ * \brief A lossless codec for arrays of floating point numbers such as KV data.
+ *
+ * The bytes of the elements are split into byte planes, and each plane is coded
+ * on its own with a length-limited canonical Huffman code. The plane holding the
+ * sign and the exponent has few distinct values and compresses well, while the
+ * mantissa planes fall back to being stored as is.
+ */
+#ifndef TVM_RUNTIME_VM_BYTE_PLANE_CODEC_H_
+#define TVM_RUNTIME_VM_BYTE_PLANE_CODEC_H_
+
+#include <tvm/runtime/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace byte_plane_codec {
+
+/*! \brief The coding mode of one byte plane. */
+enum PlaneMode : uint8_t {
+  kRaw = 0,
+  kConstant = 1,
+  kHuffman = 2,
+};
+
+/*! \brief The maximum Huffman code length, which also sizes the decoding table. */
+constexpr int kMaxCodeLength = 12;
+
+/*!
+ * \brief Compute the Huffman code lengths of the byte frequencies, limited to
+ * kMaxCodeLength. The frequencies are flattened until the code fits in the limit.
+ */
+inline std::array<uint8_t, 256> CodeLengths(std::array<uint64_t, 256> freq) {
+  std::array<uint8_t, 256> lengths;
+  while (true) {
+    lengths.fill(0);
+    using Node = std::pair<uint64_t, int32_t>;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+    // Nodes [0, 256) are the symbols, and the merged nodes follow.
+    std::vector<int32_t> parent(256, -1);
+    for (int32_t s = 0; s < 256; ++s) {
+      if (freq[s] > 0) heap.push({freq[s], s});
+    }
+    while (heap.size() > 1) {
+      Node a = heap.top();
+      heap.pop();
+      Node b = heap.top();
+      heap.pop();
+      int32_t merged = parent.size();
+      parent.push_back(-1);
+      parent[a.second] = merged;
+      parent[b.second] = merged;
+      heap.push({a.first + b.first, merged});
+    }
+    int max_length = 0;
+    for (int32_t s = 0; s < 256; ++s) {
+      if (freq[s] == 0) continue;
+      int length = 0;
+      for (int32_t node = s; parent[node] != -1; node = parent[node]) ++length;
+      lengths[s] = length;
+      max_length = std::max(max_length, length);
+    }
+    if (max_length <= kMaxCodeLength) return lengths;
+    for (uint64_t& f : freq) {
+      if (f > 0) f = (f >> 1) | 1;
+    }
+  }
+}
+
+/*! \brief Assign the canonical codes of the code lengths, ordered by (length, symbol). */
+inline std::array<uint16_t, 256> CanonicalCodes(const std::array<uint8_t, 256>& lengths) {
+  std::array<uint16_t, 256> codes;
+  codes.fill(0);
+  uint32_t code = 0;
+  for (int length = 1; length <= kMaxCodeLength; ++length) {
+    for (int s = 0; s < 256; ++s) {
+      if (lengths[s] == length) codes[s] = code++;
+    }
+    code <<= 1;
+  }
+  return codes;
+}
+
+/*! \brief Append a plain value to the output bytes. */
+template <typename T>
+inline void Put(std::vector<uint8_t>* out, T value) {
+  size_t offset = out->size();
+  out->resize(offset + sizeof(T));
+  std::memcpy(out->data() + offset, &value, sizeof(T));
+}
+
+/*! \brief Encode one byte plane of `n` bytes with the given stride. */
+inline void EncodePlane(const uint8_t* plane, int64_t n, int64_t stride,
+                        std::vector<uint8_t>* out) {
+  std::array<uint64_t, 256> freq;
+  freq.fill(0);
+  for (int64_t i = 0; i < n; ++i) ++freq[plane[i * stride]];
+  int num_symbols = 256 - std::count(freq.begin(), freq.end(), 0);
+  if (num_symbols <= 1) {
+    out->push_back(kConstant);
+    out->push_back(n == 0 ? 0 : plane[0]);
+    return;
+  }
+
+  std::array<uint8_t, 256> lengths = CodeLengths(freq);
+  uint64_t num_bits = 0;
+  for (int s = 0; s < 256; ++s) num_bits += freq[s] * lengths[s];
+  // The code lengths table takes 128 bytes, and the bitstream size 8 bytes.
+  if (static_cast<int64_t>((num_bits + 7) / 8) + 136 >= n) {
+    out->push_back(kRaw);
+    size_t offset = out->size();
+    out->resize(offset + n);
+    for (int64_t i = 0; i < n; ++i) (*out)[offset + i] = plane[i * stride];
+    return;
+  }
+
+  std::array<uint16_t, 256> codes = CanonicalCodes(lengths);
+  out->push_back(kHuffman);
+  for (int s = 0; s < 256; s += 2) out->push_back(lengths[s] | (lengths[s + 1] << 4));
+  uint64_t num_bytes = (num_bits + 7) / 8;
+  Put<uint64_t>(out, num_bytes);
+  size_t offset = out->size();
+  out->resize(offset + num_bytes);
+  uint8_t* dst = out->data() + offset;
+  uint64_t acc = 0;
+  int acc_bits = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    uint8_t symbol = plane[i * stride];
+    acc = (acc << lengths[symbol]) | codes[symbol];
+    acc_bits += lengths[symbol];
+    while (acc_bits >= 8) {
+      acc_bits -= 8;
+      *dst++ = static_cast<uint8_t>(acc >> acc_bits);
+    }
+  }
+  if (acc_bits > 0) *dst++ = static_cast<uint8_t>(acc << (8 - acc_bits));
+  ICHECK(dst == out->data() + out->size());
+}
+
+/*!
+ * \brief Decode one byte plane of `n` bytes with the given stride.
+ * \return The number of input bytes consumed.
+ */
+inline int64_t DecodePlane(const uint8_t* in, int64_t in_size, int64_t n, int64_t stride,
+                           uint8_t* plane) {
+  CHECK_GE(in_size, 1) << "ValueError: The byte plane data is truncated.";
+  if (in[0] == kConstant) {
+    CHECK_GE(in_size, 2) << "ValueError: The byte plane data is truncated.";
+    for (int64_t i = 0; i < n; ++i) plane[i * stride] = in[1];
+    return 2;
+  }
+  if (in[0] == kRaw) {
+    CHECK_GE(in_size, 1 + n) << "ValueError: The byte plane data is truncated.";
+    for (int64_t i = 0; i < n; ++i) plane[i * stride] = in[1 + i];
+    return 1 + n;
+  }
+  CHECK_EQ(in[0], kHuffman) << "ValueError: Unknown byte plane mode " << static_cast<int>(in[0]);
+  CHECK_GE(in_size, 137) << "ValueError: The byte plane data is truncated.";
+  std::array<uint8_t, 256> lengths;
+  for (int s = 0; s < 256; s += 2) {
+    lengths[s] = in[1 + s / 2] & 15;
+    lengths[s + 1] = in[1 + s / 2] >> 4;
+  }
+  uint64_t num_bytes;
+  std::memcpy(&num_bytes, in + 129, sizeof(uint64_t));
+  CHECK_LE(num_bytes, static_cast<uint64_t>(in_size - 137))
+      << "ValueError: The byte plane data is truncated.";
+  const uint8_t* src = in + 137;
+  const uint8_t* src_end = src + num_bytes;
+
+  // Each entry of the table holds the symbol and the code length of a 12-bit prefix.
+  std::array<uint16_t, 256> codes = CanonicalCodes(lengths);
+  std::vector<uint16_t> table(1 << kMaxCodeLength, 0);
+  for (int s = 0; s < 256; ++s) {
+    if (lengths[s] == 0) continue;
+    CHECK_LE(lengths[s], kMaxCodeLength) << "ValueError: Invalid Huffman code length.";
+    int shift = kMaxCodeLength - lengths[s];
+    uint32_t begin = static_cast<uint32_t>(codes[s]) << shift;
+    CHECK_LE(begin + (1u << shift), table.size()) << "ValueError: Invalid Huffman code lengths.";
+    std::fill(table.begin() + begin, table.begin() + begin + (1 << shift),
+              static_cast<uint16_t>(s | (lengths[s] << 8)));
+  }
+  uint64_t acc = 0;
+  int acc_bits = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    while (acc_bits < kMaxCodeLength) {
+      acc = (acc << 8) | (src < src_end ? *src++ : 0);
+      acc_bits += 8;
+    }
+    uint16_t entry = table[(acc >> (acc_bits - kMaxCodeLength)) & ((1 << kMaxCodeLength) - 1)];
+    CHECK_NE(entry >> 8, 0) << "ValueError: Invalid Huffman code in the byte plane data.";
+    plane[i * stride] = entry & 255;
+    acc_bits -= entry >> 8;
+  }
+  return 137 + num_bytes;
+}
+
+}  // namespace byte_plane_codec
+
+/*!
+ * \brief Encode `num_elems` elements of `elem_bytes` bytes each, appending the coded
+ * bytes to `out`. Each byte plane is coded on its own.
+ */
+inline void EncodeBytePlanes(const void* data, int64_t num_elems, int elem_bytes,
+                             std::vector<uint8_t>* out) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (int p = 0; p < elem_bytes; ++p) {
+    byte_plane_codec::EncodePlane(bytes + p, num_elems, elem_bytes, out);
+  }
+}
+
+/*!
+ * \brief Decode `num_elems` elements of `elem_bytes` bytes each from the coded bytes.
+ * \return The number of coded bytes consumed.
+ * \throws Error if the coded bytes are truncated or malformed.
+ */
+inline int64_t DecodeBytePlanes(const uint8_t* in, int64_t in_size, int64_t num_elems,
+                                int elem_bytes, void* data) {
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  int64_t consumed = 0;
+  for (int p = 0; p < elem_bytes; ++p) {
+    consumed += byte_plane_codec::DecodePlane(in + consumed, in_size - consumed, num_elems,
+                                              elem_bytes, bytes + p);
+  }
+  return consumed;
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_BYTE_PLANE_CODEC_H_
@@ -0,0 +1,343 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/chunked_prefill_scheduler.cc
+ * \brief Request scheduling with chunked prefill and decode piggybacking over the KVState API.
+ */
+#include "chunked_prefill_scheduler.h"
+
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/trace.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+/*! \brief The number of available pages reported for KV states without paging. */
+constexpr int64_t kUnlimitedPages = int64_t(1) << 40;
+
+int64_t CeilDiv(int64_t a, int64_t b) { return (a + b - 1) / b; }
+
+/*! \brief The nearest-rank percentile of the samples, or 0 without samples. */
+double Percentile(std::vector<double> samples, double p) {
+  if (samples.empty()) return 0.0;
+  std::sort(samples.begin(), samples.end());
+  int64_t rank = CeilDiv(static_cast<int64_t>(p * samples.size()), 100);
+  return samples[std::max<int64_t>(rank, 1) - 1];
+}
+
+}  // namespace
+
+TVM_REGISTER_OBJECT_TYPE(ChunkedPrefillSchedulerObj);
+
+ChunkedPrefillSchedulerObj::ChunkedPrefillSchedulerObj(
+    ffi::Function f_forward, KVState state, Array<Any> args, int64_t token_budget,
+    int64_t max_num_seqs, int64_t page_size, PreemptionMode preemption_mode,
+    ffi::Function f_swap_out, ffi::Function f_swap_in)
+    : f_forward_(std::move(f_forward)),
+      state_(std::move(state)),
+      args_(std::move(args)),
+      token_budget_(token_budget),
+      max_num_seqs_(max_num_seqs),
+      page_size_(page_size),
+      preemption_mode_(preemption_mode),
+      f_swap_out_(std::move(f_swap_out)),
+      f_swap_in_(std::move(f_swap_in)) {
+  CHECK(f_forward_ != nullptr) << "ValueError: The forward function must be defined";
+  CHECK(state_.defined()) << "ValueError: The KV state must be defined";
+  CHECK_GE(max_num_seqs_, 1) << "ValueError: The maximum number of sequences must be positive";
+  CHECK_GE(token_budget_, max_num_seqs_)
+      << "ValueError: The token budget " << token_budget_
+      << " must be at least the maximum number of sequences " << max_num_seqs_;
+  CHECK_GE(page_size_, 1) << "ValueError: The page size must be positive";
+  CHECK(preemption_mode_ != PreemptionMode::kSwap ||
+        (f_swap_out_ != nullptr && f_swap_in_ != nullptr))
+      << "ValueError: Preemption by swapping requires the swap out and swap in functions";
+}
+
+void ChunkedPrefillSchedulerObj::AddRequest(int64_t request_id, IntTuple prompt,
+                                            int64_t max_new_tokens) {
+  CHECK(!requests_.count(request_id))
+      << "ValueError: The request id " << request_id << " is already in use";
+  CHECK(!prompt.empty()) << "ValueError: The prompt of request " << request_id << " is empty";
+  CHECK_GE(max_new_tokens, 1) << "ValueError: A request must generate at least one token";
+  auto request = std::make_unique<Request>();
+  request->id = request_id;
+  request->tokens.assign(prompt.begin(), prompt.end());
+  request->prompt_length = static_cast<int64_t>(prompt.size());
+  request->max_new_tokens = max_new_tokens;
+  request->arrival_time = Clock::now();
+  waiting_.push_back(request.get());
+  requests_.emplace(request_id, std::move(request));
+}
+
+int64_t ChunkedPrefillSchedulerObj::NumAvailablePages() const {
+  if (const auto* cache = state_.as<AttentionKVCacheObj>()) {
+    return cache->GetNumAvailablePages();
+  }
+  return kUnlimitedPages;
+}
+
+int64_t ChunkedPrefillSchedulerObj::PagesToAppend(const Request& request, int64_t n) const {
+  return CeilDiv(request.num_computed + n, page_size_) - CeilDiv(request.num_computed, page_size_);
+}
+
+int64_t ChunkedPrefillSchedulerObj::MaxChunkInPages(const Request& request,
+                                                    int64_t num_pages) const {
+  if (num_pages < 0) return 0;
+  return (CeilDiv(request.num_computed, page_size_) + num_pages) * page_size_ -
+         request.num_computed;
+}
+
+void ChunkedPrefillSchedulerObj::Admit(Request* request) {
+  state_->AddSequence(request->id);
+  if (request->swapped) {
+    f_swap_in_(state_, request->id, request->swap_handle);
+    request->swap_handle = Any();
+    request->swapped = false;
+  }
+  running_.push_back(request);
+}
+
+void ChunkedPrefillSchedulerObj::PreemptLast() {
+  Request* request = running_.back();
+  running_.pop_back();
+  if (preemption_mode_ == PreemptionMode::kSwap) {
+    request->swap_handle = f_swap_out_(state_, request->id);
+    request->swapped = true;
+  } else {
+    request->num_computed = 0;
+  }
+  state_->RemoveSequence(request->id);
+  waiting_.push_front(request);
+  ++num_preemptions_;
+}
+
+Array<IntTuple> ChunkedPrefillSchedulerObj::Step() {
+  TVM_TRACE_SCOPE("scheduler", "Step");
+  if (!HasUnfinishedRequests()) return {};
+
+  // Preempt the latest admitted requests until the decodes of the others fit.
+  while (true) {
+    int64_t num_decode_pages = 0;
+    for (const Request* request : running_) {
+      if (request->IsDecoding()) num_decode_pages += PagesToAppend(*request, 1);
+    }
+    if (num_decode_pages <= NumAvailablePages()) break;
+    CHECK_GT(running_.size(), 1)
+        << "ValueError: The KV cache is too small to decode request " << running_[0]->id;
+    PreemptLast();
+  }
+
+  std::vector<std::pair<Request*, int64_t>> chunks;
+  int64_t budget = token_budget_;
+  int64_t num_pages = NumAvailablePages();
+  auto f_schedule = [&](Request* request, int64_t length) {
+    chunks.emplace_back(request, length);
+    budget -= length;
+    num_pages -= PagesToAppend(*request, length);
+  };
+  for (Request* request : running_) {
+    if (request->IsDecoding()) f_schedule(request, 1);
+  }
+  // Piggyback the prefill chunks of the running requests onto the decodes.
+  for (Request* request : running_) {
+    if (request->IsDecoding()) continue;
+    int64_t length =
+        std::min({request->NumRemaining(), budget, MaxChunkInPages(*request, num_pages)});
+    if (length <= 0) break;
+    f_schedule(request, length);
+  }
+  // Admit the waiting requests in order while they fit.
+  while (!waiting_.empty() && budget > 0 &&
+         static_cast<int64_t>(running_.size()) < max_num_seqs_) {
+    Request* request = waiting_.front();
+    int64_t swap_in_pages = request->swapped ? CeilDiv(request->num_computed, page_size_) : 0;
+    int64_t length = std::min({request->NumRemaining(), budget,
+                               MaxChunkInPages(*request, num_pages - swap_in_pages)});
+    if (length <= 0) break;
+    waiting_.pop_front();
+    Admit(request);
+    num_pages -= swap_in_pages;
+    f_schedule(request, length);
+  }
+  if (chunks.empty()) {
+    // Nothing is decoding, so the first running prompt, or else the first waiting one, cannot
+    // get a chunk in the whole cache.
+    CHECK(running_.empty()) << "ValueError: The KV cache is too small to prefill request "
+                            << running_.front()->id;
+    CHECK(waiting_.empty()) << "ValueError: The KV cache is too small to admit request "
+                            << waiting_.front()->id;
+    LOG(FATAL) << "ValueError: Cannot schedule the unfinished requests with max_num_seqs "
+               << max_num_seqs_;
+  }
+
+  // Run the forward.
+  std::vector<int64_t> seq_ids;
+  std::vector<int64_t> lengths;
+  std::vector<int32_t> tokens;
+  for (const auto& [request, length] : chunks) {
+    seq_ids.push_back(request->id);
+    lengths.push_back(length);
+    tokens.insert(tokens.end(), request->tokens.begin() + request->num_computed,
+                  request->tokens.begin() + request->num_computed + length);
+  }
+  int64_t num_tokens = static_cast<int64_t>(tokens.size());
+  int64_t num_seqs = static_cast<int64_t>(chunks.size());
+  state_->BeginForward(IntTuple(seq_ids), IntTuple(lengths), Optional<IntTuple>());
+  NDArray token_ids = NDArray::Empty({num_tokens}, DataType::Int(32), Device{kDLCPU, 0});
+  std::memcpy(token_ids->data, tokens.data(), num_tokens * sizeof(int32_t));
+  std::vector<ffi::AnyView> call_args;
+  call_args.reserve(args_.size() + 2);
+  call_args.push_back(token_ids);
+  call_args.push_back(state_);
+  for (const Any& arg : args_) call_args.push_back(arg);
+  ffi::Any rv;
+  f_forward_.CallPacked(call_args.data(), static_cast<int32_t>(call_args.size()), &rv);
+  state_->EndForward();
+
+  NDArray logits = rv.cast<NDArray>();
+  if (logits->ndim == 3 && logits->shape[0] == 1) {
+    logits = logits.CreateView({logits->shape[1], logits->shape[2]}, logits->dtype);
+  }
+  CHECK(logits->ndim == 2 && (logits->shape[0] == num_tokens || logits->shape[0] == num_seqs))
+      << "ValueError: The model is expected to return the logits of the " << num_tokens
+      << " input tokens or of the last token of the " << num_seqs
+      << " sequences, but got shape " << logits.Shape();
+  CHECK(logits.DataType() == DataType::Float(32))
+      << "ValueError: The model is expected to return float32 logits, but got "
+      << logits.DataType();
+  if (logits->device.device_type != kDLCPU) {
+    logits = logits.CopyTo(Device{kDLCPU, 0});
+  }
+  bool per_token_logits = logits->shape[0] == num_tokens;
+  const float* logits_data =
+      reinterpret_cast<const float*>(static_cast<const char*>(logits->data) + logits->byte_offset);
+  int64_t vocab_size = logits->shape[1];
+
+  // Sample the requests whose chunk reaches the end of their tokens.
+  Clock::time_point now = Clock::now();
+  Array<IntTuple> outputs;
+  int64_t offset = 0;
+  for (int64_t i = 0; i < num_seqs; ++i) {
+    auto [request, length] = chunks[i];
+    offset += length;
+    if (request->IsDecoding()) {
+      num_decode_tokens_ += length;
+    } else {
+      num_prefill_tokens_ += length;
+    }
+    request->num_computed += length;
+    if (request->NumRemaining() > 0) continue;
+
+    const float* row = logits_data + (per_token_logits ? offset - 1 : i) * vocab_size;
+    int32_t token = static_cast<int32_t>(std::max_element(row, row + vocab_size) - row);
+    double since = std::chrono::duration<double>(
+                       now - (request->NumGenerated() == 0 ? request->arrival_time
+                                                           : request->last_token_time))
+                       .count();
+    (request->NumGenerated() == 0 ? ttft_ : itl_).push_back(since);
+    request->tokens.push_back(token);
+    request->last_token_time = now;
+    outputs.push_back(IntTuple({request->id, token}));
+    if (request->NumGenerated() == request->max_new_tokens) {
+      request->finished = true;
+      state_->RemoveSequence(request->id);
+      running_.erase(std::find(running_.begin(), running_.end(), request));
+    }
+  }
+  ++num_steps_;
+  return outputs;
+}
+
+IntTuple ChunkedPrefillSchedulerObj::PopOutput(int64_t request_id) {
+  auto it = requests_.find(request_id);
+  CHECK(it != requests_.end()) << "ValueError: Unknown request id " << request_id;
+  const Request& request = *it->second;
+  IntTuple output(request.tokens.begin() + request.prompt_length, request.tokens.end());
+  if (request.finished) requests_.erase(it);
+  return output;
+}
+
+Map<String, Any> ChunkedPrefillSchedulerObj::Stats() const {
+  Map<String, Any> stats;
+  stats.Set("num_steps", num_steps_);
+  stats.Set("num_preemptions", num_preemptions_);
+  stats.Set("num_prefill_tokens", num_prefill_tokens_);
+  stats.Set("num_decode_tokens", num_decode_tokens_);
+  for (double p : {50.0, 90.0, 99.0}) {
+    std::string suffix = "_p" + std::to_string(static_cast<int>(p));
+    stats.Set("ttft" + suffix, Percentile(ttft_, p));
+    stats.Set("itl" + suffix, Percentile(itl_, p));
+  }
+  return stats;
+}
+
+void ChunkedPrefillSchedulerObj::ResetStats() {
+  num_steps_ = 0;
+  num_preemptions_ = 0;
+  num_prefill_tokens_ = 0;
+  num_decode_tokens_ = 0;
+  ttft_.clear();
+  itl_.clear();
+}
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_create")
+    .set_body_typed([](ffi::Function f_forward, KVState state, Array<Any> args,
+                       int64_t token_budget, int64_t max_num_seqs, int64_t page_size,
+                       String preemption_mode, Optional<ffi::Function> f_swap_out,
+                       Optional<ffi::Function> f_swap_in) {
+      PreemptionMode mode;
+      if (preemption_mode == "recompute") {
+        mode = PreemptionMode::kRecompute;
+      } else if (preemption_mode == "swap") {
+        mode = PreemptionMode::kSwap;
+      } else {
+        LOG(FATAL) << "ValueError: Unknown preemption mode \"" << preemption_mode
+                   << "\", expected \"recompute\" or \"swap\"";
+      }
+      ObjectPtr<ChunkedPrefillSchedulerObj> n = make_object<ChunkedPrefillSchedulerObj>(
+          std::move(f_forward), std::move(state), std::move(args), token_budget, max_num_seqs,
+          page_size, mode, f_swap_out.value_or(ffi::Function()),
+          f_swap_in.value_or(ffi::Function()));
+      return ChunkedPrefillScheduler(n);
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_add_request")
+    .set_body_method(&ChunkedPrefillSchedulerObj::AddRequest);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_step")
+    .set_body_method(&ChunkedPrefillSchedulerObj::Step);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_has_unfinished_requests")
+    .set_body_method(&ChunkedPrefillSchedulerObj::HasUnfinishedRequests);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_pop_output")
+    .set_body_method(&ChunkedPrefillSchedulerObj::PopOutput);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_stats")
+    .set_body_method(&ChunkedPrefillSchedulerObj::Stats);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.chunked_prefill_scheduler_reset_stats")
+    .set_body_method(&ChunkedPrefillSchedulerObj::ResetStats);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/chunked_prefill_scheduler.h
+ * \brief Request scheduling with chunked prefill and decode piggybacking over the KVState API.
+ *
+ *  Every step runs a single forward whose number of tokens is bounded by a token
+ *  budget. The running requests which are decoding are scheduled first, one token
+ *  each, and the rest of the budget is filled with prefill chunks: first the
+ *  remaining prompts of the running requests, then the prompts of the waiting
+ *  requests in arrival order. A long prompt is therefore split over several steps,
+ *  and the ongoing decodes keep generating a token per step meanwhile.
+ *
+ *  When the KV state is an attention KV cache, a chunk is only scheduled if the
+ *  pages it needs are available according to GetNumAvailablePages. When the
+ *  decodes do not fit, the most recently admitted running request is preempted,
+ *  either by dropping its KV data and recomputing it later as a prefill of the
+ *  prompt and the tokens generated so far, or by swapping it out through a pair
+ *  of user functions.
+ *
+ *  The model is a function `f(token_ids, kv_state, *args) -> logits`, where
+ *  `token_ids` is an int32 [n] array on CPU with the tokens of all the sequences
+ *  of the forward concatenated, and `logits` is a float32 array of shape [n, vocab_size]
+ *  or [num_sequences, vocab_size] (the logits of the last token of each sequence),
+ *  optionally with a leading dimension of 1. Tokens are sampled greedily.
+ */
+#ifndef TVM_RUNTIME_VM_CHUNKED_PREFILL_SCHEDULER_H_
+#define TVM_RUNTIME_VM_CHUNKED_PREFILL_SCHEDULER_H_
+
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/container/map.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/object.h>
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "kv_state.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*! \brief How the scheduler frees the KV cache of a preempted request. */
+enum class PreemptionMode : int {
+  /*! \brief Drop the KV data and prefill the prompt and the generated tokens again. */
+  kRecompute = 0,
+  /*! \brief Save the KV data with `f_swap_out` and restore it with `f_swap_in`. */
+  kSwap = 1,
+};
+
+/*! \brief Schedules generation requests over a KVState-based model. */
+class ChunkedPrefillSchedulerObj : public Object {
+ public:
+  /*!
+   * \brief Create a scheduler.
+   * \param f_forward The forward function of the model.
+   * \param state The KV state of the model. The request ids are used as its sequence ids.
+   * \param args The arguments appended after the KV state when calling `f_forward`.
+   * \param token_budget The maximum number of tokens of a forward.
+   * \param max_num_seqs The maximum number of running requests. It cannot exceed the token
+   *  budget, so that every running request can decode in each step.
+   * \param page_size The page size of the KV cache, used to compute the pages a chunk needs.
+   * \param preemption_mode The preemption mode.
+   * \param f_swap_out The function `f(kv_state, seq_id) -> handle` saving the KV data of a
+   *  sequence before it is removed, required by the swap mode.
+   * \param f_swap_in The function `f(kv_state, seq_id, handle)` restoring the KV data of a
+   *  sequence after it is added again, required by the swap mode.
+   */
+  ChunkedPrefillSchedulerObj(ffi::Function f_forward, KVState state, Array<Any> args,
+                             int64_t token_budget, int64_t max_num_seqs, int64_t page_size,
+                             PreemptionMode preemption_mode, ffi::Function f_swap_out,
+                             ffi::Function f_swap_in);
+
+  /*!
+   * \brief Enqueue a request.
+   * \param request_id The id of the request, which must be unique among unfinished requests.
+   * \param prompt The prompt tokens.
+   * \param max_new_tokens The number of tokens to generate.
+   */
+  void AddRequest(int64_t request_id, IntTuple prompt, int64_t max_new_tokens);
+
+  /*!
+   * \brief Schedule and run one forward.
+   * \return A pair (request_id, token) for each token generated in this step.
+   */
+  Array<IntTuple> Step();
+
+  /*! \return Whether some requests are not finished yet. */
+  bool HasUnfinishedRequests() const { return !waiting_.empty() || !running_.empty(); }
+
+  /*!
+   * \brief Get the tokens generated so far for a request, and forget the request if it
+   * is finished.
+   */
+  IntTuple PopOutput(int64_t request_id);
+
+  /*!
+   * \brief The statistics since the creation or the last reset: the number of steps,
+   * preemptions, prefill and decode tokens, and the 50/90/99th percentiles of the time
+   * to first token and of the inter-token latency, in seconds.
+   */
+  Map<String, Any> Stats() const;
+
+  /*! \brief Reset the statistics. */
+  void ResetStats();
+
+  static constexpr const char* _type_key = "relax.vm.ChunkedPrefillScheduler";
+  TVM_DECLARE_FINAL_OBJECT_INFO(ChunkedPrefillSchedulerObj, Object);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /*! \brief The state of a request. */
+  struct Request {
+    int64_t id;
+    /*! \brief The prompt followed by the generated tokens. */
+    std::vector<int32_t> tokens;
+    int64_t prompt_length;
+    int64_t max_new_tokens;
+    /*! \brief The number of leading tokens whose KV data is in the KV state. */
+    int64_t num_computed = 0;
+    /*! \brief The saved KV data when the request is swapped out. */
+    Any swap_handle;
+    bool swapped = false;
+    bool finished = false;
+    Clock::time_point arrival_time;
+    Clock::time_point last_token_time;
+
+    int64_t NumGenerated() const {
+      return static_cast<int64_t>(tokens.size()) - prompt_length;
+    }
+    int64_t NumRemaining() const { return static_cast<int64_t>(tokens.size()) - num_computed; }
+    bool IsDecoding() const { return NumRemaining() == 1 && NumGenerated() > 0; }
+  };
+
+  /*! \return The number of free pages, or a practically infinite number without paging. */
+  int64_t NumAvailablePages() const;
+  /*! \return The number of new pages needed to append `n` tokens to the request. */
+  int64_t PagesToAppend(const Request& request, int64_t n) const;
+  /*! \return The longest chunk of the request which fits in the given number of pages. */
+  int64_t MaxChunkInPages(const Request& request, int64_t num_pages) const;
+  /*! \brief Add the sequence of a request to the KV state, swapping it in if needed. */
+  void Admit(Request* request);
+  /*! \brief Preempt the most recently admitted running request. */
+  void PreemptLast();
+
+  ffi::Function f_forward_;
+  KVState state_;
+  Array<Any> args_;
+  int64_t token_budget_;
+  int64_t max_num_seqs_;
+  int64_t page_size_;
+  PreemptionMode preemption_mode_;
+  ffi::Function f_swap_out_;
+  ffi::Function f_swap_in_;
+
+  std::unordered_map<int64_t, std::unique_ptr<Request>> requests_;
+  /*! \brief The requests waiting for admission, the preempted ones first. */
+  std::deque<Request*> waiting_;
+  /*! \brief The requests in the KV state, in admission order. */
+  std::vector<Request*> running_;
+
+  int64_t num_steps_ = 0;
+  int64_t num_preemptions_ = 0;
+  int64_t num_prefill_tokens_ = 0;
+  int64_t num_decode_tokens_ = 0;
+  std::vector<double> ttft_;
+  std::vector<double> itl_;
+};
+
+class ChunkedPrefillScheduler : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(ChunkedPrefillScheduler, ObjectRef,
+                                        ChunkedPrefillSchedulerObj);
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_CHUNKED_PREFILL_SCHEDULER_H_
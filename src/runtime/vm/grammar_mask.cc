@@ -0,0 +1,1015 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/grammar_mask.cc
+ * \brief Token masks of grammar-constrained decoding.
+ */
+#include "grammar_mask.h"
+
+#define PICOJSON_USE_INT64
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#include <picojson.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/logging.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/********** Token trie **********/
+
+TVM_REGISTER_OBJECT_TYPE(TokenTrieObj);
+
+TokenTrieObj::TokenTrieObj(std::vector<std::string> vocab) : token_bytes_(std::move(vocab)) {
+  for (int32_t i = 0; i < static_cast<int32_t>(token_bytes_.size()); ++i) {
+    if (!token_bytes_[i].empty()) sorted_token_ids_.push_back(i);
+  }
+  // In lexicographic order, a token comes right before the tokens it is a prefix of,
+  // so creating the nodes of the tokens in this order creates them in preorder.
+  std::sort(sorted_token_ids_.begin(), sorted_token_ids_.end(), [this](int32_t a, int32_t b) {
+    int cmp = token_bytes_[a].compare(token_bytes_[b]);
+    return cmp < 0 || (cmp == 0 && a < b);
+  });
+
+  node_byte_.push_back(0);
+  node_depth_.push_back(0);
+  node_subtree_end_.push_back(0);
+  std::vector<int32_t> token_node;
+  token_node.reserve(sorted_token_ids_.size());
+  // The nodes from the root to the last node of the previous token.
+  std::vector<int32_t> path = {0};
+  const std::string* prev_bytes = nullptr;
+  auto f_pop = [this, &path]() {
+    node_subtree_end_[path.back()] = static_cast<int32_t>(node_byte_.size());
+    path.pop_back();
+  };
+  for (int32_t token_id : sorted_token_ids_) {
+    const std::string& bytes = token_bytes_[token_id];
+    size_t common_prefix = 0;
+    if (prev_bytes != nullptr) {
+      size_t max_prefix = std::min(prev_bytes->size(), bytes.size());
+      while (common_prefix < max_prefix && (*prev_bytes)[common_prefix] == bytes[common_prefix]) {
+        ++common_prefix;
+      }
+    }
+    while (path.size() > common_prefix + 1) f_pop();
+    for (size_t depth = common_prefix; depth < bytes.size(); ++depth) {
+      path.push_back(static_cast<int32_t>(node_byte_.size()));
+      node_byte_.push_back(static_cast<uint8_t>(bytes[depth]));
+      node_depth_.push_back(static_cast<int32_t>(depth + 1));
+      node_subtree_end_.push_back(-1);
+    }
+    max_depth_ = std::max(max_depth_, static_cast<int32_t>(bytes.size()));
+    token_node.push_back(path.back());
+    prev_bytes = &bytes;
+  }
+  while (!path.empty()) f_pop();
+
+  // The token nodes are nondecreasing, as the tokens are in preorder of their nodes.
+  node_token_indptr_.assign(node_byte_.size() + 1, 0);
+  for (int32_t node : token_node) ++node_token_indptr_[node + 1];
+  for (size_t i = 0; i < node_byte_.size(); ++i) {
+    node_token_indptr_[i + 1] += node_token_indptr_[i];
+  }
+}
+
+/********** Regular expression parser **********/
+
+/*!
+ * \brief Build the Thompson automaton of a regular expression over bytes.
+ *
+ *  Every fragment has a start and an end state, the end state having no transition
+ *  until the fragment is connected to the next one.
+ */
+class RegexParser {
+ public:
+  using NFAState = RegexGrammarObj::NFAState;
+  /*! \brief The start and end states of a fragment. */
+  using Fragment = std::pair<int32_t, int32_t>;
+
+  RegexParser(const std::string& pattern, std::vector<NFAState>* nfa)
+      : pattern_(pattern), nfa_(nfa) {}
+
+  Fragment Parse() {
+    Fragment frag = ParseAlternation();
+    if (pos_ < pattern_.size()) Fail("unbalanced parenthesis");
+    return frag;
+  }
+
+ private:
+  /*! \brief A set of characters, with all or none of the non-ASCII characters. */
+  struct CharSet {
+    std::bitset<128> ascii;
+    bool non_ascii = false;
+  };
+
+  [[noreturn]] void Fail(const std::string& message) const {
+    LOG(FATAL) << "ValueError: Invalid regular expression \"" << pattern_ << "\" at position "
+               << pos_ << ": " << message;
+  }
+
+  bool AtEnd() const { return pos_ >= pattern_.size(); }
+  char Peek() const { return pattern_[pos_]; }
+  /*! \brief Whether a quantifier follows. A brace not followed by a count is a literal. */
+  bool AtQuantifier() const {
+    if (AtEnd()) return false;
+    char c = Peek();
+    return c == '*' || c == '+' || c == '?' ||
+           (c == '{' && pos_ + 1 < pattern_.size() &&
+            std::isdigit(static_cast<unsigned char>(pattern_[pos_ + 1])));
+  }
+
+  int32_t NewState() {
+    nfa_->emplace_back();
+    return static_cast<int32_t>(nfa_->size()) - 1;
+  }
+
+  Fragment Empty() {
+    int32_t start = NewState();
+    int32_t end = NewState();
+    (*nfa_)[start].epsilon.push_back(end);
+    return {start, end};
+  }
+
+  Fragment ByteSet(const std::bitset<256>& bytes) {
+    int32_t start = NewState();
+    int32_t end = NewState();
+    (*nfa_)[start].bytes = bytes;
+    (*nfa_)[start].next = end;
+    return {start, end};
+  }
+
+  Fragment ByteRange(int lo, int hi) {
+    std::bitset<256> bytes;
+    for (int b = lo; b <= hi; ++b) bytes.set(b);
+    return ByteSet(bytes);
+  }
+
+  Fragment Literal(const std::string& literal) {
+    Fragment frag = Empty();
+    for (char c : literal) {
+      uint8_t byte = static_cast<uint8_t>(c);
+      frag = Concat(frag, ByteRange(byte, byte));
+    }
+    return frag;
+  }
+
+  Fragment Concat(Fragment lhs, Fragment rhs) {
+    (*nfa_)[lhs.second].epsilon.push_back(rhs.first);
+    return {lhs.first, rhs.second};
+  }
+
+  Fragment Alternate(Fragment lhs, Fragment rhs) {
+    int32_t start = NewState();
+    int32_t end = NewState();
+    (*nfa_)[start].epsilon = {lhs.first, rhs.first};
+    (*nfa_)[lhs.second].epsilon.push_back(end);
+    (*nfa_)[rhs.second].epsilon.push_back(end);
+    return {start, end};
+  }
+
+  Fragment Star(Fragment frag) {
+    int32_t start = NewState();
+    int32_t end = NewState();
+    (*nfa_)[start].epsilon = {frag.first, end};
+    (*nfa_)[frag.second].epsilon.push_back(frag.first);
+    (*nfa_)[frag.second].epsilon.push_back(end);
+    return {start, end};
+  }
+
+  Fragment Plus(Fragment frag) {
+    int32_t end = NewState();
+    (*nfa_)[frag.second].epsilon.push_back(frag.first);
+    (*nfa_)[frag.second].epsilon.push_back(end);
+    return {frag.first, end};
+  }
+
+  Fragment Optional(Fragment frag) {
+    int32_t start = NewState();
+    int32_t end = NewState();
+    (*nfa_)[start].epsilon = {frag.first, end};
+    (*nfa_)[frag.second].epsilon.push_back(end);
+    return {start, end};
+  }
+
+  /*! \brief A single UTF-8 encoded non-ASCII character. */
+  Fragment NonASCIIChar() {
+    auto f_continuation = [this]() { return ByteRange(0x80, 0xBF); };
+    Fragment two = Concat(ByteRange(0xC2, 0xDF), f_continuation());
+    Fragment three = Concat(Concat(ByteRange(0xE0, 0xEF), f_continuation()), f_continuation());
+    Fragment four = Concat(ByteRange(0xF0, 0xF4), f_continuation());
+    four = Concat(Concat(four, f_continuation()), f_continuation());
+    return Alternate(Alternate(two, three), four);
+  }
+
+  Fragment FromCharSet(const CharSet& set) {
+    std::bitset<256> bytes;
+    for (int b = 0; b < 128; ++b) bytes[b] = set.ascii[b];
+    Fragment frag = ByteSet(bytes);
+    return set.non_ascii ? Alternate(frag, NonASCIIChar()) : frag;
+  }
+
+  /*! \brief The UTF-8 bytes of a code point. */
+  static std::string EncodeUTF8(int code) {
+    if (code < 0x80) return std::string(1, static_cast<char>(code));
+    if (code < 0x800) {
+      return {static_cast<char>(0xC0 | (code >> 6)), static_cast<char>(0x80 | (code & 0x3F))};
+    }
+    return {static_cast<char>(0xE0 | (code >> 12)), static_cast<char>(0x80 | ((code >> 6) & 0x3F)),
+            static_cast<char>(0x80 | (code & 0x3F))};
+  }
+
+  /*! \brief Parse the UTF-8 bytes of a non-ASCII character of the pattern, after its first byte. */
+  std::string ParseUTF8Char(uint8_t lead) {
+    size_t begin = pos_ - 1;
+    int num_continuation = lead >= 0xC2 && lead <= 0xDF   ? 1
+                           : lead >= 0xE0 && lead <= 0xEF ? 2
+                           : lead >= 0xF0 && lead <= 0xF4 ? 3
+                                                          : -1;
+    for (int i = 0; i < num_continuation; ++i, ++pos_) {
+      if (AtEnd() || (static_cast<uint8_t>(Peek()) & 0xC0) != 0x80) num_continuation = -1;
+    }
+    if (num_continuation == -1) {
+      pos_ = begin;
+      Fail("invalid UTF-8");
+    }
+    return pattern_.substr(begin, pos_ - begin);
+  }
+
+  int ParseHex(int num_digits) {
+    int value = 0;
+    for (int i = 0; i < num_digits; ++i, ++pos_) {
+      if (AtEnd() || !std::isxdigit(static_cast<unsigned char>(Peek()))) {
+        Fail("invalid hexadecimal escape");
+      }
+      char c = static_cast<char>(std::tolower(static_cast<unsigned char>(Peek())));
+      value = value * 16 + (c <= '9' ? c - '0' : c - 'a' + 10);
+    }
+    return value;
+  }
+
+  /*!
+   * \brief Parse an escape after the backslash, either as a character set or as the
+   * UTF-8 bytes of a single character.
+   * \return Whether the escape is a character set.
+   */
+  bool ParseEscape(CharSet* set, std::string* literal) {
+    if (AtEnd()) Fail("trailing backslash");
+    char c = pattern_[pos_++];
+    // The set of the escape, added to `set` at the end, as `set` may be a whole class.
+    CharSet escape;
+    auto f_range = [&escape](char lo, char hi) {
+      for (int b = lo; b <= hi; ++b) escape.ascii.set(b);
+    };
+    switch (c) {
+      case 'd':
+      case 'D':
+        f_range('0', '9');
+        break;
+      case 'w':
+      case 'W':
+        f_range('0', '9');
+        f_range('a', 'z');
+        f_range('A', 'Z');
+        escape.ascii.set('_');
+        break;
+      case 's':
+      case 'S':
+        for (char space : {' ', '\t', '\n', '\r', '\f', '\v'}) escape.ascii.set(space);
+        break;
+      case 'n':
+        *literal = "\n";
+        return false;
+      case 't':
+        *literal = "\t";
+        return false;
+      case 'r':
+        *literal = "\r";
+        return false;
+      case 'f':
+        *literal = "\f";
+        return false;
+      case 'v':
+        *literal = "\v";
+        return false;
+      case 'x':
+        *literal = EncodeUTF8(ParseHex(2));
+        return false;
+      case 'u':
+        *literal = EncodeUTF8(ParseHex(4));
+        return false;
+      default:
+        if (std::isalnum(static_cast<unsigned char>(c))) {
+          --pos_;
+          Fail(std::string("unsupported escape \\") + c);
+        }
+        *literal = std::string(1, c);
+        return false;
+    }
+    // As with re.ASCII, \d \w \s only match ASCII characters, and their negations match
+    // the complements, with all the non-ASCII characters.
+    if (std::isupper(static_cast<unsigned char>(c))) {
+      escape.ascii.flip();
+      escape.non_ascii = true;
+    }
+    set->ascii |= escape.ascii;
+    set->non_ascii = set->non_ascii || escape.non_ascii;
+    return true;
+  }
+
+  /*! \brief Parse a single ASCII character of a character class. */
+  char ParseClassChar(CharSet* set, bool* is_set) {
+    *is_set = false;
+    char c = pattern_[pos_++];
+    if (c == '\\') {
+      std::string literal;
+      if (ParseEscape(set, &literal)) {
+        *is_set = true;
+        return 0;
+      }
+      if (literal.size() != 1 || static_cast<unsigned char>(literal[0]) >= 0x80) {
+        Fail("non-ASCII characters in character classes are not supported");
+      }
+      return literal[0];
+    }
+    if (static_cast<unsigned char>(c) >= 0x80) {
+      --pos_;
+      Fail("non-ASCII characters in character classes are not supported");
+    }
+    return c;
+  }
+
+  Fragment ParseClass() {
+    CharSet set;
+    bool negate = !AtEnd() && Peek() == '^';
+    if (negate) ++pos_;
+    bool first = true;
+    while (true) {
+      if (AtEnd()) Fail("unterminated character class");
+      if (Peek() == ']' && !first) break;
+      first = false;
+      bool is_set;
+      char lo = ParseClassChar(&set, &is_set);
+      if (is_set) continue;
+      if (pos_ + 1 < pattern_.size() && Peek() == '-' && pattern_[pos_ + 1] != ']') {
+        ++pos_;
+        char hi = ParseClassChar(&set, &is_set);
+        if (is_set || hi < lo) Fail("invalid character class range");
+        for (int b = lo; b <= hi; ++b) set.ascii.set(b);
+      } else {
+        set.ascii.set(lo);
+      }
+    }
+    ++pos_;
+    if (negate) {
+      set.ascii.flip();
+      set.non_ascii = !set.non_ascii;
+    }
+    return FromCharSet(set);
+  }
+
+  Fragment ParseAtom() {
+    if (AtEnd()) Fail("missing expression");
+    char c = pattern_[pos_++];
+    switch (c) {
+      case '(': {
+        if (pattern_.compare(pos_, 2, "?:") == 0) {
+          pos_ += 2;
+        } else if (!AtEnd() && Peek() == '?') {
+          Fail("unsupported group extension");
+        }
+        Fragment frag = ParseAlternation();
+        if (AtEnd() || Peek() != ')') Fail("missing closing parenthesis");
+        ++pos_;
+        return frag;
+      }
+      case '[':
+        return ParseClass();
+      case '.': {
+        CharSet set;
+        set.ascii.set();
+        set.ascii.reset('\n');
+        set.non_ascii = true;
+        return FromCharSet(set);
+      }
+      case '\\': {
+        CharSet set;
+        std::string literal;
+        return ParseEscape(&set, &literal) ? FromCharSet(set) : Literal(literal);
+      }
+      case '^':
+        if (pos_ != 1) Fail("anchors are only supported at the ends of the expression");
+        return Empty();
+      case '$':
+        if (!AtEnd()) Fail("anchors are only supported at the ends of the expression");
+        return Empty();
+      case '*':
+      case '+':
+      case '?':
+        --pos_;
+        Fail("nothing to repeat");
+      default:
+        if (static_cast<uint8_t>(c) >= 0x80) return Literal(ParseUTF8Char(c));
+        return Literal(std::string(1, c));
+    }
+  }
+
+  int ParseInt() {
+    size_t begin = pos_;
+    int value = 0;
+    while (!AtEnd() && std::isdigit(static_cast<unsigned char>(Peek()))) {
+      value = value * 10 + (pattern_[pos_++] - '0');
+      if (value > kMaxRepeat) Fail("repetition count is too large");
+    }
+    if (pos_ == begin) Fail("invalid repetition count");
+    return value;
+  }
+
+  Fragment ParseRepeat() {
+    size_t atom_begin = pos_;
+    Fragment frag = ParseAtom();
+    if (!AtQuantifier()) return frag;
+    // Bounded repetitions need several copies of the atom, which are built by parsing
+    // it again.
+    auto f_copy = [this, atom_begin]() {
+      size_t pos = pos_;
+      pos_ = atom_begin;
+      Fragment copy = ParseAtom();
+      pos_ = pos;
+      return copy;
+    };
+    switch (Peek()) {
+      case '*':
+        ++pos_;
+        frag = Star(frag);
+        break;
+      case '+':
+        ++pos_;
+        frag = Plus(frag);
+        break;
+      case '?':
+        ++pos_;
+        frag = Optional(frag);
+        break;
+      case '{': {
+        ++pos_;
+        int min_count = ParseInt();
+        int max_count = min_count;
+        if (!AtEnd() && Peek() == ',') {
+          ++pos_;
+          max_count = !AtEnd() && Peek() == '}' ? -1 : ParseInt();
+        }
+        if (AtEnd() || Peek() != '}') Fail("missing closing brace");
+        ++pos_;
+        if (max_count != -1 && max_count < min_count) Fail("invalid repetition range");
+        Fragment result = min_count > 0 ? frag : Empty();
+        for (int i = 1; i < min_count; ++i) result = Concat(result, f_copy());
+        if (max_count == -1) {
+          result = Concat(result, Star(min_count > 0 ? f_copy() : frag));
+        } else {
+          for (int i = min_count; i < max_count; ++i) {
+            result = Concat(result, Optional(i > 0 || min_count > 0 ? f_copy() : frag));
+          }
+        }
+        frag = result;
+        break;
+      }
+    }
+    // A trailing `?` makes the repetition lazy, which does not change the matched language.
+    if (!AtEnd() && Peek() == '?') ++pos_;
+    if (AtQuantifier()) Fail("multiple repeat");
+    return frag;
+  }
+
+  Fragment ParseConcat() {
+    Fragment frag = Empty();
+    while (!AtEnd() && Peek() != '|' && Peek() != ')') frag = Concat(frag, ParseRepeat());
+    return frag;
+  }
+
+  Fragment ParseAlternation() {
+    Fragment frag = ParseConcat();
+    while (!AtEnd() && Peek() == '|') {
+      ++pos_;
+      frag = Alternate(frag, ParseConcat());
+    }
+    return frag;
+  }
+
+  static constexpr int kMaxRepeat = 1000;
+
+  const std::string& pattern_;
+  std::vector<NFAState>* nfa_;
+  size_t pos_ = 0;
+};
+
+/********** Regex grammar **********/
+
+TVM_REGISTER_OBJECT_TYPE(RegexGrammarObj);
+
+RegexGrammarObj::RegexGrammarObj(const std::string& pattern, TokenTrie trie,
+                                 IntTuple stop_token_ids)
+    : trie_(std::move(trie)) {
+  for (int64_t token_id : stop_token_ids) {
+    CHECK(token_id >= 0 && token_id < trie_->VocabSize())
+        << "ValueError: The stop token " << token_id << " is out of the vocabulary of size "
+        << trie_->VocabSize();
+    stop_token_ids_.push_back(static_cast<int32_t>(token_id));
+  }
+  RegexParser::Fragment frag = RegexParser(pattern, &nfa_).Parse();
+  nfa_accept_ = frag.second;
+  int32_t init_state = GetDFAState({frag.first});
+  ICHECK_EQ(init_state, InitState());
+}
+
+int32_t RegexGrammarObj::GetDFAState(std::vector<int32_t> nfa_states) {
+  std::vector<bool> visited(nfa_.size(), false);
+  std::vector<int32_t> stack;
+  for (int32_t state : nfa_states) {
+    if (!visited[state]) {
+      visited[state] = true;
+      stack.push_back(state);
+    }
+  }
+  nfa_states.clear();
+  while (!stack.empty()) {
+    int32_t state = stack.back();
+    stack.pop_back();
+    // Only the states with a byte transition or the accept state tell DFA states apart.
+    if (nfa_[state].next != -1 || state == nfa_accept_) nfa_states.push_back(state);
+    for (int32_t next : nfa_[state].epsilon) {
+      if (!visited[next]) {
+        visited[next] = true;
+        stack.push_back(next);
+      }
+    }
+  }
+  std::sort(nfa_states.begin(), nfa_states.end());
+
+  auto it = dfa_index_.find(nfa_states);
+  if (it != dfa_index_.end()) return it->second;
+  int32_t dfa_state = static_cast<int32_t>(dfa_states_.size());
+  dfa_accepting_.push_back(std::binary_search(nfa_states.begin(), nfa_states.end(), nfa_accept_));
+  dfa_index_.emplace(nfa_states, dfa_state);
+  dfa_states_.push_back(std::move(nfa_states));
+  dfa_transitions_.emplace_back();
+  dfa_transitions_.back().fill(kUnknown);
+  masks_.emplace_back();
+  return dfa_state;
+}
+
+int32_t RegexGrammarObj::Step(int32_t state, uint8_t byte) {
+  int32_t next = dfa_transitions_[state][byte];
+  if (next != kUnknown) return next;
+  std::vector<int32_t> targets;
+  for (int32_t nfa_state : dfa_states_[state]) {
+    if (nfa_[nfa_state].bytes.test(byte)) targets.push_back(nfa_[nfa_state].next);
+  }
+  next = targets.empty() ? kDead : GetDFAState(std::move(targets));
+  dfa_transitions_[state][byte] = next;
+  return next;
+}
+
+void RegexGrammarObj::CheckState(int64_t state) const {
+  CHECK(state >= 0 && state < NumStates())
+      << "ValueError: Invalid grammar state " << state << ", there are " << NumStates()
+      << " states so far";
+}
+
+int64_t RegexGrammarObj::AcceptToken(int64_t state, int64_t token_id) {
+  CheckState(state);
+  CHECK(token_id >= 0 && token_id < trie_->VocabSize())
+      << "ValueError: The token " << token_id << " is out of the vocabulary of size "
+      << trie_->VocabSize();
+  if (std::find(stop_token_ids_.begin(), stop_token_ids_.end(), token_id) !=
+      stop_token_ids_.end()) {
+    return dfa_accepting_[state] ? state : kRejectedState;
+  }
+  const std::string& bytes = trie_->token_bytes_[token_id];
+  if (bytes.empty()) return kRejectedState;
+  int32_t cur = static_cast<int32_t>(state);
+  for (char c : bytes) {
+    cur = Step(cur, static_cast<uint8_t>(c));
+    if (cur == kDead) return kRejectedState;
+  }
+  return cur;
+}
+
+bool RegexGrammarObj::IsAccepting(int64_t state) const {
+  CheckState(state);
+  return dfa_accepting_[state];
+}
+
+const std::vector<uint32_t>& RegexGrammarObj::NextTokenBitmask(int64_t state) {
+  CheckState(state);
+  if (!masks_[state].empty()) return masks_[state];
+
+  const TokenTrieObj* trie = trie_.operator->();
+  std::vector<uint32_t> mask((trie->VocabSize() + 31) / 32, 0);
+  // The automaton state after the bytes of the current node and of its ancestors.
+  std::vector<int32_t> depth_states(trie->max_depth_ + 1);
+  depth_states[0] = static_cast<int32_t>(state);
+  int32_t num_nodes = static_cast<int32_t>(trie->node_byte_.size());
+  for (int32_t node = 1; node < num_nodes;) {
+    int32_t depth = trie->node_depth_[node];
+    int32_t next = Step(depth_states[depth - 1], trie->node_byte_[node]);
+    if (next == kDead) {
+      // No token with this prefix is allowed.
+      node = trie->node_subtree_end_[node];
+      continue;
+    }
+    depth_states[depth] = next;
+    for (int32_t i = trie->node_token_indptr_[node]; i < trie->node_token_indptr_[node + 1]; ++i) {
+      int32_t token_id = trie->sorted_token_ids_[i];
+      mask[token_id >> 5] |= 1u << (token_id & 31);
+    }
+    ++node;
+  }
+  if (dfa_accepting_[state]) {
+    for (int32_t token_id : stop_token_ids_) mask[token_id >> 5] |= 1u << (token_id & 31);
+  }
+  // Stepping may have appended states, so index the cache only now.
+  masks_[state] = std::move(mask);
+  return masks_[state];
+}
+
+void RegexGrammarObj::FillNextTokenBitmask(IntTuple states, NDArray bitmask) {
+  int64_t num_words = (trie_->VocabSize() + 31) / 32;
+  CHECK(bitmask.DataType() == DataType::Int(32) && bitmask->ndim == 2 &&
+        bitmask->shape[0] == static_cast<int64_t>(states.size()) &&
+        bitmask->shape[1] == num_words)
+      << "ValueError: The bitmask must be an int32 array of shape (" << states.size() << ", "
+      << num_words << "), but got " << bitmask.DataType() << " " << bitmask.Shape();
+  ICHECK(bitmask.IsContiguous());
+  bool on_cpu = bitmask->device.device_type == kDLCPU;
+  NDArray host = on_cpu ? bitmask : NDArray::Empty(bitmask.Shape(), bitmask->dtype, {kDLCPU, 0});
+  uint32_t* data = reinterpret_cast<uint32_t*>(static_cast<char*>(host->data) + host->byte_offset);
+  for (int64_t i = 0; i < static_cast<int64_t>(states.size()); ++i) {
+    uint32_t* row = data + i * num_words;
+    CHECK_NE(states[i], kRejectedState)
+        << "ValueError: The grammar rejected the last token of sequence " << i
+        << ", so no token is allowed after it";
+    if (states[i] == kUnconstrainedState) {
+      std::fill(row, row + num_words, std::numeric_limits<uint32_t>::max());
+    } else {
+      const std::vector<uint32_t>& mask = NextTokenBitmask(states[i]);
+      std::memcpy(row, mask.data(), num_words * sizeof(uint32_t));
+    }
+  }
+  if (!on_cpu) bitmask.CopyFrom(host);
+}
+
+/********** JSON schema **********/
+
+/*! \brief Convert a JSON schema to a regular expression, see JSONSchemaToRegex. */
+class JSONSchemaConverter {
+ public:
+  explicit JSONSchemaConverter(const std::string& schema) {
+    std::string err = picojson::parse(root_, schema);
+    CHECK(err.empty()) << "ValueError: Invalid JSON schema: " << err;
+  }
+
+  std::string Convert() { return Visit(root_); }
+
+ private:
+  [[noreturn]] void Fail(const std::string& message) const {
+    LOG(FATAL) << "ValueError: Unsupported JSON schema: " << message;
+  }
+
+  /*! \brief A regular expression matching a literal string. */
+  static std::string Escape(const std::string& literal) {
+    std::string escaped;
+    for (char c : literal) {
+      if (std::strchr("\\^$.|?*+()[]{}", c) != nullptr && c != '\0') escaped.push_back('\\');
+      escaped.push_back(c);
+    }
+    return escaped;
+  }
+
+  /*! \brief Serialize a JSON value with the separators of the output. */
+  static std::string Serialize(const picojson::value& value) {
+    if (value.is<picojson::array>()) {
+      std::string result = "[";
+      for (const picojson::value& item : value.get<picojson::array>()) {
+        if (result.size() > 1) result += ", ";
+        result += Serialize(item);
+      }
+      return result + "]";
+    }
+    if (value.is<picojson::object>()) {
+      const picojson::object& object = value.get<picojson::object>();
+      std::string result = "{";
+      for (const std::string& key : object.ordered_keys()) {
+        if (result.size() > 1) result += ", ";
+        result += picojson::value(key).serialize() + ": " + Serialize(object.at(key));
+      }
+      return result + "}";
+    }
+    return value.serialize();
+  }
+
+  /*! \brief The `{m,n}` quantifier of a count in [min_count, max_count], -1 being unbounded. */
+  static std::string Quantifier(int64_t min_count, int64_t max_count) {
+    if (min_count == 0 && max_count == -1) return "*";
+    if (min_count == 1 && max_count == -1) return "+";
+    std::string result = "{" + std::to_string(min_count);
+    if (max_count != min_count) {
+      result += "," + (max_count == -1 ? "" : std::to_string(max_count));
+    }
+    return result + "}";
+  }
+
+  int64_t GetCount(const picojson::object& schema, const std::string& key, int64_t default_value) {
+    auto it = schema.find(key);
+    if (it == schema.end()) return default_value;
+    if (!it->second.is<int64_t>() || it->second.get<int64_t>() < 0) {
+      Fail("\"" + key + "\" must be a non-negative integer");
+    }
+    return it->second.get<int64_t>();
+  }
+
+  /*! \brief Resolve a local reference, given as a JSON pointer into the root schema. */
+  const picojson::value& Resolve(const std::string& ref) const {
+    if (ref.compare(0, 1, "#") != 0) Fail("only local references are supported, got " + ref);
+    const picojson::value* value = &root_;
+    size_t pos = 1;
+    while (pos < ref.size()) {
+      if (ref[pos] != '/') Fail("invalid reference " + ref);
+      size_t end = std::min(ref.find('/', pos + 1), ref.size());
+      std::string token = ref.substr(pos + 1, end - pos - 1);
+      for (size_t i = 0; (i = token.find('~', i)) != std::string::npos; ++i) {
+        token.replace(i, 2, token.compare(i, 2, "~1") == 0 ? "/" : "~");
+      }
+      if (!value->is<picojson::object>() || !value->get<picojson::object>().count(token)) {
+        Fail("unresolved reference " + ref);
+      }
+      value = &value->get<picojson::object>().at(token);
+      pos = end;
+    }
+    return *value;
+  }
+
+  std::string Visit(const picojson::value& value) {
+    if (!value.is<picojson::object>()) Fail("schemas of any JSON value are not regular");
+    const picojson::object& schema = value.get<picojson::object>();
+    if (schema.count("$ref")) {
+      std::string ref = schema.at("$ref").to_str();
+      if (std::find(ref_stack_.begin(), ref_stack_.end(), ref) != ref_stack_.end()) {
+        Fail("recursive reference " + ref + " is not regular");
+      }
+      ref_stack_.push_back(ref);
+      std::string result = Visit(Resolve(ref));
+      ref_stack_.pop_back();
+      return result;
+    }
+    if (schema.count("const")) return Escape(Serialize(schema.at("const")));
+    if (schema.count("enum")) {
+      std::vector<std::string> alternatives;
+      for (const picojson::value& item : GetArray(schema, "enum")) {
+        alternatives.push_back(Escape(Serialize(item)));
+      }
+      return Alternation(alternatives);
+    }
+    for (const char* key : {"anyOf", "oneOf"}) {
+      if (schema.count(key)) {
+        std::vector<std::string> alternatives;
+        for (const picojson::value& item : GetArray(schema, key)) {
+          alternatives.push_back(Visit(item));
+        }
+        return Alternation(alternatives);
+      }
+    }
+    if (schema.count("allOf")) {
+      const picojson::array& items = GetArray(schema, "allOf");
+      if (items.size() != 1) Fail("\"allOf\" is only supported with a single schema");
+      return Visit(items[0]);
+    }
+
+    if (!schema.count("type")) {
+      if (schema.count("properties")) return VisitObject(schema);
+      if (schema.count("items")) return VisitArray(schema);
+      Fail("schemas of any JSON value are not regular");
+    }
+    const picojson::value& type = schema.at("type");
+    if (type.is<picojson::array>()) {
+      std::vector<std::string> alternatives;
+      for (const picojson::value& item : type.get<picojson::array>()) {
+        alternatives.push_back(VisitType(schema, item.to_str()));
+      }
+      return Alternation(alternatives);
+    }
+    return VisitType(schema, type.to_str());
+  }
+
+  std::string VisitType(const picojson::object& schema, const std::string& type) {
+    if (type == "object") return VisitObject(schema);
+    if (type == "array") return VisitArray(schema);
+    if (type == "string") return VisitString(schema);
+    if (type == "boolean") return "(?:true|false)";
+    if (type == "null") return "null";
+    if (type != "integer" && type != "number") Fail("unknown type \"" + type + "\"");
+    auto it = schema.find("minimum");
+    bool non_negative = it != schema.end() && it->second.is<double>() &&
+                        it->second.get<double>() >= 0;
+    std::string result = non_negative ? "" : "-?";
+    result += "(?:0|[1-9][0-9]*)";
+    if (type == "number") result += "(?:\\.[0-9]+)?(?:[eE][+-]?[0-9]+)?";
+    return result;
+  }
+
+  std::string VisitString(const picojson::object& schema) {
+    if (schema.count("pattern")) {
+      std::string pattern = schema.at("pattern").to_str();
+      if (!pattern.empty() && pattern.front() == '^') pattern.erase(0, 1);
+      if (!pattern.empty() && pattern.back() == '$') pattern.pop_back();
+      return "\"(?:" + pattern + ")\"";
+    }
+    if (schema.count("format")) {
+      const std::string format = schema.at("format").to_str();
+      const std::string date = "[0-9]{4}-[0-9]{2}-[0-9]{2}";
+      const std::string time =
+          "[0-9]{2}:[0-9]{2}:[0-9]{2}(?:\\.[0-9]+)?(?:Z|[+-][0-9]{2}:[0-9]{2})?";
+      if (format == "date") return "\"" + date + "\"";
+      if (format == "time") return "\"" + time + "\"";
+      if (format == "date-time") return "\"" + date + "T" + time + "\"";
+      if (format == "uuid") {
+        return "\"[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}\"";
+      }
+    }
+    // A character other than the quote, the backslash and the control characters, or an escape.
+    std::string character = "(?:[^\"\\\\\\x00-\\x1f]|\\\\[\"\\\\/bfnrt]|\\\\u[0-9a-fA-F]{4})";
+    int64_t min_length = GetCount(schema, "minLength", 0);
+    int64_t max_length = GetCount(schema, "maxLength", -1);
+    return "\"" + character + Quantifier(min_length, max_length) + "\"";
+  }
+
+  std::string VisitArray(const picojson::object& schema) {
+    if (!schema.count("items")) Fail("arrays without \"items\" are not regular");
+    int64_t min_items = GetCount(schema, "minItems", 0);
+    int64_t max_items = GetCount(schema, "maxItems", -1);
+    if (max_items == 0) return "\\[\\]";
+    std::string item = Visit(schema.at("items"));
+    std::string items = item + "(?:, " + item + ")" +
+                        Quantifier(std::max<int64_t>(min_items - 1, 0),
+                                   max_items == -1 ? -1 : max_items - 1);
+    return min_items == 0 ? "\\[(?:" + items + ")?\\]" : "\\[" + items + "\\]";
+  }
+
+  std::string VisitObject(const picojson::object& schema) {
+    if (!schema.count("properties")) return "\\{\\}";
+    if (!schema.at("properties").is<picojson::object>()) Fail("\"properties\" must be an object");
+    const picojson::object& properties = schema.at("properties").get<picojson::object>();
+    std::vector<std::string> names;
+    if (schema.count("required")) {
+      for (const picojson::value& name : GetArray(schema, "required")) {
+        names.push_back(name.to_str());
+      }
+    }
+    std::vector<std::string> patterns;
+    std::vector<bool> required;
+    for (const std::string& key : properties.ordered_keys()) {
+      patterns.push_back(Escape(picojson::value(key).serialize()) + ": " +
+                         Visit(properties.at(key)));
+      required.push_back(std::find(names.begin(), names.end(), key) != names.end());
+    }
+    // The first property present decides where the separators go, so the optional
+    // properties before the first required one give one alternative each.
+    std::vector<std::string> alternatives;
+    for (size_t first = 0; first < patterns.size(); ++first) {
+      std::string alternative = patterns[first];
+      for (size_t i = first + 1; i < patterns.size(); ++i) {
+        alternative += required[i] ? ", " + patterns[i] : "(?:, " + patterns[i] + ")?";
+      }
+      alternatives.push_back(alternative);
+      if (required[first]) break;
+    }
+    bool all_optional = std::find(required.begin(), required.end(), true) == required.end();
+    if (all_optional) alternatives.push_back("");
+    return "\\{" + Alternation(alternatives) + "\\}";
+  }
+
+  const picojson::array& GetArray(const picojson::object& schema, const std::string& key) {
+    if (!schema.at(key).is<picojson::array>()) Fail("\"" + key + "\" must be an array");
+    return schema.at(key).get<picojson::array>();
+  }
+
+  static std::string Alternation(const std::vector<std::string>& alternatives) {
+    std::string result = "(?:";
+    for (size_t i = 0; i < alternatives.size(); ++i) {
+      if (i != 0) result += "|";
+      result += alternatives[i];
+    }
+    return result + ")";
+  }
+
+  picojson::value root_;
+  /*! \brief The references being expanded. */
+  std::vector<std::string> ref_stack_;
+};
+
+std::string JSONSchemaToRegex(const std::string& schema) {
+  return JSONSchemaConverter(schema).Convert();
+}
+
+/*!
+ * \brief Set the logits of the tokens disallowed by a bitmask to -inf.
+ * \param logits The float32 logits of shape (batch_size, vocab_size) on CPU.
+ * \param bitmask The int32 bitmask of shape (batch_size, ceil(vocab_size / 32)), as filled by
+ * `vm.builtin.regex_grammar_fill_next_token_bitmask`.
+ */
+void ApplyTokenBitmaskInplace(NDArray logits, NDArray bitmask) {
+  CHECK(logits.DataType() == DataType::Float(32) && logits->ndim == 2 &&
+        logits->device.device_type == kDLCPU)
+      << "ValueError: The logits must be a float32 array of shape (batch_size, vocab_size) on CPU";
+  int64_t batch_size = logits->shape[0];
+  int64_t vocab_size = logits->shape[1];
+  int64_t num_words = (vocab_size + 31) / 32;
+  CHECK(bitmask.DataType() == DataType::Int(32) && bitmask->ndim == 2 &&
+        bitmask->shape[0] == batch_size && bitmask->shape[1] == num_words &&
+        bitmask->device.device_type == kDLCPU)
+      << "ValueError: The bitmask must be an int32 array of shape (" << batch_size << ", "
+      << num_words << ") on CPU, but got " << bitmask.DataType() << " " << bitmask.Shape();
+  ICHECK(logits.IsContiguous() && bitmask.IsContiguous());
+  float* logits_data =
+      reinterpret_cast<float*>(static_cast<char*>(logits->data) + logits->byte_offset);
+  const uint32_t* mask_data = reinterpret_cast<const uint32_t*>(
+      static_cast<const char*>(bitmask->data) + bitmask->byte_offset);
+  for (int64_t i = 0; i < batch_size; ++i) {
+    float* row = logits_data + i * vocab_size;
+    const uint32_t* mask = mask_data + i * num_words;
+    for (int64_t w = 0; w < num_words; ++w) {
+      if (mask[w] == std::numeric_limits<uint32_t>::max()) continue;
+      int64_t end = std::min(vocab_size, (w + 1) * 32);
+      for (int64_t v = w * 32; v < end; ++v) {
+        if (!((mask[w] >> (v & 31)) & 1)) row[v] = -std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+}
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.token_trie_create").set_body_typed([](Array<Any> vocab) {
+  std::vector<std::string> token_bytes;
+  token_bytes.reserve(vocab.size());
+  for (const Any& token : vocab) {
+    if (auto opt_str = token.as<String>()) {
+      token_bytes.push_back(*opt_str);
+    } else if (auto opt_bytes = token.as<Bytes>()) {
+      token_bytes.push_back(*opt_bytes);
+    } else {
+      LOG(FATAL) << "ValueError: The vocabulary must contain strings or bytes, but got "
+                 << token.GetTypeKey();
+    }
+  }
+  return TokenTrie(make_object<TokenTrieObj>(std::move(token_bytes)));
+});
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.token_trie_vocab_size")
+    .set_body_method(&TokenTrieObj::VocabSize);
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_create")
+    .set_body_typed([](String pattern, TokenTrie trie, IntTuple stop_token_ids) {
+      return RegexGrammar(make_object<RegexGrammarObj>(pattern, trie, stop_token_ids));
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_init_state")
+    .set_body_method(&RegexGrammarObj::InitState);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_accept_token")
+    .set_body_method(&RegexGrammarObj::AcceptToken);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_is_accepting")
+    .set_body_method(&RegexGrammarObj::IsAccepting);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_fill_next_token_bitmask")
+    .set_body_method(&RegexGrammarObj::FillNextTokenBitmask);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.regex_grammar_num_states")
+    .set_body_method(&RegexGrammarObj::NumStates);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.apply_token_bitmask_inplace")
+    .set_body_typed(ApplyTokenBitmaskInplace);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.json_schema_to_regex").set_body_typed([](String schema) {
+  return String(JSONSchemaToRegex(schema));
+});
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/grammar_mask.h
+ * \brief Token masks of grammar-constrained decoding.
+ *
+ *  The tokenizer vocabulary is precompiled once into a byte-level trie, and an
+ *  output grammar given as a regular expression is compiled into a byte automaton
+ *  whose states are determinized lazily. The allowed tokens of an automaton state
+ *  are found by walking the trie and pruning every subtree whose prefix is rejected,
+ *  and the resulting bitmask is cached per automaton state, so that the steady state
+ *  of decoding only copies cached masks.
+ *
+ *  `runtime/regex.h` only checks full matches through Python's `re` module, which
+ *  cannot be advanced byte by byte, hence the self-contained automaton here. A JSON
+ *  schema is supported by converting it to a regular expression with JSONSchemaToRegex.
+ */
+#ifndef TVM_RUNTIME_VM_GRAMMAR_MASK_H_
+#define TVM_RUNTIME_VM_GRAMMAR_MASK_H_
+
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/string.h>
+#include <tvm/runtime/int_tuple.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/object.h>
+
+#include <array>
+#include <bitset>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*!
+ * \brief The tokenizer vocabulary as a byte-level trie.
+ *
+ *  The nodes are stored in preorder, so that a subtree is a contiguous range of
+ *  nodes and a walk over the trie is a linear scan which can skip subtrees.
+ */
+class TokenTrieObj : public Object {
+ public:
+  /*!
+   * \brief Build the trie.
+   * \param vocab The byte strings of the tokens, indexed by token id. Tokens with no bytes,
+   *  such as special tokens, are not in the trie.
+   */
+  explicit TokenTrieObj(std::vector<std::string> vocab);
+
+  /*! \return The vocabulary size. */
+  int64_t VocabSize() const { return static_cast<int64_t>(token_bytes_.size()); }
+
+  /*! \brief The bytes of each token. */
+  std::vector<std::string> token_bytes_;
+  /*! \brief The byte labelling the edge from the parent of each node, the root being node 0. */
+  std::vector<uint8_t> node_byte_;
+  /*! \brief The depth of each node, the root being at depth 0. */
+  std::vector<int32_t> node_depth_;
+  /*! \brief The end of the preorder range of the subtree of each node. */
+  std::vector<int32_t> node_subtree_end_;
+  /*! \brief The tokens ending at node `i` are at `[indptr[i], indptr[i + 1])` of the sorted ids. */
+  std::vector<int32_t> node_token_indptr_;
+  /*! \brief The token ids sorted by bytes. */
+  std::vector<int32_t> sorted_token_ids_;
+  /*! \brief The maximum depth of the trie. */
+  int32_t max_depth_ = 0;
+
+  static constexpr const char* _type_key = "relax.vm.TokenTrie";
+  TVM_DECLARE_FINAL_OBJECT_INFO(TokenTrieObj, Object);
+};
+
+class TokenTrie : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(TokenTrie, ObjectRef, TokenTrieObj);
+};
+
+/*!
+ * \brief An output grammar given as a regular expression over the bytes of the output,
+ * compiled against a token trie.
+ *
+ *  The whole output must match the expression. The supported syntax is literals,
+ *  `.`, character classes with ranges and negation, the escapes `\d \w \s \D \W \S`,
+ *  `\n \t \r \f \v \xHH \uHHHH` and escaped punctuation, groups with `(...)` or `(?:...)`,
+ *  alternation, and the quantifiers `* + ? {m} {m,} {m,n}`. The pattern is UTF-8, and
+ *  literals, `.`, negated classes and `\D \W \S` match whole UTF-8 characters, while
+ *  `\d \w \s` only match ASCII characters as with `re.ASCII`.
+ *
+ *  A grammar state is the id of a state of the automaton, and is shared by all
+ *  the sequences in the same position of the grammar. The grammar is not thread
+ *  safe, as it determinizes states and caches masks lazily.
+ */
+class RegexGrammarObj : public Object {
+ public:
+  /*!
+   * \brief Compile a grammar.
+   * \param pattern The regular expression.
+   * \param trie The token trie of the vocabulary.
+   * \param stop_token_ids The tokens allowed once the output matches the expression.
+   */
+  RegexGrammarObj(const std::string& pattern, TokenTrie trie, IntTuple stop_token_ids);
+
+  /*! \brief The state returned by AcceptToken for a token the grammar rejects. */
+  static constexpr int64_t kRejectedState = -1;
+  /*! \brief The state of a sequence without grammar, whose tokens are all allowed. */
+  static constexpr int64_t kUnconstrainedState = -2;
+
+  /*! \return The state before any output. */
+  int64_t InitState() const { return 0; }
+
+  /*!
+   * \brief Advance a state by a token.
+   * \return The new state, or kRejectedState if the grammar rejects the token. A stop
+   *  token leaves the state unchanged.
+   */
+  int64_t AcceptToken(int64_t state, int64_t token_id);
+
+  /*! \return Whether the output matches the expression in the state. */
+  bool IsAccepting(int64_t state) const;
+
+  /*!
+   * \brief Fill the bitmask of the allowed next tokens of a batch of states.
+   * \param states The grammar state of each sequence. kUnconstrainedState allows all tokens,
+   *  and kRejectedState is an error, as no token can follow a rejected one.
+   * \param bitmask The int32 bitmask of shape (batch_size, ceil(vocab_size / 32)), where
+   *  bit `i % 32` of word `i / 32` of a row tells whether token `i` is allowed.
+   */
+  void FillNextTokenBitmask(IntTuple states, NDArray bitmask);
+
+  /*! \return The cached bitmask of the allowed next tokens of a state. */
+  const std::vector<uint32_t>& NextTokenBitmask(int64_t state);
+
+  /*! \return The number of automaton states determinized so far. */
+  int64_t NumStates() const { return static_cast<int64_t>(dfa_states_.size()); }
+
+  static constexpr const char* _type_key = "relax.vm.RegexGrammar";
+  TVM_DECLARE_FINAL_OBJECT_INFO(RegexGrammarObj, Object);
+
+ private:
+  /*! \brief A state of the nondeterministic automaton. */
+  struct NFAState {
+    /*! \brief The bytes of the transition to `next`. */
+    std::bitset<256> bytes;
+    int32_t next = -1;
+    std::vector<int32_t> epsilon;
+  };
+
+  static constexpr int32_t kDead = -1;
+  static constexpr int32_t kUnknown = -2;
+
+  /*! \brief Get the deterministic state of a set of NFA states, closing it first. */
+  int32_t GetDFAState(std::vector<int32_t> nfa_states);
+  /*! \brief The transition of a deterministic state by a byte, determinized lazily. */
+  int32_t Step(int32_t state, uint8_t byte);
+  /*! \brief Check that a state is a valid deterministic state. */
+  void CheckState(int64_t state) const;
+
+  TokenTrie trie_;
+  std::vector<int32_t> stop_token_ids_;
+  std::vector<NFAState> nfa_;
+  int32_t nfa_accept_;
+  std::map<std::vector<int32_t>, int32_t> dfa_index_;
+  std::vector<std::vector<int32_t>> dfa_states_;
+  std::vector<std::array<int32_t, 256>> dfa_transitions_;
+  std::vector<bool> dfa_accepting_;
+  /*! \brief The cached bitmask of each deterministic state, empty until computed. */
+  std::vector<std::vector<uint32_t>> masks_;
+
+  friend class RegexParser;
+};
+
+class RegexGrammar : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(RegexGrammar, ObjectRef, RegexGrammarObj);
+};
+
+/*!
+ * \brief Convert a JSON schema to a regular expression of RegexGrammarObj matching its
+ *  instances, serialized with the separators ", " and ": " and with the properties of the
+ *  objects in the order of the schema.
+ *
+ *  The supported keywords are `type` (one or a list), `properties` and `required`,
+ *  `items`, `minItems` and `maxItems`, `minLength`, `maxLength` and `pattern`, the
+ *  `date`, `time`, `date-time` and `uuid` formats, `enum`, `const`, `anyOf`, `oneOf`, a
+ *  single `allOf`, and local `$ref`. The objects have no other properties than the listed
+ *  ones. A `minimum` of at least 0 forbids negative numbers, other numeric bounds are not
+ *  enforced. Schemas of any JSON value, such as `{}`, and recursive schemas are not
+ *  regular, and are rejected.
+ * \param schema The JSON schema.
+ * \return The regular expression.
+ */
+std::string JSONSchemaToRegex(const std::string& schema);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_GRAMMAR_MASK_H_
@@ -59,6 +59,16 @@ TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_cache_disagg_prepare_recv")
     .set_body_method(&AttentionKVCacheObj::DisaggPrepareRecv);
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_cache_disagg_mark_send")
     .set_body_method(&AttentionKVCacheObj::DisaggMarkSend);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_cache_disagg_send_sequence")
+    .set_body_method(&AttentionKVCacheObj::DisaggSendSequence);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_cache_disagg_start_recv")
+    .set_body_method(&AttentionKVCacheObj::DisaggStartRecv);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_cache_disagg_poll_recv")
+    .set_body_method(&AttentionKVCacheObj::DisaggPollRecv);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.attention_kv_cache_save_sequence")
+    .set_body_method(&AttentionKVCacheObj::SaveSequence);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.attention_kv_cache_restore_sequence")
+    .set_body_method(&AttentionKVCacheObj::RestoreSequence);
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.attention_kv_cache_enable_sliding_window_for_seq")
     .set_body_method(&AttentionKVCacheObj::EnableSlidingWindowForSeq);
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.attention_kv_cache_commit_accepted_token_tree_nodes")
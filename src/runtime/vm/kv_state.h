@@ -26,6 +26,8 @@
 #include <tvm/runtime/ndarray.h>
 #include <tvm/runtime/object.h>
 
+#include "kv_transport.h"
+
 namespace tvm {
 namespace runtime {
 namespace vm {
@@ -165,6 +167,62 @@ class AttentionKVCacheObj : public KVStateObj {
                               const IntTuple& compressed_remote_position_map,
                               int32_t recver_pe_offset) = 0;
 
+  /*!
+   * \brief Send the KV data of a sequence at positions [begin, length) to the KV cache
+   * of another instance over a KV transport, where the receiver calls DisaggStartRecv.
+   * The pages are streamed a chunk at a time, and the call returns when all of them
+   * are sent. This method is not supposed to be invoked between BeginForward and EndForward.
+   * \param seq_id The id of the sequence to send.
+   * \param begin The first position to send, which the receiver sequence already holds.
+   * \param transport The transport to the receiver.
+   * \return The number of bytes sent.
+   */
+  virtual int64_t DisaggSendSequence(int64_t seq_id, int64_t begin, KVTransport transport) = 0;
+
+  /*!
+   * \brief Start receiving the KV data of a sequence over a KV transport in the
+   * background, so that the receive overlaps with the forward of other sequences.
+   * The received data is written into the pages of the sequence by DisaggPollRecv.
+   * Until the receive completes, the sequence cannot be forwarded, forked or removed.
+   * \param seq_id The id of the receiving sequence, whose length must be the first
+   * position sent.
+   * \param transport The transport from the sender.
+   */
+  virtual void DisaggStartRecv(int64_t seq_id, KVTransport transport) = 0;
+
+  /*!
+   * \brief Write the KV data received so far for a sequence into its pages.
+   * This method is not supposed to be invoked between BeginForward and EndForward.
+   * \param seq_id The id of the receiving sequence.
+   * \return Whether the receive completed, after which the sequence has the sent length.
+   * \throws Error if the receive failed, after which the sequence is back to its
+   * length before the receive.
+   */
+  virtual bool DisaggPollRecv(int64_t seq_id) = 0;
+
+  /************** Persistence **************/
+
+  /*!
+   * \brief Save the KV data and the metadata of a sequence to a file, so that the
+   * sequence can be removed and restored later without recomputing its KV data.
+   * The KV data is streamed to the file a few pages at a time.
+   * This method is not supposed to be invoked between BeginForward and EndForward.
+   * \param seq_id The id of the sequence to save.
+   * \param path The path of the file to write.
+   * \param compress Whether to compress the KV data losslessly.
+   * \return The number of bytes written.
+   */
+  virtual int64_t SaveSequence(int64_t seq_id, const String& path, bool compress) = 0;
+
+  /*!
+   * \brief Restore a sequence saved by SaveSequence into free pages of the KV cache.
+   * The KV cache must have the same configuration as the one the sequence was saved from.
+   * \param seq_id The id of the restored sequence, which must not be in the KV cache.
+   * \param path The path of the file to read.
+   * \return The length of the restored sequence.
+   */
+  virtual int64_t RestoreSequence(int64_t seq_id, const String& path) = 0;
+
   /************** Attention **************/
 
   /*!
@@ -0,0 +1,380 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/kv_transport.cc
+ * \brief The shared memory and TCP transports of KV data.
+ *
+ * The shared memory transport is a single-producer single-consumer ring buffer
+ * in a POSIX shared memory object, for a prefill and a decode instance on the
+ * same host. The TCP transport works across hosts.
+ */
+#include "kv_transport.h"
+
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/logging.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../../support/socket.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+TVM_REGISTER_OBJECT_TYPE(KVTransportObj);
+
+namespace {
+
+constexpr int kConnectTimeoutSec = 600;
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+/*!
+ * \brief Wait until `ready` returns true, spinning first and then sleeping, so that
+ * a steady stream does not pay for the sleeps while an idle wait does not burn a core.
+ */
+template <typename FReady>
+void WaitUntil(FReady ready) {
+  for (int spins = 0; !ready(); ++spins) {
+    if (spins < 1024) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+  }
+}
+
+}  // namespace
+
+/********** Shared Memory Transport **********/
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr uint64_t kShmTransportMagic = 0x505254564b4d5654;  // "TVMKVTRP"
+constexpr size_t kShmHeaderBytes = 4096;
+
+/*!
+ * \brief The header at the beginning of the shared memory object. The positions are
+ * the total number of bytes written and read, so the ring holds `write - read` bytes.
+ */
+struct ShmRingHeader {
+  std::atomic<uint64_t> magic;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> write_pos;
+  alignas(64) std::atomic<uint64_t> read_pos;
+  alignas(64) std::atomic<uint32_t> closed;
+};
+static_assert(sizeof(ShmRingHeader) <= kShmHeaderBytes, "header does not fit in a page");
+
+}  // namespace
+
+/*! \brief The transport over a ring buffer in POSIX shared memory. */
+class ShmKVTransportObj : public KVTransportObj {
+ public:
+  /*!
+   * \brief Create or open the shared memory object of the ring buffer.
+   * \param name The name of the shared memory object, starting with "/".
+   * \param capacity The capacity of the ring buffer in bytes, used by the creator.
+   * \param create Whether to create the object, which the peer then opens.
+   */
+  ShmKVTransportObj(std::string name, int64_t capacity, bool create)
+      : name_(std::move(name)), creator_(create) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kConnectTimeoutSec);
+    int fd;
+    if (create) {
+      CHECK_GT(capacity, 0) << "ValueError: The capacity of the transport must be positive.";
+      fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      CHECK_GE(fd, 0) << "Failed to create shared memory " << name_ << ": " << strerror(errno);
+      if (ftruncate(fd, kShmHeaderBytes + capacity) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name_.c_str());
+        LOG(FATAL) << "Failed to size shared memory " << name_ << ": " << strerror(err);
+      }
+    } else {
+      // Wait for the peer to create and size the object.
+      while ((fd = shm_open(name_.c_str(), O_RDWR, 0)) < 0) {
+        CHECK(errno == ENOENT && std::chrono::steady_clock::now() < deadline)
+            << "Failed to open shared memory " << name_ << ": " << strerror(errno);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      struct stat st;
+      while (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) <= kShmHeaderBytes) {
+        CHECK(std::chrono::steady_clock::now() < deadline)
+            << "Timed out waiting for shared memory " << name_ << " to be created";
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      capacity = st.st_size - kShmHeaderBytes;
+    }
+    map_bytes_ = kShmHeaderBytes + capacity;
+    void* ptr = mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      if (create) shm_unlink(name_.c_str());
+      LOG(FATAL) << "Failed to map shared memory " << name_ << ": " << strerror(err);
+    }
+    header_ = static_cast<ShmRingHeader*>(ptr);
+    ring_ = static_cast<char*>(ptr) + kShmHeaderBytes;
+    if (create) {
+      header_->capacity = capacity;
+      header_->write_pos.store(0, std::memory_order_relaxed);
+      header_->read_pos.store(0, std::memory_order_relaxed);
+      header_->closed.store(0, std::memory_order_relaxed);
+      header_->magic.store(kShmTransportMagic, std::memory_order_release);
+    } else {
+      WaitUntil([&]() {
+        CHECK(std::chrono::steady_clock::now() < deadline)
+            << "Timed out waiting for shared memory " << name_ << " to be initialized";
+        return header_->magic.load(std::memory_order_acquire) == kShmTransportMagic;
+      });
+      CHECK_EQ(header_->capacity, capacity)
+          << "ValueError: Shared memory " << name_ << " is not a KV transport.";
+    }
+  }
+
+  ~ShmKVTransportObj() {
+    Close();
+    munmap(header_, map_bytes_);
+    if (creator_) shm_unlink(name_.c_str());
+  }
+
+  void Send(const void* data, size_t size) final {
+    const char* src = static_cast<const char*>(data);
+    uint64_t capacity = header_->capacity;
+    uint64_t write_pos = header_->write_pos.load(std::memory_order_relaxed);
+    while (size > 0) {
+      uint64_t read_pos = 0;
+      WaitUntil([&]() {
+        CHECK(!header_->closed.load(std::memory_order_acquire))
+            << "The KV transport " << name_ << " is closed.";
+        read_pos = header_->read_pos.load(std::memory_order_acquire);
+        return write_pos - read_pos < capacity;
+      });
+      size_t offset = write_pos % capacity;
+      size_t n = std::min<uint64_t>({size, capacity - (write_pos - read_pos), capacity - offset});
+      std::memcpy(ring_ + offset, src, n);
+      write_pos += n;
+      header_->write_pos.store(write_pos, std::memory_order_release);
+      src += n;
+      size -= n;
+    }
+  }
+
+  void Recv(void* data, size_t size) final {
+    char* dst = static_cast<char*>(data);
+    uint64_t capacity = header_->capacity;
+    uint64_t read_pos = header_->read_pos.load(std::memory_order_relaxed);
+    while (size > 0) {
+      uint64_t write_pos = 0;
+      WaitUntil([&]() {
+        write_pos = header_->write_pos.load(std::memory_order_acquire);
+        if (write_pos != read_pos) return true;
+        // The bytes written before closing can still be received.
+        CHECK(!header_->closed.load(std::memory_order_acquire))
+            << "The KV transport " << name_ << " is closed.";
+        return false;
+      });
+      size_t offset = read_pos % capacity;
+      size_t n = std::min<uint64_t>({size, write_pos - read_pos, capacity - offset});
+      std::memcpy(dst, ring_ + offset, n);
+      read_pos += n;
+      header_->read_pos.store(read_pos, std::memory_order_release);
+      dst += n;
+      size -= n;
+    }
+  }
+
+  void Close() final { header_->closed.store(1, std::memory_order_release); }
+
+  static constexpr const char* _type_key = "relax.vm.ShmKVTransport";
+  TVM_DECLARE_FINAL_OBJECT_INFO(ShmKVTransportObj, KVTransportObj);
+
+ private:
+  std::string name_;
+  bool creator_;
+  size_t map_bytes_;
+  ShmRingHeader* header_;
+  char* ring_;
+};
+
+TVM_REGISTER_OBJECT_TYPE(ShmKVTransportObj);
+
+#endif  // _WIN32
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_transport_shm")
+    .set_body_typed([](String name, int64_t capacity, bool create) -> KVTransport {
+#ifndef _WIN32
+      return KVTransport(make_object<ShmKVTransportObj>(name, capacity, create));
+#else
+      LOG(FATAL) << "The shared memory KV transport is not supported on Windows.";
+#endif
+    });
+
+/********** TCP Transport **********/
+
+/*!
+ * \brief The transport over a TCP connection. The listening side accepts the
+ * connection on its first Send or Recv.
+ */
+class TCPKVTransportObj : public KVTransportObj {
+ public:
+  /*! \brief Listen on the given host and port, where port 0 picks a free port. */
+  static KVTransport Listen(const std::string& host, int port) {
+    support::Socket::Startup();
+    ObjectPtr<TCPKVTransportObj> n = make_object<TCPKVTransportObj>();
+    support::SockAddr addr(host.c_str(), port);
+    n->listen_sock_.Create(addr.ss_family());
+    int reuse = 1;
+    setsockopt(n->listen_sock_.sockfd, SOL_SOCKET, SO_REUSEADDR,
+               reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    n->listen_sock_.Bind(addr);
+    n->listen_sock_.Listen(1);
+    sockaddr_storage bound;
+    socklen_t len = sizeof(bound);
+    getsockname(n->listen_sock_.sockfd, reinterpret_cast<sockaddr*>(&bound), &len);
+    n->port_ = ntohs(bound.ss_family == AF_INET6
+                         ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port
+                         : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+    return KVTransport(n);
+  }
+
+  /*! \brief Connect to the listening peer, retrying until the peer is up. */
+  static KVTransport Connect(const std::string& host, int port) {
+    support::Socket::Startup();
+    ObjectPtr<TCPKVTransportObj> n = make_object<TCPKVTransportObj>();
+    support::SockAddr addr(host.c_str(), port);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kConnectTimeoutSec);
+    while (true) {
+      n->sock_.Create(addr.ss_family());
+      if (n->sock_.Connect(addr)) break;
+      n->sock_.Close();
+      CHECK(std::chrono::steady_clock::now() < deadline)
+          << "Timed out connecting the KV transport to " << host << ":" << port;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    n->SetNoDelay();
+    n->port_ = port;
+    return KVTransport(n);
+  }
+
+  ~TCPKVTransportObj() {
+    if (!sock_.IsClosed()) sock_.Close();
+    if (!listen_sock_.IsClosed()) listen_sock_.Close();
+  }
+
+  void Send(const void* data, size_t size) final {
+    EnsureConnected();
+    const char* buf = static_cast<const char*>(data);
+    while (size > 0) {
+      // A peer that went away must surface as an error rather than SIGPIPE.
+      ssize_t ret = sock_.Send(buf, size, kSendFlags);
+      CHECK_NE(ret, -1) << "The KV transport connection is broken: " << strerror(errno);
+      buf += ret;
+      size -= ret;
+    }
+  }
+
+  void Recv(void* data, size_t size) final {
+    EnsureConnected();
+    CHECK_EQ(sock_.RecvAll(data, size), size) << "The KV transport connection is closed.";
+  }
+
+  void Close() final {
+    closed_.store(true);
+#ifndef _WIN32
+    // Shutting down wakes up the threads blocked on the sockets.
+    shutdown(listen_sock_.sockfd, SHUT_RDWR);
+    int fd = connected_fd_.load();
+    if (fd != support::Socket::INVALID_SOCKET) shutdown(fd, SHUT_RDWR);
+#endif
+  }
+
+  /*! \brief The port the transport listens on or connects to. */
+  int64_t GetPort() const { return port_; }
+
+  static constexpr const char* _type_key = "relax.vm.TCPKVTransport";
+  TVM_DECLARE_FINAL_OBJECT_INFO(TCPKVTransportObj, KVTransportObj);
+
+ private:
+  void EnsureConnected() {
+    std::lock_guard<std::mutex> lock(accept_mutex_);
+    CHECK(!closed_.load()) << "The KV transport is closed.";
+    if (!sock_.IsClosed()) return;
+    sock_ = listen_sock_.Accept();
+    SetNoDelay();
+  }
+
+  /*! \brief Disable Nagle's algorithm on the connection and publish it for Close. */
+  void SetNoDelay() {
+    // The records are large, and the small headers should not wait for them.
+    int nodelay = 1;
+    setsockopt(sock_.sockfd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay),
+               sizeof(nodelay));
+    connected_fd_.store(sock_.sockfd);
+    if (closed_.load()) Close();
+  }
+
+  support::TCPSocket listen_sock_;
+  support::TCPSocket sock_;
+  /*! \brief The connected socket, published for Close on other threads. */
+  std::atomic<int> connected_fd_{support::Socket::INVALID_SOCKET};
+  std::mutex accept_mutex_;
+  std::atomic<bool> closed_{false};
+  int port_ = 0;
+};
+
+TVM_REGISTER_OBJECT_TYPE(TCPKVTransportObj);
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_transport_tcp_listen")
+    .set_body_typed([](String host, int port) { return TCPKVTransportObj::Listen(host, port); });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_transport_tcp_connect")
+    .set_body_typed([](String host, int port) { return TCPKVTransportObj::Connect(host, port); });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_transport_tcp_port")
+    .set_body_typed([](KVTransport transport) {
+      const auto* tcp = transport.as<TCPKVTransportObj>();
+      CHECK(tcp != nullptr) << "ValueError: The KV transport is not a TCP transport.";
+      return tcp->GetPort();
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.kv_transport_close").set_body_method(&KVTransportObj::Close);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
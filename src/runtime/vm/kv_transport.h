@@ -0,0 +1,71 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/kv_transport.h
+ * \brief The byte stream transports that carry KV data from a prefill instance
+ * to a decode instance in disaggregated serving.
+ */
+#ifndef TVM_RUNTIME_VM_KV_TRANSPORT_H_
+#define TVM_RUNTIME_VM_KV_TRANSPORT_H_
+
+#include <tvm/runtime/object.h>
+
+#include <cstddef>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*!
+ * \brief A reliable, ordered byte stream between one sender and one receiver.
+ * Send and Recv block until all the bytes are transferred. One thread may send
+ * while another one receives, and Close may be called from any thread.
+ */
+class KVTransportObj : public Object {
+ public:
+  /*!
+   * \brief Send bytes to the peer.
+   * \throws Error if the transport is closed or broken.
+   */
+  virtual void Send(const void* data, size_t size) = 0;
+
+  /*!
+   * \brief Receive exactly `size` bytes from the peer.
+   * \throws Error if the transport is closed or broken before all bytes arrive.
+   */
+  virtual void Recv(void* data, size_t size) = 0;
+
+  /*! \brief Close the transport, which wakes up the pending Send and Recv with an error. */
+  virtual void Close() = 0;
+
+  static constexpr const char* _type_key = "relax.vm.KVTransport";
+  TVM_DECLARE_BASE_OBJECT_INFO(KVTransportObj, Object);
+};
+
+class KVTransport : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(KVTransport, ObjectRef, KVTransportObj);
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_KV_TRANSPORT_H_
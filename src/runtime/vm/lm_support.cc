@@ -42,9 +42,14 @@
 #include <tvm/runtime/logging.h>
 #include <tvm/runtime/memory/memory_manager.h>
 #include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/threading_backend.h>
 #include <tvm/runtime/vm/vm.h>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
 
 namespace tvm {
 namespace runtime {
@@ -621,6 +626,304 @@ void ApplySoftmaxWithTemperature(NDArray logits, double temperature) {
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.apply_softmax_with_temperature")
     .set_body_typed(ApplySoftmaxWithTemperature);
 
+namespace {
+
+/*! \brief The columns of the per-row parameters of FusedSampleFromLogits. */
+enum FusedSamplingParam : int {
+  kTemperature = 0,
+  kTopP = 1,
+  kTopK = 2,
+  kRepetitionPenalty = 3,
+  kPresencePenalty = 4,
+  kFrequencyPenalty = 5,
+  kNumFusedSamplingParams = 6,
+};
+
+/*! \brief The number of logits per block of the online softmax. */
+constexpr int64_t kSoftmaxBlock = 256;
+/*! \brief The least number of top-p candidates above which the stale ones are pruned. */
+constexpr size_t kMinPruneLimit = 4096;
+/*! \brief The result of FusedSampleRow for a row of logits which are all -inf or NaN. */
+constexpr int32_t kInvalidRow = -1;
+
+/*! \brief Sample from (probability, token) candidates sorted by decreasing probability. */
+int32_t SampleSortedCandidates(const std::vector<std::pair<float, int32_t>>& candidates,
+                               double top_p, double uniform_sample) {
+  // Keep the most likely candidates until their probability reaches top_p.
+  float cum_sum_prob = 0.0f;
+  size_t num_kept = 0;
+  while (num_kept < candidates.size() && (num_kept == 0 || cum_sum_prob < top_p)) {
+    cum_sum_prob += candidates[num_kept++].first;
+  }
+  float target = static_cast<float>(uniform_sample) * cum_sum_prob;
+  float cum = 0.0f;
+  for (size_t i = 0; i < num_kept; ++i) {
+    cum += candidates[i].first;
+    if (target < cum) return candidates[i].second;
+  }
+  return candidates[num_kept - 1].second;
+}
+
+/*!
+ * \brief Penalize, filter and sample one row of logits.
+ * \param row The logits of the row, penalized in place.
+ * \param candidates The scratch space of the row.
+ * \return The sampled token, or kInvalidRow if the logits are all -inf or NaN. The rows run
+ * in the thread pool, where no error can be thrown, so the caller raises it.
+ */
+int32_t FusedSampleRow(float* row, int64_t vocab_size, const float* params, const int32_t* ids,
+                       const int32_t* freqs, int64_t num_ids, double uniform_sample,
+                       std::vector<std::pair<float, int32_t>>* candidates) {
+  constexpr float kNegInf = -std::numeric_limits<float>::infinity();
+  // Penalties only touch the appeared tokens.
+  float repetition_penalty = params[kRepetitionPenalty];
+  float presence_penalty = params[kPresencePenalty];
+  float frequency_penalty = params[kFrequencyPenalty];
+  for (int64_t i = 0; i < num_ids; ++i) {
+    float& logit = row[ids[i]];
+    if (repetition_penalty != 1.0f) {
+      logit = logit <= 0 ? logit * repetition_penalty : logit / repetition_penalty;
+    }
+    logit -= freqs[i] * frequency_penalty + presence_penalty;
+  }
+
+  float temperature = params[kTemperature];
+  double top_p = params[kTopP];
+  int64_t top_k = std::min<int64_t>(static_cast<int64_t>(params[kTopK]), vocab_size);
+  if (temperature < 1e-6f || top_k == 1) {
+    return static_cast<int32_t>(std::max_element(row, row + vocab_size) - row);
+  }
+  float inv_temp = 1.0f / temperature;
+  candidates->clear();
+
+  if (top_k > 0) {
+    // Top-k: keep a min-heap of the k largest logits in a single pass.
+    auto fcmp = [](const std::pair<float, int32_t>& lhs, const std::pair<float, int32_t>& rhs) {
+      return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    };
+    for (int64_t i = 0; i < vocab_size; ++i) {
+      if (static_cast<int64_t>(candidates->size()) < top_k) {
+        candidates->emplace_back(row[i], static_cast<int32_t>(i));
+        std::push_heap(candidates->begin(), candidates->end(), fcmp);
+      } else if (row[i] > candidates->front().first) {
+        std::pop_heap(candidates->begin(), candidates->end(), fcmp);
+        candidates->back() = {row[i], static_cast<int32_t>(i)};
+        std::push_heap(candidates->begin(), candidates->end(), fcmp);
+      }
+    }
+    std::sort_heap(candidates->begin(), candidates->end(), fcmp);
+    // Softmax over the k candidates.
+    float max_logit = candidates->front().first;
+    float sum = 0.0f;
+    for (auto& [value, token] : *candidates) {
+      value = std::exp((value - max_logit) * inv_temp);
+      sum += value;
+    }
+    if (max_logit == kNegInf || std::isnan(sum)) return kInvalidRow;
+    for (auto& [value, token] : *candidates) value /= sum;
+    return SampleSortedCandidates(*candidates, top_p, uniform_sample);
+  }
+
+  // Online softmax over blocks. For top-p, the logits whose probability may reach the
+  // cutoff top_p / 1024 are collected along the way. As the running max only grows,
+  // the running threshold selects a superset of them.
+  const float log_cutoff = top_p < 1 ? std::log(static_cast<float>(top_p) / 1024) : kNegInf;
+  float max_logit = kNegInf;
+  float sum = 0.0f;
+  float threshold = kNegInf;
+  size_t prune_limit = kMinPruneLimit;
+  for (int64_t begin = 0; begin < vocab_size; begin += kSoftmaxBlock) {
+    int64_t end = std::min(begin + kSoftmaxBlock, vocab_size);
+    float block_max = *std::max_element(row + begin, row + end);
+    if (block_max == kNegInf) continue;
+    if (block_max > max_logit) {
+      sum *= std::exp((max_logit - block_max) * inv_temp);
+      max_logit = block_max;
+      threshold = max_logit + log_cutoff * temperature;
+    }
+    for (int64_t i = begin; i < end; ++i) {
+      sum += std::exp((row[i] - max_logit) * inv_temp);
+    }
+    if (top_p < 1) {
+      for (int64_t i = begin; i < end; ++i) {
+        if (row[i] >= threshold) candidates->emplace_back(row[i], static_cast<int32_t>(i));
+      }
+      // Drop the candidates collected under a lower running max.
+      if (candidates->size() > prune_limit) {
+        candidates->erase(std::remove_if(candidates->begin(), candidates->end(),
+                                         [threshold](const std::pair<float, int32_t>& c) {
+                                           return c.first < threshold;
+                                         }),
+                          candidates->end());
+        prune_limit = std::max(kMinPruneLimit, 2 * candidates->size());
+      }
+    }
+  }
+  if (max_logit == kNegInf || std::isnan(sum)) return kInvalidRow;
+
+  if (top_p < 1) {
+    float prob_cutoff = static_cast<float>(top_p) / 1024;
+    size_t num_candidates = 0;
+    float cum_sum_prob = 0.0f;
+    for (const auto& [value, token] : *candidates) {
+      float prob = std::exp((value - max_logit) * inv_temp) / sum;
+      if (prob >= prob_cutoff) {
+        (*candidates)[num_candidates++] = {prob, token};
+        cum_sum_prob += prob;
+      }
+    }
+    candidates->resize(num_candidates);
+    auto fcmp = [](const std::pair<float, int32_t>& lhs, const std::pair<float, int32_t>& rhs) {
+      return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    };
+    if (cum_sum_prob >= top_p) {
+      std::sort(candidates->begin(), candidates->end(), fcmp);
+      return SampleSortedCandidates(*candidates, top_p, uniform_sample);
+    }
+    // The distribution is too flat for the cutoff. Select growing prefixes of the whole
+    // vocabulary until they cover top_p, rather than sorting all of it.
+    candidates->resize(vocab_size);
+    for (int64_t i = 0; i < vocab_size; ++i) {
+      (*candidates)[i] = {std::exp((row[i] - max_logit) * inv_temp) / sum, static_cast<int32_t>(i)};
+    }
+    for (int64_t k = kMinPruneLimit;; k *= 4) {
+      if (k >= vocab_size) {
+        std::sort(candidates->begin(), candidates->end(), fcmp);
+        break;
+      }
+      std::nth_element(candidates->begin(), candidates->begin() + k, candidates->end(), fcmp);
+      float prefix_sum = 0.0f;
+      for (int64_t i = 0; i < k; ++i) prefix_sum += (*candidates)[i].first;
+      if (prefix_sum >= top_p) {
+        candidates->resize(k);
+        std::sort(candidates->begin(), candidates->end(), fcmp);
+        break;
+      }
+    }
+    return SampleSortedCandidates(*candidates, top_p, uniform_sample);
+  }
+
+  // Plain multinomial sampling in vocabulary order, which stops at the sampled token.
+  float target = static_cast<float>(uniform_sample) * sum;
+  float cum = 0.0f;
+  int64_t last_valid = 0;
+  for (int64_t i = 0; i < vocab_size; ++i) {
+    if (row[i] == kNegInf) continue;
+    cum += std::exp((row[i] - max_logit) * inv_temp);
+    last_valid = i;
+    if (target < cum) return static_cast<int32_t>(i);
+  }
+  return static_cast<int32_t>(last_valid);
+}
+
+}  // namespace
+
+/*!
+ * \brief Penalize, filter and sample a batch of logits in one builtin.
+ *
+ * Each row goes through the repetition, presence and frequency penalties, the softmax
+ * with temperature, the top-k and top-p filtering and the multinomial sampling. The
+ * rows run in parallel, and each of them is read in a single pass in the common cases,
+ * instead of one pass per step when chaining the separate builtins.
+ *
+ * \param logits The float32 logits of shape (batch_size, vocab_size). The penalties are
+ * applied in place when the logits are on CPU.
+ * \param sampling_params The float32 parameters of shape (batch_size, 6), with columns
+ * temperature, top_p, top_k, repetition_penalty, presence_penalty and frequency_penalty.
+ * A temperature close to 0 or a top_k of 1 samples greedily, a top_k of 0 disables top-k.
+ * \param uniform_samples The float32 uniform samples in [0, 1) of shape (batch_size,).
+ * \param token_indptr The int32 indptr of shape (batch_size + 1,) of the appeared tokens.
+ * \param token_ids The int32 ids of the unique appeared tokens of all the rows.
+ * \param token_freqs The int32 number of appearances of each appeared token.
+ * \return The int32 sampled token ids of shape (batch_size,) on CPU.
+ */
+NDArray FusedSampleFromLogits(NDArray logits, NDArray sampling_params, NDArray uniform_samples,
+                              NDArray token_indptr, NDArray token_ids, NDArray token_freqs) {
+  Device cpu{kDLCPU, 0};
+  auto f_to_cpu = [&cpu](NDArray arr) {
+    ICHECK(arr.IsContiguous());
+    return arr->device.device_type == kDLCPU ? arr : arr.CopyTo(cpu);
+  };
+  logits = f_to_cpu(logits);
+  sampling_params = f_to_cpu(sampling_params);
+  uniform_samples = f_to_cpu(uniform_samples);
+  token_indptr = f_to_cpu(token_indptr);
+  token_ids = f_to_cpu(token_ids);
+  token_freqs = f_to_cpu(token_freqs);
+
+  CHECK(logits.DataType() == DataType::Float(32) && logits->ndim == 2)
+      << "ValueError: The logits must be a float32 (batch_size, vocab_size) array";
+  int64_t batch_size = logits->shape[0];
+  int64_t vocab_size = logits->shape[1];
+  CHECK(sampling_params.DataType() == DataType::Float(32) && sampling_params->ndim == 2 &&
+        sampling_params->shape[0] == batch_size &&
+        sampling_params->shape[1] == kNumFusedSamplingParams)
+      << "ValueError: The sampling parameters must be a float32 (batch_size, "
+      << kNumFusedSamplingParams << ") array";
+  CHECK(uniform_samples.DataType() == DataType::Float(32) &&
+        uniform_samples.Shape().Product() == batch_size)
+      << "ValueError: There must be one float32 uniform sample per row";
+  CHECK(token_indptr.DataType() == DataType::Int(32) &&
+        token_indptr.Shape().Product() == batch_size + 1)
+      << "ValueError: The token indptr must be an int32 array of batch_size + 1 elements";
+  CHECK(token_ids.DataType() == DataType::Int(32) && token_freqs.DataType() == DataType::Int(32) &&
+        token_ids.Shape().Product() == token_freqs.Shape().Product())
+      << "ValueError: The token ids and frequencies must be int32 arrays of the same size";
+
+  float* plogits = static_cast<float*>(logits->data);
+  const float* pparams = static_cast<const float*>(sampling_params->data);
+  const float* psamples = static_cast<const float*>(uniform_samples->data);
+  const int32_t* pindptr = static_cast<const int32_t*>(token_indptr->data);
+  const int32_t* pids = static_cast<const int32_t*>(token_ids->data);
+  const int32_t* pfreqs = static_cast<const int32_t*>(token_freqs->data);
+  // The rows index the logits with the appeared tokens, check them before sampling in parallel.
+  int64_t num_token_ids = token_ids.Shape().Product();
+  CHECK_GE(pindptr[0], 0) << "ValueError: The token indptr must be non-negative, but got "
+                          << pindptr[0];
+  for (int64_t i = 0; i < batch_size; ++i) {
+    CHECK(pindptr[i] <= pindptr[i + 1] && pindptr[i + 1] <= num_token_ids)
+        << "ValueError: The token indptr must be non-decreasing and bounded by the "
+        << num_token_ids << " token ids, but got " << pindptr[i] << " and " << pindptr[i + 1]
+        << " for row " << i;
+  }
+  for (int64_t j = pindptr[0]; j < pindptr[batch_size]; ++j) {
+    CHECK(pids[j] >= 0 && pids[j] < vocab_size)
+        << "ValueError: The token id " << pids[j] << " is out of the vocabulary of size "
+        << vocab_size;
+  }
+  NDArray result = NDArray::Empty({batch_size}, DataType::Int(32), cpu);
+  int32_t* presult = static_cast<int32_t*>(result->data);
+
+  auto f_sample_rows = [&](int64_t begin, int64_t end) {
+    std::vector<std::pair<float, int32_t>> candidates;
+    for (int64_t i = begin; i < end; ++i) {
+      presult[i] = FusedSampleRow(plogits + i * vocab_size, vocab_size,
+                                  pparams + i * kNumFusedSamplingParams, pids + pindptr[i],
+                                  pfreqs + pindptr[i], pindptr[i + 1] - pindptr[i], psamples[i],
+                                  &candidates);
+    }
+  };
+  int num_tasks = std::min<int64_t>(batch_size, threading::MaxConcurrency());
+  if (num_tasks <= 1) {
+    f_sample_rows(0, batch_size);
+  } else {
+    parallel_for_with_threading_backend(
+        [&](int64_t task_id) {
+          f_sample_rows(batch_size * task_id / num_tasks, batch_size * (task_id + 1) / num_tasks);
+        },
+        0, num_tasks);
+  }
+  for (int64_t i = 0; i < batch_size; ++i) {
+    CHECK_NE(presult[i], kInvalidRow)
+        << "ValueError: Cannot sample from row " << i
+        << " of logits, which are all -inf or NaN";
+  }
+  return result;
+}
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.fused_sample_from_logits")
+    .set_body_typed(FusedSampleFromLogits);
+
 }  // namespace vm
 }  // namespace runtime
 }  // namespace tvm
@@ -0,0 +1,444 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/lora_adapter.cc
+ * \brief Runtime support of serving many LoRA adapters of one base model in a batch.
+ *
+ *  The adapters live in a pool of slots, with for each target linear weight W of shape
+ *  (out_features, in_features) a stacked `lora_a` array of shape (num_slots, max_rank,
+ *  in_features) and a stacked `lora_b` array of shape (num_slots, out_features, max_rank),
+ *  plus the scaling of each slot. Adapters are hot-loaded into a free slot from the
+ *  ndarray cache format, while the other slots keep serving.
+ *
+ *  Within a forward, each token selects its adapter slot through an adapter-id array,
+ *  and `vm.builtin.lora_segmented_gemm` computes the LoRA branch of all the tokens at
+ *  once. The relax pass `InsertLoRABranch` inserts such calls after the target linear
+ *  layers of a model.
+ */
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/container/map.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/int_tuple.h>
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/threading_backend.h>
+#include <tvm/runtime/vm/ndarray_cache_support.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+/*! \brief A dot product with independent partial sums, which lets the compiler vectorize it. */
+inline float Dot(const float* lhs, const float* rhs, int64_t n) {
+  constexpr int kLanes = 8;
+  float partial[kLanes] = {0.0f};
+  int64_t k = 0;
+  for (; k + kLanes <= n; k += kLanes) {
+    for (int j = 0; j < kLanes; ++j) partial[j] += lhs[k + j] * rhs[k + j];
+  }
+  float sum = 0.0f;
+  for (; k < n; ++k) sum += lhs[k] * rhs[k];
+  for (int j = 0; j < kLanes; ++j) sum += partial[j];
+  return sum;
+}
+
+}  // namespace
+
+/*!
+ * \brief Compute the LoRA branch of a batch of tokens, each with its own adapter.
+ *
+ * For each token i with adapter slot s = adapter_ids[i], computes
+ * `out[i] = scaling[s] * lora_b[s] @ (lora_a[s] @ x[i])`, or zeros when s is -1.
+ * The tokens are grouped by adapter, so that the weights of each adapter are read once
+ * per group of tokens rather than once per token.
+ *
+ * \param x The float32 input of shape (..., in_features) on CPU.
+ * \param lora_a The float32 stacked A matrices of shape (num_slots, rank, in_features).
+ * \param lora_b The float32 stacked B matrices of shape (num_slots, out_features, rank).
+ * \param scaling The float32 scaling of each slot, of shape (num_slots,).
+ * \param adapter_ids The int32 adapter slot of each token, with as many elements as the
+ * leading dimensions of `x`.
+ * \param out The float32 output of shape (..., out_features).
+ */
+void LoRASegmentedGEMM(NDArray x, NDArray lora_a, NDArray lora_b, NDArray scaling,
+                       NDArray adapter_ids, NDArray out) {
+  for (const NDArray& arr : {x, lora_a, lora_b, scaling, adapter_ids, out}) {
+    CHECK_EQ(arr->device.device_type, kDLCPU)
+        << "ValueError: lora_segmented_gemm only supports CPU arrays";
+    ICHECK(arr.IsContiguous());
+  }
+  for (const NDArray& arr : {x, lora_a, lora_b, scaling, out}) {
+    CHECK(arr.DataType() == DataType::Float(32))
+        << "ValueError: lora_segmented_gemm only supports float32, but got " << arr.DataType();
+  }
+  CHECK(adapter_ids.DataType() == DataType::Int(32))
+      << "ValueError: The adapter ids must be int32, but got " << adapter_ids.DataType();
+  CHECK(x->ndim >= 1 && out->ndim == x->ndim && lora_a->ndim == 3 && lora_b->ndim == 3)
+      << "ValueError: Invalid ranks of the arrays of lora_segmented_gemm";
+  int64_t in_features = x->shape[x->ndim - 1];
+  int64_t out_features = out->shape[out->ndim - 1];
+  int64_t num_slots = lora_a->shape[0];
+  int64_t rank = lora_a->shape[1];
+  int64_t num_tokens = x.Shape().Product() / std::max<int64_t>(in_features, 1);
+  CHECK(lora_a->shape[2] == in_features && lora_b->shape[0] == num_slots &&
+        lora_b->shape[1] == out_features && lora_b->shape[2] == rank)
+      << "ValueError: The LoRA weights of shapes " << lora_a.Shape() << " and " << lora_b.Shape()
+      << " do not match the input features " << in_features << " and output features "
+      << out_features;
+  CHECK(scaling.Shape().Product() == num_slots)
+      << "ValueError: Expected " << num_slots << " scaling factors, but got " << scaling.Shape();
+  CHECK(adapter_ids.Shape().Product() == num_tokens)
+      << "ValueError: Expected " << num_tokens << " adapter ids, but got " << adapter_ids.Shape();
+  CHECK(out.Shape().Product() == num_tokens * out_features)
+      << "ValueError: The output shape " << out.Shape() << " does not match the input shape "
+      << x.Shape();
+
+  auto f_data = [](const NDArray& arr) {
+    return reinterpret_cast<char*>(arr->data) + arr->byte_offset;
+  };
+  const float* x_data = reinterpret_cast<const float*>(f_data(x));
+  const float* a_data = reinterpret_cast<const float*>(f_data(lora_a));
+  const float* b_data = reinterpret_cast<const float*>(f_data(lora_b));
+  const float* scaling_data = reinterpret_cast<const float*>(f_data(scaling));
+  const int32_t* ids = reinterpret_cast<const int32_t*>(f_data(adapter_ids));
+  float* out_data = reinterpret_cast<float*>(f_data(out));
+
+  // Group the tokens by adapter with a counting sort, keeping their order in each group.
+  std::vector<int64_t> segment_indptr(num_slots + 1, 0);
+  for (int64_t i = 0; i < num_tokens; ++i) {
+    CHECK(ids[i] >= -1 && ids[i] < num_slots)
+        << "ValueError: Invalid adapter id " << ids[i] << " of token " << i << ", there are "
+        << num_slots << " adapter slots";
+    if (ids[i] >= 0) {
+      ++segment_indptr[ids[i] + 1];
+    } else {
+      std::fill(out_data + i * out_features, out_data + (i + 1) * out_features, 0.0f);
+    }
+  }
+  for (int64_t s = 0; s < num_slots; ++s) segment_indptr[s + 1] += segment_indptr[s];
+  std::vector<int64_t> token_order(segment_indptr[num_slots]);
+  {
+    std::vector<int64_t> cursor(segment_indptr.begin(), segment_indptr.end() - 1);
+    for (int64_t i = 0; i < num_tokens; ++i) {
+      if (ids[i] >= 0) token_order[cursor[ids[i]]++] = i;
+    }
+  }
+
+  // Each task computes a block of tokens of the same adapter, reusing every row of the
+  // adapter weights across the tokens of the block.
+  constexpr int64_t kTokensPerTask = 16;
+  std::vector<std::pair<int64_t, int64_t>> tasks;
+  for (int64_t s = 0; s < num_slots; ++s) {
+    for (int64_t begin = segment_indptr[s]; begin < segment_indptr[s + 1];
+         begin += kTokensPerTask) {
+      tasks.emplace_back(s, begin);
+    }
+  }
+  parallel_for_with_threading_backend(
+      [&](int64_t task_id) {
+        int64_t slot = tasks[task_id].first;
+        int64_t begin = tasks[task_id].second;
+        int64_t end = std::min(begin + kTokensPerTask, segment_indptr[slot + 1]);
+        const float* a = a_data + slot * rank * in_features;
+        const float* b = b_data + slot * out_features * rank;
+        std::vector<float> hidden((end - begin) * rank);
+        for (int64_t r = 0; r < rank; ++r) {
+          const float* a_row = a + r * in_features;
+          for (int64_t t = begin; t < end; ++t) {
+            const float* x_row = x_data + token_order[t] * in_features;
+            hidden[(t - begin) * rank + r] = Dot(a_row, x_row, in_features) * scaling_data[slot];
+          }
+        }
+        for (int64_t t = begin; t < end; ++t) {
+          const float* h = hidden.data() + (t - begin) * rank;
+          float* out_row = out_data + token_order[t] * out_features;
+          for (int64_t o = 0; o < out_features; ++o) out_row[o] = Dot(b + o * rank, h, rank);
+        }
+      },
+      0, static_cast<int64_t>(tasks.size()));
+}
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_segmented_gemm").set_body_typed(LoRASegmentedGEMM);
+
+/*! \brief A pool of LoRA adapter slots over a fixed set of target linear weights. */
+class LoRAAdapterPoolObj : public Object {
+ public:
+  /*!
+   * \brief Create an empty pool.
+   * \param targets The names of the target weights, e.g. "model.layers.0.q_proj.weight".
+   * \param target_shapes The shape (out_features, in_features) of each target weight.
+   * \param num_slots The maximum number of adapters loaded at the same time.
+   * \param max_rank The maximum rank of the adapters.
+   * \param dtype The data type of the adapter weights.
+   * \param device The device of the pool.
+   */
+  LoRAAdapterPoolObj(Array<String> targets, Array<IntTuple> target_shapes, int64_t num_slots,
+                     int64_t max_rank, DLDataType dtype, Device device)
+      : num_slots_(num_slots), max_rank_(max_rank), dtype_(dtype), device_(device) {
+    CHECK_EQ(targets.size(), target_shapes.size())
+        << "ValueError: Got " << targets.size() << " targets but " << target_shapes.size()
+        << " target shapes";
+    CHECK(num_slots > 0 && max_rank > 0)
+        << "ValueError: The number of slots and the maximum rank must be positive";
+    for (size_t i = 0; i < targets.size(); ++i) {
+      CHECK_EQ(target_shapes[i].size(), 2)
+          << "ValueError: The target " << targets[i] << " must be a 2-D weight";
+      int64_t out_features = target_shapes[i][0];
+      int64_t in_features = target_shapes[i][1];
+      Target target;
+      target.name = targets[i];
+      target.lora_a = NDArray::Empty({num_slots, max_rank, in_features}, dtype, device);
+      target.lora_b = NDArray::Empty({num_slots, out_features, max_rank}, dtype, device);
+      targets_.push_back(std::move(target));
+    }
+    scaling_ = NDArray::Empty({num_slots}, DataType::Float(32), device);
+    for (int64_t slot = num_slots - 1; slot >= 0; --slot) {
+      ClearSlot(slot);
+      free_slots_.push_back(slot);
+    }
+  }
+
+  /*!
+   * \brief Load an adapter from an ndarray cache directory into a slot, replacing the
+   * adapter of the same name if it is already loaded.
+   *
+   * The cache holds the arrays "<target>.lora_a" of shape (rank, in_features) and
+   * "<target>.lora_b" of shape (out_features, rank) for the targets the adapter covers.
+   * Adapters of a rank lower than the pool are zero padded.
+   *
+   * \param name The name of the adapter.
+   * \param cache_path The ndarray cache directory.
+   * \param alpha The LoRA alpha of the adapter. The scaling of the adapter is alpha / rank.
+   * \return The slot of the adapter.
+   */
+  int64_t Load(String name, String cache_path, double alpha) {
+    NDArrayCacheMetadata metadata = NDArrayCacheMetadata::Load(cache_path);
+    std::unordered_map<std::string, int64_t> target_index;
+    for (size_t i = 0; i < targets_.size(); ++i) target_index[targets_[i].name] = i;
+
+    // Load all the records first, so that a failure leaves the pool unchanged.
+    std::vector<NDArray> host_a(targets_.size());
+    std::vector<NDArray> host_b(targets_.size());
+    int64_t rank = -1;
+    std::string raw_data;
+    Device cpu{kDLCPU, 0};
+    for (const NDArrayCacheMetadata::FileRecord& file : metadata.records) {
+      Array<NDArray> arrays = file.Load(cpu, metadata.path, &raw_data);
+      for (size_t j = 0; j < file.records.size(); ++j) {
+        const std::string& record_name = file.records[j].name;
+        size_t dot = record_name.rfind('.');
+        std::string suffix = dot == std::string::npos ? "" : record_name.substr(dot + 1);
+        auto it = target_index.find(record_name.substr(0, dot));
+        CHECK(it != target_index.end() && (suffix == "lora_a" || suffix == "lora_b"))
+            << "ValueError: The array " << record_name << " of adapter " << name
+            << " is not the lora_a or lora_b array of a target of the pool";
+        NDArray arr = arrays[j];
+        const IntTuple& target_shape = Shape(it->second);
+        CHECK_EQ(arr->ndim, 2) << "ValueError: The array " << record_name << " of adapter "
+                               << name << " must be 2-D, but got shape " << arr.Shape();
+        int64_t arr_rank = suffix == "lora_a" ? arr->shape[0] : arr->shape[1];
+        bool shape_ok = suffix == "lora_a" ? arr->shape[1] == target_shape[1]
+                                           : arr->shape[0] == target_shape[0];
+        CHECK(shape_ok && arr_rank <= max_rank_ && (rank == -1 || arr_rank == rank))
+            << "ValueError: The array " << record_name << " of adapter " << name
+            << " has an invalid shape " << arr.Shape() << " for the target of shape "
+            << target_shape << " and the maximum rank " << max_rank_;
+        CHECK(arr.DataType() == DataType(dtype_))
+            << "ValueError: The array " << record_name << " of adapter " << name << " has dtype "
+            << arr.DataType() << ", but the pool has dtype " << DataType(dtype_);
+        rank = arr_rank;
+        (suffix == "lora_a" ? host_a : host_b)[it->second] = arr;
+      }
+    }
+    CHECK_GT(rank, 0) << "ValueError: The adapter " << name << " has no LoRA weights";
+    for (size_t i = 0; i < targets_.size(); ++i) {
+      CHECK_EQ(host_a[i].defined(), host_b[i].defined())
+          << "ValueError: The adapter " << name << " has only one of the lora_a and lora_b "
+          << "arrays of target " << targets_[i].name;
+    }
+
+    int64_t slot;
+    auto it = slot_of_adapter_.find(name);
+    if (it != slot_of_adapter_.end()) {
+      slot = it->second;
+    } else {
+      CHECK(!free_slots_.empty()) << "ValueError: The LoRA adapter pool is full with "
+                                  << num_slots_ << " adapters, unload one first";
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+      slot_of_adapter_[name] = slot;
+    }
+    ClearSlot(slot);
+    int64_t elem_bytes = DataType(dtype_).bytes();
+    for (size_t i = 0; i < targets_.size(); ++i) {
+      if (!host_a[i].defined()) continue;
+      const IntTuple& shape = Shape(i);
+      int64_t out_features = shape[0];
+      int64_t in_features = shape[1];
+      // lora_a rows beyond the rank stay zero, so its slot starts with the adapter rows.
+      SlotView(targets_[i].lora_a, slot)
+          .CreateView({rank, in_features}, dtype_)
+          .CopyFromBytes(host_a[i]->data, rank * in_features * elem_bytes);
+      // lora_b columns beyond the rank stay zero, so its rows are padded on the host.
+      std::vector<char> padded_b(out_features * max_rank_ * elem_bytes, 0);
+      const char* b_data = static_cast<const char*>(host_b[i]->data);
+      for (int64_t o = 0; o < out_features; ++o) {
+        std::memcpy(padded_b.data() + o * max_rank_ * elem_bytes,
+                    b_data + o * rank * elem_bytes, rank * elem_bytes);
+      }
+      SlotView(targets_[i].lora_b, slot).CopyFromBytes(padded_b.data(), padded_b.size());
+    }
+    SetScaling(slot, static_cast<float>(alpha / rank));
+    return slot;
+  }
+
+  /*! \brief Unload an adapter, freeing its slot. */
+  void Unload(String name) {
+    auto it = slot_of_adapter_.find(name);
+    CHECK(it != slot_of_adapter_.end()) << "ValueError: The adapter " << name << " is not loaded";
+    // Zero the scaling, so that stale adapter ids of the slot contribute nothing.
+    ClearSlot(it->second);
+    free_slots_.push_back(it->second);
+    slot_of_adapter_.erase(it);
+  }
+
+  /*! \return The slot of an adapter, or -1 for the empty name which selects the base model. */
+  int64_t GetSlot(String name) const {
+    if (name.empty()) return -1;
+    auto it = slot_of_adapter_.find(name);
+    CHECK(it != slot_of_adapter_.end()) << "ValueError: The adapter " << name << " is not loaded";
+    return it->second;
+  }
+
+  /*!
+   * \brief The arrays to pass to a model after its adapter ids, in the parameter order of
+   * `InsertLoRABranch`: the scaling, then the lora_a and lora_b arrays of each target.
+   */
+  Array<NDArray> GetParams() const {
+    Array<NDArray> params{scaling_};
+    for (const Target& target : targets_) {
+      params.push_back(target.lora_a);
+      params.push_back(target.lora_b);
+    }
+    return params;
+  }
+
+  /*!
+   * \brief Create the adapter ids of a batch of sequences.
+   * \param adapter_names The adapter of each sequence, the empty name for the base model.
+   * \param num_tokens The number of tokens of each sequence in the forward.
+   * \return The int32 adapter slot of each token, on the device of the pool.
+   */
+  NDArray TokenAdapterIds(Array<String> adapter_names, IntTuple num_tokens) const {
+    CHECK_EQ(adapter_names.size(), num_tokens.size())
+        << "ValueError: Got " << adapter_names.size() << " adapters for " << num_tokens.size()
+        << " sequences";
+    std::vector<int32_t> ids;
+    for (size_t i = 0; i < adapter_names.size(); ++i) {
+      ids.insert(ids.end(), num_tokens[i], static_cast<int32_t>(GetSlot(adapter_names[i])));
+    }
+    NDArray result = NDArray::Empty({static_cast<int64_t>(ids.size())}, DataType::Int(32), device_);
+    result.CopyFromBytes(ids.data(), ids.size() * sizeof(int32_t));
+    return result;
+  }
+
+  static constexpr const char* _type_key = "relax.vm.LoRAAdapterPool";
+  TVM_DECLARE_FINAL_OBJECT_INFO(LoRAAdapterPoolObj, Object);
+
+ private:
+  struct Target {
+    std::string name;
+    NDArray lora_a;
+    NDArray lora_b;
+  };
+
+  IntTuple Shape(size_t target) const {
+    return IntTuple{targets_[target].lora_b->shape[1], targets_[target].lora_a->shape[2]};
+  }
+
+  /*! \return The view of the slot of a stacked array. */
+  NDArray SlotView(const NDArray& arr, int64_t slot) const {
+    std::vector<int64_t> shape(arr->shape + 1, arr->shape + arr->ndim);
+    int64_t slot_bytes = GetDataSize(*arr.operator->()) / num_slots_;
+    return arr.CreateView(IntTuple(shape), arr->dtype, slot * slot_bytes);
+  }
+
+  /*! \brief Zero the weights and the scaling of a slot. */
+  void ClearSlot(int64_t slot) {
+    for (const Target& target : targets_) {
+      for (const NDArray& arr : {target.lora_a, target.lora_b}) {
+        NDArray view = SlotView(arr, slot);
+        std::vector<char> zeros(GetDataSize(*view.operator->()), 0);
+        view.CopyFromBytes(zeros.data(), zeros.size());
+      }
+    }
+    SetScaling(slot, 0.0f);
+  }
+
+  void SetScaling(int64_t slot, float scale) {
+    scaling_.CreateView({1}, scaling_->dtype, slot * sizeof(float))
+        .CopyFromBytes(&scale, sizeof(float));
+  }
+
+  int64_t num_slots_;
+  int64_t max_rank_;
+  DLDataType dtype_;
+  Device device_;
+  std::vector<Target> targets_;
+  NDArray scaling_;
+  std::unordered_map<std::string, int64_t> slot_of_adapter_;
+  std::vector<int64_t> free_slots_;
+};
+
+class LoRAAdapterPool : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(LoRAAdapterPool, ObjectRef, LoRAAdapterPoolObj);
+};
+
+TVM_REGISTER_OBJECT_TYPE(LoRAAdapterPoolObj);
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_create")
+    .set_body_typed([](Array<String> targets, Array<IntTuple> target_shapes, int64_t num_slots,
+                       int64_t max_rank, DLDataType dtype, Device device) {
+      return LoRAAdapterPool(make_object<LoRAAdapterPoolObj>(targets, target_shapes, num_slots,
+                                                             max_rank, dtype, device));
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_load")
+    .set_body_method(&LoRAAdapterPoolObj::Load);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_unload")
+    .set_body_method(&LoRAAdapterPoolObj::Unload);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_get_slot")
+    .set_body_method(&LoRAAdapterPoolObj::GetSlot);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_get_params")
+    .set_body_method(&LoRAAdapterPoolObj::GetParams);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.lora_adapter_pool_token_adapter_ids")
+    .set_body_method(&LoRAAdapterPoolObj::TokenAdapterIds);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
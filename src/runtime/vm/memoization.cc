@@ -0,0 +1,384 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/memoization.cc
+ * \brief The memoization of the calls to the Relax functions marked with "relax.memoize".
+ */
+
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/vm/vm.h>
+
+#include <cstring>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+constexpr uint64_t kPrime32_1 = 0x9E3779B1ULL;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+/*! \brief The keys mixed into the lanes of the accumulator. */
+constexpr uint64_t kSecret[8] = {0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL,
+                                 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+                                 0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL,
+                                 0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL};
+
+/*! \brief The number of bytes consumed by each step of the accumulator. */
+constexpr size_t kStripeBytes = 64;
+/*! \brief The number of stripes between two scrambles of the accumulator. */
+constexpr size_t kStripesPerBlock = 16;
+
+inline uint64_t Read64(const uint8_t* ptr) {
+  uint64_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime64_2;
+  h ^= h >> 29;
+  h *= kPrime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+/*!
+ * \brief Accumulate a stripe into the eight lanes, with the 32x32->64 multiplications of XXH3.
+ * The lanes are independent of each other, so that the loop is vectorized by the compiler into
+ * SSE2/AVX2/NEON multiplications.
+ */
+inline void Accumulate(uint64_t* acc, const uint8_t* stripe) {
+  for (int i = 0; i < 8; ++i) {
+    uint64_t data = Read64(stripe + 8 * i);
+    uint64_t key = data ^ kSecret[i];
+    acc[i ^ 1] += data;
+    acc[i] += (key & 0xFFFFFFFFULL) * (key >> 32);
+  }
+}
+
+inline void Scramble(uint64_t* acc) {
+  for (int i = 0; i < 8; ++i) {
+    acc[i] ^= acc[i] >> 47;
+    acc[i] ^= kSecret[i];
+    acc[i] *= kPrime32_1;
+  }
+}
+
+/*!
+ * \brief The XXH3-style 64-bit hash of a byte range. It is not bit-compatible with XXH3, and is
+ * only used to key the cache within a process.
+ */
+uint64_t HashBytes(const uint8_t* data, size_t num_bytes) {
+  uint64_t acc[8] = {kPrime32_1, kPrime64_1, kPrime64_2, kPrime64_3,
+                     kPrime64_4, kPrime64_5, kPrime64_1 ^ kPrime64_2, kPrime64_3 ^ kPrime64_4};
+  size_t num_stripes = num_bytes / kStripeBytes;
+  for (size_t i = 0; i < num_stripes; ++i) {
+    Accumulate(acc, data + i * kStripeBytes);
+    if ((i + 1) % kStripesPerBlock == 0) {
+      Scramble(acc);
+    }
+  }
+  if (size_t tail = num_bytes % kStripeBytes) {
+    uint8_t last_stripe[kStripeBytes] = {0};
+    std::memcpy(last_stripe, data + num_stripes * kStripeBytes, tail);
+    Accumulate(acc, last_stripe);
+  }
+  uint64_t h = num_bytes * kPrime64_1;
+  for (int i = 0; i < 8; ++i) {
+    h ^= Avalanche(acc[i] ^ kSecret[i]);
+    h = h * kPrime64_1 + kPrime64_4;
+  }
+  return Avalanche(h);
+}
+
+/*! \brief The tags of the values in the encoding of the arguments of a call. */
+enum class ArgTag : uint8_t {
+  kNone = 0,
+  kBool = 1,
+  kInt = 2,
+  kFloat = 3,
+  kNDArray = 4,
+  kShape = 5,
+  kString = 6,
+  kArray = 7,
+};
+
+/*!
+ * \brief The encoding of the arguments of a call by value, which is the key of the cache. Two
+ * calls have equal encodings if and only if their arguments are equal, so that a hit is checked
+ * by comparing the encodings beyond their hashes.
+ */
+class ArgEncoder {
+ public:
+  /*!
+   * \brief Append an argument to the encoding.
+   * \return Whether the argument can be encoded. If not, the call bypasses the cache.
+   */
+  bool Append(const ffi::AnyView& arg) {
+    switch (arg.type_index()) {
+      case ffi::TypeIndex::kTVMFFINone:
+        AppendPOD(ArgTag::kNone);
+        return true;
+      case ffi::TypeIndex::kTVMFFIBool:
+        AppendPOD(ArgTag::kBool);
+        AppendPOD(arg.cast<int64_t>());
+        return true;
+      case ffi::TypeIndex::kTVMFFIInt:
+        AppendPOD(ArgTag::kInt);
+        AppendPOD(arg.cast<int64_t>());
+        return true;
+      case ffi::TypeIndex::kTVMFFIFloat:
+        AppendPOD(ArgTag::kFloat);
+        AppendPOD(arg.cast<double>());
+        return true;
+      default:
+        break;
+    }
+    if (auto opt_nd = arg.as<NDArray>()) {
+      NDArray nd = opt_nd.value();
+      if (!nd.IsContiguous()) {
+        return false;
+      }
+      AppendPOD(ArgTag::kNDArray);
+      AppendPOD(nd->dtype);
+      AppendPOD(nd->device);
+      AppendPOD(static_cast<int64_t>(nd->ndim));
+      AppendBytes(nd->shape, nd->ndim * sizeof(int64_t));
+      size_t num_bytes = ffi::GetDataSize(*nd.operator->());
+      if (nd->device.device_type == kDLCPU || nd->device.device_type == kDLCUDAHost) {
+        AppendBytes(static_cast<const uint8_t*>(nd->data) + nd->byte_offset, num_bytes);
+      } else {
+        size_t offset = data_.size();
+        data_.resize(offset + num_bytes);
+        nd.CopyToBytes(data_.data() + offset, num_bytes);
+      }
+      return true;
+    }
+    if (auto opt_shape = arg.as<ffi::Shape>()) {
+      ffi::Shape shape = opt_shape.value();
+      AppendPOD(ArgTag::kShape);
+      AppendPOD(static_cast<int64_t>(shape.size()));
+      AppendBytes(shape.data(), shape.size() * sizeof(int64_t));
+      return true;
+    }
+    if (auto opt_str = arg.as<String>()) {
+      const String& str = opt_str.value();
+      AppendPOD(ArgTag::kString);
+      AppendPOD(static_cast<int64_t>(str.size()));
+      AppendBytes(str.data(), str.size());
+      return true;
+    }
+    if (auto opt_tuple = arg.as<Array<ffi::Any>>()) {
+      AppendPOD(ArgTag::kArray);
+      AppendPOD(static_cast<int64_t>(opt_tuple.value().size()));
+      for (const ffi::Any& field : opt_tuple.value()) {
+        if (!Append(field)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    return false;
+  }
+
+  /*! \brief Take the encoding. */
+  std::vector<uint8_t> Finish() { return std::move(data_); }
+
+ private:
+  template <typename T>
+  void AppendPOD(const T& value) {
+    AppendBytes(&value, sizeof(T));
+  }
+
+  void AppendBytes(const void* ptr, size_t num_bytes) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(ptr);
+    data_.insert(data_.end(), bytes, bytes + num_bytes);
+  }
+
+  std::vector<uint8_t> data_;
+};
+
+/*! \brief The number of bytes of the tensors held by an output of a memoized function. */
+int64_t GetOutputBytes(const ffi::Any& output) {
+  if (auto opt_nd = output.as<NDArray>()) {
+    return static_cast<int64_t>(ffi::GetDataSize(*opt_nd.value().operator->()));
+  }
+  if (auto opt_tuple = output.as<Array<ffi::Any>>()) {
+    int64_t num_bytes = 0;
+    for (const ffi::Any& field : opt_tuple.value()) {
+      num_bytes += GetOutputBytes(field);
+    }
+    return num_bytes;
+  }
+  return 0;
+}
+
+/*!
+ * \brief Copy the tensors of an output of a memoized function, so that the cached outputs are
+ * never aliased by the callers, which may update them in place.
+ */
+ffi::Any CopyOutput(const ffi::Any& output) {
+  if (auto opt_nd = output.as<NDArray>()) {
+    NDArray nd = opt_nd.value();
+    NDArray copy = NDArray::Empty(nd.Shape(), nd->dtype, nd->device);
+    copy.CopyFrom(nd);
+    return copy;
+  }
+  if (auto opt_tuple = output.as<Array<ffi::Any>>()) {
+    Array<ffi::Any> fields;
+    for (const ffi::Any& field : opt_tuple.value()) {
+      fields.push_back(CopyOutput(field));
+    }
+    return fields;
+  }
+  return output;
+}
+
+/*!
+ * \brief The LRU cache of the outputs of a memoized function, bounded by the bytes of the outputs
+ * and of the encoded arguments kept to check the hits.
+ */
+class MemoizationCache {
+ public:
+  explicit MemoizationCache(int64_t capacity_bytes) : capacity_bytes_(capacity_bytes) {}
+
+  /*! \brief Look up the output of a call, marking it as the most recently used. */
+  std::optional<ffi::Any> Get(uint64_t hash, const std::vector<uint8_t>& args) {
+    auto it = index_.find(hash);
+    if (it == index_.end() || it->second->args != args) {
+      return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->output;
+  }
+
+  /*!
+   * \brief Cache the output of a call, evicting the least recently used outputs to fit it. The
+   * output is not cached if it does not fit, or if another call with the same hash is cached.
+   */
+  void Put(uint64_t hash, std::vector<uint8_t> args, const ffi::Any& output) {
+    int64_t num_bytes = GetOutputBytes(output) + static_cast<int64_t>(args.size());
+    if (num_bytes > capacity_bytes_ || index_.count(hash)) {
+      return;
+    }
+    while (used_bytes_ + num_bytes > capacity_bytes_) {
+      used_bytes_ -= entries_.back().num_bytes;
+      index_.erase(entries_.back().hash);
+      entries_.pop_back();
+    }
+    entries_.push_front(Entry{hash, std::move(args), CopyOutput(output), num_bytes});
+    index_[hash] = entries_.begin();
+    used_bytes_ += num_bytes;
+  }
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    std::vector<uint8_t> args;
+    ffi::Any output;
+    int64_t num_bytes;
+  };
+  /*! \brief The cached outputs, the most recently used first. */
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+  int64_t capacity_bytes_;
+  int64_t used_bytes_ = 0;
+};
+
+}  // namespace
+
+/*! \brief The VM extension of the memoized functions. */
+class MemoizationExtensionNode : public VMExtensionNode {
+ public:
+  TVM_DECLARE_FINAL_OBJECT_INFO(MemoizationExtensionNode, VMExtensionNode);
+
+  /*!
+   * \brief Return a copy of the cached output of the function for the arguments, or call the
+   * function and cache a copy of its output.
+   * \param vm The virtual machine.
+   * \param func The memoized function.
+   * \param capacity_bytes The capacity in bytes of the cache of the function.
+   * \param args The arguments of the function.
+   * \param rv The return value of the function.
+   */
+  void Call(VirtualMachine* vm, const ObjectRef& func, int64_t capacity_bytes,
+            ffi::PackedArgs args, ffi::Any* rv) {
+    ArgEncoder encoder;
+    for (int i = 0; i < args.size(); ++i) {
+      if (!encoder.Append(args[i])) {
+        vm->InvokeClosurePacked(func, args, rv);
+        return;
+      }
+    }
+    std::vector<uint8_t> encoded_args = encoder.Finish();
+    uint64_t hash = HashBytes(encoded_args.data(), encoded_args.size());
+    auto it = caches_.try_emplace(func.get(), capacity_bytes).first;
+    if (std::optional<ffi::Any> output = it->second.Get(hash, encoded_args)) {
+      *rv = CopyOutput(output.value());
+      return;
+    }
+    vm->InvokeClosurePacked(func, args, rv);
+    it->second.Put(hash, std::move(encoded_args), *rv);
+  }
+
+  static constexpr const char* _type_key = "vm.MemoizationExtension";
+
+ private:
+  /*! \brief The caches of the memoized functions, keyed by the functions in the VM. */
+  std::unordered_map<const Object*, MemoizationCache> caches_;
+};
+
+/*! Managed reference to MemoizationExtensionNode */
+class MemoizationExtension : public VMExtension {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(MemoizationExtension, VMExtension,
+                                        MemoizationExtensionNode);
+  static MemoizationExtension Create() {
+    auto data_ = make_object<MemoizationExtensionNode>();
+    return MemoizationExtension(std::move(data_));
+  }
+};
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.memoize.call")
+    .set_body_packed([](ffi::PackedArgs args, ffi::Any* rv) {
+      ICHECK_GE(args.size(), 3);
+      VirtualMachine* vm = VirtualMachine::GetContextPtr(args[0]);
+      auto extension = vm->GetOrCreateExtension<MemoizationExtension>();
+      auto func = args[1].cast<ObjectRef>();
+      int64_t capacity_bytes = args[2].cast<int64_t>();
+      extension->Call(vm, func, capacity_bytes, args.Slice(3), rv);
+    });
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,380 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+/*!
+ * \file src/runtime/vm/ndarray_cache_shared.cc
+ * \brief Sharing the parameters of an ndarray cache across processes.
+ *
+ * The parameters are decoded once into a POSIX shared memory object. The
+ * region starts with a header page holding the load state, the number of
+ * attached processes and the pid of the creator, followed by the parameters,
+ * each aligned to kAllocAlignment. The parameter pages are mapped read-only in
+ * every process.
+ *
+ * A process joins the count of attached processes before it waits for the
+ * load, and only while the count is positive: the process that drops it to 0
+ * removes the name, and the region can no longer be joined. A region whose
+ * creator died while loading is removed by the first attacher to notice, and
+ * the attachers create a new one. The liveness of the creator is checked by
+ * its pid, so the processes sharing a region should share a PID namespace;
+ * otherwise a live creator may be taken for dead, and the weights are loaded
+ * twice. A creator dying before it sets up the header, a window of a few system
+ * calls, still leaves the attachers waiting until the timeout.
+ */
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/vm/ndarray_cache_support.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../file_utils.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr uint64_t kSharedWeightMagic = 0x54475748534d5654;  // "TVMSHWGT"
+constexpr int kAttachTimeoutSec = 600;
+
+enum class SharedRegionState : uint32_t {
+  kLoading = 0,
+  kReady = 1,
+  kFailed = 2,
+  /*! \brief The name is removed, and the attachers must open the region again. */
+  kRemoved = 3,
+};
+
+/*! \brief The header at the beginning of the shared memory object. */
+struct SharedRegionHeader {
+  uint64_t magic;
+  /*! \brief Hash of the parameter layout, to detect regions created from other caches. */
+  uint64_t fingerprint;
+  uint64_t data_bytes;
+  pid_t creator_pid;
+  std::atomic<uint32_t> state;
+  /*! \brief The number of attached processes, 0 before the creator sets up the header. */
+  std::atomic<int32_t> num_attached;
+};
+
+/*! \brief The bytes of the header, a whole number of pages so that the data can be mapped. */
+size_t HeaderBytes() {
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return (sizeof(SharedRegionHeader) + page_size - 1) / page_size * page_size;
+}
+
+void HashCombine(uint64_t* hash, const void* data, size_t size) {
+  // FNV-1a
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= 0x100000001b3ULL;
+  }
+}
+
+/*! \brief Join the count of attached processes, unless the region is not set up or removed. */
+bool TryAttach(SharedRegionHeader* header) {
+  int32_t count = header->num_attached.load(std::memory_order_acquire);
+  while (count > 0) {
+    if (header->num_attached.compare_exchange_weak(count, count + 1,
+                                                   std::memory_order_acq_rel)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! \brief Remove the name of the region, unless it has been removed already. */
+void RemoveName(const std::string& name, SharedRegionHeader* header) {
+  uint32_t prev = header->state.exchange(static_cast<uint32_t>(SharedRegionState::kRemoved),
+                                         std::memory_order_acq_rel);
+  if (prev != static_cast<uint32_t>(SharedRegionState::kRemoved)) {
+    shm_unlink(name.c_str());
+  }
+}
+
+/*! \brief Leave the count of attached processes and unmap the header. */
+void Detach(const std::string& name, SharedRegionHeader* header, size_t header_bytes) {
+  // The last process to detach removes the name, a later load starts afresh.
+  if (header->num_attached.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    RemoveName(name, header);
+  }
+  munmap(header, header_bytes);
+}
+
+/*!
+ * \brief A mapping of the shared memory object, released when the last
+ *  parameter view of this process goes away.
+ */
+class SharedRegion {
+ public:
+  SharedRegion(std::string name, SharedRegionHeader* header, size_t header_bytes, char* data,
+               size_t data_bytes)
+      : name_(std::move(name)),
+        header_(header),
+        header_bytes_(header_bytes),
+        data_(data),
+        data_bytes_(data_bytes) {}
+
+  ~SharedRegion() {
+    if (data_ != nullptr) munmap(data_, data_bytes_);
+    Detach(name_, header_, header_bytes_);
+  }
+
+  char* data() const { return data_; }
+
+ private:
+  std::string name_;
+  SharedRegionHeader* header_;
+  size_t header_bytes_;
+  char* data_;
+  size_t data_bytes_;
+};
+
+/*! \brief NDArray allocator which points into a shared region and keeps it alive. */
+class SharedRegionAlloc {
+ public:
+  SharedRegionAlloc(std::shared_ptr<SharedRegion> region, size_t offset)
+      : region_(std::move(region)), offset_(offset) {}
+  void AllocData(DLTensor* tensor) { tensor->data = region_->data() + offset_; }
+  void FreeData(DLTensor* tensor) {}
+
+ private:
+  std::shared_ptr<SharedRegion> region_;
+  size_t offset_;
+};
+
+}  // namespace
+
+Array<NDArray> NDArrayCacheMetadata::LoadShared(const std::string& shm_name) const {
+  // Compute the layout of the decoded parameters, identical in every process.
+  std::vector<size_t> offsets;
+  uint64_t fingerprint = 0xcbf29ce484222325ULL;
+  size_t data_bytes = 0;
+  for (const FileRecord& shard_rec : records) {
+    for (const FileRecord::ParamRecord& nd_rec : shard_rec.records) {
+      int64_t numel = 1;
+      for (int64_t dim : nd_rec.shape) numel *= dim;
+      size_t nbytes = GetDataSize(numel, nd_rec.dtype);
+      offsets.push_back(data_bytes);
+      data_bytes += (nbytes + kAllocAlignment - 1) / kAllocAlignment * kAllocAlignment;
+      DLDataType dtype = nd_rec.dtype;
+      HashCombine(&fingerprint, nd_rec.name.data(), nd_rec.name.size());
+      HashCombine(&fingerprint, &dtype, sizeof(dtype));
+      HashCombine(&fingerprint, nd_rec.shape.data(), nd_rec.shape.size() * sizeof(int64_t));
+    }
+  }
+  // Keep a non-empty data mapping so that an empty cache still round trips.
+  data_bytes = std::max<size_t>(data_bytes, kAllocAlignment);
+  const size_t header_bytes = HeaderBytes();
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(kAttachTimeoutSec);
+  auto f_wait = [&](const char* what) {
+    CHECK(std::chrono::steady_clock::now() < deadline)
+        << "Timed out waiting for shared memory " << shm_name << " to be " << what << ". "
+        << "If the creating process died, remove the stale object /dev/shm" << shm_name;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+
+  // Open the region, or create it when it does not exist or its creator died.
+  bool creator;
+  int fd;
+  SharedRegionHeader* header;
+  while (true) {
+    creator = true;
+    fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+      creator = false;
+      fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+      // The name was removed in between.
+      if (fd < 0 && errno == ENOENT) continue;
+    }
+    CHECK_GE(fd, 0) << "Failed to open shared memory " << shm_name << ": " << strerror(errno);
+
+    if (creator) {
+      if (ftruncate(fd, header_bytes + data_bytes) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(shm_name.c_str());
+        LOG(FATAL) << "Failed to size shared memory " << shm_name << ": " << strerror(err);
+      }
+    } else {
+      // Wait for the creator to size the object before mapping it.
+      struct stat st;
+      while (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < header_bytes) {
+        f_wait("created");
+      }
+    }
+
+    void* header_ptr = mmap(nullptr, header_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header_ptr == MAP_FAILED) {
+      int err = errno;
+      close(fd);
+      if (creator) shm_unlink(shm_name.c_str());
+      LOG(FATAL) << "Failed to map shared memory " << shm_name << ": " << strerror(err);
+    }
+    header = static_cast<SharedRegionHeader*>(header_ptr);
+    if (creator) {
+      header->magic = kSharedWeightMagic;
+      header->fingerprint = fingerprint;
+      header->data_bytes = data_bytes;
+      header->creator_pid = getpid();
+      header->state.store(static_cast<uint32_t>(SharedRegionState::kLoading),
+                          std::memory_order_relaxed);
+      // Publish the header, the region can be joined from now on.
+      header->num_attached.store(1, std::memory_order_release);
+      break;
+    }
+
+    // Join the region before waiting for the load, so that it is not removed under us.
+    if (!TryAttach(header)) {
+      // Not set up yet, or being removed: open it again.
+      munmap(header, header_bytes);
+      close(fd);
+      f_wait("created");
+      continue;
+    }
+    uint32_t state;
+    while ((state = header->state.load(std::memory_order_acquire)) ==
+           static_cast<uint32_t>(SharedRegionState::kLoading)) {
+      if (kill(header->creator_pid, 0) != 0 && errno == ESRCH) {
+        // The creator died while loading. Whoever notices first removes the name.
+        uint32_t expected = static_cast<uint32_t>(SharedRegionState::kLoading);
+        if (header->state.compare_exchange_strong(
+                expected, static_cast<uint32_t>(SharedRegionState::kRemoved),
+                std::memory_order_acq_rel)) {
+          LOG(WARNING) << "The process " << header->creator_pid << " creating shared memory "
+                       << shm_name << " died, creating it again";
+          shm_unlink(shm_name.c_str());
+        }
+        continue;
+      }
+      f_wait("loaded");
+    }
+    if (state == static_cast<uint32_t>(SharedRegionState::kRemoved)) {
+      Detach(shm_name, header, header_bytes);
+      close(fd);
+      continue;
+    }
+    if (state != static_cast<uint32_t>(SharedRegionState::kReady)) {
+      Detach(shm_name, header, header_bytes);
+      close(fd);
+      LOG(FATAL) << "The process creating shared memory " << shm_name
+                 << " failed to load the weights";
+    }
+    if (header->magic != kSharedWeightMagic || header->fingerprint != fingerprint ||
+        header->data_bytes != data_bytes) {
+      Detach(shm_name, header, header_bytes);
+      close(fd);
+      LOG(FATAL) << "Shared memory " << shm_name
+                 << " holds the weights of a different ndarray cache";
+    }
+    break;
+  }
+
+  void* data_ptr = mmap(nullptr, data_bytes, creator ? PROT_READ | PROT_WRITE : PROT_READ,
+                        MAP_SHARED, fd, header_bytes);
+  int map_errno = errno;
+  close(fd);
+  if (data_ptr == MAP_FAILED) {
+    if (creator) {
+      header->state.store(static_cast<uint32_t>(SharedRegionState::kFailed),
+                          std::memory_order_release);
+    }
+    // Detach, and unlink the name if it was the last user.
+    Detach(shm_name, header, header_bytes);
+    LOG(FATAL) << "Failed to map shared memory " << shm_name << ": " << strerror(map_errno);
+  }
+  char* data = static_cast<char*>(data_ptr);
+  auto region = std::make_shared<SharedRegion>(shm_name, header, header_bytes, data, data_bytes);
+
+  Device cpu{kDLCPU, 0};
+  Array<NDArray> result;
+  result.reserve(offsets.size());
+  for (const FileRecord& shard_rec : records) {
+    for (const FileRecord::ParamRecord& nd_rec : shard_rec.records) {
+      result.push_back(NDArray::FromNDAlloc(SharedRegionAlloc(region, offsets[result.size()]),
+                                            nd_rec.shape, nd_rec.dtype, cpu));
+    }
+  }
+
+  if (creator) {
+    // The state only leaves kLoading here, unless an attacher took this process for dead.
+    uint32_t loading = static_cast<uint32_t>(SharedRegionState::kLoading);
+    try {
+      std::string raw_data;
+      size_t index = 0;
+      for (const FileRecord& shard_rec : records) {
+        LoadBinaryFromFile(path + "/" + shard_rec.data_path, &raw_data);
+        CHECK_EQ(shard_rec.nbytes, raw_data.length())
+            << "ValueError: Encountered an corrupted parameter shard " << shard_rec.data_path;
+        for (const FileRecord::ParamRecord& nd_rec : shard_rec.records) {
+          nd_rec.LoadInto(result[index++], &raw_data);
+        }
+      }
+    } catch (...) {
+      header->state.compare_exchange_strong(loading,
+                                            static_cast<uint32_t>(SharedRegionState::kFailed),
+                                            std::memory_order_acq_rel);
+      throw;
+    }
+    // Freeze the weights, writes through any view now fault instead of leaking to other
+    // processes.
+    CHECK_EQ(mprotect(data, data_bytes, PROT_READ), 0)
+        << "Failed to protect shared memory " << shm_name << ": " << strerror(errno);
+    if (!header->state.compare_exchange_strong(loading,
+                                               static_cast<uint32_t>(SharedRegionState::kReady),
+                                               std::memory_order_acq_rel)) {
+      LOG(WARNING) << "Shared memory " << shm_name << " was removed while loading, the weights "
+                   << "of this process are not shared";
+    }
+  }
+  return result;
+}
+
+#else  // _WIN32
+
+Array<NDArray> NDArrayCacheMetadata::LoadShared(const std::string& shm_name) const {
+  LOG(FATAL) << "Loading an ndarray cache into shared memory is not supported on Windows";
+  return {};
+}
+
+#endif  // _WIN32
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
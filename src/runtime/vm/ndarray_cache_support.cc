@@ -47,6 +47,7 @@
 #include <vector>
 
 #include "../../support/utils.h"
+#include "../cpu_copy_kernels.h"
 #include "../file_utils.h"
 
 namespace tvm {
@@ -168,19 +169,34 @@ void CopyNDArrayFromBytes(NDArray param, const void* data, size_t nbytes,
 NDArray NDArrayCacheMetadata::FileRecord::ParamRecord::Load(
     Device device, const std::string* raw_data, Optional<NDArray>* staging_buffer) const {
   NDArray arr = NDArray::Empty(shape, dtype, device);
+  LoadInto(arr, raw_data, staging_buffer);
+  return arr;
+}
+
+void NDArrayCacheMetadata::FileRecord::ParamRecord::LoadInto(
+    NDArray arr, const std::string* raw_data, Optional<NDArray>* staging_buffer) const {
   if (dtype == DataType::Float(32) && format == "f32-to-bf16") {
     // decode bf16 to f32
-    std::vector<uint16_t> buffer(nbytes / 2);
-    std::vector<uint32_t> decoded(nbytes / 2);
-    std::memcpy(buffer.data(), raw_data->data() + byte_offset, nbytes);
-    for (size_t i = 0; i < buffer.size(); ++i) {
-      decoded[i] = static_cast<uint32_t>(buffer[i]) << 16;
+    const char* raw = raw_data->data() + byte_offset;
+    std::vector<uint16_t> aligned;
+    if (reinterpret_cast<uintptr_t>(raw) % alignof(uint16_t) != 0) {
+      aligned.resize(nbytes / 2);
+      std::memcpy(aligned.data(), raw, nbytes);
+      raw = reinterpret_cast<const char*>(aligned.data());
+    }
+    const uint16_t* encoded = reinterpret_cast<const uint16_t*>(raw);
+    if (arr->device.device_type == kDLCPU) {
+      // Decode straight into the array, without intermediate buffers.
+      float* data = reinterpret_cast<float*>(static_cast<char*>(arr->data) + arr->byte_offset);
+      ConvertBFloat16ToFloat32(encoded, data, nbytes / 2);
+    } else {
+      std::vector<float> decoded(nbytes / 2);
+      ConvertBFloat16ToFloat32(encoded, decoded.data(), decoded.size());
+      CopyNDArrayFromBytes(arr, decoded.data(), decoded.size() * sizeof(float), staging_buffer);
     }
-    CopyNDArrayFromBytes(arr, decoded.data(), decoded.size() * sizeof(uint32_t), staging_buffer);
   } else {
     CopyNDArrayFromBytes(arr, raw_data->data() + byte_offset, nbytes, staging_buffer);
   }
-  return arr;
 }
 
 TVM_DLL Array<NDArray> NDArrayCacheMetadata::FileRecord::Load(
@@ -262,6 +278,23 @@ class NDArrayCache {
     }
   }
 
+  /*!
+   * \brief Load parameters from path into a CPU shared memory region and append them.
+   * \param cache_path The cache to path.
+   * \param shm_name The name of the shared memory region.
+   * \sa NDArrayCacheMetadata::LoadShared
+   */
+  static void LoadShared(const std::string& cache_path, const std::string& shm_name) {
+    NDArrayCacheMetadata metadata = NDArrayCacheMetadata::Load(cache_path);
+    Array<NDArray> params = metadata.LoadShared(shm_name);
+    int index = 0;
+    for (const NDArrayCacheMetadata::FileRecord& shard_rec : metadata.records) {
+      for (const NDArrayCacheMetadata::FileRecord::ParamRecord& nd_rec : shard_rec.records) {
+        Update(nd_rec.name, params[index++], true);
+      }
+    }
+  }
+
  private:
   Map<String, NDArray> pool_;
 };
@@ -293,6 +326,8 @@ TVM_FFI_REGISTER_GLOBAL("vm.builtin.ndarray_cache.update")
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.ndarray_cache.remove").set_body_typed(NDArrayCache::Remove);
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.ndarray_cache.clear").set_body_typed(NDArrayCache::Clear);
 TVM_FFI_REGISTER_GLOBAL("vm.builtin.ndarray_cache.load").set_body_typed(NDArrayCache::Load);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.ndarray_cache.load_shared")
+    .set_body_typed(NDArrayCache::LoadShared);
 
 // This param module node can be useful to get param dict in RPC mode
 // when the remote already have loaded parameters from file.
@@ -28,13 +28,22 @@
 #include <tvm/runtime/ndarray.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "../file_utils.h"
 #include "attn_backend.h"
 #include "attn_utils.h"
+#include "byte_plane_codec.h"
 #include "kv_state.h"
 
 namespace tvm {
@@ -49,6 +58,167 @@ namespace vm {
 // runtime API function calls
 //-------------------------------------------
 
+/*! \brief The magic number of the files of saved sequences, "TVMKVSEQ" in little endian. */
+constexpr uint64_t kKVSequenceFileMagic = 0x514553564B4D5654;
+/*! \brief The format version of the files of saved sequences. */
+constexpr uint32_t kKVSequenceFileVersion = 1;
+/*! \brief The host staging size for streaming the pages of saved sequences. */
+constexpr int64_t kKVSequenceFileStagingBytes = 4 << 20;
+
+/*!
+ * \brief The header of a file of a saved sequence.
+ * It is followed by the page shape of each layer, and then by the KV data in
+ * chunks of pages. Each chunk has one record per layer, which holds the pages
+ * of the chunk with the unused slots of the last page of the sequence dropped.
+ */
+struct KVSequenceFileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t compressed;
+  DLDataType dtype;
+  int32_t rope_mode;
+  double rotary_scale;
+  double rotary_theta;
+  int64_t num_layers;
+  int64_t page_size;
+  /*! \brief The sequence length. */
+  int64_t seq_length;
+  /*! \brief The position of the first token of the sequence, used by RoPE. */
+  int64_t start_pos;
+};
+
+/*! \brief The magic number of the KV data streams over KV transports, "TVMKVXFR". */
+constexpr uint64_t kKVTransferMagic = 0x524658564B4D5654;
+/*! \brief The format version of the KV data streams over KV transports. */
+constexpr uint32_t kKVTransferVersion = 1;
+/*! \brief The bytes of received KV data a receive may buffer before waiting for a poll. */
+constexpr int64_t kKVTransferQueueBytes = 64 << 20;
+
+/*!
+ * \brief The header of a KV data stream over a KV transport.
+ * It is followed by the sender pages holding positions [begin, length) in chunks of
+ * `chunk_pages` pages, with one record per layer in each chunk. The receiver may
+ * use a different page size, and places the tokens into its own pages.
+ */
+struct KVTransferHeader {
+  uint64_t magic;
+  uint32_t version;
+  DLDataType dtype;
+  int32_t rope_mode;
+  double rotary_scale;
+  double rotary_theta;
+  int64_t num_layers;
+  int64_t num_kv_heads;
+  int64_t head_dim;
+  /*! \brief The page size of the sender. */
+  int64_t page_size;
+  int64_t chunk_pages;
+  /*! \brief The first position sent, which the receiver sequence must already hold. */
+  int64_t begin;
+  /*! \brief The sequence length after the transfer. */
+  int64_t length;
+};
+
+/*!
+ * \brief The state of a background receive of the KV data of a sequence. The
+ * receiving thread converts the sender pages to token-major K/V records, and the
+ * KV cache writes the records into its pages when polled.
+ */
+struct DisaggRecvState {
+  /*! \brief The K/V data of a range of tokens of one layer, in layout (2, n, heads, dim). */
+  struct Record {
+    int64_t layer;
+    int64_t token_begin;
+    int64_t num_tokens;
+    std::vector<uint8_t> data;
+  };
+
+  KVTransport transport;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  /*! \brief The fields below are guarded by the mutex. */
+  KVTransferHeader header;
+  bool header_ready = false;
+  std::deque<Record> records;
+  int64_t queued_bytes = 0;
+  bool finished = false;
+  bool cancelled = false;
+  std::string error;
+  /*! \brief The fields below are only accessed by the KV cache. */
+  bool reserved = false;
+  int64_t block_length_before = 0;
+};
+
+/*! \brief The loop of the receiving thread of a DisaggRecvState. */
+inline void DisaggRecvLoop(DisaggRecvState* state) {
+  auto f_push = [state](DisaggRecvState::Record record) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [state]() {
+      return state->cancelled || state->queued_bytes < kKVTransferQueueBytes;
+    });
+    if (state->cancelled) return false;
+    state->queued_bytes += record.data.size();
+    state->records.push_back(std::move(record));
+    return true;
+  };
+  try {
+    KVTransferHeader header;
+    state->transport->Recv(&header, sizeof(header));
+    CHECK_EQ(header.magic, kKVTransferMagic) << "ValueError: The KV data stream is corrupted.";
+    CHECK_EQ(header.version, kKVTransferVersion)
+        << "ValueError: Unsupported KV data stream version " << header.version;
+    CHECK(header.page_size > 0 && header.chunk_pages > 0 && header.begin >= 0 &&
+          header.begin <= header.length)
+        << "ValueError: The KV data stream is corrupted.";
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->header = header;
+      state->header_ready = true;
+    }
+
+    int64_t elem_bytes = (header.dtype.bits * header.dtype.lanes + 7) / 8;
+    int64_t slot_bytes = header.head_dim * elem_bytes;
+    int64_t page_bytes = 2 * header.num_kv_heads * header.page_size * slot_bytes;
+    int64_t first_page = header.begin / header.page_size;
+    int64_t end_page = (header.length + header.page_size - 1) / header.page_size;
+    std::vector<uint8_t> staging;
+    for (int64_t begin = first_page; begin < end_page; begin += header.chunk_pages) {
+      int64_t end = std::min(begin + header.chunk_pages, end_page);
+      int64_t token_begin = std::max(begin * header.page_size, header.begin);
+      int64_t token_end = std::min(end * header.page_size, header.length);
+      int64_t num_tokens = token_end - token_begin;
+      staging.resize((end - begin) * page_bytes);
+      for (int64_t layer = 0; layer < header.num_layers; ++layer) {
+        state->transport->Recv(staging.data(), staging.size());
+        // Transpose the pages (pages, 2, heads, page_size, dim) to (2, tokens, heads, dim).
+        DisaggRecvState::Record record{layer, token_begin, num_tokens, {}};
+        record.data.resize(2 * num_tokens * header.num_kv_heads * slot_bytes);
+        uint8_t* dst = record.data.data();
+        for (int64_t kv = 0; kv < 2; ++kv) {
+          for (int64_t pos = token_begin; pos < token_end; ++pos) {
+            const uint8_t* page = staging.data() + (pos / header.page_size - begin) * page_bytes;
+            for (int64_t head = 0; head < header.num_kv_heads; ++head) {
+              std::memcpy(dst,
+                          page + ((kv * header.num_kv_heads + head) * header.page_size +
+                                  pos % header.page_size) *
+                                     slot_bytes,
+                          slot_bytes);
+              dst += slot_bytes;
+            }
+          }
+        }
+        if (!f_push(std::move(record))) return;
+      }
+    }
+  } catch (const std::exception& e) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->error = e.what();
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->finished = true;
+}
+
 /*!
  * \brief The paged KV cache for attention.
  * - It supports managing the K/V data of **multiple sequences**.
@@ -134,6 +304,8 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
   std::vector<int32_t> free_page_ids_;
   /*! \brief The mapping from sequence ids to sequences. */
   std::unordered_map<int64_t, Sequence> seq_map_;
+  /*! \brief The sequences receiving KV data from KV transports. */
+  std::unordered_map<int64_t, std::unique_ptr<DisaggRecvState>> disagg_recvs_;
 
   /********************* Sequence Block Structures *********************/
 
@@ -178,6 +350,25 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
   bool page_to_page_transfer_kv_;
   /*! \brief The auxiliary data manager for attention. */
   std::unique_ptr<PagedKVCacheAuxDataManager> aux_data_manager_;
+  /*!
+   * \brief The batch of the last BeginForward if it was a plain decode step,
+   * i.e., every sequence has a single block and appends one token.
+   * When the next BeginForward decodes the same batch, the host auxiliary
+   * arrays are patched in place instead of being rebuilt.
+   * (see TryIncrementalDecodeBeginForward)
+   * It is invalidated by every change of the blocks or pages outside of
+   * BeginForward, since freed blocks and pages are reused and the checks of
+   * the fast path cannot tell a reused page from the recorded one.
+   */
+  struct DecodeBatchSnapshot {
+    bool valid = false;
+    std::vector<int64_t> seq_ids;
+    /*! \brief The index of the only block of each sequence. */
+    std::vector<int32_t> block_ids;
+    /*! \brief The length of each sequence after the last append. */
+    std::vector<int32_t> seq_lengths;
+  };
+  DecodeBatchSnapshot last_decode_batch_;
 
   // Temporary arrays to store intermediate attention results.
   NDArray temp_attn_q_device_;
@@ -497,10 +688,13 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     }
 
     // Create the auxiliary data manager for attention.
+    // On CPU the kernels read the host arrays directly.
     // We only use the merged aux data for CUDA, since direct pointer
     // operations may have issues on other platforms.
-    if (device_.device_type == DLDeviceType::kDLCUDA ||
-        device_.device_type == DLDeviceType::kDLCPU) {
+    if (device_.device_type == DLDeviceType::kDLCPU) {
+      aux_data_manager_ = std::make_unique<HostPagedKVCacheAuxDataManager>(
+          reserved_num_seqs, prefill_chunk_size, dtype_aux_, device, preferred_host_device);
+    } else if (device_.device_type == DLDeviceType::kDLCUDA) {
       aux_data_manager_ = std::make_unique<CachedPagedKVCacheAuxDataManager>(
           reserved_num_seqs, num_total_pages, prefill_chunk_size, dtype_aux_, device,
           preferred_host_device, copy_stream_);
@@ -518,6 +712,9 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
   }
 
   ~PagedAttentionKVCacheObj() {
+    while (!disagg_recvs_.empty()) {
+      AbortDisaggRecv(disagg_recvs_.begin()->first);
+    }
     // Free the copy stream if defined.
     if (copy_stream_ != nullptr) {
       DeviceAPI::Get(device_)->FreeStream(device_, copy_stream_);
@@ -529,6 +726,9 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
 
   /*! \brief Reset the KV cache. */
   void Clear() final {
+    while (!disagg_recvs_.empty()) {
+      AbortDisaggRecv(disagg_recvs_.begin()->first);
+    }
     seq_map_.clear();
     free_page_ids_.clear();
     for (int64_t page_id = num_total_pages_ - 1; page_id >= 0; --page_id) {
@@ -537,6 +737,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     global_block_pool_.clear();
     free_block_idx_.clear();
     dirty_aux_data_device_ = false;
+    last_decode_batch_.valid = false;
   }
 
   /************** Sequence Management **************/
@@ -547,11 +748,13 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     int32_t block_idx = GetFreeBlock();
     seq_map_.insert({seq_id, Sequence(&global_block_pool_, block_idx)});
     dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
   }
 
   void RemoveSequence(int64_t seq_id) final {
     auto it = seq_map_.find(seq_id);
     CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id << "\" cannot be found in KV cache.";
+    CheckNotReceiving(seq_id);
     int32_t block_idx = it->second.last_block_idx;
     // The block should have at least one reference, which comes from the sequence.
     ICHECK_GE(global_block_pool_[block_idx].external_ref_cnt, 1);
@@ -570,6 +773,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     }
     seq_map_.erase(it);
     dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
   }
 
   void ForkSequence(int64_t parent_seq_id, int64_t child_seq_id, int64_t fork_pos = -1) final {
@@ -578,6 +782,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
         << "The parent sequence \"" << parent_seq_id << "\" cannot be found in KV cache.";
     CHECK(seq_map_.find(child_seq_id) == seq_map_.end())
         << "The child sequence \"" << child_seq_id << "\" is already in the KV cache.";
+    CheckNotReceiving(parent_seq_id);
     CHECK_GE(fork_pos, -1)
         << "The forked position should be non-negative, or -1 for last position as default.";
     CHECK_LE(fork_pos, parent_it->second.seq_length)
@@ -685,6 +890,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     // Create the child sequence with the child block.
     seq_map_.insert({child_seq_id, Sequence(&global_block_pool_, child_block_idx)});
     dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
   }
 
   void CopySinglePage(int32_t src_page_id, int32_t tgt_page_id, int64_t copy_length) {
@@ -770,6 +976,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
   void PopN(int64_t seq_id, int32_t n) final {
     auto it = seq_map_.find(seq_id);
     CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id << "\" cannot be found in KV cache.";
+    CheckNotReceiving(seq_id);
 
     CHECK_GE(n, 0) << "The length of popping " << n << " cannot be negative.";
     CHECK_LE(n, it->second.seq_length)
@@ -825,6 +1032,7 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     }
 
     dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
   }
 
   /************** Raw Info Query **************/
@@ -857,6 +1065,10 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     CHECK_EQ(seq_ids.size(), append_lengths.size())
         << "The seq_ids size (" << seq_ids.size() << ") and append_lengths size ("
         << append_lengths.size() << ") mismatch.";
+    if (TryIncrementalDecodeBeginForward(seq_ids, append_lengths, opt_token_tree_parent_ptr)) {
+      return;
+    }
+    last_decode_batch_.valid = false;
     cur_batch_size_ = seq_ids.size();
     cur_seq_ids_ = seq_ids;
     cur_append_lengths_ = append_lengths;
@@ -872,6 +1084,9 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
       auto it = seq_map_.find(seq_ids[i]);
       CHECK(it != seq_map_.end()) << "The sequence \"" << seq_ids[i]
                                   << "\" cannot be found in KV cache.";
+      if (!disagg_recvs_.empty()) {
+        CheckNotReceiving(seq_ids[i]);
+      }
       sequences.push_back(&it->second);
       last_block_length_before_append.push_back(
           global_block_pool_[it->second.last_block_idx].seq_length);
@@ -1008,15 +1223,18 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
               // Do the same for page_indices_sliding_window
             }
 
-            // For sliding window, the first page and last page will both be partially used
-            page_indptr_sliding_window_h.push_back(
-                page_indptr_sliding_window_h.back() +
-                std::min(static_cast<int32_t>(block.page_ids.size()),
-                         static_cast<int32_t>(1024 / page_size_ +
-                                              (block.seq_length % page_size_ ? 1 : 0))));
-            for (int i = page_indices_h.size() - page_indptr_sliding_window_h.back();
-                 i < static_cast<int32_t>(page_indices_h.size()); i++) {
-              page_indices_sliding_window_h.push_back(page_indices_h[i]);
+            // For sliding window, the first page and last page will both be partially used.
+            // The sliding window page table is only read with per-layer sliding window.
+            if (support_layer_sliding_window_) {
+              page_indptr_sliding_window_h.push_back(
+                  page_indptr_sliding_window_h.back() +
+                  std::min(static_cast<int32_t>(block.page_ids.size()),
+                           static_cast<int32_t>(1024 / page_size_ +
+                                                (block.seq_length % page_size_ ? 1 : 0))));
+              for (int i = page_indices_h.size() - page_indptr_sliding_window_h.back();
+                   i < static_cast<int32_t>(page_indices_h.size()); i++) {
+                page_indices_sliding_window_h.push_back(page_indices_h[i]);
+              }
             }
             // set up the page indices properly by choosing the last (sliding_window_size /
             // page_size_) pages (at most)
@@ -1063,14 +1281,16 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
               last_block_id = id;
             }
             page_indptr_h.push_back(page_indptr_h.back() + num_pages);
-            page_indptr_sliding_window_h.push_back(
-                page_indptr_sliding_window_h.back() +
-                std::min(static_cast<int32_t>(block.page_ids.size()),
-                         static_cast<int32_t>(1024 / page_size_ +
-                                              (block.seq_length % page_size_ ? 1 : 0))));
-            for (int i = page_indices_h.size() - page_indptr_sliding_window_h.back();
-                 i < static_cast<int32_t>(page_indices_h.size()); i++) {
-              page_indices_sliding_window_h.push_back(page_indices_h[i]);
+            if (support_layer_sliding_window_) {
+              page_indptr_sliding_window_h.push_back(
+                  page_indptr_sliding_window_h.back() +
+                  std::min(static_cast<int32_t>(block.page_ids.size()),
+                           static_cast<int32_t>(1024 / page_size_ +
+                                                (block.seq_length % page_size_ ? 1 : 0))));
+              for (int i = page_indices_h.size() - page_indptr_sliding_window_h.back();
+                   i < static_cast<int32_t>(page_indices_h.size()); i++) {
+                page_indices_sliding_window_h.push_back(page_indices_h[i]);
+              }
             }
             const Block& last_block = global_block_pool_[last_block_id];
             last_page_len_h.push_back(total_seq_length == 0
@@ -1180,6 +1400,31 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
         sequences[i]->kv_transfer_metadata.local_position_map.clear();
       }
     }
+
+    // - Remember the batch if this is a plain decode step, so that the next
+    // decode step of the same batch can take the incremental path.
+    bool plain_decode = is_decode_request_ && !opt_token_tree_parent_ptr.defined() &&
+                        num_depths_ == 1 && append_before_attn_ && !support_sliding_window_ &&
+                        !support_layer_sliding_window_ && !transfer_kv_ &&
+                        !page_to_page_transfer_kv_ && cur_batch_size_ > 0 &&
+                        static_cast<int64_t>(chunked_block_ids_arr[0].size()) == cur_batch_size_;
+    for (int i = 0; plain_decode && i < cur_batch_size_; ++i) {
+      const Block& block = global_block_pool_[sequences[i]->last_block_idx];
+      plain_decode = chunked_block_ids_arr[0][i].first == sequences[i]->last_block_idx &&
+                     block.parent_idx == -1 && block.seq_length == sequences[i]->seq_length &&
+                     sequences[i]->kv_transfer_metadata.start ==
+                         std::numeric_limits<int64_t>::max();
+    }
+    if (plain_decode) {
+      last_decode_batch_.valid = true;
+      last_decode_batch_.seq_ids.assign(seq_ids.begin(), seq_ids.end());
+      last_decode_batch_.block_ids.clear();
+      last_decode_batch_.seq_lengths.clear();
+      for (const Sequence* sequence : sequences) {
+        last_decode_batch_.block_ids.push_back(sequence->last_block_idx);
+        last_decode_batch_.seq_lengths.push_back(sequence->seq_length);
+      }
+    }
   }
 
   void EndForward() final {
@@ -1270,6 +1515,284 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
                  sequence->kv_transfer_metadata.local_position_map.end());
   }
 
+  /************** Disaggregated KV Transfer over KV Transports **************/
+
+  int64_t DisaggSendSequence(int64_t seq_id, int64_t begin, KVTransport transport) final {
+    auto it = seq_map_.find(seq_id);
+    CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id << "\" cannot be found in KV cache.";
+    CheckNotReceiving(seq_id);
+    const Sequence& seq = it->second;
+    CheckDisaggTransportSupported();
+    CHECK(seq.accepted_indices_committed)
+        << "ValueError: The token tree of sequence \"" << seq_id
+        << "\" computed in the last round of forward has not been committed with accepted nodes.";
+    CHECK_EQ(seq.sliding_window_size, -1)
+        << "ValueError: The sequence \"" << seq_id
+        << "\" is enabled with sliding window and cannot be sent.";
+    CHECK(begin >= 0 && begin <= seq.seq_length)
+        << "ValueError: The begin position " << begin << " of the KV data to send is out of "
+        << "the range of sequence \"" << seq_id << "\" of length " << seq.seq_length;
+
+    int64_t start_pos;
+    std::vector<int32_t> page_ids = GetSequencePageIds(seq, &start_pos);
+    KVTransferHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kKVTransferMagic;
+    header.version = kKVTransferVersion;
+    header.dtype = kv_dtype_;
+    header.rope_mode = static_cast<int32_t>(rope_mode_);
+    header.rotary_scale = rotary_scale_;
+    header.rotary_theta = rotary_theta_;
+    header.num_layers = num_layers_;
+    header.num_kv_heads = num_kv_heads_;
+    header.head_dim = qk_head_dim_;
+    header.page_size = page_size_;
+    header.chunk_pages = GetKVSequenceFileChunkPages();
+    header.begin = begin;
+    header.length = seq.seq_length;
+    SyncStreamsForHostAccess();
+    transport->Send(&header, sizeof(header));
+    int64_t nbytes = sizeof(header);
+
+    // Stream the pages holding the positions to send a chunk at a time. The receiver
+    // translates the positions to its own pages.
+    int64_t num_pages = page_ids.size();
+    std::vector<uint8_t> staging;
+    for (int64_t begin_page = begin / page_size_; begin_page < num_pages;
+         begin_page += header.chunk_pages) {
+      int64_t end_page = std::min(begin_page + header.chunk_pages, num_pages);
+      for (int64_t layer = 0; layer < num_layers_; ++layer) {
+        staging.resize((end_page - begin_page) * GetPageBytes(layer));
+        CopyPagesWithHost(layer, page_ids.data() + begin_page, end_page - begin_page,
+                          staging.data(), /*to_host=*/true);
+        transport->Send(staging.data(), staging.size());
+        nbytes += staging.size();
+      }
+    }
+    return nbytes;
+  }
+
+  void DisaggStartRecv(int64_t seq_id, KVTransport transport) final {
+    auto it = seq_map_.find(seq_id);
+    CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id << "\" cannot be found in KV cache.";
+    CheckNotReceiving(seq_id);
+    CheckDisaggTransportSupported();
+    CHECK_EQ(it->second.sliding_window_size, -1)
+        << "ValueError: The sequence \"" << seq_id
+        << "\" is enabled with sliding window and cannot receive KV data.";
+    // The received tokens are appended to the last block in place, which therefore cannot be
+    // shared with the blocks of forked sequences.
+    const Block& last_block = global_block_pool_[it->second.last_block_idx];
+    CHECK_EQ(last_block.external_ref_cnt, 1)
+        << "ValueError: The last block of sequence \"" << seq_id << "\" is shared with "
+        << last_block.external_ref_cnt - 1
+        << " forked sequence(s) and cannot receive KV data. Please fork the sequence after "
+           "the receive finishes.";
+    auto state = std::make_unique<DisaggRecvState>();
+    state->transport = std::move(transport);
+    state->thread = std::thread(DisaggRecvLoop, state.get());
+    disagg_recvs_.emplace(seq_id, std::move(state));
+    last_decode_batch_.valid = false;
+  }
+
+  bool DisaggPollRecv(int64_t seq_id) final {
+    auto it = disagg_recvs_.find(seq_id);
+    CHECK(it != disagg_recvs_.end())
+        << "ValueError: The sequence \"" << seq_id << "\" is not receiving KV data.";
+    DisaggRecvState* state = it->second.get();
+    Sequence* seq = &seq_map_.at(seq_id);
+    std::deque<DisaggRecvState::Record> records;
+    bool finished;
+    try {
+      std::string error;
+      bool header_ready;
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        records.swap(state->records);
+        state->queued_bytes = 0;
+        finished = state->finished;
+        error = state->error;
+        header_ready = state->header_ready;
+      }
+      state->cv.notify_all();
+      CHECK(error.empty()) << "ValueError: Receiving the KV data of sequence \"" << seq_id
+                           << "\" failed: " << error;
+      if (header_ready && !state->reserved) {
+        ReserveDisaggRecv(seq_id, seq, state);
+      }
+      for (const DisaggRecvState::Record& record : records) {
+        WriteDisaggRecord(seq, state, record);
+      }
+    } catch (...) {
+      AbortDisaggRecv(seq_id);
+      throw;
+    }
+    if (!finished) {
+      return false;
+    }
+    // All records are taken together with the finished flag, so the receive is done.
+    state->thread.join();
+    seq->seq_length = state->header.length;
+    disagg_recvs_.erase(it);
+    dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
+    return true;
+  }
+
+  /************** Persistence **************/
+
+  int64_t SaveSequence(int64_t seq_id, const String& path, bool compress) final {
+    auto it = seq_map_.find(seq_id);
+    CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id << "\" cannot be found in KV cache.";
+    CheckNotReceiving(seq_id);
+    const Sequence& seq = it->second;
+    CHECK(seq.accepted_indices_committed)
+        << "ValueError: The token tree of sequence \"" << seq_id
+        << "\" computed in the last round of forward has not been committed with accepted nodes.";
+    CHECK_EQ(seq.sliding_window_size, -1)
+        << "ValueError: The sequence \"" << seq_id
+        << "\" is enabled with sliding window and cannot be saved.";
+
+    int64_t start_pos;
+    std::vector<int32_t> page_ids = GetSequencePageIds(seq, &start_pos);
+    int64_t length = seq.seq_length;
+
+    KVSequenceFileHeader header = MakeKVSequenceFileHeader(compress);
+    header.seq_length = length;
+    header.start_pos = start_pos;
+    std::vector<int64_t> page_shapes = GetPageShapes();
+    SyncStreamsForHostAccess();
+
+    SimpleBinaryFileStream strm(path, "wb");
+    int64_t nbytes = 0;
+    auto f_write = [&strm, &nbytes](const void* data, size_t size) {
+      strm.Write(data, size);
+      nbytes += size;
+    };
+    f_write(&header, sizeof(header));
+    f_write(page_shapes.data(), page_shapes.size() * sizeof(int64_t));
+
+    // Stream the pages a chunk at a time through the host staging buffer.
+    int64_t num_pages = page_ids.size();
+    int64_t chunk_pages = GetKVSequenceFileChunkPages();
+    std::vector<uint8_t> staging;
+    std::vector<uint8_t> encoded;
+    for (int64_t begin = 0; begin < num_pages; begin += chunk_pages) {
+      int64_t end = std::min(begin + chunk_pages, num_pages);
+      int64_t last_page_length = std::min(page_size_, length - (end - 1) * page_size_);
+      for (int64_t layer = 0; layer < num_layers_; ++layer) {
+        int64_t record_bytes = GetPagesRecordBytes(layer, end - begin, last_page_length);
+        staging.resize((end - begin) * GetPageBytes(layer));
+        CopyPagesWithHost(layer, page_ids.data() + begin, end - begin, staging.data(),
+                          /*to_host=*/true);
+        PackLastPage(layer, end - begin, last_page_length, staging.data());
+        if (compress) {
+          encoded.clear();
+          int elem_bytes = kv_dtype_.bytes();
+          EncodeBytePlanes(staging.data(), record_bytes / elem_bytes, elem_bytes, &encoded);
+          uint64_t encoded_bytes = encoded.size();
+          f_write(&encoded_bytes, sizeof(encoded_bytes));
+          f_write(encoded.data(), encoded_bytes);
+        } else {
+          uint64_t raw_bytes = record_bytes;
+          f_write(&raw_bytes, sizeof(raw_bytes));
+          f_write(staging.data(), raw_bytes);
+        }
+      }
+    }
+    return nbytes;
+  }
+
+  int64_t RestoreSequence(int64_t seq_id, const String& path) final {
+    CHECK(seq_map_.find(seq_id) == seq_map_.end())
+        << "The sequence \"" << seq_id << "\" is already in the KV cache.";
+    SimpleBinaryFileStream strm(path, "rb");
+    auto f_read = [&strm, &path](void* data, size_t size) {
+      CHECK_EQ(strm.Read(data, size), size)
+          << "ValueError: The saved sequence file \"" << path << "\" is truncated.";
+    };
+
+    // Check that the sequence was saved from a KV cache of the same configuration.
+    KVSequenceFileHeader header;
+    f_read(&header, sizeof(header));
+    CHECK_EQ(header.magic, kKVSequenceFileMagic)
+        << "ValueError: \"" << path << "\" is not a saved sequence file.";
+    CHECK_EQ(header.version, kKVSequenceFileVersion)
+        << "ValueError: The saved sequence file \"" << path << "\" has version " << header.version
+        << ", while version " << kKVSequenceFileVersion << " is expected.";
+    CHECK(DataType(header.dtype) == kv_dtype_ && header.num_layers == num_layers_ &&
+          header.page_size == page_size_ && header.rope_mode == static_cast<int32_t>(rope_mode_) &&
+          header.rotary_scale == rotary_scale_ && header.rotary_theta == rotary_theta_)
+        << "ValueError: The sequence in \"" << path
+        << "\" was saved from a KV cache with a different configuration.";
+    std::vector<int64_t> page_shapes = GetPageShapes();
+    std::vector<int64_t> saved_page_shapes(page_shapes.size());
+    f_read(saved_page_shapes.data(), saved_page_shapes.size() * sizeof(int64_t));
+    CHECK(saved_page_shapes == page_shapes)
+        << "ValueError: The sequence in \"" << path
+        << "\" was saved from a KV cache with different page shapes.";
+    int64_t length = header.seq_length;
+    CHECK_GE(length, 0) << "ValueError: The saved sequence file \"" << path << "\" is corrupted.";
+    int64_t num_pages = (length + page_size_ - 1) / page_size_;
+    CHECK_LE(num_pages, static_cast<int64_t>(free_page_ids_.size()))
+        << "ValueError: The KV cache has " << free_page_ids_.size()
+        << " free pages, while restoring the sequence of length " << length << " needs "
+        << num_pages << " pages.";
+
+    // The sequence is restored into a single block starting at the saved position.
+    int32_t block_idx = GetFreeBlock();
+    Block& block = global_block_pool_[block_idx];
+    for (int64_t i = 0; i < num_pages; ++i) {
+      block.page_ids.push_back(GetFreePage());
+    }
+    SyncStreamsForHostAccess();
+    try {
+      int64_t chunk_pages = GetKVSequenceFileChunkPages();
+      std::vector<uint8_t> staging;
+      std::vector<uint8_t> encoded;
+      for (int64_t begin = 0; begin < num_pages; begin += chunk_pages) {
+        int64_t end = std::min(begin + chunk_pages, num_pages);
+        int64_t last_page_length = std::min(page_size_, length - (end - 1) * page_size_);
+        for (int64_t layer = 0; layer < num_layers_; ++layer) {
+          uint64_t record_bytes = GetPagesRecordBytes(layer, end - begin, last_page_length);
+          uint64_t stored_bytes;
+          f_read(&stored_bytes, sizeof(stored_bytes));
+          staging.resize((end - begin) * GetPageBytes(layer));
+          if (header.compressed) {
+            encoded.resize(stored_bytes);
+            f_read(encoded.data(), stored_bytes);
+            int elem_bytes = kv_dtype_.bytes();
+            int64_t consumed = DecodeBytePlanes(encoded.data(), stored_bytes,
+                                                record_bytes / elem_bytes, elem_bytes,
+                                                staging.data());
+            CHECK_EQ(consumed, stored_bytes)
+                << "ValueError: The saved sequence file \"" << path << "\" is corrupted.";
+          } else {
+            CHECK_EQ(stored_bytes, record_bytes)
+                << "ValueError: The saved sequence file \"" << path << "\" is corrupted.";
+            f_read(staging.data(), stored_bytes);
+          }
+          UnpackLastPage(layer, end - begin, last_page_length, staging.data());
+          CopyPagesWithHost(layer, block.page_ids.data() + begin, end - begin, staging.data(),
+                            /*to_host=*/false);
+        }
+      }
+    } catch (...) {
+      for (int32_t page_id : block.page_ids) {
+        free_page_ids_.push_back(page_id);
+      }
+      free_block_idx_.push_back(block_idx);
+      throw;
+    }
+
+    block.seq_length = length;
+    block.start_pos = header.start_pos;
+    seq_map_.insert({seq_id, Sequence(&global_block_pool_, block_idx)});
+    dirty_aux_data_device_ = true;
+    last_decode_batch_.valid = false;
+    return length;
+  }
+
   void AttentionWithFusedQKV(int64_t layer_id, NDArray qkv_data, Optional<NDArray> mask,
                              NDArray o_data, double sm_scale) final {
     // Part 1. Shape and dtype check.
@@ -1719,6 +2242,252 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     return block_idx;
   }
 
+  /*! \brief Check that the sequence is not receiving KV data from a KV transport. */
+  void CheckNotReceiving(int64_t seq_id) const {
+    CHECK(disagg_recvs_.find(seq_id) == disagg_recvs_.end())
+        << "ValueError: The sequence \"" << seq_id << "\" is still receiving KV data.";
+  }
+
+  /*! \brief Check that the KV cache can send and receive KV data over KV transports. */
+  void CheckDisaggTransportSupported() const {
+    for (AttnKind attn_kind : attn_kinds_) {
+      CHECK(attn_kind == AttnKind::kMHA)
+          << "ValueError: KV transfer over KV transports only supports MHA for now.";
+    }
+    CHECK(f_transpose_append_mha_.defined());
+  }
+
+  /*! \brief Check the header of a receive and reserve the pages for the received tokens. */
+  void ReserveDisaggRecv(int64_t seq_id, Sequence* seq, DisaggRecvState* state) {
+    const KVTransferHeader& header = state->header;
+    CHECK(DataType(header.dtype) == kv_dtype_ && header.num_layers == num_layers_ &&
+          header.num_kv_heads == num_kv_heads_ && header.head_dim == qk_head_dim_)
+        << "ValueError: The KV data received for sequence \"" << seq_id
+        << "\" has a different dtype, number of layers or head shape from the KV cache.";
+    CHECK(header.rope_mode == static_cast<int32_t>(rope_mode_) &&
+          header.rotary_scale == rotary_scale_ && header.rotary_theta == rotary_theta_)
+        << "ValueError: The KV data received for sequence \"" << seq_id
+        << "\" has a different RoPE configuration from the KV cache.";
+    CHECK_EQ(header.begin, seq->seq_length)
+        << "ValueError: The KV data received for sequence \"" << seq_id << "\" starts at "
+        << header.begin << ", while the sequence has length " << seq->seq_length;
+    Block& block = global_block_pool_[seq->last_block_idx];
+    state->block_length_before = block.seq_length;
+    int64_t append_length = header.length - header.begin;
+    if (append_length > 0) {
+      int64_t num_new_pages =
+          (block.seq_length + append_length + page_size_ - 1) / page_size_ - block.page_ids.size();
+      CHECK_LE(num_new_pages, static_cast<int64_t>(free_page_ids_.size()))
+          << "ValueError: The KV cache does not have enough free pages to receive "
+          << append_length << " tokens for sequence \"" << seq_id << "\"";
+      ReserveAppendLengthInSeq(seq, append_length);
+    }
+    state->reserved = true;
+  }
+
+  /*! \brief Write a received record into the reserved pages of the sequence. */
+  void WriteDisaggRecord(const Sequence* seq, const DisaggRecvState* state,
+                         const DisaggRecvState::Record& record) {
+    if (record.num_tokens == 0) {
+      return;
+    }
+    ICHECK(state->reserved);
+    const Block& block = global_block_pool_[seq->last_block_idx];
+    std::vector<int32_t> position_map(record.num_tokens);
+    for (int64_t i = 0; i < record.num_tokens; ++i) {
+      int64_t offset =
+          state->block_length_before + record.token_begin - state->header.begin + i;
+      position_map[i] = block.page_ids[offset / page_size_] * page_size_ + offset % page_size_;
+    }
+    NDArray position_map_device = NDArray::Empty({record.num_tokens}, dtype_aux_, device_);
+    position_map_device.CopyFromBytes(position_map.data(), position_map.size() * sizeof(int32_t));
+    size_t kv_bytes = record.data.size() / 2;
+    NDArray k_data = NDArray::Empty({record.num_tokens, num_kv_heads_, qk_head_dim_}, kv_dtype_,
+                                    device_);
+    NDArray v_data = NDArray::Empty({record.num_tokens, num_kv_heads_, qk_head_dim_}, kv_dtype_,
+                                    device_);
+    k_data.CopyFromBytes(record.data.data(), kv_bytes);
+    v_data.CopyFromBytes(record.data.data() + kv_bytes, kv_bytes);
+    f_transpose_append_mha_.value()(pages_[record.layer], k_data, v_data, position_map_device);
+  }
+
+  /*! \brief Stop a receive, and release the pages reserved for it. */
+  void AbortDisaggRecv(int64_t seq_id) {
+    auto it = disagg_recvs_.find(seq_id);
+    ICHECK(it != disagg_recvs_.end());
+    DisaggRecvState* state = it->second.get();
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->cancelled = true;
+    }
+    state->cv.notify_all();
+    state->transport->Close();
+    state->thread.join();
+    auto seq_it = seq_map_.find(seq_id);
+    if (state->reserved && seq_it != seq_map_.end()) {
+      Block& block = global_block_pool_[seq_it->second.last_block_idx];
+      block.seq_length = state->block_length_before;
+      int64_t num_pages = (block.seq_length + page_size_ - 1) / page_size_;
+      while (static_cast<int64_t>(block.page_ids.size()) > num_pages) {
+        free_page_ids_.push_back(block.page_ids.back());
+        block.page_ids.pop_back();
+      }
+      dirty_aux_data_device_ = true;
+      last_decode_batch_.valid = false;
+    }
+    disagg_recvs_.erase(it);
+  }
+
+  /*!
+   * \brief Collect the pages of a sequence in position order. Every block starts at a
+   * page boundary, and all pages of a block but the last one are full. So only the
+   * last page of the sequence can be partially filled.
+   * \param start_pos The position of the first token of the sequence.
+   */
+  std::vector<int32_t> GetSequencePageIds(const Sequence& seq, int64_t* start_pos) const {
+    std::vector<int32_t> trace = seq.GetBlockTrace(global_block_pool_);
+    std::vector<int32_t> page_ids;
+    page_ids.reserve((seq.seq_length + page_size_ - 1) / page_size_);
+    *start_pos = global_block_pool_[trace.front()].start_pos;
+    int64_t length = 0;
+    for (int32_t block_id : trace) {
+      const Block& block = global_block_pool_[block_id];
+      if (block.seq_length == 0) {
+        continue;
+      }
+      ICHECK_EQ(length % page_size_, 0);
+      ICHECK_EQ(block.start_pos, *start_pos + length);
+      int64_t num_pages = (block.seq_length + page_size_ - 1) / page_size_;
+      page_ids.insert(page_ids.end(), block.page_ids.begin(), block.page_ids.begin() + num_pages);
+      length += block.seq_length;
+    }
+    ICHECK_EQ(length, seq.seq_length);
+    return page_ids;
+  }
+
+  /*! \brief Make the header of a saved sequence file without the sequence fields. */
+  KVSequenceFileHeader MakeKVSequenceFileHeader(bool compress) const {
+    KVSequenceFileHeader header;
+    // Zero the padding bytes as well, since the header is written as is.
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kKVSequenceFileMagic;
+    header.version = kKVSequenceFileVersion;
+    header.compressed = compress;
+    header.dtype = kv_dtype_;
+    header.rope_mode = static_cast<int32_t>(rope_mode_);
+    header.rotary_scale = rotary_scale_;
+    header.rotary_theta = rotary_theta_;
+    header.num_layers = num_layers_;
+    header.page_size = page_size_;
+    return header;
+  }
+
+  /*! \brief The page shape of each layer, each prefixed with its number of dimensions. */
+  std::vector<int64_t> GetPageShapes() const {
+    std::vector<int64_t> page_shapes;
+    for (int64_t layer = 0; layer < num_layers_; ++layer) {
+      // MHA pages are in layout (num_pages, 2, num_kv_heads, page_size, head_dim), and MLA
+      // pages in (num_pages, page_size, head_dim). Linear attention keeps per-sequence
+      // states instead of pages.
+      const NDArray& pages = pages_[layer];
+      CHECK(pages->ndim == 5 || pages->ndim == 3)
+          << "ValueError: Saving and restoring sequences is not supported for the KV cache of "
+             "linear attention layers.";
+      CHECK(kv_dtype_.bits() % 8 == 0 && kv_dtype_.lanes() == 1)
+          << "ValueError: Saving and restoring sequences is not supported for KV dtype "
+          << kv_dtype_;
+      page_shapes.push_back(pages->ndim - 1);
+      page_shapes.insert(page_shapes.end(), pages->shape + 1, pages->shape + pages->ndim);
+    }
+    return page_shapes;
+  }
+
+  /*! \brief The number of bytes of one page of the given layer. */
+  int64_t GetPageBytes(int64_t layer) const {
+    return GetDataSize(*pages_[layer].operator->()) / pages_[layer]->shape[0];
+  }
+
+  /*!
+   * \brief The number of page slot groups and the bytes of one slot in a group of the
+   * pages of the given layer. The slots of each group are contiguous in a page.
+   */
+  std::pair<int64_t, int64_t> GetPageSlotGroups(int64_t layer) const {
+    const NDArray& pages = pages_[layer];
+    int64_t num_groups = pages->ndim == 5 ? pages->shape[1] * pages->shape[2] : 1;
+    return {num_groups, GetPageBytes(layer) / num_groups / page_size_};
+  }
+
+  /*! \brief The number of pages streamed at a time when saving or restoring sequences. */
+  int64_t GetKVSequenceFileChunkPages() const {
+    int64_t max_page_bytes = 1;
+    for (int64_t layer = 0; layer < num_layers_; ++layer) {
+      max_page_bytes = std::max(max_page_bytes, GetPageBytes(layer));
+    }
+    return std::max<int64_t>(kKVSequenceFileStagingBytes / max_page_bytes, 1);
+  }
+
+  /*! \brief The bytes of a saved record of pages whose last page has the given length. */
+  int64_t GetPagesRecordBytes(int64_t layer, int64_t num_pages, int64_t last_page_length) const {
+    auto [num_groups, slot_bytes] = GetPageSlotGroups(layer);
+    return (num_pages - 1) * GetPageBytes(layer) + num_groups * last_page_length * slot_bytes;
+  }
+
+  /*! \brief Drop the unused slots of the last page of the staged pages in place. */
+  void PackLastPage(int64_t layer, int64_t num_pages, int64_t last_page_length,
+                    uint8_t* staging) const {
+    auto [num_groups, slot_bytes] = GetPageSlotGroups(layer);
+    uint8_t* last_page = staging + (num_pages - 1) * GetPageBytes(layer);
+    for (int64_t group = 1; group < num_groups; ++group) {
+      std::memmove(last_page + group * last_page_length * slot_bytes,
+                   last_page + group * page_size_ * slot_bytes, last_page_length * slot_bytes);
+    }
+  }
+
+  /*! \brief Restore the page layout of the last page of a saved record in place. */
+  void UnpackLastPage(int64_t layer, int64_t num_pages, int64_t last_page_length,
+                      uint8_t* staging) const {
+    auto [num_groups, slot_bytes] = GetPageSlotGroups(layer);
+    uint8_t* last_page = staging + (num_pages - 1) * GetPageBytes(layer);
+    for (int64_t group = num_groups - 1; group >= 1; --group) {
+      std::memmove(last_page + group * page_size_ * slot_bytes,
+                   last_page + group * last_page_length * slot_bytes,
+                   last_page_length * slot_bytes);
+    }
+  }
+
+  /*!
+   * \brief Copy the given pages of a layer from or to the host staging buffer, where
+   * the pages are laid out back to back. Runs of consecutive page ids are copied at once.
+   */
+  void CopyPagesWithHost(int64_t layer, const int32_t* page_ids, int64_t num_pages,
+                         uint8_t* staging, bool to_host) {
+    const NDArray& pages = pages_[layer];
+    int64_t page_bytes = GetPageBytes(layer);
+    std::vector<int64_t> shape(pages->shape, pages->shape + pages->ndim);
+    for (int64_t i = 0; i < num_pages;) {
+      int64_t run = 1;
+      while (i + run < num_pages && page_ids[i + run] == page_ids[i] + run) {
+        ++run;
+      }
+      shape[0] = run;
+      NDArray view = pages.CreateView(shape, pages->dtype, page_ids[i] * page_bytes);
+      if (to_host) {
+        view.CopyToBytes(staging + i * page_bytes, run * page_bytes);
+      } else {
+        view.CopyFromBytes(staging + i * page_bytes, run * page_bytes);
+      }
+      i += run;
+    }
+  }
+
+  /*! \brief Wait for the pending kernels and copies on the pages before host access. */
+  void SyncStreamsForHostAccess() {
+    DeviceAPI::Get(device_)->StreamSync(device_, compute_stream_);
+    if (copy_stream_ != compute_stream_) {
+      DeviceAPI::Get(device_)->StreamSync(device_, copy_stream_);
+    }
+  }
+
   void ConstructTokenTreeMask(const std::vector<Sequence*>& sequences,
                               const ffi::Shape& token_tree_parent_ptr,
                               const std::vector<std::vector<int32_t>>& block_ids_on_depths,
@@ -1965,6 +2734,96 @@ class PagedAttentionKVCacheObj : public AttentionKVCacheObj {
     dirty_aux_data_device_ = true;
   }
 
+  /*!
+   * \brief The steady-state decode path of BeginForward. When the batch is
+   * the same as the last plain decode step and nothing else touched its
+   * sequences since, only the per-sequence lengths and positions change, plus
+   * the page table of the sequences that cross a page boundary. The host
+   * auxiliary arrays are patched in place, and the page table is rebuilt
+   * from the first sequence which gets a new page.
+   * \return Whether the fast path applies. Nothing is changed if it does not.
+   */
+  bool TryIncrementalDecodeBeginForward(const ffi::Shape& seq_ids,
+                                        const ffi::Shape& append_lengths,
+                                        const Optional<ffi::Shape>& opt_token_tree_parent_ptr) {
+    DecodeBatchSnapshot& snapshot = last_decode_batch_;
+    int batch_size = seq_ids.size();
+    if (!snapshot.valid || opt_token_tree_parent_ptr.defined() ||
+        batch_size != static_cast<int>(snapshot.seq_ids.size())) {
+      return false;
+    }
+    HostMemoryVector& page_indptr_h = page_indptr_on_depths_host_[0];
+    HostMemoryVector& page_indices_h = page_indices_on_depths_host_[0];
+    std::vector<Sequence*> sequences;
+    sequences.reserve(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      if (append_lengths[i] != 1 || seq_ids[i] != snapshot.seq_ids[i]) {
+        return false;
+      }
+      auto it = seq_map_.find(seq_ids[i]);
+      if (it == seq_map_.end()) {
+        return false;
+      }
+      Sequence* sequence = &it->second;
+      if (sequence->last_block_idx != snapshot.block_ids[i] ||
+          sequence->seq_length != snapshot.seq_lengths[i] ||
+          !sequence->accepted_indices_committed ||
+          sequence->kv_transfer_metadata.start != std::numeric_limits<int64_t>::max() ||
+          !sequence->kv_transfer_metadata.local_position_map.empty()) {
+        return false;
+      }
+      // The block must not have been forked, popped or refilled since the last step.
+      const Block& block = global_block_pool_[sequence->last_block_idx];
+      int32_t num_pages = page_indptr_h[i + 1] - page_indptr_h[i];
+      if (block.parent_idx != -1 || block.external_ref_cnt != 1 ||
+          block.seq_length != sequence->seq_length || num_pages == 0 ||
+          static_cast<int32_t>(block.page_ids.size()) != num_pages ||
+          block.page_ids.back() != page_indices_h[page_indptr_h[i + 1] - 1]) {
+        return false;
+      }
+      sequences.push_back(sequence);
+    }
+
+    cur_batch_size_ = batch_size;
+    cur_seq_ids_ = seq_ids;
+    cur_append_lengths_ = append_lengths;
+    is_decode_request_ = true;
+    // qo_indptr, k_rope_pos_offset and the kv transfer maps stay the same.
+    int32_t* k_ragged_rope_pos_offset = k_ragged_rope_pos_offset_host_.data();
+    int32_t* q_rope_position_map = q_rope_position_map_host_.data();
+    int32_t* append_position_map = append_position_map_host_.data();
+    int32_t* last_page_len = last_page_len_on_depths_host_[0].data();
+    int first_new_page_seq = batch_size;
+    for (int i = 0; i < batch_size; ++i) {
+      Sequence* sequence = sequences[i];
+      size_t num_pages_before = global_block_pool_[sequence->last_block_idx].page_ids.size();
+      k_ragged_rope_pos_offset[i] = sequence->seq_length;
+      q_rope_position_map[i] = sequence->seq_length;
+      sequence->seq_length += 1;
+      ReserveAppendLengthInSeq(sequence, /*append_length=*/1);
+      const Block& block = global_block_pool_[sequence->last_block_idx];
+      if (block.page_ids.size() != num_pages_before && first_new_page_seq == batch_size) {
+        first_new_page_seq = i;
+      }
+      int32_t pos = block.seq_length - 1;
+      last_page_len[i] = pos % page_size_ + 1;
+      append_position_map[i] = block.page_ids[pos / page_size_] * page_size_ + pos % page_size_;
+      snapshot.seq_lengths[i] = sequence->seq_length;
+    }
+    if (first_new_page_seq < batch_size) {
+      page_indptr_h.resize(first_new_page_seq + 1);
+      page_indices_h.resize(page_indptr_h.back());
+      for (int i = first_new_page_seq; i < batch_size; ++i) {
+        const Block& block = global_block_pool_[sequences[i]->last_block_idx];
+        for (int32_t page_id : block.page_ids) {
+          page_indices_h.push_back(page_id);
+        }
+        page_indptr_h.push_back(page_indptr_h.back() + block.page_ids.size());
+      }
+    }
+    return true;
+  }
+
   /*! \brief Check whether BeginForward for kernels is needed. */
   bool NeedKernelBeginForward() {
     std::vector<AttnBackendFunc*> funcs = {f_attention_prefill_.get(),
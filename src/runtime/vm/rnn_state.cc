@@ -41,8 +41,11 @@ class RNNStateImpObj : public RNNStateObj {
   /********************* Data Structures *********************/
 
   /*!
-   * \brief The sequence structure in paged KV cache with common prefix support.
-   * Each sequence contains one or more blocks to support common prefix.
+   * \brief The sequence structure in the space state storage.
+   * The state of the sequence at each history slot is stored in the seq slot
+   * recorded for that history slot. Forked sequences share the seq slots of their
+   * parent, and a sequence only writes into a seq slot when no other sequence
+   * references the history slot being overwritten, so that forks copy no state data.
    */
   struct Sequence {
     /*! \brief The total sequence length of the sequence. */
@@ -51,17 +54,15 @@ class RNNStateImpObj : public RNNStateObj {
     int64_t available_history_num = 0;
     /*! \brief The index of history slot in the storage. */
     int64_t history_slot_id = 0;
-    /*! \brief The index of seq slot in the storage. */
-    int64_t seq_slot_id;
+    /*! \brief The index of the seq slot in the storage holding each history slot. */
+    std::vector<int64_t> seq_slot_ids;
 
     /*! \brief Constructor. */
-    explicit Sequence(int64_t seq_slot_id) : seq_slot_id(seq_slot_id) {}
+    explicit Sequence(int64_t seq_slot_id, int64_t max_history)
+        : seq_slot_ids(max_history, seq_slot_id) {}
 
-    static Sequence Fork(const Sequence& parent, int64_t seq_slot_id) {
-      Sequence child = parent;
-      child.seq_slot_id = seq_slot_id;
-      return child;
-    }
+    /*! \brief The index of the seq slot holding the current state. */
+    int64_t CurrentSlot() const { return seq_slot_ids[history_slot_id]; }
   };
 
   /********************* Configuration *********************/
@@ -95,6 +96,13 @@ class RNNStateImpObj : public RNNStateObj {
   Array<Array<NDArray>> storages_;
   /*! \brief The list of ids of released seq slot for reuse. */
   std::vector<int64_t> free_slot_ids_;
+  /*!
+   * \brief The number of sequences referencing each history slot of each seq slot,
+   * in layout `(num_seq, max_history)`.
+   */
+  std::vector<int32_t> history_ref_count_;
+  /*! \brief The total number of references to each seq slot. A seq slot is free at zero. */
+  std::vector<int32_t> slot_ref_count_;
   /*! \brief The mapping from sequence ids to sequences. */
   std::unordered_map<int64_t, Sequence> seq_map_;
 
@@ -106,6 +114,8 @@ class RNNStateImpObj : public RNNStateObj {
   ffi::Shape cur_append_lengths_;
   /*! \brief The sequence ids of the current round of forwarding. */
   ffi::Shape cur_seq_ids_;
+  /*! \brief The seq slots the sequences of the current round of forwarding write into. */
+  std::vector<int64_t> cur_write_slot_ids_;
 
   /**************** Auxiliary Arrays on Device *****************/
 
@@ -128,6 +138,13 @@ class RNNStateImpObj : public RNNStateObj {
    * The view is used to reuse the memory but with different shape.
    */
   NDArray history_slot_ids_view_;
+  /*! \brief The device array of the seq slot ids written by `Set`. */
+  NDArray write_slot_ids_device_;
+  /*!
+   * \brief The view of the device array of the written seq slot ids.
+   * The view is used to reuse the memory but with different shape.
+   */
+  NDArray write_slot_ids_view_;
 
   /******************* Interaction Functions *******************/
 
@@ -188,6 +205,7 @@ class RNNStateImpObj : public RNNStateObj {
     // Allocate the auxiliary arrays on device.
     seq_slot_ids_device_ = NDArray::Empty({reserved_num_seqs}, dtype_aux_, device);
     history_slot_ids_device_ = NDArray::Empty({reserved_num_seqs}, dtype_aux_, device);
+    write_slot_ids_device_ = NDArray::Empty({reserved_num_seqs}, dtype_aux_, device);
 
     Clear();
   }
@@ -200,6 +218,8 @@ class RNNStateImpObj : public RNNStateObj {
     for (int64_t slot_id = reserved_num_seqs_ - 1; slot_id >= 0; --slot_id) {
       free_slot_ids_.push_back(slot_id);
     }
+    history_ref_count_.assign(reserved_num_seqs_ * max_history_, 0);
+    slot_ref_count_.assign(reserved_num_seqs_, 0);
     dirty_aux_data_device_ = false;
   }
 
@@ -227,6 +247,15 @@ class RNNStateImpObj : public RNNStateObj {
     cur_append_lengths_ = append_lengths;
     cur_seq_ids_ = seq_ids;
 
+    // Drop rollback history when the storage is too full for the forked sequences.
+    bool assigned = AssignWriteSlots(seq_ids);
+    for (bool keep_current_slot : {true, false}) {
+      if (assigned) break;
+      TrimHistory(keep_current_slot);
+      assigned = AssignWriteSlots(seq_ids);
+    }
+    CHECK(assigned) << "The Sequence slot is full, cannot write the states of forked sequences.";
+
     if (dirty_aux_data_device_) {
       SyncAuxArrayToDevice();
     }
@@ -239,15 +268,22 @@ class RNNStateImpObj : public RNNStateObj {
       auto it = seq_map_.find(seq_id);
       CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id
                                   << "\" cannot be found in the space state storage.";
-      it->second.seq_length += seq_length;
+      Sequence& seq = it->second;
+      Sequence prev_seq = seq;
+      seq.seq_length += seq_length;
       if (seq_length > 1) {
         // We cannot rollback the prefill input
-        it->second.available_history_num = 0;
+        seq.available_history_num = 0;
       } else {
-        it->second.available_history_num =
-            std::min(it->second.available_history_num + 1, max_history_ - 1);
+        seq.available_history_num = std::min(seq.available_history_num + 1, max_history_ - 1);
       }
-      it->second.history_slot_id = (it->second.history_slot_id + 1) % max_history_;
+      seq.history_slot_id = (seq.history_slot_id + 1) % max_history_;
+      seq.seq_slot_ids[seq.history_slot_id] = cur_write_slot_ids_[i];
+      // Retain the new history before releasing the old one, so that the shared seq
+      // slots are never freed in between.
+      RetainHistory(seq);
+      ReleaseHistory(prev_seq);
+      ReleaseHistorySlot(cur_write_slot_ids_[i], seq.history_slot_id);
     }
     // TODO(Siyuan): We need to update history_slot_id_device_ (on device) as well.
     // There are two ways to do this:
@@ -281,7 +317,7 @@ class RNNStateImpObj : public RNNStateObj {
     CHECK_GT(cur_batch_size_, 0) << "The curent batch size should be greater than 0.";
 
     NDArray state = storages_[layer_id][state_id];
-    f_sets_[state_id](state, seq_slot_ids_view_, history_slot_ids_view_, data);
+    f_sets_[state_id](state, write_slot_ids_view_, history_slot_ids_view_, data);
   }
 
   NDArray DebugGet(int64_t layer_id, int64_t state_id, int64_t seq_id) {
@@ -289,7 +325,7 @@ class RNNStateImpObj : public RNNStateObj {
     CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id
                                 << "\" cannot be found in the space state storage.";
     NDArray state = storages_[layer_id][state_id];
-    int64_t seq_slot_id = it->second.seq_slot_id;
+    int64_t seq_slot_id = it->second.CurrentSlot();
     int64_t history_slot_id = it->second.history_slot_id;
 
     std::vector<int64_t> shape{state.Shape().begin() + 2, state.Shape().end()};
@@ -307,7 +343,9 @@ class RNNStateImpObj : public RNNStateObj {
     CHECK(seq_map_.find(seq_id) == seq_map_.end())
         << "The sequence \"" << seq_id << "\" is already in the space state storage.";
     int64_t seq_slot_id = GetFreeSlot();
-    seq_map_.insert({seq_id, Sequence(seq_slot_id)});
+    Sequence seq(seq_slot_id, max_history_);
+    RetainHistory(seq);
+    seq_map_.insert({seq_id, std::move(seq)});
 
     // Initialize the state data with the init value.
     for (int64_t layer_id = 0; layer_id < num_layers_; ++layer_id) {
@@ -327,7 +365,7 @@ class RNNStateImpObj : public RNNStateObj {
     CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id
                                 << "\" cannot be found in the space state storage.";
 
-    free_slot_ids_.push_back(it->second.seq_slot_id);
+    ReleaseHistory(it->second);
     seq_map_.erase(it);
 
     dirty_aux_data_device_ = true;
@@ -340,19 +378,10 @@ class RNNStateImpObj : public RNNStateObj {
     CHECK(seq_map_.find(child_seq_id) == seq_map_.end())
         << "The child sequence \"" << child_seq_id << "\" is already in the space state storage.";
 
-    // Create a child block with the parent block pointer.
-    int64_t child_slot_id = GetFreeSlot();
-    seq_map_.insert({child_seq_id, Sequence::Fork(parent_it->second, child_slot_id)});
-
-    // Copy the parent state data to the child state data.
-    int64_t parent_slot_id = parent_it->second.seq_slot_id;
-    for (int64_t layer_id = 0; layer_id < num_layers_; ++layer_id) {
-      for (int64_t state_id = 0; state_id < num_states_per_layer_; ++state_id) {
-        DLTensor copy_src = GetStatePtrBySeq(layer_id, state_id, parent_slot_id);
-        DLTensor copy_dst = GetStatePtrBySeq(layer_id, state_id, child_slot_id);
-        NDArray::CopyFromTo(&copy_src, &copy_dst);
-      }
-    }
+    // The child shares the seq slots of the parent, no state data is copied.
+    Sequence child = parent_it->second;
+    RetainHistory(child);
+    seq_map_.insert({child_seq_id, std::move(child)});
     dirty_aux_data_device_ = true;
   }
 
@@ -366,6 +395,10 @@ class RNNStateImpObj : public RNNStateObj {
         << " available history in the space state storage, while the length of rollback is " << n
         << " which exceeds the sequence length.";
 
+    for (int32_t i = 0; i < n; ++i) {
+      int64_t history_slot_id = (it->second.history_slot_id - i + max_history_) % max_history_;
+      ReleaseHistorySlot(it->second.seq_slot_ids[history_slot_id], history_slot_id);
+    }
     it->second.seq_length -= n;
     it->second.available_history_num -= n;
     it->second.history_slot_id = (it->second.history_slot_id - n + max_history_) % max_history_;
@@ -375,6 +408,10 @@ class RNNStateImpObj : public RNNStateObj {
  private:
   /*! \brief Get a new free block and return its index. */
   int32_t GetFreeSlot() {
+    for (bool keep_current_slot : {true, false}) {
+      if (!free_slot_ids_.empty()) break;
+      TrimHistory(keep_current_slot);
+    }
     CHECK(!free_slot_ids_.empty()) << "The Sequence slot is full, cannot accept new sequence.";
     int32_t seq_slot_id = free_slot_ids_.back();
     free_slot_ids_.pop_back();
@@ -397,19 +434,95 @@ class RNNStateImpObj : public RNNStateObj {
     return _state;
   }
 
-  DLTensor GetStatePtrBySeq(int64_t layer_id, int64_t state_id, int64_t seq_slot_id) {
-    NDArray state = storages_[layer_id][state_id];
-    int64_t state_size = 1;
-    for (int64_t i = 1; i < state->ndim; ++i) {
-      state_size *= state->shape[i];
+  /*!
+   * \brief Pick the seq slot each sequence of the forward writes its next state into.
+   * The current seq slot is reused unless another sequence references the history slot
+   * to overwrite, in which case the state is read from the shared seq slot and written
+   * to a new one.
+   * \return Whether there are enough free seq slots. Nothing is assigned otherwise.
+   */
+  bool AssignWriteSlots(const ffi::Shape& seq_ids) {
+    cur_write_slot_ids_.clear();
+    cur_write_slot_ids_.reserve(seq_ids.size());
+    for (int64_t seq_id : seq_ids) {
+      auto it = seq_map_.find(seq_id);
+      CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id
+                                  << "\" cannot be found in the space state storage.";
+      const Sequence& seq = it->second;
+      int64_t next_history_slot_id = (seq.history_slot_id + 1) % max_history_;
+      int64_t write_slot_id = seq.CurrentSlot();
+      int32_t self_ref = seq.available_history_num == max_history_ - 1 &&
+                         seq.seq_slot_ids[next_history_slot_id] == write_slot_id;
+      if (history_ref_count_[write_slot_id * max_history_ + next_history_slot_id] > self_ref) {
+        if (free_slot_ids_.empty()) {
+          // Roll back the assignment.
+          for (size_t i = 0; i < cur_write_slot_ids_.size(); ++i) {
+            const Sequence& assigned_seq = seq_map_.at(seq_ids[i]);
+            ReleaseHistorySlot(cur_write_slot_ids_[i],
+                               (assigned_seq.history_slot_id + 1) % max_history_);
+          }
+          cur_write_slot_ids_.clear();
+          return false;
+        }
+        write_slot_id = GetFreeSlot();
+        dirty_aux_data_device_ = true;
+      }
+      // Hold the written history slot until EndForward.
+      RetainHistorySlot(write_slot_id, next_history_slot_id);
+      cur_write_slot_ids_.push_back(write_slot_id);
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Drop the rollback history of the sequences to release the seq slots only kept
+   * alive for rolling back across forks, when the storage is full.
+   * \param keep_current_slot Whether to keep the history stored in the current seq slot
+   * of each sequence, which holds no seq slot alive by itself.
+   */
+  void TrimHistory(bool keep_current_slot) {
+    for (auto& [seq_id, seq] : seq_map_) {
+      while (seq.available_history_num > 0) {
+        int64_t oldest_history_slot_id =
+            (seq.history_slot_id - seq.available_history_num + max_history_) % max_history_;
+        int64_t seq_slot_id = seq.seq_slot_ids[oldest_history_slot_id];
+        if (keep_current_slot && seq_slot_id == seq.CurrentSlot()) break;
+        ReleaseHistorySlot(seq_slot_id, oldest_history_slot_id);
+        --seq.available_history_num;
+      }
+    }
+  }
+
+  /*! \brief Add a reference to a history slot of a seq slot. */
+  void RetainHistorySlot(int64_t seq_slot_id, int64_t history_slot_id) {
+    ++history_ref_count_[seq_slot_id * max_history_ + history_slot_id];
+    ++slot_ref_count_[seq_slot_id];
+  }
+
+  /*! \brief Remove a reference to a history slot of a seq slot, freeing unreferenced seq slots. */
+  void ReleaseHistorySlot(int64_t seq_slot_id, int64_t history_slot_id) {
+    int32_t& history_ref = history_ref_count_[seq_slot_id * max_history_ + history_slot_id];
+    ICHECK_GT(history_ref, 0);
+    --history_ref;
+    if (--slot_ref_count_[seq_slot_id] == 0) {
+      free_slot_ids_.push_back(seq_slot_id);
+    }
+  }
+
+  /*! \brief Add a reference to the current and the available history slots of a sequence. */
+  void RetainHistory(const Sequence& seq) {
+    for (int64_t i = 0; i <= seq.available_history_num; ++i) {
+      int64_t history_slot_id = (seq.history_slot_id - i + max_history_) % max_history_;
+      RetainHistorySlot(seq.seq_slot_ids[history_slot_id], history_slot_id);
+    }
+  }
+
+  /*! \brief Remove the references of a sequence added by RetainHistory. */
+  void ReleaseHistory(const Sequence& seq) {
+    for (int64_t i = 0; i <= seq.available_history_num; ++i) {
+      int64_t history_slot_id = (seq.history_slot_id - i + max_history_) % max_history_;
+      ReleaseHistorySlot(seq.seq_slot_ids[history_slot_id], history_slot_id);
     }
-    int64_t elem_offset = seq_slot_id * state_size;
-    // Create a new DLTensor with the same shape and dtype as the state.
-    DLTensor _state = *(state.operator->());
-    _state.byte_offset = elem_offset * state->dtype.bits / 8;
-    _state.ndim = state->ndim - 1;
-    _state.shape = const_cast<int64_t*>(_state.shape + 1);
-    return _state;
   }
 
   /*!
@@ -433,6 +546,7 @@ class RNNStateImpObj : public RNNStateObj {
 
     std::vector<int32_t> seq_slot_ids;
     std::vector<int32_t> history_slot_ids;
+    std::vector<int32_t> write_slot_ids(cur_write_slot_ids_.begin(), cur_write_slot_ids_.end());
     seq_slot_ids.reserve(cur_batch_size_);
     history_slot_ids.reserve(cur_batch_size_);
     for (int64_t seq_id : cur_seq_ids_) {
@@ -440,14 +554,16 @@ class RNNStateImpObj : public RNNStateObj {
       CHECK(it != seq_map_.end()) << "The sequence \"" << seq_id
                                   << "\" cannot be found in the space state storage.";
       const Sequence& seq = it->second;
-      seq_slot_ids.push_back(seq.seq_slot_id);
+      seq_slot_ids.push_back(seq.CurrentSlot());
       history_slot_ids.push_back(seq.history_slot_id);
     }
     seq_slot_ids_view_ = seq_slot_ids_device_.CreateView({cur_batch_size_}, dtype_aux_);
     history_slot_ids_view_ = history_slot_ids_device_.CreateView({cur_batch_size_}, dtype_aux_);
+    write_slot_ids_view_ = write_slot_ids_device_.CreateView({cur_batch_size_}, dtype_aux_);
 
     fcopy_from_vec(seq_slot_ids_view_, seq_slot_ids);
     fcopy_from_vec(history_slot_ids_view_, history_slot_ids);
+    fcopy_from_vec(write_slot_ids_view_, write_slot_ids);
 
     // Reset the dirty flag to false.
     dirty_aux_data_device_ = false;
@@ -0,0 +1,396 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/speculative_decoding.cc
+ * \brief Speculative decoding with a draft and a target model over the KVState API.
+ */
+#include "speculative_decoding.h"
+
+#include <tvm/runtime/logging.h>
+#include <tvm/runtime/trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <unordered_set>
+#include <utility>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+namespace {
+
+const float* LogitsRow(const NDArray& logits, int64_t row) {
+  const float* data =
+      reinterpret_cast<const float*>(static_cast<const char*>(logits->data) + logits->byte_offset);
+  return data + row * logits->shape[1];
+}
+
+int32_t ArgMax(const NDArray& logits, int64_t row) {
+  const float* data = LogitsRow(logits, row);
+  return static_cast<int32_t>(std::max_element(data, data + logits->shape[1]) - data);
+}
+
+/*! \brief The `k` most likely tokens of a row, the most likely first. */
+std::vector<int32_t> TopK(const NDArray& logits, int64_t row, int64_t k) {
+  CHECK_LE(k, logits->shape[1]) << "ValueError: The draft tree width " << k
+                                 << " exceeds the vocabulary size " << logits->shape[1];
+  const float* data = LogitsRow(logits, row);
+  std::vector<int32_t> ids(logits->shape[1]);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), [data](int32_t a, int32_t b) {
+    return data[a] > data[b] || (data[a] == data[b] && a < b);
+  });
+  ids.resize(k);
+  return ids;
+}
+
+/*!
+ * \brief The draft sequences forked in a step, removed when the step ends, also when
+ *  a forward throws midway.
+ */
+class DraftForkGuard {
+ public:
+  explicit DraftForkGuard(KVState state) : state_(std::move(state)) {}
+
+  ~DraftForkGuard() {
+    try {
+      RemoveAll();
+    } catch (const std::exception& err) {
+      LOG(WARNING) << "Failed to remove the draft forks of a failed step: " << err.what();
+    }
+  }
+
+  void Fork(int64_t seq_id, int64_t child_seq_id) {
+    state_->ForkSequence(seq_id, child_seq_id, /*fork_pos=*/-1);
+    forks_.push_back(child_seq_id);
+  }
+
+  void RemoveAll() {
+    while (!forks_.empty()) {
+      int64_t seq_id = forks_.back();
+      forks_.pop_back();
+      state_->RemoveSequence(seq_id);
+    }
+  }
+
+ private:
+  KVState state_;
+  std::vector<int64_t> forks_;
+};
+
+}  // namespace
+
+TVM_REGISTER_OBJECT_TYPE(SpeculativeDecoderObj);
+
+SpeculativeDecoderObj::SpeculativeDecoderObj(ffi::Function f_draft, KVState draft_state,
+                                             Array<Any> draft_args, ffi::Function f_target,
+                                             KVState target_state, Array<Any> target_args,
+                                             int64_t tree_width, int64_t tree_depth)
+    : f_draft_(std::move(f_draft)),
+      draft_state_(std::move(draft_state)),
+      draft_args_(std::move(draft_args)),
+      f_target_(std::move(f_target)),
+      target_state_(std::move(target_state)),
+      target_args_(std::move(target_args)),
+      tree_width_(tree_width),
+      tree_depth_(tree_depth) {
+  CHECK(f_draft_ != nullptr && f_target_ != nullptr)
+      << "ValueError: The draft and target functions must be defined";
+  CHECK(draft_state_.defined() && target_state_.defined())
+      << "ValueError: The draft and target KV states must be defined";
+  CHECK(!draft_state_.same_as(target_state_))
+      << "ValueError: The draft and target models cannot share a KV state";
+  CHECK_GE(tree_width_, 1) << "ValueError: The draft tree width must be positive";
+  CHECK_GE(tree_depth_, 1) << "ValueError: The draft tree depth must be positive";
+  CHECK(tree_width_ == 1 || target_state_->IsInstance<AttentionKVCacheObj>())
+      << "ValueError: Verifying draft trees of width " << tree_width_
+      << " requires the target KV state to be an attention KV cache";
+}
+
+NDArray SpeculativeDecoderObj::Forward(const ffi::Function& func, const KVState& state,
+                                       const Array<Any>& args, const std::vector<int64_t>& seq_ids,
+                                       const std::vector<int64_t>& lengths,
+                                       const std::vector<int32_t>& tokens,
+                                       const std::vector<int64_t>& token_parent_ptr) {
+  Optional<IntTuple> opt_parent_ptr;
+  if (!token_parent_ptr.empty()) opt_parent_ptr = IntTuple(token_parent_ptr);
+  state->BeginForward(IntTuple(seq_ids), IntTuple(lengths), opt_parent_ptr);
+
+  int64_t num_tokens = static_cast<int64_t>(tokens.size());
+  NDArray token_ids = NDArray::Empty({num_tokens}, DataType::Int(32), Device{kDLCPU, 0});
+  std::memcpy(token_ids->data, tokens.data(), num_tokens * sizeof(int32_t));
+  std::vector<ffi::AnyView> call_args;
+  call_args.reserve(args.size() + 2);
+  call_args.push_back(token_ids);
+  call_args.push_back(state);
+  for (const Any& arg : args) call_args.push_back(arg);
+  ffi::Any rv;
+  func.CallPacked(call_args.data(), static_cast<int32_t>(call_args.size()), &rv);
+  state->EndForward();
+
+  NDArray logits = rv.cast<NDArray>();
+  if (logits->ndim == 3 && logits->shape[0] == 1) {
+    logits = logits.CreateView({logits->shape[1], logits->shape[2]}, logits->dtype);
+  }
+  CHECK(logits->ndim == 2 && logits->shape[0] == num_tokens)
+      << "ValueError: The model is expected to return the logits of the " << num_tokens
+      << " input tokens, but got shape " << logits.Shape();
+  CHECK(logits.DataType() == DataType::Float(32))
+      << "ValueError: The model is expected to return float32 logits, but got "
+      << logits.DataType();
+  if (logits->device.device_type != kDLCPU) {
+    logits = logits.CopyTo(Device{kDLCPU, 0});
+  }
+  return logits;
+}
+
+int64_t SpeculativeDecoderObj::AddSequence(int64_t seq_id, IntTuple prompt) {
+  CHECK(seq_id >= 0 && seq_id < kBranchSeqIdBase)
+      << "ValueError: The sequence id " << seq_id << " is out of the range [0, "
+      << kBranchSeqIdBase << ")";
+  CHECK(seqs_.find(seq_id) == seqs_.end())
+      << "ValueError: The sequence " << seq_id << " already exists";
+  CHECK(!prompt.empty()) << "ValueError: The prompt of a sequence cannot be empty";
+  std::vector<int32_t> tokens(prompt.begin(), prompt.end());
+  std::vector<int64_t> ids{seq_id};
+  std::vector<int64_t> lengths{static_cast<int64_t>(tokens.size())};
+
+  draft_state_->AddSequence(seq_id);
+  Forward(f_draft_, draft_state_, draft_args_, ids, lengths, tokens);
+  target_state_->AddSequence(seq_id);
+  NDArray logits = Forward(f_target_, target_state_, target_args_, ids, lengths, tokens);
+
+  SeqState& state = seqs_[seq_id];
+  state.pending_token = ArgMax(logits, lengths[0] - 1);
+  return state.pending_token;
+}
+
+void SpeculativeDecoderObj::RemoveSequence(int64_t seq_id) {
+  CHECK(seqs_.erase(seq_id)) << "ValueError: The sequence " << seq_id << " does not exist";
+  draft_state_->RemoveSequence(seq_id);
+  target_state_->RemoveSequence(seq_id);
+}
+
+Array<IntTuple> SpeculativeDecoderObj::Step(IntTuple seq_ids) {
+  TVM_TRACE_SCOPE_ARG("speculative", "SpeculativeDecoder::Step", seq_ids.size());
+  auto start = std::chrono::steady_clock::now();
+  const int64_t batch_size = seq_ids.size();
+  const int64_t width = tree_width_;
+  const int64_t depth = tree_depth_;
+  std::vector<int64_t> ids(seq_ids.begin(), seq_ids.end());
+  std::vector<SeqState*> states;
+  states.reserve(batch_size);
+  std::unordered_set<int64_t> seen;
+  for (int64_t seq_id : ids) {
+    auto it = seqs_.find(seq_id);
+    CHECK(it != seqs_.end()) << "ValueError: The sequence " << seq_id << " does not exist";
+    CHECK(seen.insert(seq_id).second)
+        << "ValueError: The sequence " << seq_id << " appears twice in a step";
+    states.push_back(&it->second);
+  }
+
+  // drafts[i][b * depth + l] is the draft token at level l + 1 of branch b of sequence i.
+  std::vector<std::vector<int32_t>> drafts(batch_size, std::vector<int32_t>(width * depth));
+  DraftForkGuard forks(draft_state_);
+  {
+    TVM_TRACE_SCOPE("speculative", "Draft");
+    // The first draft forward also appends the tokens accepted in the last step.
+    std::vector<int64_t> lengths;
+    std::vector<int32_t> tokens;
+    for (SeqState* state : states) {
+      tokens.insert(tokens.end(), state->draft_catch_up.begin(), state->draft_catch_up.end());
+      tokens.push_back(state->pending_token);
+      lengths.push_back(static_cast<int64_t>(state->draft_catch_up.size()) + 1);
+      state->draft_catch_up.clear();
+    }
+    NDArray logits = Forward(f_draft_, draft_state_, draft_args_, ids, lengths, tokens);
+    int64_t row = 0;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      row += lengths[i];
+      std::vector<int32_t> top = TopK(logits, row - 1, width);
+      for (int64_t b = 0; b < width; ++b) drafts[i][b * depth] = top[b];
+    }
+
+    if (depth > 1) {
+      // Branch 0 grows in the sequence itself, the other branches in forks of it.
+      std::vector<int64_t> branch_ids;
+      for (int64_t i = 0; i < batch_size; ++i) {
+        branch_ids.push_back(ids[i]);
+        for (int64_t b = 1; b < width; ++b) {
+          forks.Fork(ids[i], BranchSeqId(i, b));
+          branch_ids.push_back(BranchSeqId(i, b));
+        }
+      }
+      std::vector<int64_t> ones(branch_ids.size(), 1);
+      for (int64_t l = 1; l < depth; ++l) {
+        tokens.clear();
+        for (int64_t i = 0; i < batch_size; ++i) {
+          for (int64_t b = 0; b < width; ++b) tokens.push_back(drafts[i][b * depth + l - 1]);
+        }
+        logits = Forward(f_draft_, draft_state_, draft_args_, branch_ids, ones, tokens);
+        for (int64_t i = 0; i < batch_size; ++i) {
+          for (int64_t b = 0; b < width; ++b) {
+            drafts[i][b * depth + l] = ArgMax(logits, i * width + b);
+          }
+        }
+      }
+    }
+  }
+
+  // Node 0 of a tree is the pending token, node 1 + b * depth + l is drafts[i][b * depth + l].
+  const int64_t tree_size = 1 + width * depth;
+  NDArray target_logits;
+  {
+    TVM_TRACE_SCOPE("speculative", "Verify");
+    std::vector<int64_t> lengths(batch_size, tree_size);
+    std::vector<int32_t> tokens;
+    std::vector<int64_t> parent_ptr;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      tokens.push_back(states[i]->pending_token);
+      tokens.insert(tokens.end(), drafts[i].begin(), drafts[i].end());
+      if (width > 1) {
+        parent_ptr.push_back(-1);
+        for (int64_t b = 0; b < width; ++b) {
+          for (int64_t l = 0; l < depth; ++l) {
+            parent_ptr.push_back(l == 0 ? 0 : 1 + b * depth + l - 1);
+          }
+        }
+      }
+    }
+    target_logits =
+        Forward(f_target_, target_state_, target_args_, ids, lengths, tokens, parent_ptr);
+  }
+
+  TVM_TRACE_SCOPE("speculative", "Accept");
+  Array<IntTuple> results;
+  std::vector<int64_t> leaf_indices;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    // Walk down the tree while the draft matches the greedy prediction of the target.
+    const std::vector<int32_t>& draft = drafts[i];
+    int64_t row_base = i * tree_size;
+    int64_t node = 0;
+    int64_t branch = -1;
+    int64_t num_accepted = 0;
+    int32_t prediction = ArgMax(target_logits, row_base);
+    for (int64_t l = 0; l < depth; ++l) {
+      if (l == 0) {
+        for (int64_t b = 0; b < width && branch == -1; ++b) {
+          if (draft[b * depth] == prediction) branch = b;
+        }
+        if (branch == -1) break;
+      } else if (draft[branch * depth + l] != prediction) {
+        break;
+      }
+      node = 1 + branch * depth + l;
+      ++num_accepted;
+      prediction = ArgMax(target_logits, row_base + node);
+    }
+    leaf_indices.push_back(node);
+
+    std::vector<int64_t> generated(draft.begin() + std::max<int64_t>(branch, 0) * depth,
+                                   draft.begin() + std::max<int64_t>(branch, 0) * depth +
+                                       num_accepted);
+    generated.push_back(prediction);
+    results.push_back(IntTuple(generated));
+
+    // The target keeps the pending token and the accepted drafts.
+    if (width == 1) target_state_->PopN(ids[i], static_cast<int32_t>(depth - num_accepted));
+    // The draft sequence holds the pending token and levels [1, depth) of branch 0.
+    SeqState* state = states[i];
+    if (branch <= 0) {
+      int64_t kept = std::min(num_accepted, depth - 1);
+      draft_state_->PopN(ids[i], static_cast<int32_t>(depth - 1 - kept));
+      if (num_accepted == depth) state->draft_catch_up.push_back(draft[depth - 1]);
+    } else {
+      draft_state_->PopN(ids[i], static_cast<int32_t>(depth - 1));
+      state->draft_catch_up.assign(draft.begin() + branch * depth,
+                                   draft.begin() + branch * depth + num_accepted);
+    }
+    state->pending_token = prediction;
+
+    num_generated_tokens_ += num_accepted + 1;
+    num_accepted_draft_tokens_ += num_accepted;
+  }
+  forks.RemoveAll();
+  if (width > 1) {
+    Downcast<AttentionKVCache>(target_state_)
+        ->CommitAcceptedTokenTreeNodes(IntTuple(ids), IntTuple(leaf_indices));
+  }
+
+  ++num_steps_;
+  num_seq_steps_ += batch_size;
+  step_seconds_ +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return results;
+}
+
+Map<String, Any> SpeculativeDecoderObj::Stats() const {
+  Map<String, Any> stats;
+  stats.Set("num_steps", num_steps_);
+  stats.Set("num_generated_tokens", num_generated_tokens_);
+  stats.Set("num_accepted_draft_tokens", num_accepted_draft_tokens_);
+  double num_draft_tokens = static_cast<double>(num_seq_steps_ * tree_depth_);
+  stats.Set("acceptance_rate",
+            num_seq_steps_ == 0 ? 0.0 : num_accepted_draft_tokens_ / num_draft_tokens);
+  double num_generated_tokens = static_cast<double>(num_generated_tokens_);
+  stats.Set("mean_accepted_length",
+            num_seq_steps_ == 0 ? 0.0 : num_generated_tokens / num_seq_steps_);
+  stats.Set("tokens_per_sec", step_seconds_ == 0 ? 0.0 : num_generated_tokens_ / step_seconds_);
+  return stats;
+}
+
+void SpeculativeDecoderObj::ResetStats() {
+  num_steps_ = 0;
+  num_seq_steps_ = 0;
+  num_generated_tokens_ = 0;
+  num_accepted_draft_tokens_ = 0;
+  step_seconds_ = 0;
+}
+
+//-------------------------------------------------
+//  Register runtime functions
+//-------------------------------------------------
+
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_create")
+    .set_body_typed([](ffi::Function f_draft, KVState draft_state, Array<Any> draft_args,
+                       ffi::Function f_target, KVState target_state, Array<Any> target_args,
+                       int64_t tree_width, int64_t tree_depth) {
+      ObjectPtr<SpeculativeDecoderObj> n = make_object<SpeculativeDecoderObj>(
+          std::move(f_draft), std::move(draft_state), std::move(draft_args), std::move(f_target),
+          std::move(target_state), std::move(target_args), tree_width, tree_depth);
+      return SpeculativeDecoder(n);
+    });
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_add_sequence")
+    .set_body_method(&SpeculativeDecoderObj::AddSequence);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_remove_sequence")
+    .set_body_method(&SpeculativeDecoderObj::RemoveSequence);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_step")
+    .set_body_method(&SpeculativeDecoderObj::Step);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_stats")
+    .set_body_method(&SpeculativeDecoderObj::Stats);
+TVM_FFI_REGISTER_GLOBAL("vm.builtin.speculative_decoder_reset_stats")
+    .set_body_method(&SpeculativeDecoderObj::ResetStats);
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
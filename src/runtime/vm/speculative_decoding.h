@@ -0,0 +1,165 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/runtime/vm/speculative_decoding.h
+ * \brief Speculative decoding with a draft and a target model over the KVState API.
+ *
+ *  Each step drafts a token tree for every sequence of the batch: the draft
+ *  model proposes the `tree_width` most likely next tokens, and extends each of
+ *  them greedily into a branch of `tree_depth` tokens. The branches of all the
+ *  sequences are decoded together, the first branch in the draft sequence itself
+ *  and the others in forked sequences. The target model then verifies the trees
+ *  of the whole batch in a single forward, and the longest draft prefix matching
+ *  the greedy predictions of the target is accepted, followed by the target
+ *  prediction after it. The rejected tokens are dropped from the target KV state
+ *  by committing the accepted tree path, or by PopN when the tree is a chain, and
+ *  from the draft KV state by PopN.
+ *
+ *  The accepted tokens are the ones greedy decoding of the target model would
+ *  generate, the draft model only affects the speed.
+ *
+ *  Both models are functions `f(token_ids, kv_state, *args) -> logits`, where
+ *  `token_ids` is an int32 [n] array on CPU with the tokens of all the sequences
+ *  of the forward concatenated, and `logits` is a float32 [n, vocab_size] (or
+ *  [1, n, vocab_size]) array. The driver invokes BeginForward/EndForward of the
+ *  KV state around each call.
+ */
+#ifndef TVM_RUNTIME_VM_SPECULATIVE_DECODING_H_
+#define TVM_RUNTIME_VM_SPECULATIVE_DECODING_H_
+
+#include <tvm/ffi/container/array.h>
+#include <tvm/ffi/container/map.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/object.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "kv_state.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*! \brief Runs speculative decoding of a batch of sequences. */
+class SpeculativeDecoderObj : public Object {
+ public:
+  /*!
+   * \brief The sequence ids from this value on are used for the forked draft branches,
+   * user sequence ids must be smaller.
+   */
+  static constexpr int64_t kBranchSeqIdBase = int64_t(1) << 62;
+
+  /*!
+   * \brief Create a speculative decoder.
+   * \param f_draft The forward function of the draft model.
+   * \param draft_state The KV state of the draft model.
+   * \param draft_args The arguments appended after the KV state when calling `f_draft`.
+   * \param f_target The forward function of the target model.
+   * \param target_state The KV state of the target model. It must be an attention KV cache
+   *  when `tree_width` is larger than 1.
+   * \param target_args The arguments appended after the KV state when calling `f_target`.
+   * \param tree_width The number of branches of the draft token tree.
+   * \param tree_depth The number of draft tokens of each branch.
+   */
+  SpeculativeDecoderObj(ffi::Function f_draft, KVState draft_state, Array<Any> draft_args,
+                        ffi::Function f_target, KVState target_state, Array<Any> target_args,
+                        int64_t tree_width, int64_t tree_depth);
+
+  /*!
+   * \brief Add a sequence and prefill its prompt into both models.
+   * \return The first generated token.
+   */
+  int64_t AddSequence(int64_t seq_id, IntTuple prompt);
+
+  /*! \brief Remove a sequence from both models. */
+  void RemoveSequence(int64_t seq_id);
+
+  /*!
+   * \brief Run one speculative step for the given sequences.
+   * \return The tokens generated for each sequence, at least one per sequence.
+   */
+  Array<IntTuple> Step(IntTuple seq_ids);
+
+  /*!
+   * \brief The statistics since the creation or the last reset: the number of steps,
+   * generated tokens and accepted draft tokens, the acceptance rate of the draft tokens
+   * along a branch, the mean number of tokens generated per sequence and step, and the
+   * generated tokens per second spent in Step.
+   */
+  Map<String, Any> Stats() const;
+
+  /*! \brief Reset the statistics. */
+  void ResetStats();
+
+  static constexpr const char* _type_key = "relax.vm.SpeculativeDecoder";
+  TVM_DECLARE_FINAL_OBJECT_INFO(SpeculativeDecoderObj, Object);
+
+ private:
+  /*! \brief The decoding state of a sequence. */
+  struct SeqState {
+    /*! \brief The last generated token, which is in neither KV state yet. */
+    int32_t pending_token;
+    /*! \brief The accepted tokens of the last step which are missing in the draft KV state. */
+    std::vector<int32_t> draft_catch_up;
+  };
+
+  /*!
+   * \brief Run a forward of a model and return the logits on CPU.
+   * \param token_parent_ptr The token tree of the forward, or empty for chains.
+   */
+  NDArray Forward(const ffi::Function& func, const KVState& state, const Array<Any>& args,
+                  const std::vector<int64_t>& seq_ids, const std::vector<int64_t>& lengths,
+                  const std::vector<int32_t>& tokens,
+                  const std::vector<int64_t>& token_parent_ptr = {});
+
+  /*! \brief The id of a forked draft branch of the i-th sequence of a step. */
+  int64_t BranchSeqId(int64_t i, int64_t branch) const {
+    return kBranchSeqIdBase + i * tree_width_ + branch;
+  }
+
+  ffi::Function f_draft_;
+  KVState draft_state_;
+  Array<Any> draft_args_;
+  ffi::Function f_target_;
+  KVState target_state_;
+  Array<Any> target_args_;
+  int64_t tree_width_;
+  int64_t tree_depth_;
+  std::unordered_map<int64_t, SeqState> seqs_;
+
+  int64_t num_steps_ = 0;
+  int64_t num_seq_steps_ = 0;
+  int64_t num_generated_tokens_ = 0;
+  int64_t num_accepted_draft_tokens_ = 0;
+  double step_seconds_ = 0;
+};
+
+class SpeculativeDecoder : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(SpeculativeDecoder, ObjectRef, SpeculativeDecoderObj);
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_SPECULATIVE_DECODING_H_
@@ -25,6 +25,7 @@
 #include <tvm/runtime/memory/memory_manager.h>
 #include <tvm/runtime/nvtx.h>
 #include <tvm/runtime/profiling.h>
+#include <tvm/runtime/trace.h>
 #include <tvm/runtime/vm/vm.h>
 #include <optional>
 #include <thread>
@@ -751,6 +752,7 @@ void VirtualMachineImpl::InitFuncPool() {
 }
 
 void VirtualMachineImpl::RunInstrCall(VMFrame* curr_frame, Instruction instr) {
+  TVM_TRACE_SCOPE("vm", GetFuncName(instr.func_idx));
   DLOG(INFO) << "\n  pc = " << pc_ << ", execute: " << GetFuncName(instr.func_idx);
   int args_begin_offset = instrument_ != nullptr ? 4 : 0;
   // Use the call arg stack from the current frame to increase reuse
@@ -1189,6 +1191,7 @@ void VirtualMachineImpl::InvokeSegment(const std::vector<int> segment){
 
 // HayeonP
 void VirtualMachineImpl::RunInstrCallForSegment(VMFrame*& curr_frame, Instruction instr) {
+  TVM_TRACE_SCOPE("vm", GetFuncName(instr.func_idx));
   DLOG(INFO) << "\n  pc = " << pc_ << ", execute: " << GetFuncName(instr.func_idx);
   int args_begin_offset = instrument_ != nullptr ? 4 : 0;
   // Use the call arg stack from the current frame to increase reuse
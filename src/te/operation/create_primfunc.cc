@@ -22,6 +22,8 @@
 #include <tvm/arith/analyzer.h>
 #include <tvm/ffi/function.h>
 #include <tvm/ir/name_supply.h>
+#include <tvm/node/structural_equal.h>
+#include <tvm/node/structural_hash.h>
 #include <tvm/te/operation.h>
 #include <tvm/tir/analysis.h>
 #include <tvm/tir/data_type_rewriter.h>
@@ -859,9 +861,163 @@ PrimFunc CreatePrimFuncWithConstants(const Array<ObjectRef>& arg_list,
   return result;
 }
 
+/*!
+ * \brief The key of a TE graph in the cache of CreatePrimFunc. The tensors are referred to by
+ * the post-order index of their op in the graph, and the names of the placeholders are dropped,
+ * so that the graphs of the same structure, e.g. of the same op in each layer of a model, have
+ * structurally equal keys.
+ */
+class TEGraphKeyBuilder : public ExprMutator {
+ public:
+  /*! \return The key, or std::nullopt if the graph has ops other than placeholders and computes. */
+  static std::optional<ObjectRef> Build(const Array<ObjectRef>& arg_list,
+                                        std::optional<DataType> index_dtype_override) {
+    TEGraphKeyBuilder builder;
+    Array<ObjectRef> args;
+    for (const ObjectRef& arg : arg_list) {
+      if (auto tensor = arg.as<te::Tensor>()) {
+        if (!builder.VisitOp(tensor.value()->op)) {
+          return std::nullopt;
+        }
+        args.push_back(builder.TensorKey(tensor.value()));
+      } else {
+        args.push_back(arg);
+      }
+    }
+    String index_dtype =
+        index_dtype_override ? DLDataTypeToString(index_dtype_override.value()) : "";
+    return Array<ObjectRef>{builder.ops_, args, index_dtype};
+  }
+
+ private:
+  using ExprMutator::VisitExpr_;
+
+  bool VisitOp(const te::Operation& op) {
+    if (op_index_.count(op)) {
+      return true;
+    }
+    for (const te::Tensor& input : op->InputTensors()) {
+      if (!VisitOp(input->op)) {
+        return false;
+      }
+    }
+    if (const auto* placeholder = op.as<te::PlaceholderOpNode>()) {
+      ops_.push_back(
+          Array<ObjectRef>{placeholder->shape, String(DLDataTypeToString(placeholder->dtype))});
+    } else if (const auto* compute = op.as<te::ComputeOpNode>()) {
+      Map<String, ffi::Any> attrs;
+      for (const auto& [name, value] : compute->attrs) {
+        auto opt_value = CanonicalizeAttr(value);
+        if (!opt_value) {
+          return false;
+        }
+        attrs.Set(name, opt_value.value());
+      }
+      Array<PrimExpr> body = compute->body.Map([this](const PrimExpr& e) { return VisitExpr(e); });
+      // The axes come before the body, to define the vars of the body.
+      ops_.push_back(Array<ObjectRef>{String(compute->name), String(compute->tag), attrs,
+                                      compute->axis, body});
+    } else {
+      return false;
+    }
+    op_index_[op] = static_cast<int64_t>(ops_.size()) - 1;
+    return true;
+  }
+
+  Array<IntImm> TensorKey(const te::Tensor& tensor) {
+    return {IntImm(DataType::Int(64), op_index_.at(tensor->op)),
+            IntImm(DataType::Int(64), tensor->value_index)};
+  }
+
+  /*! \brief Replace the tensors in an attribute, e.g. "layout_free_placeholders", by keys. */
+  std::optional<ffi::Any> CanonicalizeAttr(const ffi::Any& value) {
+    if (auto tensor = value.as<te::Tensor>()) {
+      if (!op_index_.count(tensor.value()->op)) {
+        return std::nullopt;
+      }
+      return TensorKey(tensor.value());
+    }
+    if (auto array = value.as<Array<ffi::Any>>()) {
+      Array<ffi::Any> result;
+      for (const ffi::Any& item : array.value()) {
+        auto opt_item = CanonicalizeAttr(item);
+        if (!opt_item) {
+          return std::nullopt;
+        }
+        result.push_back(opt_item.value());
+      }
+      return result;
+    }
+    return value;
+  }
+
+  PrimExpr VisitExpr_(const ProducerLoadNode* op) final {
+    te::Tensor tensor = Downcast<te::Tensor>(op->producer);
+    Array<IntImm> key = TensorKey(tensor);
+    Array<PrimExpr> args{StringImm("te.tensor"), key[0], key[1]};
+    for (const PrimExpr& index : op->indices) {
+      args.push_back(VisitExpr(index));
+    }
+    return Call(op->dtype, builtin::call_pure_extern(), args);
+  }
+
+  /*! \brief The keys of the ops in post-order. */
+  Array<ObjectRef> ops_;
+  std::unordered_map<te::Operation, int64_t, ObjectPtrHash, ObjectPtrEqual> op_index_;
+};
+
+/*!
+ * \brief The PrimFuncs created within a CreatePrimFuncCacheScope, keyed by their TE graph.
+ * The free vars of the keys are mapped, since the symbolic shapes of the TE graphs created by
+ * relax are made of fresh vars in each call.
+ */
+struct CreatePrimFuncCacheScope::Cache {
+  struct KeyHash {
+    uint64_t operator()(const ObjectRef& key) const {
+      return SHashHandlerDefault().Hash(key, /*map_free_vars=*/true);
+    }
+  };
+  struct KeyEqual {
+    bool operator()(const ObjectRef& lhs, const ObjectRef& rhs) const {
+      return StructuralEqual()(lhs, rhs, /*map_free_params=*/true);
+    }
+  };
+  std::unordered_map<ObjectRef, PrimFunc, KeyHash, KeyEqual> funcs;
+};
+
+/*! \brief The cache of the outermost CreatePrimFuncCacheScope of the thread. */
+static thread_local CreatePrimFuncCacheScope::Cache* current_create_prim_func_cache = nullptr;
+
+CreatePrimFuncCacheScope::CreatePrimFuncCacheScope() {
+  if (current_create_prim_func_cache == nullptr) {
+    cache_ = std::make_unique<Cache>();
+    current_create_prim_func_cache = cache_.get();
+  }
+}
+
+CreatePrimFuncCacheScope::~CreatePrimFuncCacheScope() {
+  if (cache_ != nullptr) {
+    current_create_prim_func_cache = nullptr;
+  }
+}
+
 PrimFunc CreatePrimFunc(const Array<ObjectRef>& arg_list,
                         std::optional<DataType> index_dtype_override) {
-  return CreatePrimFuncWithConstants(arg_list, {}, index_dtype_override);
+  CreatePrimFuncCacheScope::Cache* cache = current_create_prim_func_cache;
+  std::optional<ObjectRef> key;
+  if (cache != nullptr) {
+    key = TEGraphKeyBuilder::Build(arg_list, index_dtype_override);
+  }
+  if (key) {
+    if (auto it = cache->funcs.find(key.value()); it != cache->funcs.end()) {
+      return it->second;
+    }
+  }
+  PrimFunc func = CreatePrimFuncWithConstants(arg_list, {}, index_dtype_override);
+  if (key) {
+    cache->funcs.emplace(key.value(), func);
+  }
+  return func;
 }
 
 }  // namespace tir
@@ -24,6 +24,7 @@
 #include <tvm/te/tensor.h>
 #include <tvm/tir/function.h>
 
+#include <memory>
 #include <optional>
 
 namespace tvm {
@@ -55,6 +56,25 @@ PrimFunc CreatePrimFuncWithConstants(const Array<ObjectRef>& arg_list,
                                      const Array<runtime::NDArray>& constants,
                                      std::optional<DataType> index_dtype_override);
 
+/*!
+ * \brief Within the scope, CreatePrimFunc of a list of arguments is memoized on the structure of
+ * their TE graph, so that the same op over tensors of the same shapes, e.g. in each layer of a
+ * model, is converted to TensorIR once. The scopes do not nest: the outermost scope of the thread
+ * holds the cache.
+ */
+class CreatePrimFuncCacheScope {
+ public:
+  CreatePrimFuncCacheScope();
+  ~CreatePrimFuncCacheScope();
+  CreatePrimFuncCacheScope(const CreatePrimFuncCacheScope&) = delete;
+  CreatePrimFuncCacheScope& operator=(const CreatePrimFuncCacheScope&) = delete;
+
+  struct Cache;
+
+ private:
+  std::unique_ptr<Cache> cache_;
+};
+
 }  // namespace tir
 }  // namespace tvm
 
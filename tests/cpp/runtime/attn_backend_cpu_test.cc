@@ -0,0 +1,371 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/builtin_fp16.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../../../src/runtime/vm/attn_backend.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+constexpr int64_t kNumQOHeads = 4;
+constexpr int64_t kNumKVHeads = 2;
+constexpr int64_t kHeadDim = 24;
+constexpr int64_t kPageSize = 4;
+constexpr double kRoPEScale = 1.0;
+constexpr double kRoPETheta = 1e4;
+
+const Device kCPU{kDLCPU, 0};
+
+std::vector<float> RandomVector(int64_t n, std::mt19937* rng) {
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> v(n);
+  for (float& x : v) x = dist(*rng);
+  return v;
+}
+
+NDArray Int32Array(const std::vector<int32_t>& data, std::vector<int64_t> shape = {}) {
+  if (shape.empty()) shape = {static_cast<int64_t>(data.size())};
+  NDArray arr = NDArray::Empty(ffi::Shape(shape), DataType::Int(32), kCPU);
+  std::copy(data.begin(), data.end(), static_cast<int32_t*>(arr->data));
+  return arr;
+}
+
+NDArray FloatArray(const std::vector<float>& data, std::vector<int64_t> shape, DataType dtype) {
+  NDArray arr = NDArray::Empty(ffi::Shape(shape), dtype, kCPU);
+  if (dtype == DataType::Float(32)) {
+    std::copy(data.begin(), data.end(), static_cast<float*>(arr->data));
+  } else {
+    uint16_t* dst = static_cast<uint16_t*>(arr->data);
+    for (size_t i = 0; i < data.size(); ++i) dst[i] = __gnu_f2h_ieee(data[i]);
+  }
+  return arr;
+}
+
+std::vector<float> ReadFloatArray(const NDArray& arr) {
+  int64_t numel = 1;
+  for (int i = 0; i < arr->ndim; ++i) numel *= arr->shape[i];
+  std::vector<float> result(numel);
+  if (arr.DataType() == DataType::Float(32)) {
+    std::copy_n(static_cast<const float*>(arr->data), numel, result.begin());
+  } else {
+    const uint16_t* src = static_cast<const uint16_t*>(arr->data);
+    for (int64_t i = 0; i < numel; ++i) result[i] = __gnu_h2f_ieee(src[i]);
+  }
+  return result;
+}
+
+/*! \brief Rotate one head vector in place, as the default RoPE of the TIR kernels. */
+void ApplyRoPE(float* x, int64_t pos, int64_t dim) {
+  std::vector<float> y(dim);
+  for (int64_t d = 0; d < dim; ++d) {
+    double freq = pos * kRoPEScale / std::pow(kRoPETheta, static_cast<double>(2 * d % dim) / dim);
+    double rotated = d < dim / 2 ? -x[d + dim / 2] : x[d - dim / 2];
+    y[d] = static_cast<float>(std::cos(freq) * x[d] + std::sin(freq) * rotated);
+  }
+  std::copy(y.begin(), y.end(), x);
+}
+
+/*! \brief One sequence: its queries and the keys/values it attends to, all in float. */
+struct SeqData {
+  int64_t qo_len;
+  int64_t kv_len;
+  std::vector<float> q;  // [qo_len, kNumQOHeads, kHeadDim]
+  std::vector<float> k;  // [kv_len, kNumKVHeads, kHeadDim]
+  std::vector<float> v;  // [kv_len, kNumKVHeads, v_dim]
+  std::vector<int32_t> q_pos;
+  int32_t k_pos_offset;
+};
+
+/*!
+ * \brief The naive attention of one sequence, with base-2 LSE.
+ * Appends [qo_len, kNumQOHeads, v_dim] outputs and [qo_len, kNumQOHeads] LSEs.
+ */
+void ReferenceAttention(const SeqData& seq, int64_t v_dim, bool causal, bool rope,
+                        double sm_scale, std::vector<float>* out, std::vector<float>* lse) {
+  int64_t group_size = kNumQOHeads / kNumKVHeads;
+  for (int64_t i = 0; i < seq.qo_len; ++i) {
+    for (int64_t h = 0; h < kNumQOHeads; ++h) {
+      int64_t h_kv = h / group_size;
+      std::vector<float> q(seq.q.begin() + (i * kNumQOHeads + h) * kHeadDim,
+                           seq.q.begin() + (i * kNumQOHeads + h + 1) * kHeadDim);
+      if (rope) ApplyRoPE(q.data(), seq.q_pos[i], kHeadDim);
+      int64_t kv_end = causal ? seq.kv_len - seq.qo_len + i + 1 : seq.kv_len;
+      std::vector<double> scores;
+      for (int64_t j = 0; j < kv_end; ++j) {
+        std::vector<float> k(seq.k.begin() + (j * kNumKVHeads + h_kv) * kHeadDim,
+                             seq.k.begin() + (j * kNumKVHeads + h_kv + 1) * kHeadDim);
+        if (rope) ApplyRoPE(k.data(), seq.k_pos_offset + j, kHeadDim);
+        double s = 0;
+        for (int64_t d = 0; d < kHeadDim; ++d) s += static_cast<double>(q[d]) * k[d];
+        scores.push_back(s * sm_scale);
+      }
+      std::vector<double> o(v_dim, 0.0);
+      if (scores.empty()) {
+        out->insert(out->end(), o.begin(), o.end());
+        lse->push_back(-5e4f);
+        continue;
+      }
+      double m = *std::max_element(scores.begin(), scores.end());
+      double sum = 0;
+      for (double s : scores) sum += std::exp(s - m);
+      for (int64_t j = 0; j < kv_end; ++j) {
+        double p = std::exp(scores[j] - m) / sum;
+        for (int64_t d = 0; d < v_dim; ++d) {
+          o[d] += p * seq.v[(j * kNumKVHeads + h_kv) * v_dim + d];
+        }
+      }
+      out->insert(out->end(), o.begin(), o.end());
+      lse->push_back(static_cast<float>((m + std::log(sum)) / std::log(2.0)));
+    }
+  }
+}
+
+std::vector<SeqData> RandomSequences(const std::vector<std::pair<int64_t, int64_t>>& lengths,
+                                     int64_t v_dim, std::mt19937* rng) {
+  std::vector<SeqData> seqs;
+  for (auto [qo_len, kv_len] : lengths) {
+    SeqData seq;
+    seq.qo_len = qo_len;
+    seq.kv_len = kv_len;
+    seq.q = RandomVector(qo_len * kNumQOHeads * kHeadDim, rng);
+    seq.k = RandomVector(kv_len * kNumKVHeads * kHeadDim, rng);
+    seq.v = RandomVector(kv_len * kNumKVHeads * v_dim, rng);
+    seq.k_pos_offset = static_cast<int32_t>((*rng)() % 64);
+    for (int64_t i = 0; i < qo_len; ++i) {
+      seq.q_pos.push_back(static_cast<int32_t>(seq.k_pos_offset + kv_len - qo_len + i));
+    }
+    seqs.push_back(std::move(seq));
+  }
+  return seqs;
+}
+
+/*! \brief The paged layout of the sequences, with the pages shuffled. */
+struct PagedKV {
+  NDArray pages;
+  NDArray page_indptr;
+  NDArray page_indices;
+  NDArray length_info;
+};
+
+/*!
+ * \brief Store the KV of the sequences into pages. With a sliding window, the first
+ * `sink_size` positions are the sink and `window_offset` positions are evicted after it.
+ */
+PagedKV MakePagedKV(const std::vector<SeqData>& seqs, DataType dtype, std::mt19937* rng,
+                    int64_t sink_size = 0, int64_t window_offset = 0) {
+  bool sliding_window = sink_size > 0 || window_offset > 0;
+  std::vector<int32_t> page_indptr{0};
+  std::vector<int32_t> last_page_len;
+  std::vector<int32_t> window_offsets;
+  std::vector<int32_t> sink_sizes;
+  int64_t num_pages = 0;
+  std::vector<int64_t> seq_num_pages;
+  for (const SeqData& seq : seqs) {
+    // The positions held in the pages, including the evicted ones.
+    int64_t stored_len = seq.kv_len + (seq.kv_len > sink_size ? window_offset - sink_size : 0);
+    if (seq.kv_len <= sink_size) stored_len = seq.kv_len;
+    int64_t n = (stored_len + kPageSize - 1) / kPageSize;
+    seq_num_pages.push_back(n);
+    num_pages += n;
+    page_indptr.push_back(static_cast<int32_t>(num_pages));
+    last_page_len.push_back(n == 0 ? 0 : static_cast<int32_t>(stored_len - (n - 1) * kPageSize));
+    window_offsets.push_back(seq.kv_len > sink_size ? static_cast<int32_t>(window_offset) : 0);
+    sink_sizes.push_back(seq.kv_len > sink_size ? static_cast<int32_t>(sink_size) : 0);
+  }
+  std::vector<int32_t> page_ids(num_pages);
+  std::iota(page_ids.begin(), page_ids.end(), 0);
+  std::shuffle(page_ids.begin(), page_ids.end(), *rng);
+
+  // Unused slots are filled with garbage which must never be read.
+  std::vector<float> pages(num_pages * 2 * kNumKVHeads * kPageSize * kHeadDim, 1e3f);
+  for (size_t b = 0; b < seqs.size(); ++b) {
+    const SeqData& seq = seqs[b];
+    for (int64_t pos = 0; pos < seq.kv_len; ++pos) {
+      int64_t offset = pos < sink_sizes[b] ? pos : pos - sink_sizes[b] + window_offsets[b];
+      int64_t page = page_ids[page_indptr[b] + offset / kPageSize];
+      for (int64_t h = 0; h < kNumKVHeads; ++h) {
+        for (int kv = 0; kv < 2; ++kv) {
+          const std::vector<float>& src = kv == 0 ? seq.k : seq.v;
+          std::copy_n(src.begin() + (pos * kNumKVHeads + h) * kHeadDim, kHeadDim,
+                      pages.begin() +
+                          (((page * 2 + kv) * kNumKVHeads + h) * kPageSize + offset % kPageSize) *
+                              kHeadDim);
+        }
+      }
+    }
+  }
+  PagedKV result;
+  result.pages = FloatArray(pages, {num_pages, 2, kNumKVHeads, kPageSize, kHeadDim}, dtype);
+  result.page_indptr = Int32Array(page_indptr);
+  result.page_indices = Int32Array(page_ids);
+  if (sliding_window) {
+    std::vector<int32_t> info = last_page_len;
+    info.insert(info.end(), window_offsets.begin(), window_offsets.end());
+    info.insert(info.end(), sink_sizes.begin(), sink_sizes.end());
+    result.length_info = Int32Array(info, {3, static_cast<int64_t>(seqs.size())});
+  } else {
+    result.length_info = Int32Array(last_page_len);
+  }
+  return result;
+}
+
+/*! \brief Concatenate the queries and the RoPE positions of the sequences. */
+void PackQueries(const std::vector<SeqData>& seqs, DataType dtype, NDArray* q, NDArray* qo_indptr,
+                 NDArray* q_rope_position, NDArray* k_rope_pos_offset) {
+  std::vector<float> q_data;
+  std::vector<int32_t> indptr{0};
+  std::vector<int32_t> q_pos;
+  std::vector<int32_t> k_offsets;
+  for (const SeqData& seq : seqs) {
+    q_data.insert(q_data.end(), seq.q.begin(), seq.q.end());
+    indptr.push_back(static_cast<int32_t>(indptr.back() + seq.qo_len));
+    q_pos.insert(q_pos.end(), seq.q_pos.begin(), seq.q_pos.end());
+    k_offsets.push_back(seq.k_pos_offset);
+  }
+  *q = FloatArray(q_data, {indptr.back(), kNumQOHeads, kHeadDim}, dtype);
+  *qo_indptr = Int32Array(indptr);
+  *q_rope_position = Int32Array(q_pos);
+  *k_rope_pos_offset = Int32Array(k_offsets);
+}
+
+void ExpectClose(const std::vector<float>& actual, const std::vector<float>& expected,
+                 float tol) {
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    ASSERT_NEAR(actual[i], expected[i], tol) << "at index " << i;
+  }
+}
+
+void CheckPagedPrefill(DataType dtype, bool causal, bool rope, int64_t sink_size,
+                       int64_t window_offset, float tol) {
+  std::mt19937 rng(42);
+  std::vector<SeqData> seqs =
+      RandomSequences({{5, 37}, {1, 1}, {20, 20}, {3, 70}, {2, 0}}, kHeadDim, &rng);
+  PagedKV kv = MakePagedKV(seqs, dtype, &rng, sink_size, window_offset);
+  NDArray q, qo_indptr, q_rope_position, k_rope_pos_offset;
+  PackQueries(seqs, dtype, &q, &qo_indptr, &q_rope_position, &k_rope_pos_offset);
+  int64_t total = q->shape[0];
+  NDArray output = NDArray::Empty({total, kNumQOHeads, kHeadDim}, dtype, kCPU);
+  NDArray lse = NDArray::Empty({total, kNumQOHeads}, DataType::Float(32), kCPU);
+  double sm_scale = 1.0 / std::sqrt(static_cast<double>(kHeadDim));
+
+  CPUPagedPrefillFunc func(AttnKind::kMHA);
+  func.MHA(0, q, qo_indptr, kv.pages, kv.page_indptr, kv.page_indices, kv.length_info,
+           q_rope_position, k_rope_pos_offset, causal, rope ? RoPEMode::kInline : RoPEMode::kNone,
+           kRoPEScale, kRoPETheta, sm_scale, output, lse, nullptr);
+
+  std::vector<float> expected_out;
+  std::vector<float> expected_lse;
+  for (const SeqData& seq : seqs) {
+    ReferenceAttention(seq, kHeadDim, causal, rope, sm_scale, &expected_out, &expected_lse);
+  }
+  ExpectClose(ReadFloatArray(output), expected_out, tol);
+  ExpectClose(ReadFloatArray(lse), expected_lse, tol * 10);
+}
+
+}  // namespace
+
+TEST(CPUAttnBackend, PagedPrefill) {
+  CheckPagedPrefill(DataType::Float(32), /*causal=*/false, /*rope=*/false, 0, 0, 1e-4f);
+  CheckPagedPrefill(DataType::Float(32), /*causal=*/true, /*rope=*/false, 0, 0, 1e-4f);
+  CheckPagedPrefill(DataType::Float(16), /*causal=*/true, /*rope=*/false, 0, 0, 3e-3f);
+}
+
+TEST(CPUAttnBackend, PagedPrefillInlineRoPE) {
+  CheckPagedPrefill(DataType::Float(32), /*causal=*/true, /*rope=*/true, 0, 0, 1e-4f);
+}
+
+TEST(CPUAttnBackend, PagedPrefillSlidingWindow) {
+  CheckPagedPrefill(DataType::Float(32), /*causal=*/true, /*rope=*/true, /*sink_size=*/3,
+                    /*window_offset=*/9, 1e-4f);
+}
+
+TEST(CPUAttnBackend, PagedDecode) {
+  std::mt19937 rng(7);
+  std::vector<SeqData> seqs =
+      RandomSequences({{1, 33}, {1, 4}, {1, 100}, {1, 1}, {1, 17}}, kHeadDim, &rng);
+  DataType dtype = DataType::Float(16);
+  PagedKV kv = MakePagedKV(seqs, dtype, &rng);
+  NDArray q, qo_indptr, q_rope_position, k_rope_pos_offset;
+  PackQueries(seqs, dtype, &q, &qo_indptr, &q_rope_position, &k_rope_pos_offset);
+  int64_t batch_size = static_cast<int64_t>(seqs.size());
+  NDArray output = NDArray::Empty({batch_size, kNumQOHeads, kHeadDim}, dtype, kCPU);
+  NDArray lse = NDArray::Empty({batch_size, kNumQOHeads}, DataType::Float(32), kCPU);
+  double sm_scale = 0.3;
+
+  CPUPagedDecodeFunc func(AttnKind::kMHA);
+  func.MHA(0, q, kv.pages, kv.page_indptr, kv.page_indices, kv.length_info, k_rope_pos_offset,
+           q_rope_position, RoPEMode::kInline, kRoPEScale, kRoPETheta, sm_scale, output, lse,
+           nullptr);
+
+  std::vector<float> expected_out;
+  std::vector<float> expected_lse;
+  for (const SeqData& seq : seqs) {
+    ReferenceAttention(seq, kHeadDim, /*causal=*/false, /*rope=*/true, sm_scale, &expected_out,
+                       &expected_lse);
+  }
+  ExpectClose(ReadFloatArray(output), expected_out, 3e-3f);
+  ExpectClose(ReadFloatArray(lse), expected_lse, 3e-2f);
+}
+
+TEST(CPUAttnBackend, RaggedPrefill) {
+  std::mt19937 rng(3);
+  // Value heads narrower than the key heads, as in the MLA prefill.
+  const int64_t v_dim = 16;
+  std::vector<SeqData> seqs = RandomSequences({{9, 9}, {40, 40}, {1, 1}}, v_dim, &rng);
+  NDArray q, qo_indptr, q_rope_position, k_rope_pos_offset;
+  PackQueries(seqs, DataType::Float(32), &q, &qo_indptr, &q_rope_position, &k_rope_pos_offset);
+  std::vector<float> k_data;
+  std::vector<float> v_data;
+  for (const SeqData& seq : seqs) {
+    k_data.insert(k_data.end(), seq.k.begin(), seq.k.end());
+    v_data.insert(v_data.end(), seq.v.begin(), seq.v.end());
+  }
+  int64_t total = q->shape[0];
+  NDArray k = FloatArray(k_data, {total, kNumKVHeads, kHeadDim}, DataType::Float(32));
+  NDArray v = FloatArray(v_data, {total, kNumKVHeads, v_dim}, DataType::Float(32));
+  NDArray output = NDArray::Empty({total, kNumQOHeads, v_dim}, DataType::Float(32), kCPU);
+  NDArray lse = NDArray::Empty({total, kNumQOHeads}, DataType::Float(32), kCPU);
+  double sm_scale = 0.2;
+
+  CPURaggedPrefillFunc func(AttnKind::kMHA);
+  func.MHA(q, k, v, qo_indptr, qo_indptr, q_rope_position, k_rope_pos_offset, /*causal=*/true,
+           RoPEMode::kNone, kRoPEScale, kRoPETheta, sm_scale, output, lse, nullptr);
+
+  std::vector<float> expected_out;
+  std::vector<float> expected_lse;
+  for (const SeqData& seq : seqs) {
+    ReferenceAttention(seq, v_dim, /*causal=*/true, /*rope=*/false, sm_scale, &expected_out,
+                       &expected_lse);
+  }
+  ExpectClose(ReadFloatArray(output), expected_out, 1e-4f);
+  ExpectClose(ReadFloatArray(lse), expected_lse, 1e-3f);
+}
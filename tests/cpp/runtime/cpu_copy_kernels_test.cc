@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/builtin_fp16.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "../../../src/runtime/cpu_copy_kernels.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+
+namespace {
+
+std::vector<float> TestValues(int64_t n) {
+  std::vector<float> values(n);
+  for (int64_t i = 0; i < n; ++i) {
+    values[i] = std::sin(static_cast<float>(i)) * static_cast<float>(i % 97);
+  }
+  // Special values, including a rounding tie for bf16 (0x3f808000).
+  uint32_t tie_bits = 0x3f808000;
+  float tie;
+  std::memcpy(&tie, &tie_bits, sizeof(tie));
+  values[0] = std::numeric_limits<float>::quiet_NaN();
+  values[1] = std::numeric_limits<float>::infinity();
+  values[2] = -0.0f;
+  values[3] = tie;
+  return values;
+}
+
+}  // namespace
+
+TEST(CPUCopyKernels, Float16RoundTrip) {
+  // An odd length exercises both the vector body and the scalar tail.
+  std::vector<float> values = TestValues(1031);
+  std::vector<uint16_t> half(values.size());
+  std::vector<float> back(values.size());
+  ConvertFloat32ToFloat16(values.data(), half.data(), values.size());
+  ConvertFloat16ToFloat32(half.data(), back.data(), half.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(half[i], __gnu_f2h_ieee(values[i])) << "at " << i;
+    uint16_t expected_bits = __gnu_f2h_ieee(values[i]);
+    float expected = __gnu_h2f_ieee(expected_bits);
+    if (std::isnan(expected)) {
+      EXPECT_TRUE(std::isnan(back[i]));
+    } else {
+      EXPECT_EQ(back[i], expected) << "at " << i;
+    }
+  }
+}
+
+TEST(CPUCopyKernels, BuiltinFloat16Arrays) {
+  std::vector<float> values = TestValues(1031);
+  std::vector<uint16_t> half(values.size());
+  std::vector<float> back(values.size());
+  Float32ToFloat16Array(values.data(), half.data(), values.size());
+  Float16ToFloat32Array(half.data(), back.data(), half.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(half[i], __gnu_f2h_ieee(values[i])) << "at " << i;
+    float expected = __gnu_h2f_ieee(half[i]);
+    if (std::isnan(expected)) {
+      EXPECT_TRUE(std::isnan(back[i]));
+    } else {
+      EXPECT_EQ(back[i], expected) << "at " << i;
+    }
+  }
+}
+
+TEST(CPUCopyKernels, BFloat16RoundTrip) {
+  std::vector<float> values = TestValues(1031);
+  std::vector<uint16_t> bf16(values.size());
+  std::vector<float> back(values.size());
+  ConvertFloat32ToBFloat16(values.data(), bf16.data(), values.size());
+  ConvertBFloat16ToFloat32(bf16.data(), back.data(), bf16.size());
+  EXPECT_TRUE(std::isnan(back[0]));
+  EXPECT_EQ(back[1], std::numeric_limits<float>::infinity());
+  EXPECT_EQ(bf16[2], 0x8000);
+  // Ties round to even.
+  EXPECT_EQ(bf16[3], 0x3f80);
+  for (size_t i = 4; i < values.size(); ++i) {
+    EXPECT_LE(std::abs(back[i] - values[i]), std::abs(values[i]) / 256) << "at " << i;
+  }
+}
+
+TEST(CPUCopyKernels, DequantizeInt8) {
+  std::vector<int8_t> values(259);
+  for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int8_t>(i * 7);
+  std::vector<float> result(values.size());
+  DequantizeInt8ToFloat32(values.data(), result.data(), values.size(), 0.5f, 3);
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(result[i], (static_cast<int32_t>(values[i]) - 3) * 0.5f) << "at " << i;
+  }
+}
+
+TEST(CPUCopyKernels, StridedTranspose) {
+  int64_t rows = 67, cols = 45;
+  NDArray src = NDArray::Empty({rows, cols}, DataType::Float(32), Device{kDLCPU, 0});
+  float* src_data = static_cast<float*>(src->data);
+  for (int64_t i = 0; i < rows * cols; ++i) src_data[i] = static_cast<float>(i);
+
+  // View the destination of shape [rows, cols] as the transpose of a [cols, rows] buffer.
+  NDArray dst = NDArray::Empty({cols, rows}, DataType::Float(32), Device{kDLCPU, 0});
+  DLTensor dst_view = *dst.operator->();
+  int64_t dst_shape[] = {rows, cols};
+  int64_t dst_strides[] = {1, rows};
+  dst_view.shape = dst_shape;
+  dst_view.strides = dst_strides;
+  NDArray::CopyFromTo(src.operator->(), &dst_view);
+
+  const float* dst_data = static_cast<const float*>(dst->data);
+  for (int64_t i = 0; i < rows; ++i) {
+    for (int64_t j = 0; j < cols; ++j) {
+      ASSERT_EQ(dst_data[j * rows + i], src_data[i * cols + j]);
+    }
+  }
+}
+
+TEST(CPUCopyKernels, StridedSliceCopy) {
+  // Copy the [:, 1:3, :] slice of a [4, 5, 6] int16 tensor into a compact one.
+  NDArray src = NDArray::Empty({4, 5, 6}, DataType::Int(16), Device{kDLCPU, 0});
+  int16_t* src_data = static_cast<int16_t*>(src->data);
+  for (int i = 0; i < 4 * 5 * 6; ++i) src_data[i] = static_cast<int16_t>(i);
+
+  DLTensor src_view = *src.operator->();
+  int64_t src_shape[] = {4, 2, 6};
+  int64_t src_strides[] = {30, 6, 1};
+  src_view.shape = src_shape;
+  src_view.strides = src_strides;
+  src_view.byte_offset = 6 * sizeof(int16_t);
+
+  NDArray dst = NDArray::Empty({4, 2, 6}, DataType::Int(16), Device{kDLCPU, 0});
+  DLTensor* dst_tensor = const_cast<ffi::NDArrayObj*>(dst.get());
+  CopyStridedHost(&src_view, dst_tensor);
+
+  const int16_t* dst_data = static_cast<const int16_t*>(dst->data);
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 2; ++j) {
+      for (int k = 0; k < 6; ++k) {
+        ASSERT_EQ(dst_data[(i * 2 + j) * 6 + k], src_data[i * 30 + (j + 1) * 6 + k]);
+      }
+    }
+  }
+}
+
+TEST(CPUCopyKernels, ConvertDTypeRejectsInvalidArrays) {
+  const auto fconvert = ffi::Function::GetGlobal("runtime.NDArrayConvertDType").value();
+  Device cpu{kDLCPU, 0};
+  NDArray from = NDArray::Empty({4, 8}, DataType::Float(32), cpu);
+  EXPECT_THROW(fconvert(from, NDArray::Empty({4, 4}, DataType::Float(16), cpu)), Error);
+  EXPECT_THROW(fconvert(from, NDArray::Empty({4, 8}, DataType::Int(8), cpu)), Error);
+  EXPECT_THROW(fconvert(from, NDArray::Empty({4, 8}, DataType::Float(16, 2), cpu)), Error);
+  fconvert(from, NDArray::Empty({8, 4}, DataType::BFloat(16), cpu));
+}
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/threading_backend.h>
+
+#include <numeric>
+#include <vector>
+
+using namespace tvm;
+using namespace tvm::runtime;
+
+namespace {
+
+NDArray Iota(int64_t n) {
+  NDArray arr = NDArray::Empty({n}, DataType::Int(32), Device{kDLCPU, 0});
+  int32_t* data = static_cast<int32_t*>(arr->data);
+  std::iota(data, data + n, 0);
+  return arr;
+}
+
+bool IsIota(const NDArray& arr) {
+  const int32_t* data = static_cast<const int32_t*>(arr->data);
+  for (int64_t i = 0; i < arr->shape[0]; ++i) {
+    if (data[i] != i) return false;
+  }
+  return true;
+}
+
+DLTensor* MutableTensor(const NDArray& arr) { return const_cast<ffi::NDArrayObj*>(arr.get()); }
+
+}  // namespace
+
+TEST(CPUDeviceAPI, StreamCopy) {
+  Device dev{kDLCPU, 0};
+  DeviceAPI* api = DeviceAPI::Get(dev);
+  TVMStreamHandle stream = api->CreateStream(dev);
+  ASSERT_NE(stream, nullptr);
+
+  NDArray src = Iota(1 << 16);
+  NDArray dst = NDArray::Empty({1 << 16}, DataType::Int(32), dev);
+  NDArray::CopyFromTo(src.get(), MutableTensor(dst), stream);
+  api->StreamSync(dev, stream);
+  EXPECT_TRUE(IsIota(dst));
+
+  api->FreeStream(dev, stream);
+}
+
+TEST(CPUDeviceAPI, StreamOrderAcrossStreams) {
+  Device dev{kDLCPU, 0};
+  DeviceAPI* api = DeviceAPI::Get(dev);
+  TVMStreamHandle first = api->CreateStream(dev);
+  TVMStreamHandle second = api->CreateStream(dev);
+
+  NDArray src = Iota(1 << 20);
+  NDArray mid = NDArray::Empty({1 << 20}, DataType::Int(32), dev);
+  NDArray dst = NDArray::Empty({1 << 20}, DataType::Int(32), dev);
+  NDArray::CopyFromTo(src.get(), MutableTensor(mid), first);
+  // The second copy reads what the first one writes, so it must wait for it.
+  api->SyncStreamFromTo(dev, first, second);
+  NDArray::CopyFromTo(mid.get(), MutableTensor(dst), second);
+  // Freeing the first stream must not invalidate the event the second stream waits on.
+  api->FreeStream(dev, first);
+  api->StreamSync(dev, second);
+  EXPECT_TRUE(IsIota(dst));
+
+  api->FreeStream(dev, second);
+}
+
+TEST(CPUDeviceAPI, LargeSynchronousCopy) {
+  Device dev{kDLCPU, 0};
+  // Large enough to be split into chunks over the thread pool.
+  NDArray src = Iota(5 << 20);
+  NDArray dst = src.CopyTo(dev);
+  EXPECT_TRUE(IsIota(dst));
+}
+
+TEST(CPUDeviceAPI, LargeSynchronousCopyInParallelTask) {
+  Device dev{kDLCPU, 0};
+  std::vector<NDArray> srcs, dsts;
+  for (int i = 0; i < 4; ++i) {
+    srcs.push_back(Iota(5 << 20));
+    dsts.push_back(NDArray::Empty({5 << 20}, DataType::Int(32), dev));
+  }
+  // The copies cannot launch another parallel job from a task, so they run serially there.
+  parallel_for_with_threading_backend([&](int64_t i) { dsts[i].CopyFrom(srcs[i]); }, 0, 4);
+  for (const NDArray& dst : dsts) {
+    EXPECT_TRUE(IsIota(dst));
+  }
+}
+
+TEST(CPUDeviceAPI, CurrentStream) {
+  Device dev{kDLCPU, 0};
+  DeviceAPI* api = DeviceAPI::Get(dev);
+  EXPECT_EQ(api->GetCurrentStream(dev), nullptr);
+  TVMStreamHandle stream = api->CreateStream(dev);
+  api->SetStream(dev, stream);
+  EXPECT_EQ(api->GetCurrentStream(dev), stream);
+  api->FreeStream(dev, stream);
+  EXPECT_EQ(api->GetCurrentStream(dev), nullptr);
+}
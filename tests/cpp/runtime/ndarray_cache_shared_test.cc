@@ -0,0 +1,145 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <tvm/runtime/vm/ndarray_cache_support.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+/*! \brief Write a cache with a raw int32 tensor and a bf16-encoded float32 tensor. */
+std::string WriteCache() {
+  char dir_template[] = "/tmp/tvm_shared_cache_XXXXXX";
+  std::string dir = mkdtemp(dir_template);
+  std::vector<int32_t> ints = {1, 2, 3, 4, 5, 6};
+  // bfloat16 of 1.0, -2.0, 0.5
+  std::vector<uint16_t> bf16 = {0x3f80, 0xc000, 0x3f00};
+  std::ofstream shard(dir + "/params_shard_0.bin", std::ios::binary);
+  shard.write(reinterpret_cast<const char*>(ints.data()), ints.size() * sizeof(int32_t));
+  shard.write(reinterpret_cast<const char*>(bf16.data()), bf16.size() * sizeof(uint16_t));
+  shard.close();
+  std::ofstream json(dir + "/ndarray-cache.json");
+  json << R"({"records": [{"dataPath": "params_shard_0.bin", "format": "raw-shard",
+    "nbytes": 30, "records": [
+      {"name": "ints", "shape": [2, 3], "dtype": "int32", "format": "raw",
+       "nbytes": 24, "byteOffset": 0},
+      {"name": "floats", "shape": [3], "dtype": "float32", "format": "f32-to-bf16",
+       "nbytes": 6, "byteOffset": 24}]}]})";
+  return dir;
+}
+
+void RemoveCache(const std::string& dir) {
+  std::remove((dir + "/params_shard_0.bin").c_str());
+  std::remove((dir + "/ndarray-cache.json").c_str());
+  rmdir(dir.c_str());
+}
+
+bool ShmExists(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  close(fd);
+  return true;
+}
+
+}  // namespace
+
+TEST(NDArrayCacheShared, CreateAttachRelease) {
+  std::string dir = WriteCache();
+  std::string shm_name = "/tvm_test_shared_cache_" + std::to_string(getpid());
+  NDArrayCacheMetadata metadata = NDArrayCacheMetadata::Load(dir);
+  {
+    Array<NDArray> created = metadata.LoadShared(shm_name);
+    // The second load attaches to the region created by the first one.
+    Array<NDArray> attached = metadata.LoadShared(shm_name);
+    ASSERT_EQ(attached.size(), 2);
+    for (const Array<NDArray>& params : {created, attached}) {
+      const int32_t* ints = static_cast<const int32_t*>(params[0]->data);
+      for (int i = 0; i < 6; ++i) EXPECT_EQ(ints[i], i + 1);
+      const float* floats = static_cast<const float*>(params[1]->data);
+      EXPECT_EQ(floats[0], 1.0f);
+      EXPECT_EQ(floats[1], -2.0f);
+      EXPECT_EQ(floats[2], 0.5f);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(params[1]->data) % kAllocAlignment, 0);
+    }
+    // Keep only one view alive, which must keep the region around.
+    NDArray ints = attached[0];
+    created = Array<NDArray>();
+    attached = Array<NDArray>();
+    EXPECT_TRUE(ShmExists(shm_name));
+    EXPECT_EQ(static_cast<const int32_t*>(ints->data)[5], 6);
+  }
+  // The last view unlinks the name.
+  EXPECT_FALSE(ShmExists(shm_name));
+  RemoveCache(dir);
+}
+
+TEST(NDArrayCacheShared, RecreateAfterCreatorDied) {
+  std::string dir = WriteCache();
+  // A cache of the same layout whose shard is a FIFO, so that its creator blocks while loading.
+  std::string stuck_dir = WriteCache();
+  std::remove((stuck_dir + "/params_shard_0.bin").c_str());
+  ASSERT_EQ(mkfifo((stuck_dir + "/params_shard_0.bin").c_str(), 0600), 0);
+  std::string shm_name = "/tvm_test_shared_cache_dead_" + std::to_string(getpid());
+
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    NDArrayCacheMetadata::Load(stuck_dir).LoadShared(shm_name);
+    _exit(0);
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!ShmExists(shm_name)) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    usleep(1000);
+  }
+  // Let the child set up the header and block on the FIFO, then kill it.
+  usleep(200000);
+  kill(child, SIGKILL);
+  waitpid(child, nullptr, 0);
+
+  {
+    Array<NDArray> params = NDArrayCacheMetadata::Load(dir).LoadShared(shm_name);
+    const int32_t* ints = static_cast<const int32_t*>(params[0]->data);
+    for (int i = 0; i < 6; ++i) EXPECT_EQ(ints[i], i + 1);
+    EXPECT_EQ(static_cast<const float*>(params[1]->data)[2], 0.5f);
+  }
+  EXPECT_FALSE(ShmExists(shm_name));
+  RemoveCache(dir);
+  RemoveCache(stuck_dir);
+}
+
+#endif  // _WIN32
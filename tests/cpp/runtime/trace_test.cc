@@ -0,0 +1,127 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/trace.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tvm::runtime;
+
+namespace {
+
+size_t CountOccurrences(const std::string& str, const std::string& pattern) {
+  size_t count = 0;
+  for (size_t pos = str.find(pattern); pos != std::string::npos;
+       pos = str.find(pattern, pos + pattern.size())) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(Trace, DisabledRecordsNothing) {
+  TraceSetEnabled(false);
+  TraceClear();
+  {
+    TVM_TRACE_SCOPE("test", "disabled_scope");
+    TVM_TRACE_INSTANT("test", "disabled_instant", 1);
+  }
+  std::string json = TraceDumpJSON();
+  EXPECT_EQ(json.find("disabled_scope"), std::string::npos);
+  EXPECT_EQ(json.find("disabled_instant"), std::string::npos);
+}
+
+TEST(Trace, ScopesFromMultipleThreads) {
+  TraceClear();
+  TraceSetEnabled(true);
+  constexpr int kNumThreads = 4;
+  constexpr int kNumEvents = 100;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < kNumEvents; ++i) {
+        TVM_TRACE_SCOPE_ARG("test", std::string("dynamic_scope"), i);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  TVM_TRACE_INSTANT("test", "main_instant", 42);
+  TraceSetEnabled(false);
+
+  std::string json = TraceDumpJSON();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_EQ(CountOccurrences(json, "\"dynamic_scope\""), kNumThreads * kNumEvents);
+  EXPECT_EQ(CountOccurrences(json, "\"main_instant\""), 1);
+  EXPECT_NE(json.find("\"args\":{\"arg\":42}"), std::string::npos);
+
+  TraceClear();
+  EXPECT_EQ(TraceDumpJSON().find("dynamic_scope"), std::string::npos);
+}
+
+TEST(Trace, EscapeNames) {
+  TraceClear();
+  TraceSetEnabled(true);
+  { TVM_TRACE_SCOPE("test", "quote\"back\\slash"); }
+  TraceSetEnabled(false);
+  EXPECT_NE(TraceDumpJSON().find("quote\\\"back\\\\slash"), std::string::npos);
+  TraceClear();
+}
+
+TEST(Trace, DumpWhileRecording) {
+  TraceClear();
+  TraceSetEnabled(true);
+  std::atomic<bool> stop{false};
+  // The writer wraps around its ring many times while the dumps copy it. Every event
+  // has begin_ns = 1000 * arg and a duration of 7 ns, which a torn read would break.
+  std::thread writer([&stop]() {
+    for (int64_t i = 1; !stop.load(std::memory_order_relaxed); ++i) {
+      TraceRecord("test", "concurrent_event", i * 1000, i * 1000 + 7, i);
+    }
+  });
+  const std::string prefix = "{\"name\":\"concurrent_event\",\"cat\":\"test\",";
+  for (int dump = 0; dump < 20; ++dump) {
+    std::string json = TraceDumpJSON();
+    int64_t base = -1;
+    for (size_t pos = json.find(prefix); pos != std::string::npos;
+         pos = json.find(prefix, pos + prefix.size())) {
+      double ts, dur;
+      int tid;
+      long long arg;  // NOLINT(runtime/int)
+      ASSERT_EQ(std::sscanf(json.c_str() + pos + prefix.size(),
+                            "\"ts\":%lf,\"ph\":\"X\",\"dur\":%lf,\"pid\":0,\"tid\":%d,"
+                            "\"args\":{\"arg\":%lld}}",
+                            &ts, &dur, &tid, &arg),
+                4);
+      EXPECT_DOUBLE_EQ(dur, 0.007);
+      // The timestamps are relative to the first event of the dump.
+      if (base == -1) base = arg - static_cast<int64_t>(ts);
+      EXPECT_EQ(arg - static_cast<int64_t>(ts), base);
+    }
+  }
+  stop.store(true);
+  writer.join();
+  TraceSetEnabled(false);
+  TraceClear();
+}
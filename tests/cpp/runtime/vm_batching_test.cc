@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <mutex>
+#include <vector>
+
+#include "../../../src/runtime/vm/batching.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+NDArray Rows(int64_t num_rows, int64_t width, float value) {
+  NDArray arr = NDArray::Empty({num_rows, width}, DataType::Float(32), Device{kDLCPU, 0});
+  float* data = static_cast<float*>(arr->data);
+  for (int64_t i = 0; i < num_rows * width; ++i) data[i] = value + i;
+  return arr;
+}
+
+/*! \brief A batched function computing x * 2 + bias which records the batch sizes it sees. */
+ffi::Function ScaleFunc(std::vector<int64_t>* batch_sizes, std::mutex* mutex) {
+  return ffi::Function::FromTyped([batch_sizes, mutex](NDArray x, double bias) {
+    {
+      std::lock_guard<std::mutex> lock(*mutex);
+      batch_sizes->push_back(x->shape[0]);
+    }
+    NDArray y = NDArray::Empty(x.Shape(), x->dtype, x->device);
+    const float* src = static_cast<const float*>(x->data);
+    float* dst = static_cast<float*>(y->data);
+    for (int64_t i = 0; i < x->shape[0] * x->shape[1]; ++i) dst[i] = src[i] * 2 + bias;
+    return y;
+  });
+}
+
+}  // namespace
+
+TEST(DynamicBatcher, PadAndScatter) {
+  std::vector<int64_t> batch_sizes;
+  std::mutex mutex;
+  // A long timeout, the batch is flushed by filling up or by shutdown.
+  DynamicBatcher batcher(make_object<DynamicBatcherObj>(
+      ScaleFunc(&batch_sizes, &mutex), Array<Any>{1.0}, 4, 10000000, std::vector<int64_t>{2, 4}));
+  BatchRequest r0 = batcher->Submit({Rows(1, 3, 0)});
+  BatchRequest r1 = batcher->Submit({Rows(2, 3, 10)});
+  BatchRequest r2 = batcher->Submit({Rows(1, 3, 20)});
+  for (const BatchRequest& request : {r0, r1, r2}) {
+    Array<NDArray> outputs = request->Wait();
+    ASSERT_EQ(outputs.size(), 1);
+    NDArray out = outputs[0];
+    ASSERT_EQ(out->shape[0], request->batch_size);
+    ASSERT_EQ(out->shape[1], 3);
+    const float* in_data = static_cast<const float*>(request->inputs[0]->data);
+    const float* out_data =
+        reinterpret_cast<const float*>(static_cast<const char*>(out->data) + out->byte_offset);
+    for (int64_t i = 0; i < request->batch_size * 3; ++i) {
+      EXPECT_EQ(out_data[i], in_data[i] * 2 + 1);
+    }
+  }
+  batcher->Shutdown();
+  ASSERT_EQ(batch_sizes.size(), 1);
+  EXPECT_EQ(batch_sizes[0], 4);
+}
+
+TEST(DynamicBatcher, TimeoutAndBuckets) {
+  std::vector<int64_t> batch_sizes;
+  std::mutex mutex;
+  DynamicBatcher batcher(make_object<DynamicBatcherObj>(
+      ScaleFunc(&batch_sizes, &mutex), Array<Any>{0.0}, 8, 1000, std::vector<int64_t>{4, 8}));
+  // A lone request is flushed by the timeout and padded to the first bucket.
+  Array<NDArray> outputs = batcher->Submit({Rows(3, 2, 0)})->Wait();
+  EXPECT_EQ(outputs[0]->shape[0], 3);
+  batcher->Shutdown();
+  ASSERT_EQ(batch_sizes.size(), 1);
+  EXPECT_EQ(batch_sizes[0], 4);
+  EXPECT_EQ(batcher->NumBatches(), 1);
+}
+
+TEST(DynamicBatcher, ErrorPropagates) {
+  DynamicBatcher batcher(make_object<DynamicBatcherObj>(
+      ffi::Function::FromTyped([](NDArray x) -> NDArray { LOG(FATAL) << "kernel failed"; }),
+      Array<Any>{}, 2, 0, std::vector<int64_t>{}));
+  BatchRequest request = batcher->Submit({Rows(1, 1, 0)});
+  EXPECT_THROW(request->Wait(), ffi::Error);
+}
+
+TEST(DynamicBatcher, DestroyWithoutShutdown) {
+  std::vector<int64_t> batch_sizes;
+  std::mutex mutex;
+  BatchRequest request;
+  {
+    // A long timeout, the request is flushed by the destructor, which does not wait for it.
+    DynamicBatcher batcher(make_object<DynamicBatcherObj>(
+        ScaleFunc(&batch_sizes, &mutex), Array<Any>{0.0}, 4, 10000000, std::vector<int64_t>{}));
+    request = batcher->Submit({Rows(1, 2, 3)});
+  }
+  Array<NDArray> outputs = request->Wait();
+  const float* out_data = reinterpret_cast<const float*>(
+      static_cast<const char*>(outputs[0]->data) + outputs[0]->byte_offset);
+  EXPECT_EQ(out_data[0], 6);
+  EXPECT_EQ(out_data[1], 8);
+}
@@ -0,0 +1,268 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "../../../src/runtime/vm/chunked_prefill_scheduler.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+constexpr int64_t kVocabSize = 37;
+constexpr int64_t kPageSize = 4;
+
+/*!
+ * \brief A paged KV cache which stores the token history of each sequence instead of K/V
+ * data, and checks that no forward exceeds its capacity.
+ */
+class PagedTokenCacheObj : public AttentionKVCacheObj {
+ public:
+  int64_t num_pages;
+  std::unordered_map<int64_t, std::vector<int32_t>> history;
+  IntTuple cur_seq_ids;
+  IntTuple cur_lengths;
+  /*! \brief The (sequence id, length) pairs of every forward. */
+  std::vector<std::vector<std::pair<int64_t, int64_t>>> forwards;
+
+  explicit PagedTokenCacheObj(int64_t num_pages) : num_pages(num_pages) {}
+
+  int64_t NumUsedPages() const {
+    int64_t used = 0;
+    for (const auto& [seq_id, tokens] : history) {
+      used += (static_cast<int64_t>(tokens.size()) + kPageSize - 1) / kPageSize;
+    }
+    return used;
+  }
+
+  void Clear() final { history.clear(); }
+  void AddSequence(int64_t seq_id) final {
+    ASSERT_TRUE(history.emplace(seq_id, std::vector<int32_t>{}).second);
+  }
+  void RemoveSequence(int64_t seq_id) final { ASSERT_EQ(history.erase(seq_id), 1); }
+  void ForkSequence(int64_t, int64_t, int64_t) final { LOG(FATAL) << "unused"; }
+  void PopN(int64_t, int32_t) final { LOG(FATAL) << "unused"; }
+  void BeginForward(const IntTuple& seq_ids, const IntTuple& append_lengths,
+                    const Optional<IntTuple>& token_tree_parent_ptr) final {
+    ASSERT_FALSE(token_tree_parent_ptr.defined());
+    cur_seq_ids = seq_ids;
+    cur_lengths = append_lengths;
+    std::vector<std::pair<int64_t, int64_t>> forward;
+    int64_t used = NumUsedPages();
+    for (size_t i = 0; i < seq_ids.size(); ++i) {
+      int64_t length = static_cast<int64_t>(history.at(seq_ids[i]).size());
+      used += (length + append_lengths[i] + kPageSize - 1) / kPageSize -
+              (length + kPageSize - 1) / kPageSize;
+      forward.emplace_back(seq_ids[i], append_lengths[i]);
+    }
+    CHECK_LE(used, num_pages) << "The KV cache is full";
+    forwards.push_back(forward);
+  }
+  void EndForward() final {}
+  void CommitAcceptedTokenTreeNodes(const IntTuple&, const IntTuple&) final {
+    LOG(FATAL) << "unused";
+  }
+
+  bool Empty() const final { return history.empty(); }
+  int32_t GetNumAvailablePages() const final { return num_pages - NumUsedPages(); }
+  int32_t GetTotalSequenceLength() const final { return 0; }
+  void EnableSlidingWindowForSeq(int64_t, int32_t, int32_t) final { LOG(FATAL) << "unused"; }
+  IntTuple DisaggPrepareRecv(int64_t, int) final { LOG(FATAL) << "unused"; }
+  void DisaggMarkSend(int64_t, int64_t, const IntTuple&, int32_t) final { LOG(FATAL) << "unused"; }
+  int64_t DisaggSendSequence(int64_t, int64_t, KVTransport) final { LOG(FATAL) << "unused"; }
+  void DisaggStartRecv(int64_t, KVTransport) final { LOG(FATAL) << "unused"; }
+  bool DisaggPollRecv(int64_t) final { LOG(FATAL) << "unused"; }
+  int64_t SaveSequence(int64_t, const String&, bool) final { LOG(FATAL) << "unused"; }
+  int64_t RestoreSequence(int64_t, const String&) final { LOG(FATAL) << "unused"; }
+  void AttentionWithFusedQKV(int64_t, NDArray, Optional<NDArray>, NDArray, double) final {
+    LOG(FATAL) << "unused";
+  }
+  void SelfAttention(int64_t, NDArray, NDArray, NDArray, NDArray, NDArray, double) final {
+    LOG(FATAL) << "unused";
+  }
+  void CrossAttention(int64_t, NDArray, NDArray, NDArray, double) final { LOG(FATAL) << "unused"; }
+  void AppendMLAKV(int64_t, NDArray) final { LOG(FATAL) << "unused"; }
+  Array<NDArray> MergeAttnOutputInplace(NDArray, NDArray, NDArray, NDArray) final {
+    LOG(FATAL) << "unused";
+  }
+  void LinearAttention(int64_t, NDArray, NDArray, NDArray, double) final { LOG(FATAL) << "unused"; }
+  NDArray GetQueryPositions() final { LOG(FATAL) << "unused"; }
+  void DebugGetKV(int64_t, int64_t, int64_t, NDArray, NDArray) final { LOG(FATAL) << "unused"; }
+  void DebugGetKVMLA(int64_t, int64_t, int64_t, NDArray) final { LOG(FATAL) << "unused"; }
+  void DebugSetKV(int64_t, int64_t, NDArray, NDArray) final { LOG(FATAL) << "unused"; }
+
+  static constexpr const char* _type_key = "test.PagedTokenCache";
+  TVM_DECLARE_FINAL_OBJECT_INFO(PagedTokenCacheObj, AttentionKVCacheObj);
+};
+
+/*! \brief The next token, a function of the last two tokens and the context length. */
+int32_t NextToken(const std::vector<int32_t>& context) {
+  int32_t last = context.back();
+  int32_t second_last = context.size() > 1 ? context[context.size() - 2] : 0;
+  return (3 * last + 2 * second_last + static_cast<int32_t>(context.size())) % kVocabSize;
+}
+
+/*!
+ * \brief A model which appends the tokens to the histories and predicts the next tokens
+ * from them, returning the logits of every token or of the last token of each sequence.
+ */
+ffi::Function MakeModel(bool last_token_logits) {
+  return ffi::Function::FromTyped([last_token_logits](NDArray token_ids, KVState state) {
+    auto* cache = const_cast<PagedTokenCacheObj*>(state.as<PagedTokenCacheObj>());
+    const int32_t* tokens = static_cast<const int32_t*>(token_ids->data);
+    int64_t num_rows = last_token_logits ? cache->cur_seq_ids.size() : token_ids->shape[0];
+    NDArray logits = NDArray::Empty({num_rows, kVocabSize}, DataType::Float(32), Device{kDLCPU, 0});
+    float* out = static_cast<float*>(logits->data);
+    int64_t offset = 0;
+    int64_t row = 0;
+    for (size_t i = 0; i < cache->cur_seq_ids.size(); ++i) {
+      std::vector<int32_t>& context = cache->history.at(cache->cur_seq_ids[i]);
+      for (int64_t j = 0; j < cache->cur_lengths[i]; ++j) {
+        context.push_back(tokens[offset + j]);
+        if (!last_token_logits || j + 1 == cache->cur_lengths[i]) {
+          int32_t next = NextToken(context);
+          for (int64_t v = 0; v < kVocabSize; ++v) {
+            out[row * kVocabSize + v] = v == next ? 1.0f : 0.0f;
+          }
+          ++row;
+        }
+      }
+      offset += cache->cur_lengths[i];
+    }
+    return logits;
+  });
+}
+
+std::vector<int32_t> Prompt(int64_t length, int32_t seed) {
+  std::vector<int32_t> prompt(length);
+  for (int64_t i = 0; i < length; ++i) prompt[i] = (seed + 7 * i) % kVocabSize;
+  return prompt;
+}
+
+std::vector<int32_t> GreedyDecode(std::vector<int32_t> context, int64_t num_tokens) {
+  std::vector<int32_t> generated;
+  for (int64_t i = 0; i < num_tokens; ++i) {
+    generated.push_back(NextToken(context));
+    context.push_back(generated.back());
+  }
+  return generated;
+}
+
+/*! \brief Run requests to completion and check the outputs against greedy decoding. */
+void RunToCompletion(ChunkedPrefillScheduler scheduler, const std::vector<int64_t>& prompt_lengths,
+                     int64_t max_new_tokens) {
+  for (size_t i = 0; i < prompt_lengths.size(); ++i) {
+    std::vector<int32_t> prompt = Prompt(prompt_lengths[i], i);
+    scheduler->AddRequest(i, IntTuple(prompt.begin(), prompt.end()), max_new_tokens);
+  }
+  for (int iter = 0; scheduler->HasUnfinishedRequests(); ++iter) {
+    ASSERT_LT(iter, 1000);
+    scheduler->Step();
+  }
+  for (size_t i = 0; i < prompt_lengths.size(); ++i) {
+    IntTuple output = scheduler->PopOutput(i);
+    std::vector<int32_t> expected = GreedyDecode(Prompt(prompt_lengths[i], i), max_new_tokens);
+    EXPECT_EQ(std::vector<int32_t>(output.begin(), output.end()), expected) << "request " << i;
+  }
+}
+
+}  // namespace
+
+TEST(ChunkedPrefillScheduler, ChunkedPrefillWithDecodes) {
+  for (bool last_token_logits : {false, true}) {
+    auto cache = make_object<PagedTokenCacheObj>(1000);
+    ChunkedPrefillScheduler scheduler(make_object<ChunkedPrefillSchedulerObj>(
+        MakeModel(last_token_logits), KVState(cache), Array<Any>{}, 8, 4, kPageSize,
+        PreemptionMode::kRecompute, ffi::Function(), ffi::Function()));
+    RunToCompletion(scheduler, {5, 40, 23}, 6);
+
+    bool piggybacked = false;
+    for (const auto& forward : cache->forwards) {
+      int64_t num_tokens = 0;
+      bool has_decode = false, has_prefill = false;
+      for (const auto& [seq_id, length] : forward) {
+        num_tokens += length;
+        (length == 1 ? has_decode : has_prefill) = true;
+      }
+      EXPECT_LE(num_tokens, 8);
+      piggybacked |= has_decode && has_prefill;
+    }
+    EXPECT_TRUE(piggybacked);
+    EXPECT_TRUE(cache->history.empty());
+
+    Map<String, Any> stats = scheduler->Stats();
+    EXPECT_EQ(stats["num_prefill_tokens"].cast<int64_t>(), 5 + 40 + 23);
+    EXPECT_EQ(stats["num_decode_tokens"].cast<int64_t>(), 3 * 5);
+    EXPECT_EQ(stats["num_preemptions"].cast<int64_t>(), 0);
+    EXPECT_LE(stats["ttft_p50"].cast<double>(), stats["ttft_p99"].cast<double>());
+    EXPECT_GE(stats["itl_p90"].cast<double>(), 0.0);
+  }
+}
+
+TEST(ChunkedPrefillScheduler, PreemptByRecompute) {
+  auto cache = make_object<PagedTokenCacheObj>(6);
+  ChunkedPrefillScheduler scheduler(make_object<ChunkedPrefillSchedulerObj>(
+      MakeModel(false), KVState(cache), Array<Any>{}, 16, 4, kPageSize,
+      PreemptionMode::kRecompute, ffi::Function(), ffi::Function()));
+  RunToCompletion(scheduler, {6, 7, 5}, 9);
+  EXPECT_GT(scheduler->Stats()["num_preemptions"].cast<int64_t>(), 0);
+}
+
+TEST(ChunkedPrefillScheduler, PreemptBySwap) {
+  auto cache = make_object<PagedTokenCacheObj>(6);
+  int64_t num_swap_outs = 0;
+  ffi::Function f_swap_out =
+      ffi::Function::FromTyped([&num_swap_outs](KVState state, int64_t seq_id) {
+        ++num_swap_outs;
+        const std::vector<int32_t>& tokens = state.as<PagedTokenCacheObj>()->history.at(seq_id);
+        return IntTuple(tokens.begin(), tokens.end());
+      });
+  ffi::Function f_swap_in =
+      ffi::Function::FromTyped([](KVState state, int64_t seq_id, IntTuple tokens) {
+        auto* cache = const_cast<PagedTokenCacheObj*>(state.as<PagedTokenCacheObj>());
+        cache->history.at(seq_id).assign(tokens.begin(), tokens.end());
+      });
+  ChunkedPrefillScheduler scheduler(make_object<ChunkedPrefillSchedulerObj>(
+      MakeModel(false), KVState(cache), Array<Any>{}, 16, 4, kPageSize, PreemptionMode::kSwap,
+      f_swap_out, f_swap_in));
+  RunToCompletion(scheduler, {6, 7, 5}, 9);
+  int64_t num_preemptions = scheduler->Stats()["num_preemptions"].cast<int64_t>();
+  EXPECT_GT(num_preemptions, 0);
+  EXPECT_EQ(num_swap_outs, num_preemptions);
+  // Swapped requests are not prefilled again.
+  EXPECT_EQ(scheduler->Stats()["num_prefill_tokens"].cast<int64_t>(), 6 + 7 + 5);
+}
+
+TEST(ChunkedPrefillScheduler, PromptLargerThanCacheRaises) {
+  auto cache = make_object<PagedTokenCacheObj>(2);
+  ChunkedPrefillScheduler scheduler(make_object<ChunkedPrefillSchedulerObj>(
+      MakeModel(false), KVState(cache), Array<Any>{}, 16, 4, kPageSize,
+      PreemptionMode::kRecompute, ffi::Function(), ffi::Function()));
+  std::vector<int32_t> prompt = Prompt(20, 0);
+  scheduler->AddRequest(0, IntTuple(prompt.begin(), prompt.end()), 4);
+  // The first chunk fills the cache, and nothing is left waiting for the next step.
+  scheduler->Step();
+  EXPECT_THROW(scheduler->Step(), ffi::Error);
+}
@@ -0,0 +1,224 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace tvm;
+using namespace tvm::runtime;
+
+namespace {
+
+constexpr int64_t kVocabSize = 1000;
+
+template <typename T>
+NDArray ToNDArray(const std::vector<T>& data, std::vector<int64_t> shape, DLDataType dtype) {
+  NDArray arr = NDArray::Empty(shape, dtype, Device{kDLCPU, 0});
+  std::memcpy(arr->data, data.data(), data.size() * sizeof(T));
+  return arr;
+}
+
+struct RowConfig {
+  float temperature;
+  float top_p;
+  int top_k;
+  float repetition_penalty;
+  float presence_penalty;
+  float frequency_penalty;
+};
+
+/*!
+ * \brief The probability interval [low, high) of the inverse CDF the sampled token covers
+ * when computed with the chained builtins, or an empty interval if it is filtered out.
+ */
+std::pair<double, double> ReferenceInterval(std::vector<float> logits, const RowConfig& config,
+                                            const std::vector<int32_t>& ids,
+                                            const std::vector<int32_t>& freqs, int32_t token) {
+  const auto fpenalty = ffi::Function::GetGlobal("vm.builtin.apply_repetition_penalty").value();
+  const auto fpresence =
+      ffi::Function::GetGlobal("vm.builtin.apply_presence_and_frequency_penalty").value();
+  const auto fsoftmax =
+      ffi::Function::GetGlobal("vm.builtin.apply_softmax_with_temperature").value();
+  NDArray row = ToNDArray(logits, {1, kVocabSize}, DataType::Float(32));
+  int64_t n = ids.size();
+  NDArray id_arr = ToNDArray(ids, {n}, DataType::Int(32));
+  fpenalty(row, id_arr, static_cast<double>(config.repetition_penalty));
+  fpresence(row, id_arr, ToNDArray(freqs, {n}, DataType::Int(32)),
+            static_cast<double>(config.presence_penalty),
+            static_cast<double>(config.frequency_penalty));
+  fsoftmax(row, static_cast<double>(config.temperature));
+  const float* prob = static_cast<const float*>(row->data);
+
+  std::vector<int32_t> order(kVocabSize);
+  std::iota(order.begin(), order.end(), 0);
+  if (config.top_k == 0 && config.top_p >= 1) {
+    // Plain multinomial sampling in vocabulary order.
+    double cum = 0;
+    for (int32_t i = 0; i < token; ++i) cum += prob[i];
+    return {cum, cum + prob[token]};
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [prob](int32_t a, int32_t b) { return prob[a] > prob[b]; });
+  if (config.top_k > 0) order.resize(config.top_k);
+  double total = 0;
+  for (int32_t i : order) total += prob[i];
+  double cum = 0;
+  size_t num_kept = 0;
+  while (num_kept < order.size() && (num_kept == 0 || cum < config.top_p)) {
+    cum += prob[order[num_kept++]] / total;
+  }
+  double low = 0;
+  for (size_t i = 0; i < num_kept; ++i) {
+    double p = prob[order[i]] / total / cum;
+    if (order[i] == token) return {low, low + p};
+    low += p;
+  }
+  return {0, 0};
+}
+
+}  // namespace
+
+TEST(FusedSampling, MatchesChainedBuiltins) {
+  std::vector<RowConfig> configs = {
+      {0.0f, 1.0f, 0, 1.3f, 0.5f, 0.2f},   // greedy with penalties
+      {0.7f, 0.9f, 0, 1.0f, 0.0f, 0.0f},   // top-p
+      {1.0f, 1.0f, 0, 1.1f, 0.0f, 0.0f},   // plain multinomial
+      {0.8f, 1.0f, 40, 1.0f, 0.3f, 0.1f},  // top-k
+      {1.2f, 0.5f, 20, 1.2f, 0.0f, 0.0f},  // top-k and top-p
+      {1.5f, 0.95f, 0, 1.0f, 0.0f, 0.0f},  // top-p over a flat distribution
+  };
+  std::mt19937 rng(0);
+  std::normal_distribution<float> normal;
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  const auto fsample = ffi::Function::GetGlobal("vm.builtin.fused_sample_from_logits").value();
+
+  for (int trial = 0; trial < 20; ++trial) {
+    int64_t batch_size = configs.size();
+    std::vector<float> logits(batch_size * kVocabSize);
+    std::vector<float> params;
+    std::vector<float> samples;
+    std::vector<int32_t> indptr = {0};
+    std::vector<int32_t> ids;
+    std::vector<int32_t> freqs;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      float scale = i == batch_size - 1 ? 0.05f : 3.0f;
+      for (int64_t v = 0; v < kVocabSize; ++v) logits[i * kVocabSize + v] = normal(rng) * scale;
+      const RowConfig& c = configs[i];
+      params.insert(params.end(), {c.temperature, c.top_p, static_cast<float>(c.top_k),
+                                   c.repetition_penalty, c.presence_penalty, c.frequency_penalty});
+      samples.push_back(uniform(rng));
+      for (int32_t token = 7 * i; token < kVocabSize; token += 97 + i) {
+        ids.push_back(token);
+        freqs.push_back(1 + token % 3);
+      }
+      indptr.push_back(ids.size());
+    }
+
+    NDArray result = fsample(ToNDArray(logits, {batch_size, kVocabSize}, DataType::Float(32)),
+                             ToNDArray(params, {batch_size, 6}, DataType::Float(32)),
+                             ToNDArray(samples, {batch_size}, DataType::Float(32)),
+                             ToNDArray(indptr, {batch_size + 1}, DataType::Int(32)),
+                             ToNDArray(ids, {static_cast<int64_t>(ids.size())}, DataType::Int(32)),
+                             ToNDArray(freqs, {static_cast<int64_t>(freqs.size())},
+                                       DataType::Int(32)))
+                         .cast<NDArray>();
+    const int32_t* tokens = static_cast<const int32_t*>(result->data);
+    for (int64_t i = 0; i < batch_size; ++i) {
+      std::vector<float> row(logits.begin() + i * kVocabSize,
+                             logits.begin() + (i + 1) * kVocabSize);
+      std::vector<int32_t> row_ids(ids.begin() + indptr[i], ids.begin() + indptr[i + 1]);
+      std::vector<int32_t> row_freqs(freqs.begin() + indptr[i], freqs.begin() + indptr[i + 1]);
+      if (configs[i].temperature == 0.0f) {
+        // Greedy: compare with the argmax of the penalized logits.
+        RowConfig unit = configs[i];
+        unit.temperature = 1.0f;
+        std::vector<float> probs(kVocabSize);
+        for (int32_t v = 0; v < kVocabSize; ++v) {
+          auto [low, high] = ReferenceInterval(row, unit, row_ids, row_freqs, v);
+          probs[v] = high - low;
+        }
+        EXPECT_EQ(tokens[i], std::max_element(probs.begin(), probs.end()) - probs.begin());
+        continue;
+      }
+      auto [low, high] = ReferenceInterval(row, configs[i], row_ids, row_freqs, tokens[i]);
+      EXPECT_LT(low, high) << "row " << i << " sampled a filtered token " << tokens[i];
+      EXPECT_GE(samples[i], low - 1e-4) << "row " << i;
+      EXPECT_LT(samples[i], high + 1e-4) << "row " << i;
+    }
+  }
+}
+
+TEST(FusedSampling, InvalidRowRaises) {
+  // Enough rows to run in the thread pool, with the last one all -inf.
+  int64_t batch_size = 16;
+  std::vector<float> logits(batch_size * kVocabSize, 0.0f);
+  std::fill(logits.end() - kVocabSize, logits.end(), -std::numeric_limits<float>::infinity());
+  std::vector<float> params;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    params.insert(params.end(), {1.0f, 0.9f, 0.0f, 1.0f, 0.0f, 0.0f});
+  }
+  std::vector<float> samples(batch_size, 0.5f);
+  std::vector<int32_t> indptr(batch_size + 1, 0);
+  std::vector<int32_t> empty;
+  const auto fsample = ffi::Function::GetGlobal("vm.builtin.fused_sample_from_logits").value();
+  EXPECT_THROW(fsample(ToNDArray(logits, {batch_size, kVocabSize}, DataType::Float(32)),
+                       ToNDArray(params, {batch_size, 6}, DataType::Float(32)),
+                       ToNDArray(samples, {batch_size}, DataType::Float(32)),
+                       ToNDArray(indptr, {batch_size + 1}, DataType::Int(32)),
+                       ToNDArray(empty, {0}, DataType::Int(32)),
+                       ToNDArray(empty, {0}, DataType::Int(32))),
+               ffi::Error);
+}
+
+TEST(FusedSampling, InvalidTokensRaise) {
+  int64_t batch_size = 2;
+  std::vector<float> logits(batch_size * kVocabSize, 0.0f);
+  std::vector<float> params;
+  for (int64_t i = 0; i < batch_size; ++i) {
+    params.insert(params.end(), {1.0f, 0.9f, 0.0f, 1.1f, 0.0f, 0.0f});
+  }
+  std::vector<float> samples(batch_size, 0.5f);
+  const auto fsample = ffi::Function::GetGlobal("vm.builtin.fused_sample_from_logits").value();
+  auto f_sample = [&](std::vector<int32_t> indptr, std::vector<int32_t> ids) {
+    int64_t num_ids = ids.size();
+    std::vector<int32_t> freqs(num_ids, 1);
+    fsample(ToNDArray(logits, {batch_size, kVocabSize}, DataType::Float(32)),
+            ToNDArray(params, {batch_size, 6}, DataType::Float(32)),
+            ToNDArray(samples, {batch_size}, DataType::Float(32)),
+            ToNDArray(indptr, {batch_size + 1}, DataType::Int(32)),
+            ToNDArray(ids, {num_ids}, DataType::Int(32)),
+            ToNDArray(freqs, {num_ids}, DataType::Int(32)));
+  };
+  f_sample({0, 1, 2}, {3, 4});
+  // The indptr out of the token ids, or decreasing.
+  EXPECT_THROW(f_sample({0, 1, 3}, {3, 4}), ffi::Error);
+  EXPECT_THROW(f_sample({0, 2, 1}, {3, 4}), ffi::Error);
+  EXPECT_THROW(f_sample({-1, 1, 2}, {3, 4}), ffi::Error);
+  // The token ids out of the vocabulary.
+  EXPECT_THROW(f_sample({0, 1, 2}, {3, -1}), ffi::Error);
+  EXPECT_THROW(f_sample({0, 1, 2}, {static_cast<int32_t>(kVocabSize), 4}), ffi::Error);
+}
@@ -0,0 +1,291 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../../src/runtime/vm/grammar_mask.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const std::vector<std::string> kVocab = {
+    "",      "0",     "1",     "12",  "123", "9",    ".",     ".5",  "-",   "a",   "ab",
+    "abc",   "b",     "\"",    "{",   "}",   ":",    ",",     " ",   "\":", "{\"", "true",
+    "false", "null",  "1.",    "0.0", "é",   "\xc3", "\xa9",  "日", "x",   "1a",  "12",
+    "\n",    "]",     "[",     "e",   "E",   "+",    "truex", "tr",  "ue",  "nul", "l",
+    "3",     "5",
+};
+constexpr int32_t kEos = 0;
+
+RegexGrammar MakeGrammar(const std::string& pattern) {
+  TokenTrie trie(make_object<TokenTrieObj>(kVocab));
+  return RegexGrammar(make_object<RegexGrammarObj>(pattern, trie, IntTuple{kEos}));
+}
+
+bool MaskBit(const std::vector<uint32_t>& mask, int32_t token_id) {
+  return (mask[token_id >> 5] >> (token_id & 31)) & 1;
+}
+
+/*! \brief The state after a string, or -1 if it is rejected, fed token by token. */
+int64_t Feed(RegexGrammar grammar, const std::vector<int32_t>& tokens) {
+  int64_t state = grammar->InitState();
+  for (int32_t token : tokens) {
+    state = grammar->AcceptToken(state, token);
+    if (state < 0) break;
+  }
+  return state;
+}
+
+int32_t TokenId(const std::string& token) {
+  return std::find(kVocab.begin(), kVocab.end(), token) - kVocab.begin();
+}
+
+bool Matches(const std::string& pattern, const std::vector<std::string>& tokens) {
+  RegexGrammar grammar = MakeGrammar(pattern);
+  std::vector<int32_t> ids;
+  for (const std::string& token : tokens) ids.push_back(TokenId(token));
+  int64_t state = Feed(grammar, ids);
+  return state >= 0 && grammar->IsAccepting(state);
+}
+
+/*! \brief Whether an output matches a pattern, fed byte by byte. */
+bool MatchesBytes(const std::string& pattern, const std::string& output) {
+  std::vector<std::string> vocab = {""};
+  for (int b = 0; b < 256; ++b) vocab.push_back(std::string(1, static_cast<char>(b)));
+  TokenTrie trie(make_object<TokenTrieObj>(vocab));
+  RegexGrammar grammar(make_object<RegexGrammarObj>(pattern, trie, IntTuple{kEos}));
+  int64_t state = grammar->InitState();
+  for (char c : output) {
+    state = grammar->AcceptToken(state, static_cast<uint8_t>(c) + 1);
+    if (state == RegexGrammarObj::kRejectedState) return false;
+  }
+  return grammar->IsAccepting(state);
+}
+
+}  // namespace
+
+TEST(GrammarMask, TokenTriePreorder) {
+  TokenTrie trie(make_object<TokenTrieObj>(kVocab));
+  int32_t num_nodes = trie->node_byte_.size();
+  std::vector<int> num_found(kVocab.size(), 0);
+  // Rebuild the bytes of each node from the preorder and check the tokens ending there.
+  std::vector<std::string> path = {""};
+  for (int32_t node = 1; node < num_nodes; ++node) {
+    int32_t depth = trie->node_depth_[node];
+    ASSERT_LE(depth, static_cast<int32_t>(path.size()));
+    path.resize(depth);
+    path.push_back(path.back() + static_cast<char>(trie->node_byte_[node]));
+    ASSERT_GT(trie->node_subtree_end_[node], node);
+    if (trie->node_subtree_end_[node] < num_nodes) {
+      EXPECT_LE(trie->node_depth_[trie->node_subtree_end_[node]], depth);
+    }
+    for (int32_t i = trie->node_token_indptr_[node]; i < trie->node_token_indptr_[node + 1]; ++i) {
+      int32_t token_id = trie->sorted_token_ids_[i];
+      EXPECT_EQ(kVocab[token_id], path.back());
+      ++num_found[token_id];
+    }
+  }
+  for (size_t i = 0; i < kVocab.size(); ++i) {
+    EXPECT_EQ(num_found[i], kVocab[i].empty() ? 0 : 1) << "token " << i;
+  }
+}
+
+TEST(GrammarMask, Match) {
+  std::string number = "-?(0|[1-9][0-9]*)(\\.[0-9]+)?([eE][+-]?[0-9]+)?";
+  EXPECT_TRUE(Matches(number, {"12", "3"}));
+  EXPECT_TRUE(Matches(number, {"-", "0.0"}));
+  EXPECT_TRUE(Matches(number, {"1.", "5", "e", "-", "12"}));
+  EXPECT_FALSE(Matches(number, {"0", "1"}));
+  EXPECT_FALSE(Matches(number, {"1."}));
+  EXPECT_FALSE(Matches(number, {"1a"}));
+
+  EXPECT_TRUE(Matches("(true|false|null)", {"tr", "ue"}));
+  EXPECT_TRUE(Matches("(?:true|false|null)", {"nul", "l"}));
+  EXPECT_FALSE(Matches("(true|false|null)", {"truex"}));
+  EXPECT_TRUE(Matches("a{2,3}b?", {"a", "a"}));
+  EXPECT_TRUE(Matches("a{2,3}b?", {"a", "ab"}));
+  EXPECT_FALSE(Matches("a{2,3}b?", {"a", "a", "a", "a"}));
+  EXPECT_TRUE(Matches("a{2,}", {"a", "a", "a", "a", "a"}));
+  EXPECT_TRUE(Matches("x{0,2}", {}));
+  EXPECT_TRUE(Matches("^\\{\"a\":\\d+\\}$", {"{\"", "a", "\":", "12", "}"}));
+  EXPECT_TRUE(Matches("{\\d}", {"{", "1", "}"}));
+  EXPECT_TRUE(Matches("[\\w\\s]+", {"ab", " ", "1", "\n"}));
+  EXPECT_FALSE(Matches("[^\\n]+", {"a", "\n"}));
+
+  // `.` and negated classes match whole UTF-8 characters, split over tokens or not.
+  EXPECT_TRUE(Matches(".", {"é"}));
+  EXPECT_TRUE(Matches(".", {"\xc3", "\xa9"}));
+  EXPECT_TRUE(Matches("[^a-z]", {"日"}));
+  EXPECT_FALSE(Matches(".", {"\xc3"}));
+  EXPECT_FALSE(Matches(".", {"a", "é"}));
+  EXPECT_TRUE(Matches("\\u00e9\\u65e5", {"é", "日"}));
+  EXPECT_TRUE(Matches("\\x2e5", {".5"}));
+  EXPECT_TRUE(Matches("\\xe9", {"é"}));
+  // A non-ASCII literal is a single atom, whose repetition repeats the whole character.
+  EXPECT_TRUE(Matches("é+", {"é", "\xc3", "\xa9"}));
+  EXPECT_TRUE(Matches("a日?", {"a", "日"}));
+  EXPECT_FALSE(Matches("é+", {"é", "\xa9"}));
+
+  // \w \d \s are ASCII, their negations match everything else, also inside classes.
+  EXPECT_FALSE(Matches("\\w", {"é"}));
+  EXPECT_TRUE(Matches("\\W", {"é"}));
+  EXPECT_TRUE(Matches("[a\\W]+", {"a", "é", "."}));
+  EXPECT_FALSE(Matches("[a\\W]", {"b"}));
+  EXPECT_TRUE(Matches("[^\\W]", {"b"}));
+  EXPECT_FALSE(Matches("[^\\W]", {"é"}));
+  EXPECT_TRUE(Matches("[\\d\\S]", {"日"}));
+}
+
+TEST(GrammarMask, BitmaskMatchesAcceptToken) {
+  std::vector<std::string> patterns = {
+      "-?(0|[1-9][0-9]*)(\\.[0-9]+)?",
+      "\\{(\"[a-c]+\": (true|false|null|\\d+))(, \"[a-c]+\": (true|false|null|\\d+))*\\}",
+      "\\[(\\d+(,\\d+)*)?\\]",
+      "[^\"]*\"",
+      ".{1,3}",
+  };
+  std::mt19937 rng(0);
+  for (const std::string& pattern : patterns) {
+    RegexGrammar grammar = MakeGrammar(pattern);
+    for (int walk = 0; walk < 20; ++walk) {
+      int64_t state = grammar->InitState();
+      for (int step = 0; step < 30; ++step) {
+        std::vector<uint32_t> mask = grammar->NextTokenBitmask(state);
+        std::vector<int32_t> allowed;
+        for (int32_t token = 0; token < static_cast<int32_t>(kVocab.size()); ++token) {
+          int64_t next = grammar->AcceptToken(state, token);
+          EXPECT_EQ(MaskBit(mask, token), next >= 0)
+              << pattern << ": token \"" << kVocab[token] << "\" at step " << step;
+          if (next >= 0) allowed.push_back(token);
+        }
+        EXPECT_EQ(MaskBit(mask, kEos), grammar->IsAccepting(state));
+        if (allowed.empty() || (allowed.size() == 1 && allowed[0] == kEos)) break;
+        int32_t token;
+        do {
+          token = allowed[rng() % allowed.size()];
+        } while (token == kEos);
+        state = grammar->AcceptToken(state, token);
+      }
+    }
+  }
+}
+
+TEST(GrammarMask, FillBatchedBitmask) {
+  RegexGrammar grammar = MakeGrammar("[0-9]+");
+  int64_t num_words = (kVocab.size() + 31) / 32;
+  int64_t digits = grammar->AcceptToken(grammar->InitState(), TokenId("12"));
+  ASSERT_GE(digits, 0);
+  NDArray bitmask = NDArray::Empty({3, num_words}, DataType::Int(32), {kDLCPU, 0});
+  grammar->FillNextTokenBitmask(
+      IntTuple{grammar->InitState(), digits, RegexGrammarObj::kUnconstrainedState}, bitmask);
+  const uint32_t* data = static_cast<const uint32_t*>(bitmask->data);
+  std::vector<uint32_t> init_row(data, data + num_words);
+  std::vector<uint32_t> digits_row(data + num_words, data + 2 * num_words);
+  EXPECT_EQ(init_row, grammar->NextTokenBitmask(grammar->InitState()));
+  EXPECT_EQ(digits_row, grammar->NextTokenBitmask(digits));
+  EXPECT_FALSE(MaskBit(init_row, kEos));
+  EXPECT_TRUE(MaskBit(digits_row, kEos));
+  EXPECT_TRUE(MaskBit(digits_row, TokenId("123")));
+  EXPECT_FALSE(MaskBit(digits_row, TokenId("1a")));
+  for (int64_t w = 0; w < num_words; ++w) EXPECT_EQ(data[2 * num_words + w], ~0u);
+
+  const auto fapply = ffi::Function::GetGlobal("vm.builtin.apply_token_bitmask_inplace").value();
+  int64_t vocab_size = kVocab.size();
+  NDArray logits = NDArray::Empty({3, vocab_size}, DataType::Float(32), {kDLCPU, 0});
+  float* logits_data = static_cast<float*>(logits->data);
+  std::fill(logits_data, logits_data + 3 * vocab_size, 1.0f);
+  fapply(logits, bitmask);
+  for (int64_t i = 0; i < 3; ++i) {
+    const std::vector<uint32_t>& mask = i == 0 ? init_row : i == 1 ? digits_row : init_row;
+    for (int32_t token = 0; token < vocab_size; ++token) {
+      bool allowed = i == 2 || MaskBit(mask, token);
+      EXPECT_EQ(logits_data[i * vocab_size + token] == 1.0f, allowed);
+    }
+  }
+
+  // No token can follow a rejected one, which is not the same as no grammar.
+  int64_t rejected = grammar->AcceptToken(grammar->InitState(), TokenId("a"));
+  EXPECT_EQ(rejected, RegexGrammarObj::kRejectedState);
+  EXPECT_THROW(grammar->FillNextTokenBitmask(IntTuple{digits, rejected, digits}, bitmask), Error);
+}
+
+TEST(GrammarMask, JSONSchema) {
+  std::string schema = R"({
+    "type": "object",
+    "properties": {
+      "name": {"type": "string", "maxLength": 5},
+      "age": {"type": "integer", "minimum": 0},
+      "tags": {"type": "array", "items": {"enum": ["a", "b"]}},
+      "ok": {"type": "boolean"}
+    },
+    "required": ["name", "age"]
+  })";
+  std::string pattern = JSONSchemaToRegex(schema);
+  for (std::string output : {R"({"name": "bob", "age": 3})",
+                             R"({"name": "b"é", "age": 30, "tags": ["a", "b"]})",
+                             R"({"name": "", "age": 0, "ok": true})"}) {
+    EXPECT_TRUE(MatchesBytes(pattern, output)) << output;
+  }
+  for (std::string output : {R"({"age": 3})", R"({"name": "bobbybob", "age": 3})",
+                             R"({"name": "bob", "age": -3})", R"({"name":"bob","age":3})",
+                             R"({"name": "bob", "age": 3, "tags": ["c"]})",
+                             R"({"age": 3, "name": "bob"})"}) {
+    EXPECT_FALSE(MatchesBytes(pattern, output)) << output;
+  }
+
+  // The separators depend on the first optional property present.
+  pattern = JSONSchemaToRegex(
+      R"({"properties": {"a": {"type": "number"}, "b": {"type": ["string", "null"]}}})");
+  for (std::string output : {"{}", R"({"b": null})", R"({"a": 1.5e3, "b": "x"})"}) {
+    EXPECT_TRUE(MatchesBytes(pattern, output)) << output;
+  }
+  EXPECT_FALSE(MatchesBytes(pattern, R"({, "b": null})"));
+
+  pattern = JSONSchemaToRegex(R"({
+    "$defs": {"day": {"type": "string", "format": "date"}},
+    "type": "array", "items": {"$ref": "#/$defs/day"}, "minItems": 1, "maxItems": 2
+  })");
+  EXPECT_TRUE(MatchesBytes(pattern, R"(["2024-01-02", "2024-01-03"])"));
+  EXPECT_FALSE(MatchesBytes(pattern, "[]"));
+  EXPECT_FALSE(MatchesBytes(pattern, R"(["2024-01-02", "2024-01-03", "2024-01-04"])"));
+
+  // Schemas of any JSON value and recursive schemas are not regular.
+  for (std::string schema :
+       {"{}", R"({"type": "array"})", "{", R"({"type": "string", "maxLength": -1})",
+        R"({"$defs": {"n": {"properties": {"c": {"$ref": "#/$defs/n"}}}}, "$ref": "#/$defs/n"})"}) {
+    EXPECT_THROW(JSONSchemaToRegex(schema), Error) << schema;
+  }
+}
+
+TEST(GrammarMask, InvalidPattern) {
+  for (std::string pattern : {"(ab", "ab)", "*a", "a**", "[b-a]", "[a", "a{3,2}", "\\q", "[é]",
+                               "\xc3", "\xa9"}) {
+    EXPECT_THROW(MakeGrammar(pattern), Error) << pattern;
+  }
+}
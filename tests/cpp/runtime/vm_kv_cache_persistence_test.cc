@@ -0,0 +1,301 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _WIN32
+
+#include <gtest/gtest.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/builtin_fp16.h>
+#include <tvm/runtime/int_tuple.h>
+#include <tvm/runtime/ndarray.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../../src/runtime/vm/byte_plane_codec.h"
+#include "../../../src/runtime/vm/kv_state.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+constexpr int64_t kNumLayers = 2;
+constexpr int64_t kNumQOHeads = 4;
+constexpr int64_t kNumKVHeads = 2;
+constexpr int64_t kHeadDim = 16;
+constexpr int64_t kPageSize = 4;
+const Device kCPU{kDLCPU, 0};
+
+/*! \brief Split the fused QKV data into Q, K and V, without RoPE. */
+void SplitQKV(NDArray qkv, NDArray position_map, NDArray q, NDArray k, NDArray v, int apply_rope) {
+  int64_t n = qkv->shape[0];
+  int64_t row = kHeadDim * sizeof(float);
+  const char* src = static_cast<const char*>(qkv->data);
+  for (int64_t i = 0; i < n; ++i) {
+    const char* token = src + i * (kNumQOHeads + 2 * kNumKVHeads) * row;
+    std::memcpy(static_cast<char*>(q->data) + i * kNumQOHeads * row, token, kNumQOHeads * row);
+    std::memcpy(static_cast<char*>(k->data) + i * kNumKVHeads * row, token + kNumQOHeads * row,
+                kNumKVHeads * row);
+    std::memcpy(static_cast<char*>(v->data) + i * kNumKVHeads * row,
+                token + (kNumQOHeads + kNumKVHeads) * row, kNumKVHeads * row);
+  }
+}
+
+/*! \brief The offset of a K/V row in pages of layout (num_pages, 2, heads, page_size, dim). */
+int64_t PageOffset(int32_t position, int kv, int64_t head) {
+  int64_t page = position / kPageSize;
+  int64_t slot = position % kPageSize;
+  return (((page * 2 + kv) * kNumKVHeads + head) * kPageSize + slot) * kHeadDim;
+}
+
+void TransposeAppend(NDArray pages, NDArray k, NDArray v, NDArray position_map) {
+  float* page_data = static_cast<float*>(pages->data);
+  const int32_t* positions = static_cast<const int32_t*>(position_map->data);
+  for (int64_t i = 0; i < k->shape[0]; ++i) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      std::memcpy(page_data + PageOffset(positions[i], 0, h),
+                  static_cast<const float*>(k->data) + (i * kNumKVHeads + h) * kHeadDim,
+                  kHeadDim * sizeof(float));
+      std::memcpy(page_data + PageOffset(positions[i], 1, h),
+                  static_cast<const float*>(v->data) + (i * kNumKVHeads + h) * kHeadDim,
+                  kHeadDim * sizeof(float));
+    }
+  }
+}
+
+void DebugGetKV(NDArray pages, NDArray position_map, NDArray k, NDArray v, int64_t layer) {
+  const float* page_data = static_cast<const float*>(pages->data);
+  const int32_t* positions = static_cast<const int32_t*>(position_map->data);
+  int64_t n = position_map->shape[0];
+  for (int64_t i = 0; i < n; ++i) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      int64_t dst = ((layer * n + i) * kNumKVHeads + h) * kHeadDim;
+      std::memcpy(static_cast<float*>(k->data) + dst, page_data + PageOffset(positions[i], 0, h),
+                  kHeadDim * sizeof(float));
+      std::memcpy(static_cast<float*>(v->data) + dst, page_data + PageOffset(positions[i], 1, h),
+                  kHeadDim * sizeof(float));
+    }
+  }
+}
+
+void CopySinglePage(NDArray pages, int64_t src, int64_t tgt, int64_t length) {
+  float* page_data = static_cast<float*>(pages->data);
+  for (int kv = 0; kv < 2; ++kv) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      std::memcpy(page_data + PageOffset(tgt * kPageSize, kv, h),
+                  page_data + PageOffset(src * kPageSize, kv, h),
+                  length * kHeadDim * sizeof(float));
+    }
+  }
+}
+
+/*! \brief Merge two attention outputs with their base-2 LSE into the first one. */
+void MergeInplace(NDArray o1, NDArray lse1, NDArray o2, NDArray lse2) {
+  int64_t n = o1->shape[0] * o1->shape[1];
+  float* o1_data = static_cast<float*>(o1->data);
+  float* lse1_data = static_cast<float*>(lse1->data);
+  const float* o2_data = static_cast<const float*>(o2->data);
+  const float* lse2_data = static_cast<const float*>(lse2->data);
+  for (int64_t i = 0; i < n; ++i) {
+    float max_lse = std::max(lse1_data[i], lse2_data[i]);
+    float w1 = std::exp2(lse1_data[i] - max_lse);
+    float w2 = std::exp2(lse2_data[i] - max_lse);
+    for (int64_t d = 0; d < kHeadDim; ++d) {
+      o1_data[i * kHeadDim + d] =
+          (o1_data[i * kHeadDim + d] * w1 + o2_data[i * kHeadDim + d] * w2) / (w1 + w2);
+    }
+    lse1_data[i] = max_lse + std::log2(w1 + w2);
+  }
+}
+
+AttentionKVCache CreateKVCache(int64_t total_capacity) {
+  const auto fcreate =
+      ffi::Function::GetGlobal("vm.builtin.paged_attention_kv_cache_create").value();
+  const auto funused = ffi::Function::FromTyped([]() { LOG(FATAL) << "Unexpected call"; });
+  Array<ObjectRef> cpu_backend{String("cpu")};
+  return fcreate(IntTuple{8, total_capacity, 256, kPageSize, 0}, IntTuple{0, kNumLayers},
+                 kNumQOHeads, kNumKVHeads, kHeadDim, kHeadDim,
+                 IntTuple(std::vector<int64_t>(kNumLayers, 0)), false, 0, 1.0, 1e4, nullptr,
+                 NDArray::Empty({}, DataType::Float(32), kCPU),
+                 ffi::Function::FromTyped(TransposeAppend), nullptr, cpu_backend, cpu_backend,
+                 cpu_backend, cpu_backend, cpu_backend, Array<ObjectRef>(), Array<ObjectRef>(),
+                 Array<ObjectRef>(),
+                 Array<ffi::Function>{ffi::Function::FromTyped(MergeInplace),
+                                      ffi::Function::FromTyped(MergeInplace)},
+                 ffi::Function::FromTyped(SplitQKV), ffi::Function::FromTyped(CopySinglePage),
+                 ffi::Function::FromTyped(DebugGetKV), funused)
+      .cast<AttentionKVCache>();
+}
+
+/*! \brief Run one forward of the given sequences and return the attention output. */
+std::vector<float> Forward(AttentionKVCache kv_cache, std::vector<int64_t> seq_ids,
+                           std::vector<int64_t> append_lengths, std::mt19937* rng) {
+  int64_t total_length = 0;
+  for (int64_t length : append_lengths) total_length += length;
+  kv_cache->BeginForward(IntTuple(seq_ids), IntTuple(append_lengths), std::nullopt);
+  std::vector<float> output;
+  std::normal_distribution<float> normal;
+  for (int64_t layer = 0; layer < kNumLayers; ++layer) {
+    NDArray qkv = NDArray::Empty({total_length, kNumQOHeads + 2 * kNumKVHeads, kHeadDim},
+                                 DataType::Float(32), kCPU);
+    float* qkv_data = static_cast<float*>(qkv->data);
+    for (int64_t i = 0; i < qkv.Shape().Product(); ++i) qkv_data[i] = normal(*rng);
+    NDArray o = NDArray::Empty({total_length, kNumQOHeads, kHeadDim}, DataType::Float(32), kCPU);
+    kv_cache->AttentionWithFusedQKV(layer, qkv, std::nullopt, o, 0.25);
+    output.insert(output.end(), static_cast<float*>(o->data),
+                  static_cast<float*>(o->data) + o.Shape().Product());
+  }
+  kv_cache->EndForward();
+  return output;
+}
+
+std::vector<float> GetKV(AttentionKVCache kv_cache, int64_t seq_id, int64_t length) {
+  ffi::Shape shape{kNumLayers, length, kNumKVHeads, kHeadDim};
+  NDArray k = NDArray::Empty(shape, DataType::Float(32), kCPU);
+  NDArray v = NDArray::Empty(shape, DataType::Float(32), kCPU);
+  kv_cache->DebugGetKV(seq_id, 0, length, k, v);
+  std::vector<float> result(static_cast<float*>(k->data),
+                            static_cast<float*>(k->data) + k.Shape().Product());
+  result.insert(result.end(), static_cast<float*>(v->data),
+                static_cast<float*>(v->data) + v.Shape().Product());
+  return result;
+}
+
+std::string TempPath() {
+  char path_template[] = "/tmp/tvm_kv_sequence_XXXXXX";
+  int fd = mkstemp(path_template);
+  close(fd);
+  return path_template;
+}
+
+}  // namespace
+
+TEST(KVCachePersistence, BytePlaneCodecRoundTrip) {
+  std::mt19937 rng(0);
+  std::normal_distribution<float> normal;
+  for (int64_t n : {0, 1, 7, 1000, 65536}) {
+    std::vector<float> fp32(n);
+    std::vector<uint16_t> fp16(n);
+    for (int64_t i = 0; i < n; ++i) {
+      fp32[i] = normal(rng);
+      fp16[i] = __gnu_f2h_ieee(fp32[i]);
+    }
+    std::vector<uint8_t> constant(n, 42);
+    for (auto [data, elem_bytes] : std::vector<std::pair<const void*, int>>{
+             {fp32.data(), 4}, {fp16.data(), 2}, {constant.data(), 1}}) {
+      std::vector<uint8_t> encoded;
+      EncodeBytePlanes(data, n, elem_bytes, &encoded);
+      std::vector<uint8_t> decoded(n * elem_bytes);
+      EXPECT_EQ(DecodeBytePlanes(encoded.data(), encoded.size(), n, elem_bytes, decoded.data()),
+                static_cast<int64_t>(encoded.size()));
+      EXPECT_EQ(std::memcmp(decoded.data(), data, n * elem_bytes), 0);
+      if (n == 65536 && elem_bytes > 1) {
+        // The sign and exponent plane of normally distributed values compresses well.
+        EXPECT_LT(encoded.size(), n * elem_bytes * 0.9);
+      }
+      if (n > 0) {
+        EXPECT_THROW(DecodeBytePlanes(encoded.data(), encoded.size() - 1, n, elem_bytes,
+                                      decoded.data()),
+                     Error);
+      }
+    }
+  }
+}
+
+TEST(KVCachePersistence, SaveAndRestore) {
+  std::mt19937 rng(0);
+  AttentionKVCache kv_cache = CreateKVCache(512);
+  // Sequence 1 is forked from sequence 0 in the middle of a page, so that it spans
+  // several blocks that share pages with sequence 0.
+  kv_cache->AddSequence(0);
+  Forward(kv_cache, {0}, {13}, &rng);
+  kv_cache->ForkSequence(0, 1, 10);
+  Forward(kv_cache, {0, 1}, {3, 9}, &rng);
+  Forward(kv_cache, {1}, {1}, &rng);
+  int64_t length = 20;
+  std::vector<float> expected_kv = GetKV(kv_cache, 1, length);
+  int32_t num_available_pages = kv_cache->GetNumAvailablePages();
+
+  for (bool compress : {false, true}) {
+    std::string path = TempPath();
+    int64_t nbytes = kv_cache->SaveSequence(1, path, compress);
+    EXPECT_GT(nbytes, 0);
+    // Restore a copy next to the original, which must behave the same in later forwards.
+    EXPECT_EQ(kv_cache->RestoreSequence(2, path), length);
+    EXPECT_EQ(kv_cache->GetNumAvailablePages(), num_available_pages - (length + 3) / kPageSize);
+    EXPECT_EQ(GetKV(kv_cache, 2, length), expected_kv);
+    EXPECT_THROW(kv_cache->RestoreSequence(2, path), Error);
+
+    std::mt19937 rng_original(compress);
+    std::mt19937 rng_restored(compress);
+    kv_cache->ForkSequence(1, 3);
+    std::vector<float> out_original = Forward(kv_cache, {3}, {6}, &rng_original);
+    std::vector<float> out_restored = Forward(kv_cache, {2}, {6}, &rng_restored);
+    ASSERT_EQ(out_original.size(), out_restored.size());
+    for (size_t i = 0; i < out_original.size(); ++i) {
+      EXPECT_NEAR(out_original[i], out_restored[i], 1e-5);
+    }
+    EXPECT_EQ(GetKV(kv_cache, 2, length + 6), GetKV(kv_cache, 3, length + 6));
+    kv_cache->RemoveSequence(2);
+    kv_cache->RemoveSequence(3);
+    EXPECT_EQ(kv_cache->GetNumAvailablePages(), num_available_pages);
+    std::remove(path.c_str());
+  }
+
+  // An evicted sequence is restored into the pages it frees.
+  std::string path = TempPath();
+  kv_cache->SaveSequence(0, path, true);
+  std::vector<float> expected_kv0 = GetKV(kv_cache, 0, 16);
+  kv_cache->RemoveSequence(0);
+  kv_cache->RemoveSequence(1);
+  EXPECT_TRUE(kv_cache->Empty());
+  EXPECT_EQ(kv_cache->RestoreSequence(0, path), 16);
+  EXPECT_EQ(GetKV(kv_cache, 0, 16), expected_kv0);
+  std::remove(path.c_str());
+}
+
+TEST(KVCachePersistence, RestoreErrors) {
+  std::mt19937 rng(0);
+  AttentionKVCache kv_cache = CreateKVCache(64);
+  kv_cache->AddSequence(0);
+  Forward(kv_cache, {0}, {40}, &rng);
+  std::string path = TempPath();
+  kv_cache->SaveSequence(0, path, false);
+
+  // Not enough free pages left for a second copy.
+  EXPECT_THROW(kv_cache->RestoreSequence(1, path), Error);
+  // A truncated file leaves the KV cache unchanged.
+  int32_t num_available_pages = kv_cache->GetNumAvailablePages();
+  kv_cache->RemoveSequence(0);
+  ASSERT_EQ(truncate(path.c_str(), 1000), 0);
+  EXPECT_THROW(kv_cache->RestoreSequence(0, path), Error);
+  EXPECT_TRUE(kv_cache->Empty());
+  EXPECT_GT(kv_cache->GetNumAvailablePages(), num_available_pages);
+  std::remove(path.c_str());
+  EXPECT_THROW(kv_cache->RestoreSequence(0, path), Error);
+}
+
+#endif  // _WIN32
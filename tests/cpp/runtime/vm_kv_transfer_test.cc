@@ -0,0 +1,346 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _WIN32
+
+#include <gtest/gtest.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/int_tuple.h>
+#include <tvm/runtime/ndarray.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../../src/runtime/vm/kv_state.h"
+#include "../../../src/runtime/vm/kv_transport.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+constexpr int64_t kNumLayers = 2;
+constexpr int64_t kNumQOHeads = 4;
+constexpr int64_t kNumKVHeads = 2;
+constexpr int64_t kHeadDim = 16;
+const Device kCPU{kDLCPU, 0};
+
+/*! \brief Split the fused QKV data into Q, K and V, without RoPE. */
+void SplitQKV(NDArray qkv, NDArray position_map, NDArray q, NDArray k, NDArray v, int apply_rope) {
+  int64_t n = qkv->shape[0];
+  int64_t row = kHeadDim * sizeof(float);
+  const char* src = static_cast<const char*>(qkv->data);
+  for (int64_t i = 0; i < n; ++i) {
+    const char* token = src + i * (kNumQOHeads + 2 * kNumKVHeads) * row;
+    std::memcpy(static_cast<char*>(q->data) + i * kNumQOHeads * row, token, kNumQOHeads * row);
+    std::memcpy(static_cast<char*>(k->data) + i * kNumKVHeads * row, token + kNumQOHeads * row,
+                kNumKVHeads * row);
+    std::memcpy(static_cast<char*>(v->data) + i * kNumKVHeads * row,
+                token + (kNumQOHeads + kNumKVHeads) * row, kNumKVHeads * row);
+  }
+}
+
+/*! \brief The offset of a K/V row in pages of layout (num_pages, 2, heads, page_size, dim). */
+template <int64_t kPageSize>
+int64_t PageOffset(int32_t position, int kv, int64_t head) {
+  int64_t page = position / kPageSize;
+  int64_t slot = position % kPageSize;
+  return (((page * 2 + kv) * kNumKVHeads + head) * kPageSize + slot) * kHeadDim;
+}
+
+template <int64_t kPageSize>
+void TransposeAppend(NDArray pages, NDArray k, NDArray v, NDArray position_map) {
+  float* page_data = static_cast<float*>(pages->data);
+  const int32_t* positions = static_cast<const int32_t*>(position_map->data);
+  for (int64_t i = 0; i < k->shape[0]; ++i) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      std::memcpy(page_data + PageOffset<kPageSize>(positions[i], 0, h),
+                  static_cast<const float*>(k->data) + (i * kNumKVHeads + h) * kHeadDim,
+                  kHeadDim * sizeof(float));
+      std::memcpy(page_data + PageOffset<kPageSize>(positions[i], 1, h),
+                  static_cast<const float*>(v->data) + (i * kNumKVHeads + h) * kHeadDim,
+                  kHeadDim * sizeof(float));
+    }
+  }
+}
+
+template <int64_t kPageSize>
+void DebugGetKV(NDArray pages, NDArray position_map, NDArray k, NDArray v, int64_t layer) {
+  const float* page_data = static_cast<const float*>(pages->data);
+  const int32_t* positions = static_cast<const int32_t*>(position_map->data);
+  int64_t n = position_map->shape[0];
+  for (int64_t i = 0; i < n; ++i) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      int64_t dst = ((layer * n + i) * kNumKVHeads + h) * kHeadDim;
+      std::memcpy(static_cast<float*>(k->data) + dst,
+                  page_data + PageOffset<kPageSize>(positions[i], 0, h), kHeadDim * sizeof(float));
+      std::memcpy(static_cast<float*>(v->data) + dst,
+                  page_data + PageOffset<kPageSize>(positions[i], 1, h), kHeadDim * sizeof(float));
+    }
+  }
+}
+
+template <int64_t kPageSize>
+void CopySinglePage(NDArray pages, int64_t src, int64_t tgt, int64_t length) {
+  float* page_data = static_cast<float*>(pages->data);
+  for (int kv = 0; kv < 2; ++kv) {
+    for (int64_t h = 0; h < kNumKVHeads; ++h) {
+      std::memcpy(page_data + PageOffset<kPageSize>(tgt * kPageSize, kv, h),
+                  page_data + PageOffset<kPageSize>(src * kPageSize, kv, h),
+                  length * kHeadDim * sizeof(float));
+    }
+  }
+}
+
+/*! \brief Merge two attention outputs with their base-2 LSE into the first one. */
+void MergeInplace(NDArray o1, NDArray lse1, NDArray o2, NDArray lse2) {
+  int64_t n = o1->shape[0] * o1->shape[1];
+  float* o1_data = static_cast<float*>(o1->data);
+  float* lse1_data = static_cast<float*>(lse1->data);
+  const float* o2_data = static_cast<const float*>(o2->data);
+  const float* lse2_data = static_cast<const float*>(lse2->data);
+  for (int64_t i = 0; i < n; ++i) {
+    float max_lse = std::max(lse1_data[i], lse2_data[i]);
+    float w1 = std::exp2(lse1_data[i] - max_lse);
+    float w2 = std::exp2(lse2_data[i] - max_lse);
+    for (int64_t d = 0; d < kHeadDim; ++d) {
+      o1_data[i * kHeadDim + d] =
+          (o1_data[i * kHeadDim + d] * w1 + o2_data[i * kHeadDim + d] * w2) / (w1 + w2);
+    }
+    lse1_data[i] = max_lse + std::log2(w1 + w2);
+  }
+}
+
+template <int64_t kPageSize>
+AttentionKVCache CreateKVCache(int64_t total_capacity) {
+  const auto fcreate =
+      ffi::Function::GetGlobal("vm.builtin.paged_attention_kv_cache_create").value();
+  const auto funused = ffi::Function::FromTyped([]() { LOG(FATAL) << "Unexpected call"; });
+  Array<ObjectRef> cpu_backend{String("cpu")};
+  return fcreate(IntTuple{8, total_capacity, 256, kPageSize, 0}, IntTuple{0, kNumLayers},
+                 kNumQOHeads, kNumKVHeads, kHeadDim, kHeadDim,
+                 IntTuple(std::vector<int64_t>(kNumLayers, 0)), false, 0, 1.0, 1e4, nullptr,
+                 NDArray::Empty({}, DataType::Float(32), kCPU),
+                 ffi::Function::FromTyped(TransposeAppend<kPageSize>), nullptr, cpu_backend,
+                 cpu_backend, cpu_backend, cpu_backend, cpu_backend, Array<ObjectRef>(),
+                 Array<ObjectRef>(), Array<ObjectRef>(),
+                 Array<ffi::Function>{ffi::Function::FromTyped(MergeInplace),
+                                      ffi::Function::FromTyped(MergeInplace)},
+                 ffi::Function::FromTyped(SplitQKV),
+                 ffi::Function::FromTyped(CopySinglePage<kPageSize>),
+                 ffi::Function::FromTyped(DebugGetKV<kPageSize>), funused)
+      .template cast<AttentionKVCache>();
+}
+
+/*! \brief Run one forward of the given sequences and return the attention output. */
+std::vector<float> Forward(AttentionKVCache kv_cache, std::vector<int64_t> seq_ids,
+                           std::vector<int64_t> append_lengths, std::mt19937* rng) {
+  int64_t total_length = 0;
+  for (int64_t length : append_lengths) total_length += length;
+  kv_cache->BeginForward(IntTuple(seq_ids), IntTuple(append_lengths), std::nullopt);
+  std::vector<float> output;
+  std::normal_distribution<float> normal;
+  for (int64_t layer = 0; layer < kNumLayers; ++layer) {
+    NDArray qkv = NDArray::Empty({total_length, kNumQOHeads + 2 * kNumKVHeads, kHeadDim},
+                                 DataType::Float(32), kCPU);
+    float* qkv_data = static_cast<float*>(qkv->data);
+    for (int64_t i = 0; i < qkv.Shape().Product(); ++i) qkv_data[i] = normal(*rng);
+    NDArray o = NDArray::Empty({total_length, kNumQOHeads, kHeadDim}, DataType::Float(32), kCPU);
+    kv_cache->AttentionWithFusedQKV(layer, qkv, std::nullopt, o, 0.25);
+    output.insert(output.end(), static_cast<float*>(o->data),
+                  static_cast<float*>(o->data) + o.Shape().Product());
+  }
+  kv_cache->EndForward();
+  return output;
+}
+
+std::vector<float> GetKV(AttentionKVCache kv_cache, int64_t seq_id, int64_t length) {
+  ffi::Shape shape{kNumLayers, length, kNumKVHeads, kHeadDim};
+  NDArray k = NDArray::Empty(shape, DataType::Float(32), kCPU);
+  NDArray v = NDArray::Empty(shape, DataType::Float(32), kCPU);
+  kv_cache->DebugGetKV(seq_id, 0, length, k, v);
+  std::vector<float> result(static_cast<float*>(k->data),
+                            static_cast<float*>(k->data) + k.Shape().Product());
+  result.insert(result.end(), static_cast<float*>(v->data),
+                static_cast<float*>(v->data) + v.Shape().Product());
+  return result;
+}
+
+/*! \brief Create the two ends of a transport, where the receiving end is returned first. */
+std::pair<KVTransport, KVTransport> CreateTransportPair(const std::string& kind) {
+  if (kind == "shm") {
+    static int counter = 0;
+    std::string name =
+        "/tvm_kv_transport_test_" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+    const auto fshm = ffi::Function::GetGlobal("vm.builtin.kv_transport_shm").value();
+    // A small ring buffer, so that the data wraps around many times.
+    KVTransport recver = fshm(name, 4096, true).cast<KVTransport>();
+    KVTransport sender = fshm(name, 0, false).cast<KVTransport>();
+    return {recver, sender};
+  }
+  const auto flisten = ffi::Function::GetGlobal("vm.builtin.kv_transport_tcp_listen").value();
+  const auto fconnect = ffi::Function::GetGlobal("vm.builtin.kv_transport_tcp_connect").value();
+  const auto fport = ffi::Function::GetGlobal("vm.builtin.kv_transport_tcp_port").value();
+  KVTransport recver = flisten("127.0.0.1", 0).cast<KVTransport>();
+  KVTransport sender = fconnect("127.0.0.1", fport(recver).cast<int>()).cast<KVTransport>();
+  return {recver, sender};
+}
+
+class KVTransferTest : public ::testing::TestWithParam<std::string> {};
+
+}  // namespace
+
+TEST_P(KVTransferTest, TransportStream) {
+  auto [recver, sender] = CreateTransportPair(GetParam());
+  std::mt19937 rng(0);
+  std::vector<uint8_t> data(1 << 20);
+  for (uint8_t& byte : data) byte = rng();
+  std::thread send_thread([&, sender = sender]() {
+    std::mt19937 rng(1);
+    for (size_t offset = 0; offset < data.size();) {
+      size_t size = std::min<size_t>(rng() % 10000, data.size() - offset);
+      sender->Send(data.data() + offset, size);
+      offset += size;
+    }
+  });
+  std::vector<uint8_t> received(data.size());
+  for (size_t offset = 0; offset < received.size();) {
+    size_t size = std::min<size_t>(rng() % 7000 + 1, received.size() - offset);
+    recver->Recv(received.data() + offset, size);
+    offset += size;
+  }
+  send_thread.join();
+  EXPECT_EQ(received, data);
+  // Closing wakes up a pending receive with an error.
+  std::thread close_thread([sender = sender]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    sender->Close();
+  });
+  uint8_t byte;
+  EXPECT_THROW(recver->Recv(&byte, 1), Error);
+  close_thread.join();
+}
+
+TEST_P(KVTransferTest, TransferSequence) {
+  // The sender and the receiver have different page sizes.
+  AttentionKVCache prefill_cache = CreateKVCache<4>(256);
+  AttentionKVCache decode_cache = CreateKVCache<8>(256);
+  int32_t num_total_pages = decode_cache->GetNumAvailablePages();
+  std::mt19937 rng(0);
+  prefill_cache->AddSequence(0);
+  decode_cache->AddSequence(5);
+  decode_cache->AddSequence(1);
+  Forward(decode_cache, {1}, {10}, &rng);
+  int64_t decode_length = 10;
+
+  // The second transfer starts in the middle of a page on both sides.
+  int64_t length = 0;
+  for (int64_t append_length : {13, 42}) {
+    Forward(prefill_cache, {0}, {append_length}, &rng);
+    auto [recver, sender] = CreateTransportPair(GetParam());
+    decode_cache->DisaggStartRecv(5, recver);
+    EXPECT_THROW(decode_cache->RemoveSequence(5), Error);
+    int64_t nbytes = 0;
+    std::thread send_thread(
+        [&, sender = sender]() { nbytes = prefill_cache->DisaggSendSequence(0, length, sender); });
+    // Sequence 1 keeps decoding while the KV data of sequence 5 is received.
+    while (!decode_cache->DisaggPollRecv(5)) {
+      Forward(decode_cache, {1}, {1}, &rng);
+      ++decode_length;
+    }
+    send_thread.join();
+    EXPECT_GT(nbytes, 0);
+    length += append_length;
+    EXPECT_EQ(GetKV(decode_cache, 5, length), GetKV(prefill_cache, 0, length));
+  }
+  EXPECT_EQ(decode_cache->GetNumAvailablePages(),
+            num_total_pages - (decode_length + 7) / 8 - (length + 7) / 8);
+
+  // Both sides produce the same attention output when decoding further.
+  std::mt19937 rng_prefill(1);
+  std::mt19937 rng_decode(1);
+  std::vector<float> out_prefill = Forward(prefill_cache, {0}, {1}, &rng_prefill);
+  std::vector<float> out_decode = Forward(decode_cache, {5}, {1}, &rng_decode);
+  ASSERT_EQ(out_prefill.size(), out_decode.size());
+  for (size_t i = 0; i < out_prefill.size(); ++i) {
+    EXPECT_NEAR(out_prefill[i], out_decode[i], 1e-5);
+  }
+}
+
+TEST_P(KVTransferTest, RecvErrors) {
+  AttentionKVCache prefill_cache = CreateKVCache<4>(256);
+  AttentionKVCache decode_cache = CreateKVCache<8>(256);
+  std::mt19937 rng(0);
+  prefill_cache->AddSequence(0);
+  Forward(prefill_cache, {0}, {20}, &rng);
+  decode_cache->AddSequence(0);
+  Forward(decode_cache, {0}, {3}, &rng);
+  int32_t num_available_pages = decode_cache->GetNumAvailablePages();
+  std::vector<float> expected_kv = GetKV(decode_cache, 0, 3);
+
+  // The receiver does not hold the positions before the first one sent.
+  {
+    auto [recver, sender] = CreateTransportPair(GetParam());
+    decode_cache->DisaggStartRecv(0, recver);
+    std::thread send_thread([&, sender = sender]() {
+      // The send fails if the receiver closes the transport before all data is sent.
+      try {
+        prefill_cache->DisaggSendSequence(0, 8, sender);
+      } catch (const Error& e) {
+      }
+    });
+    bool failed = false;
+    while (!failed) {
+      try {
+        EXPECT_FALSE(decode_cache->DisaggPollRecv(0));
+      } catch (const Error& e) {
+        failed = true;
+      }
+    }
+    send_thread.join();
+  }
+  // The sender goes away in the middle of the transfer.
+  {
+    auto [recver, sender] = CreateTransportPair(GetParam());
+    decode_cache->DisaggStartRecv(0, recver);
+    uint64_t magic = 0;
+    sender->Send(&magic, sizeof(magic));
+    sender->Close();
+    EXPECT_THROW(
+        {
+          while (!decode_cache->DisaggPollRecv(0)) {
+          }
+        },
+        Error);
+  }
+  EXPECT_EQ(decode_cache->GetNumAvailablePages(), num_available_pages);
+  EXPECT_EQ(GetKV(decode_cache, 0, 3), expected_kv);
+  Forward(decode_cache, {0}, {1}, &rng);
+}
+
+INSTANTIATE_TEST_SUITE_P(KVTransfer, KVTransferTest, ::testing::Values("shm", "tcp"));
+
+#endif  // _WIN32
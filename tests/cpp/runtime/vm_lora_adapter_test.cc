@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _WIN32
+
+#include <gtest/gtest.h>
+#include <tvm/ffi/function.h>
+#include <tvm/runtime/int_tuple.h>
+#include <tvm/runtime/ndarray.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace tvm;
+using namespace tvm::runtime;
+
+namespace {
+
+NDArray RandomArray(std::vector<int64_t> shape, std::mt19937* rng) {
+  NDArray arr = NDArray::Empty(shape, DataType::Float(32), Device{kDLCPU, 0});
+  std::normal_distribution<float> normal;
+  float* data = static_cast<float*>(arr->data);
+  for (int64_t i = 0; i < arr.Shape().Product(); ++i) data[i] = normal(*rng);
+  return arr;
+}
+
+/*! \brief The LoRA branch of one token computed naively in double precision. */
+std::vector<double> Reference(const float* x, const float* a, const float* b, double scaling,
+                              int64_t in_features, int64_t out_features, int64_t rank) {
+  std::vector<double> hidden(rank, 0.0);
+  for (int64_t r = 0; r < rank; ++r) {
+    for (int64_t k = 0; k < in_features; ++k) hidden[r] += a[r * in_features + k] * x[k];
+  }
+  std::vector<double> out(out_features, 0.0);
+  for (int64_t o = 0; o < out_features; ++o) {
+    for (int64_t r = 0; r < rank; ++r) out[o] += b[o * rank + r] * hidden[r] * scaling;
+  }
+  return out;
+}
+
+struct Record {
+  std::string name;
+  std::vector<int64_t> shape;
+  std::vector<float> data;
+};
+
+/*! \brief Write an adapter in the ndarray cache format into a new directory. */
+std::string WriteAdapter(const std::vector<Record>& records) {
+  char dir_template[] = "/tmp/tvm_lora_adapter_XXXXXX";
+  std::string dir = mkdtemp(dir_template);
+  std::ofstream shard(dir + "/params_shard_0.bin", std::ios::binary);
+  std::string json_records;
+  int64_t offset = 0;
+  for (const Record& record : records) {
+    int64_t nbytes = record.data.size() * sizeof(float);
+    shard.write(reinterpret_cast<const char*>(record.data.data()), nbytes);
+    std::string shape;
+    for (int64_t d : record.shape) shape += (shape.empty() ? "" : ", ") + std::to_string(d);
+    json_records += std::string(json_records.empty() ? "" : ", ") + "{\"name\": \"" +
+                    record.name + "\", \"shape\": [" + shape +
+                    "], \"dtype\": \"float32\", \"format\": \"raw\", \"nbytes\": " +
+                    std::to_string(nbytes) + ", \"byteOffset\": " + std::to_string(offset) + "}";
+    offset += nbytes;
+  }
+  shard.close();
+  std::ofstream json(dir + "/ndarray-cache.json");
+  json << "{\"records\": [{\"dataPath\": \"params_shard_0.bin\", \"format\": \"raw-shard\", "
+       << "\"nbytes\": " << offset << ", \"records\": [" << json_records << "]}]}";
+  return dir;
+}
+
+void RemoveAdapter(const std::string& dir) {
+  std::remove((dir + "/params_shard_0.bin").c_str());
+  std::remove((dir + "/ndarray-cache.json").c_str());
+  rmdir(dir.c_str());
+}
+
+std::vector<float> RandomVector(int64_t size, std::mt19937* rng) {
+  std::normal_distribution<float> normal;
+  std::vector<float> result(size);
+  for (float& v : result) v = normal(*rng);
+  return result;
+}
+
+}  // namespace
+
+TEST(LoRAAdapter, SegmentedGEMMMatchesReference) {
+  constexpr int64_t kNumSlots = 5;
+  constexpr int64_t kRank = 8;
+  constexpr int64_t kIn = 40;
+  constexpr int64_t kOut = 24;
+  std::mt19937 rng(0);
+  NDArray x = RandomArray({3, 23, kIn}, &rng);
+  NDArray lora_a = RandomArray({kNumSlots, kRank, kIn}, &rng);
+  NDArray lora_b = RandomArray({kNumSlots, kOut, kRank}, &rng);
+  NDArray scaling = RandomArray({kNumSlots}, &rng);
+  int64_t num_tokens = 3 * 23;
+  NDArray adapter_ids = NDArray::Empty({num_tokens}, DataType::Int(32), Device{kDLCPU, 0});
+  int32_t* ids = static_cast<int32_t*>(adapter_ids->data);
+  for (int64_t i = 0; i < num_tokens; ++i) ids[i] = static_cast<int32_t>(rng() % kNumSlots) - 1;
+  NDArray out = NDArray::Empty({3, 23, kOut}, DataType::Float(32), Device{kDLCPU, 0});
+
+  const auto fgemm = ffi::Function::GetGlobal("vm.builtin.lora_segmented_gemm").value();
+  fgemm(x, lora_a, lora_b, scaling, adapter_ids, out);
+  const float* out_data = static_cast<const float*>(out->data);
+  for (int64_t i = 0; i < num_tokens; ++i) {
+    std::vector<double> expected(kOut, 0.0);
+    if (ids[i] >= 0) {
+      expected = Reference(static_cast<const float*>(x->data) + i * kIn,
+                           static_cast<const float*>(lora_a->data) + ids[i] * kRank * kIn,
+                           static_cast<const float*>(lora_b->data) + ids[i] * kOut * kRank,
+                           static_cast<const float*>(scaling->data)[ids[i]], kIn, kOut, kRank);
+    }
+    for (int64_t o = 0; o < kOut; ++o) {
+      EXPECT_NEAR(out_data[i * kOut + o], expected[o], 1e-3 * (1 + std::abs(expected[o])))
+          << "token " << i << " adapter " << ids[i];
+    }
+  }
+
+  ids[0] = kNumSlots;
+  EXPECT_THROW(fgemm(x, lora_a, lora_b, scaling, adapter_ids, out), Error);
+}
+
+TEST(LoRAAdapter, PoolHotLoad) {
+  constexpr int64_t kMaxRank = 8;
+  constexpr int64_t kIn = 16;
+  constexpr int64_t kOut = 12;
+  std::mt19937 rng(1);
+  const auto fcreate = ffi::Function::GetGlobal("vm.builtin.lora_adapter_pool_create").value();
+  const auto fload = ffi::Function::GetGlobal("vm.builtin.lora_adapter_pool_load").value();
+  const auto funload = ffi::Function::GetGlobal("vm.builtin.lora_adapter_pool_unload").value();
+  const auto fparams = ffi::Function::GetGlobal("vm.builtin.lora_adapter_pool_get_params").value();
+  const auto fids =
+      ffi::Function::GetGlobal("vm.builtin.lora_adapter_pool_token_adapter_ids").value();
+  const auto fgemm = ffi::Function::GetGlobal("vm.builtin.lora_segmented_gemm").value();
+
+  Any pool = fcreate(Array<String>{"q.weight", "v.weight"},
+                     Array<IntTuple>{IntTuple{kOut, kIn}, IntTuple{kOut, kIn}}, 2, kMaxRank,
+                     DLDataType(DataType::Float(32)), Device{kDLCPU, 0});
+  // Adapter "x" of rank 4 only covers q, adapter "y" of rank 8 covers q and v.
+  std::vector<float> x_a = RandomVector(4 * kIn, &rng);
+  std::vector<float> x_b = RandomVector(kOut * 4, &rng);
+  std::vector<float> y_a = RandomVector(8 * kIn, &rng);
+  std::vector<float> y_b = RandomVector(kOut * 8, &rng);
+  std::string x_dir =
+      WriteAdapter({{"q.weight.lora_a", {4, kIn}, x_a}, {"q.weight.lora_b", {kOut, 4}, x_b}});
+  std::string y_dir = WriteAdapter({{"q.weight.lora_a", {8, kIn}, y_a},
+                                    {"q.weight.lora_b", {kOut, 8}, y_b},
+                                    {"v.weight.lora_a", {8, kIn}, y_a},
+                                    {"v.weight.lora_b", {kOut, 8}, y_b}});
+  std::string bad_dir = WriteAdapter({{"k.weight.lora_a", {4, kIn}, x_a}});
+  std::string flat_dir =
+      WriteAdapter({{"q.weight.lora_a", {4 * kIn}, x_a}, {"q.weight.lora_b", {kOut, 4}, x_b}});
+
+  // The 1-D array is rejected before a slot is taken.
+  EXPECT_THROW(fload(pool, "flat", flat_dir, 8.0), Error);
+  EXPECT_EQ(fload(pool, "x", x_dir, 8.0).cast<int64_t>(), 0);
+  EXPECT_EQ(fload(pool, "y", y_dir, 16.0).cast<int64_t>(), 1);
+  EXPECT_THROW(fload(pool, "z", y_dir, 8.0), Error);
+  EXPECT_THROW(fload(pool, "x", bad_dir, 8.0), Error);
+
+  Array<NDArray> params = fparams(pool).cast<Array<NDArray>>();
+  ASSERT_EQ(params.size(), 5);
+  NDArray input = RandomArray({1, 3, kIn}, &rng);
+  NDArray ids = fids(pool, Array<String>{"y", "", "x"}, IntTuple{1, 1, 1}).cast<NDArray>();
+  NDArray out = NDArray::Empty({1, 3, kOut}, DataType::Float(32), Device{kDLCPU, 0});
+  const float* in_data = static_cast<const float*>(input->data);
+  const float* out_data = static_cast<const float*>(out->data);
+
+  fgemm(input, params[1], params[2], params[0], ids, out);
+  std::vector<double> expected_y = Reference(in_data, y_a.data(), y_b.data(), 2.0, kIn, kOut, 8);
+  std::vector<double> expected_x =
+      Reference(in_data + 2 * kIn, x_a.data(), x_b.data(), 2.0, kIn, kOut, 4);
+  for (int64_t o = 0; o < kOut; ++o) {
+    EXPECT_NEAR(out_data[o], expected_y[o], 1e-3 * (1 + std::abs(expected_y[o])));
+    EXPECT_EQ(out_data[kOut + o], 0.0f);
+    EXPECT_NEAR(out_data[2 * kOut + o], expected_x[o], 1e-3 * (1 + std::abs(expected_x[o])));
+  }
+  // Adapter "x" does not cover v, so its branch there is zero.
+  fgemm(input, params[3], params[4], params[0], ids, out);
+  for (int64_t o = 0; o < kOut; ++o) EXPECT_EQ(out_data[2 * kOut + o], 0.0f);
+
+  // Unloading frees the slot, and stale ids of the slot contribute nothing.
+  funload(pool, "y");
+  fgemm(input, params[1], params[2], params[0], ids, out);
+  for (int64_t o = 0; o < kOut; ++o) EXPECT_EQ(out_data[o], 0.0f);
+  EXPECT_THROW(fids(pool, Array<String>{"y"}, IntTuple{1}), Error);
+  // Hot-loading into the freed slot while "x" stays loaded.
+  EXPECT_EQ(fload(pool, "z", x_dir, 4.0).cast<int64_t>(), 1);
+
+  RemoveAdapter(x_dir);
+  RemoveAdapter(y_dir);
+  RemoveAdapter(bad_dir);
+}
+
+#endif  // _WIN32
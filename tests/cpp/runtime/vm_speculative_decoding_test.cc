@@ -0,0 +1,279 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../src/runtime/vm/speculative_decoding.h"
+
+using namespace tvm;
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+constexpr int64_t kVocabSize = 37;
+
+/*!
+ * \brief A KV cache which stores the token history of each sequence instead of K/V data,
+ * so that a model can read the whole context it attends to.
+ */
+class TokenHistoryCacheObj : public AttentionKVCacheObj {
+ public:
+  std::unordered_map<int64_t, std::vector<int32_t>> history;
+  IntTuple cur_seq_ids;
+  IntTuple cur_lengths;
+  std::vector<int64_t> cur_parent_ptr;
+  /*! \brief The uncommitted token trees and their parent pointers. */
+  std::unordered_map<int64_t, std::pair<std::vector<int32_t>, std::vector<int64_t>>> trees;
+
+  void Clear() final { history.clear(); }
+  void AddSequence(int64_t seq_id) final {
+    ASSERT_TRUE(history.emplace(seq_id, std::vector<int32_t>{}).second);
+  }
+  void RemoveSequence(int64_t seq_id) final {
+    ASSERT_EQ(history.erase(seq_id), 1);
+    trees.erase(seq_id);
+  }
+  void ForkSequence(int64_t parent_seq_id, int64_t child_seq_id, int64_t fork_pos) final {
+    ASSERT_EQ(fork_pos, -1);
+    ASSERT_TRUE(history.emplace(child_seq_id, history.at(parent_seq_id)).second);
+  }
+  void PopN(int64_t seq_id, int32_t n) final {
+    std::vector<int32_t>& tokens = history.at(seq_id);
+    ASSERT_LE(n, static_cast<int32_t>(tokens.size()));
+    tokens.resize(tokens.size() - n);
+  }
+  void BeginForward(const IntTuple& seq_ids, const IntTuple& append_lengths,
+                    const Optional<IntTuple>& token_tree_parent_ptr) final {
+    for (int64_t seq_id : seq_ids) {
+      CHECK(!trees.count(seq_id)) << "The token tree of sequence " << seq_id << " is uncommitted";
+    }
+    cur_seq_ids = seq_ids;
+    cur_lengths = append_lengths;
+    cur_parent_ptr.clear();
+    if (token_tree_parent_ptr.defined()) {
+      cur_parent_ptr.assign(token_tree_parent_ptr.value().begin(),
+                            token_tree_parent_ptr.value().end());
+    }
+  }
+  void EndForward() final {}
+
+  void CommitAcceptedTokenTreeNodes(const IntTuple& seq_ids, const IntTuple& leaf_indices) final {
+    for (size_t i = 0; i < seq_ids.size(); ++i) {
+      auto& [tokens, parents] = trees.at(seq_ids[i]);
+      std::vector<int32_t> path;
+      for (int64_t node = leaf_indices[i]; node != -1; node = parents[node]) {
+        path.push_back(tokens[node]);
+      }
+      std::vector<int32_t>& seq_history = history.at(seq_ids[i]);
+      seq_history.insert(seq_history.end(), path.rbegin(), path.rend());
+      trees.erase(seq_ids[i]);
+    }
+  }
+
+  bool Empty() const final { return history.empty(); }
+  int32_t GetNumAvailablePages() const final { return 0; }
+  int32_t GetTotalSequenceLength() const final { return 0; }
+  void EnableSlidingWindowForSeq(int64_t, int32_t, int32_t) final { LOG(FATAL) << "unused"; }
+  IntTuple DisaggPrepareRecv(int64_t, int) final { LOG(FATAL) << "unused"; }
+  void DisaggMarkSend(int64_t, int64_t, const IntTuple&, int32_t) final { LOG(FATAL) << "unused"; }
+  int64_t DisaggSendSequence(int64_t, int64_t, KVTransport) final { LOG(FATAL) << "unused"; }
+  void DisaggStartRecv(int64_t, KVTransport) final { LOG(FATAL) << "unused"; }
+  bool DisaggPollRecv(int64_t) final { LOG(FATAL) << "unused"; }
+  int64_t SaveSequence(int64_t, const String&, bool) final { LOG(FATAL) << "unused"; }
+  int64_t RestoreSequence(int64_t, const String&) final { LOG(FATAL) << "unused"; }
+  void AttentionWithFusedQKV(int64_t, NDArray, Optional<NDArray>, NDArray, double) final {
+    LOG(FATAL) << "unused";
+  }
+  void SelfAttention(int64_t, NDArray, NDArray, NDArray, NDArray, NDArray, double) final {
+    LOG(FATAL) << "unused";
+  }
+  void CrossAttention(int64_t, NDArray, NDArray, NDArray, double) final { LOG(FATAL) << "unused"; }
+  void AppendMLAKV(int64_t, NDArray) final { LOG(FATAL) << "unused"; }
+  Array<NDArray> MergeAttnOutputInplace(NDArray, NDArray, NDArray, NDArray) final {
+    LOG(FATAL) << "unused";
+  }
+  void LinearAttention(int64_t, NDArray, NDArray, NDArray, double) final { LOG(FATAL) << "unused"; }
+  NDArray GetQueryPositions() final { LOG(FATAL) << "unused"; }
+  void DebugGetKV(int64_t, int64_t, int64_t, NDArray, NDArray) final { LOG(FATAL) << "unused"; }
+  void DebugGetKVMLA(int64_t, int64_t, int64_t, NDArray) final { LOG(FATAL) << "unused"; }
+  void DebugSetKV(int64_t, int64_t, NDArray, NDArray) final { LOG(FATAL) << "unused"; }
+
+  static constexpr const char* _type_key = "test.TokenHistoryCache";
+  TVM_DECLARE_FINAL_OBJECT_INFO(TokenHistoryCacheObj, AttentionKVCacheObj);
+};
+
+/*! \brief The next token of the target model, a function of the last two tokens. */
+int32_t TargetNextToken(const std::vector<int32_t>& context) {
+  int32_t last = context.back();
+  int32_t second_last = context.size() > 1 ? context[context.size() - 2] : 0;
+  return (3 * last + 2 * second_last + 1) % kVocabSize;
+}
+
+/*! \brief The draft model agrees with the target unless the last token is a multiple of 4. */
+int32_t DraftNextToken(const std::vector<int32_t>& context) {
+  int32_t next = TargetNextToken(context);
+  return context.back() % 4 == 0 ? (next + 1) % kVocabSize : next;
+}
+
+/*!
+ * \brief A model which reads the contexts from the token history cache and scores each
+ * token by its distance to the predicted next token, so that the runner-up tokens are
+ * the neighbours of the prediction.
+ */
+ffi::Function MakeModel(int32_t (*next_token)(const std::vector<int32_t>&)) {
+  return ffi::Function::FromTyped([next_token](NDArray token_ids, KVState state) {
+    auto* cache = const_cast<TokenHistoryCacheObj*>(state.as<TokenHistoryCacheObj>());
+    const int32_t* tokens = static_cast<const int32_t*>(token_ids->data);
+    int64_t num_tokens = token_ids->shape[0];
+    NDArray logits =
+        NDArray::Empty({num_tokens, kVocabSize}, DataType::Float(32), Device{kDLCPU, 0});
+    float* out = static_cast<float*>(logits->data);
+    int64_t offset = 0;
+    for (size_t i = 0; i < cache->cur_seq_ids.size(); ++i) {
+      int64_t seq_id = cache->cur_seq_ids[i];
+      int64_t length = cache->cur_lengths[i];
+      std::vector<int32_t>& seq_history = cache->history.at(seq_id);
+      std::vector<int64_t> parents(length);
+      for (int64_t j = 0; j < length; ++j) {
+        parents[j] = cache->cur_parent_ptr.empty() ? j - 1 : cache->cur_parent_ptr[offset + j];
+      }
+      for (int64_t j = 0; j < length; ++j) {
+        std::vector<int32_t> path;
+        for (int64_t node = j; node != -1; node = parents[node]) {
+          path.push_back(tokens[offset + node]);
+        }
+        std::vector<int32_t> context = seq_history;
+        context.insert(context.end(), path.rbegin(), path.rend());
+        int32_t next = next_token(context);
+        for (int64_t v = 0; v < kVocabSize; ++v) {
+          out[(offset + j) * kVocabSize + v] = -static_cast<float>(std::abs(v - next));
+        }
+      }
+      std::vector<int32_t> appended(tokens + offset, tokens + offset + length);
+      if (cache->cur_parent_ptr.empty()) {
+        seq_history.insert(seq_history.end(), appended.begin(), appended.end());
+      } else {
+        cache->trees[seq_id] = {appended, parents};
+      }
+      offset += length;
+    }
+    return logits;
+  });
+}
+
+/*! \brief Greedy decoding of the target model. */
+std::vector<int32_t> GreedyDecode(std::vector<int32_t> context, int64_t num_tokens) {
+  std::vector<int32_t> generated;
+  for (int64_t i = 0; i < num_tokens; ++i) {
+    generated.push_back(TargetNextToken(context));
+    context.push_back(generated.back());
+  }
+  return generated;
+}
+
+/*!
+ * \brief Decode two sequences speculatively and compare with greedy decoding.
+ * \return The acceptance rate.
+ */
+double RunSpeculativeDecoding(bool draft_is_target, int64_t width, int64_t depth) {
+  auto draft_cache = make_object<TokenHistoryCacheObj>();
+  auto target_cache = make_object<TokenHistoryCacheObj>();
+  SpeculativeDecoder decoder(make_object<SpeculativeDecoderObj>(
+      MakeModel(draft_is_target ? TargetNextToken : DraftNextToken), KVState(draft_cache),
+      Array<Any>{}, MakeModel(TargetNextToken), KVState(target_cache), Array<Any>{}, width,
+      depth));
+  std::vector<std::vector<int32_t>> prompts = {{5, 9, 2}, {11}};
+  std::vector<std::vector<int32_t>> generated(prompts.size());
+  for (size_t i = 0; i < prompts.size(); ++i) {
+    generated[i].push_back(static_cast<int32_t>(
+        decoder->AddSequence(i, IntTuple(std::vector<int64_t>(prompts[i].begin(),
+                                                              prompts[i].end())))));
+  }
+  for (int step = 0; step < 20; ++step) {
+    Array<IntTuple> new_tokens = decoder->Step(IntTuple({0, 1}));
+    for (size_t i = 0; i < prompts.size(); ++i) {
+      EXPECT_GE(new_tokens[i].size(), 1);
+      EXPECT_LE(new_tokens[i].size(), depth + 1);
+      generated[i].insert(generated[i].end(), new_tokens[i].begin(), new_tokens[i].end());
+    }
+  }
+  for (size_t i = 0; i < prompts.size(); ++i) {
+    EXPECT_EQ(generated[i], GreedyDecode(prompts[i], generated[i].size()));
+    // The target cache holds the prompt and every generated token but the last one.
+    std::vector<int32_t> expected_history = prompts[i];
+    expected_history.insert(expected_history.end(), generated[i].begin(), generated[i].end() - 1);
+    EXPECT_EQ(target_cache->history.at(i), expected_history);
+    // The draft cache lags behind by at most the accepted tokens it has not seen yet.
+    std::vector<int32_t> draft_history = draft_cache->history.at(i);
+    EXPECT_GE(draft_history.size() + depth, expected_history.size());
+    expected_history.resize(std::min(expected_history.size(), draft_history.size()));
+    EXPECT_EQ(draft_history, expected_history);
+  }
+  // Only the user sequences are left in the draft cache.
+  EXPECT_EQ(draft_cache->history.size(), prompts.size());
+  Map<String, Any> stats = decoder->Stats();
+  EXPECT_EQ(stats["num_steps"].cast<int64_t>(), 20);
+  return stats["acceptance_rate"].cast<double>();
+}
+
+}  // namespace
+
+TEST(SpeculativeDecoder, ChainMatchesGreedy) {
+  EXPECT_EQ(RunSpeculativeDecoding(/*draft_is_target=*/true, 1, 4), 1.0);
+  double acceptance_rate = RunSpeculativeDecoding(/*draft_is_target=*/false, 1, 4);
+  EXPECT_GT(acceptance_rate, 0.0);
+  EXPECT_LT(acceptance_rate, 1.0);
+}
+
+TEST(SpeculativeDecoder, TreeMatchesGreedy) {
+  double chain_rate = RunSpeculativeDecoding(/*draft_is_target=*/false, 1, 3);
+  double tree_rate = RunSpeculativeDecoding(/*draft_is_target=*/false, 3, 3);
+  // The runner-up branches recover the first draft token when the draft model is off.
+  EXPECT_GT(tree_rate, chain_rate);
+  EXPECT_EQ(RunSpeculativeDecoding(/*draft_is_target=*/true, 2, 1), 1.0);
+}
+
+TEST(SpeculativeDecoder, FailedStepRemovesDraftForks) {
+  auto draft_cache = make_object<TokenHistoryCacheObj>();
+  auto target_cache = make_object<TokenHistoryCacheObj>();
+  // The target model prefills the prompt, then fails in the verification of the drafts.
+  ffi::Function target = MakeModel(TargetNextToken);
+  auto num_calls = std::make_shared<int>(0);
+  ffi::Function failing_target =
+      ffi::Function::FromTyped([target, num_calls](NDArray token_ids, KVState state) {
+        CHECK_EQ((*num_calls)++, 0) << "target forward failed";
+        return target(token_ids, state).cast<NDArray>();
+      });
+  SpeculativeDecoder decoder(make_object<SpeculativeDecoderObj>(
+      MakeModel(DraftNextToken), KVState(draft_cache), Array<Any>{}, failing_target,
+      KVState(target_cache), Array<Any>{}, /*tree_width=*/3, /*tree_depth=*/3));
+  decoder->AddSequence(0, IntTuple({5, 9, 2}));
+  EXPECT_THROW(decoder->Step(IntTuple({0})), Error);
+  // Only the user sequence is left in the draft cache.
+  EXPECT_EQ(draft_cache->history.size(), 1);
+  EXPECT_TRUE(draft_cache->history.count(0));
+}
@@ -15,6 +15,11 @@
 # specific language governing permissions and limitations
 # under the License.
 # pylint: disable=missing-module-docstring,missing-function-docstring,missing-class-docstring
+import numpy as np
+import pytest
+
+import tvm
+import tvm.testing
 from tvm import meta_schedule as ms
 from tvm import te
 from tvm.ir import assert_structural_equal
@@ -25,8 +30,10 @@ from tvm.meta_schedule.testing.space_generation import (
 )
 from tvm.script import tir as T
 from tvm.target import Target
-from tvm.tir.tensor_intrin.arm_cpu import DP4A_S8S8S32_INTRIN
+from tvm.tir.tensor_intrin import x86
+from tvm.tir.tensor_intrin.arm_cpu import ARM_MMLA_2x2x8_i8_SMMLA_INTRIN, DP4A_S8S8S32_INTRIN
 from tvm.tir.tensor_intrin.x86 import AVX512_DOT_16x4_INTRIN as AVX512_INTRIN
+from tvm.tir.tensor_intrin.x86 import AVXVNNI_DOT_8x4_INTRIN
 from tvm.tir.tensor_intrin.x86 import VNNI_DOT_16x4_INTRIN as VNNI_INTRIN
 
 
@@ -414,6 +421,126 @@ def test_dp4a_dense_no_tensorize_2():
     )
 
 
+def _int8_dense(lhs_dtype, rhs_dtype, out_dtype, layout_free=False):
+    X = te.placeholder((64, 128), name="X", dtype=lhs_dtype)
+    W = te.placeholder((64, 128), name="W", dtype=rhs_dtype)
+    ak = te.reduce_axis((0, 128), name="k")
+    compute = te.compute(
+        (64, 64),
+        lambda i, j: te.sum(X[i, ak].astype(out_dtype) * W[j, ak].astype(out_dtype), axis=ak),
+        name="compute",
+    )
+    func = te.create_prim_func([X, W, compute])
+    if layout_free:
+        func = func.with_attr("layout_free_buffers", [1])
+    return func
+
+
+def _tensorize_int8_dense(func, intrin, target):
+    """Tile the dense for the intrinsic, and tensorize it by the postprocs."""
+    ctx = ms.TuneContext(
+        mod=func,
+        target=Target(target),
+        space_generator=ms.space_generator.PostOrderApply(
+            sch_rules=[
+                ms.schedule_rule.MultiLevelTilingWithIntrin(
+                    intrin,
+                    structure="SSRSRS",
+                    tile_binds=None,
+                    max_innermost_factor=64,
+                    vector_load_lens=None,
+                    reuse_read=None,
+                    reuse_write=None,
+                ),
+            ],
+            postprocs=[
+                ms.postproc.RewriteReductionBlock(),
+                ms.postproc.RewriteTensorize(vectorize_init_loop=True),
+            ],
+            mutator_probs={},
+        ),
+        task_name="test",
+    )
+    (sch,) = ctx.generate_design_space()
+    assert "meta_schedule.auto_tensorize" in sch.mod.script()
+    packed = [
+        sch.get(block)
+        for block in sch.get_child_blocks(sch.get_block("root"))
+        if sch.get(block).name_hint.startswith("W_global")
+    ]
+    sch.enter_postproc()
+    for proc in ctx.space_generator.postprocs:
+        assert proc.apply(sch)
+    return sch, packed
+
+
+def _check_int8_dense(sch, lhs_dtype, rhs_dtype, target):
+    rng = np.random.default_rng(0)
+    x = rng.integers(0, 64, size=(64, 128)).astype(lhs_dtype)
+    w = rng.integers(-64, 64, size=(64, 128)).astype(rhs_dtype)
+    out = tvm.nd.array(np.zeros((64, 64), "int32"))
+    lib = tvm.compile(sch.mod, target=target)
+    lib(tvm.nd.array(x), tvm.nd.array(w), out)
+    tvm.testing.assert_allclose(out.numpy(), x.astype("int32") @ w.astype("int32").T)
+
+
+@pytest.mark.parametrize("layout_free", [True, False])
+@pytest.mark.parametrize("intrin,tile", [(VNNI_INTRIN, (16, 4)), (AVXVNNI_DOT_8x4_INTRIN, (8, 4))])
+def test_x86_dense_weight_packing(intrin, tile, layout_free):
+    """The row-major weight is packed into the contiguous tiles that the intrinsic loads."""
+    func = _int8_dense("uint8", "int8", "int32", layout_free)
+    _, packed = _tensorize_int8_dense(func, intrin, "llvm -mcpu=cascadelake")
+    assert len(packed) == 1
+    shape = [int(dim) for dim in packed[0].writes[0].buffer.shape]
+    assert shape == [64 // tile[0], 128 // tile[1], *tile]
+    # The packing of a layout-free weight is hoisted out of the kernel at compile time.
+    assert ("meta_schedule.layout_rewrite_preproc" in packed[0].annotations) == layout_free
+
+
+@pytest.mark.parametrize("layout_free", [True, False])
+def test_x86_dense_weight_packing_emulated(layout_free):
+    """Check the numerics of the packing on any CPU, with the descriptions as implementations."""
+    for name, desc in [
+        ("test_dot_16x4_emulated", x86.dot_product_16x4_u8i8i32_desc),
+        ("test_dot_8x4_emulated", x86.dot_product_8x4_u8i8i32_desc),
+    ]:
+        tvm.tir.TensorIntrin.register(name, desc, desc, override=True)
+        func = _int8_dense("uint8", "int8", "int32", layout_free)
+        sch, _ = _tensorize_int8_dense(func, name, "llvm")
+        _check_int8_dense(sch, "uint8", "int8", "llvm")
+
+
+@pytest.mark.parametrize(
+    "intrin,target,instr,requires",
+    [
+        (VNNI_INTRIN, "llvm -mcpu=cascadelake", "vpdpbusd", tvm.testing.requires_x86_vnni),
+        (
+            AVXVNNI_DOT_8x4_INTRIN,
+            "llvm -mcpu=alderlake",
+            "vpdpbusd",
+            tvm.testing.requires_x86_avxvnni,
+        ),
+    ],
+)
+def test_x86_dense_vnni(intrin, target, instr, requires):
+    func = _int8_dense("uint8", "int8", "int32", layout_free=True)
+    sch, _ = _tensorize_int8_dense(func, intrin, target)
+    assert instr in tvm.compile(sch.mod, target=target).get_source("asm")
+    if requires.run_time_check():
+        _check_int8_dense(sch, "uint8", "int8", target)
+
+
+def test_arm_dense_i8mm():
+    """The rows of the 2x8 tiles are loaded with their strides, without packing."""
+    target = "llvm -mtriple=aarch64-linux-gnu -mattr=+v8.6a,+i8mm"
+    func = _int8_dense("int8", "int8", "int32")
+    sch, packed = _tensorize_int8_dense(func, ARM_MMLA_2x2x8_i8_SMMLA_INTRIN, target)
+    assert not packed
+    assert "smmla" in tvm.compile(sch.mod, target=target).get_source("asm")
+    if tvm.testing.requires_arm_i8mm.run_time_check():
+        _check_int8_dense(sch, "int8", "int8", target)
+
+
 if __name__ == "__main__":
     test_x86_conv2d_nchwc()
     test_x86_conv2d_nchwc(AVX512_INTRIN, "llvm -mcpu=skylake-avx512 -num-cores=4")
@@ -337,5 +337,70 @@ def test_einsum_infer_struct_info_wrong_inputs():
         bb.normalize(relax.op.einsum(x1, subscripts="ijk"))
 
 
+def test_sparse_dense_infer_struct_info():
+    bb = relax.BlockBuilder()
+    vdev0 = VDevice("llvm")
+    m = tir.Var("m", "int64")
+    nnz = tir.Var("nnz", "int64")
+    x0 = relax.Var("x", R.Tensor((3, 32), "float32"))
+    x1 = relax.Var("x", R.Tensor((2, m, 32), "float32"))
+    x2 = relax.Var("x", R.Tensor("float32", ndim=2))
+    x3 = relax.Var("x", R.Tensor((3, 32), "float32", vdev0))
+    x4 = relax.Var("x", R.Tensor("float32"))
+    data = relax.Var("data", R.Tensor((nnz, 16, 4), "float32"))
+    indices = relax.Var("indices", R.Tensor((nnz,), "int32"))
+    indptr = relax.Var("indptr", R.Tensor((5,), "int32"))
+
+    _check_inference(
+        bb,
+        relax.op.sparse_dense(x0, data, indices, indptr),
+        relax.TensorStructInfo((3, 64), "float32"),
+    )
+    _check_inference(
+        bb,
+        relax.op.sparse_dense(x1, data, indices, indptr),
+        relax.TensorStructInfo((2, m, 64), "float32"),
+    )
+    _check_inference(
+        bb,
+        relax.op.sparse_dense(x2, data, indices, indptr),
+        relax.TensorStructInfo(dtype="float32", ndim=2),
+    )
+    _check_inference(
+        bb,
+        relax.op.sparse_dense(x3, data, indices, indptr),
+        relax.TensorStructInfo((3, 64), "float32", vdev0),
+    )
+    _check_inference(
+        bb,
+        relax.op.sparse_dense(x4, data, indices, indptr),
+        relax.TensorStructInfo(dtype="float32"),
+    )
+
+
+def test_sparse_dense_infer_struct_info_wrong_inputs():
+    bb = relax.BlockBuilder()
+    x0 = relax.Var("x", R.Tensor((3, 30), "float32"))
+    x1 = relax.Var("x", R.Tensor((3, 32), "float16"))
+    x2 = relax.Var("x", R.Tensor((), "float32"))
+    x3 = relax.Var("x", R.Tensor((3, 32), "float32"))
+    data0 = relax.Var("data", R.Tensor((10, 16, 4), "float32"))
+    data1 = relax.Var("data", R.Tensor((10, 16), "float32"))
+    indices0 = relax.Var("indices", R.Tensor((10,), "int32"))
+    indices1 = relax.Var("indices", R.Tensor((10,), "float32"))
+    indptr = relax.Var("indptr", R.Tensor((5,), "int32"))
+
+    with pytest.raises(TVMError):
+        bb.normalize(relax.op.sparse_dense(x0, data0, indices0, indptr))
+    with pytest.raises(TVMError):
+        bb.normalize(relax.op.sparse_dense(x1, data0, indices0, indptr))
+    with pytest.raises(TVMError):
+        bb.normalize(relax.op.sparse_dense(x2, data0, indices0, indptr))
+    with pytest.raises(TVMError):
+        bb.normalize(relax.op.sparse_dense(x3, data1, indices0, indptr))
+    with pytest.raises(TVMError):
+        bb.normalize(relax.op.sparse_dense(x3, data0, indices1, indptr))
+
+
 if __name__ == "__main__":
     tvm.testing.main()
@@ -16,6 +16,9 @@
 # under the License.
 import enum
 import itertools
+import pathlib
+import tempfile
+import time
 from typing import Dict, List, Optional, Tuple, Union
 
 import numpy as np
@@ -68,6 +71,8 @@ fcommit_accepted_token_tree_nodes = None
 fattention_with_fuse_qkv = None
 fis_empty = None
 fdebug_get_kv = None
+fsave_sequence = None
+frestore_sequence = None
 
 ftranspose_append = None
 fcopy_cache = None
@@ -88,7 +93,8 @@ fcompact_copy = None
 def set_global_func(head_dim, dtype):
     global fclear, fadd_sequence, fremove_sequence, ffork_sequence, fenable_sliding_window_for_seq
     global fpopn, fbegin_forward, fend_forward, fcommit_accepted_token_tree_nodes
-    global fattention_with_fuse_qkv, fis_empty, fdebug_get_kv
+    global fattention_with_fuse_qkv, fis_empty, fdebug_get_kv, fsave_sequence, frestore_sequence
+    global fdisagg_send_sequence, fdisagg_start_recv, fdisagg_poll_recv
     global ftranspose_append, fcopy_cache, fattn_prefill, fattn_decode
     global fattn_prefill_ragged, fattn_prefill_with_tree_mask, fattn_prefill_with_tree_mask_paged_kv_cache
     global fattn_prefill_sliding_window, fattn_decode_sliding_window
@@ -112,6 +118,11 @@ def set_global_func(head_dim, dtype):
     )
     fis_empty = tvm.get_global_func("vm.builtin.attention_kv_cache_empty")
     fdebug_get_kv = tvm.get_global_func("vm.builtin.attention_kv_cache_debug_get_kv")
+    fsave_sequence = tvm.get_global_func("vm.builtin.attention_kv_cache_save_sequence")
+    frestore_sequence = tvm.get_global_func("vm.builtin.attention_kv_cache_restore_sequence")
+    fdisagg_send_sequence = tvm.get_global_func("vm.builtin.kv_cache_disagg_send_sequence")
+    fdisagg_start_recv = tvm.get_global_func("vm.builtin.kv_cache_disagg_start_recv")
+    fdisagg_poll_recv = tvm.get_global_func("vm.builtin.kv_cache_disagg_poll_recv")
 
     target = tvm.target.Target.from_device(device)
     builts = []
@@ -750,6 +761,127 @@ def test_paged_attention_kv_cache_popn(kv_cache_and_config):
     assert fis_empty(kv_cache), "The KV cache is not empty after removing all sequences"
 
 
+def test_paged_attention_kv_cache_save_restore(kv_cache_and_config, tmp_path):
+    kv_cache, rope_mode, support_sliding_window = kv_cache_and_config
+    if support_sliding_window and rope_mode == RopeMode.NORMAL:
+        return
+    fclear(kv_cache)
+
+    cached_k = {}
+    cached_v = {}
+    apply_attention(kv_cache, rope_mode, [(0, 35), (1, 20)], cached_k, cached_v)
+    apply_attention(kv_cache, rope_mode, [((2, 0, 21), 17)], cached_k, cached_v)
+    apply_attention(kv_cache, rope_mode, [(0, 1), (2, 1)], cached_k, cached_v)
+
+    # Evict sequences to files, restore them and keep decoding.
+    for seq_id, compress in [(0, False), (2, True)]:
+        path = str(tmp_path / f"seq_{seq_id}.bin")
+        assert fsave_sequence(kv_cache, seq_id, path, compress) > 0
+        fremove_sequence(kv_cache, seq_id)
+        assert frestore_sequence(kv_cache, seq_id, path) == cached_k[seq_id].shape[1]
+    verify_cached_kv(kv_cache, [0, 1, 2], cached_k, cached_v)
+    operation_seq = [[(0, 1), (1, 1), (2, 1)], [(2, 9), (0, 3)], [(0, 1), (2, 1)]]
+    for batch in operation_seq:
+        apply_attention(kv_cache, rope_mode, batch, cached_k, cached_v)
+
+    for seq_id in range(3):
+        fremove_sequence(kv_cache, seq_id)
+    assert fis_empty(kv_cache), "The KV cache is not empty after removing all sequences"
+
+
+def test_paged_attention_kv_cache_restore_between_decode_steps(kv_cache_and_config, tmp_path):
+    kv_cache, rope_mode, support_sliding_window = kv_cache_and_config
+    if support_sliding_window and rope_mode == RopeMode.NORMAL:
+        return
+    fclear(kv_cache)
+
+    cached_k = {}
+    cached_v = {}
+    apply_attention(kv_cache, rope_mode, [(0, 20), (1, 20), (2, 5), (3, 5)], cached_k, cached_v)
+    path_3 = str(tmp_path / "seq_3.bin")
+    fsave_sequence(kv_cache, 3, path_3, False)
+    fremove_sequence(kv_cache, 3)
+    decode_batch = [(0, 1), (1, 1)]
+    for _ in range(2):
+        apply_attention(kv_cache, rope_mode, list(decode_batch), cached_k, cached_v)
+
+    # Between two decode steps, sequence 0 is restored into its old block, with a reused
+    # first page and its old first page given to sequence 3. The next decode step must
+    # not keep the page table of the last one.
+    path_0 = str(tmp_path / "seq_0.bin")
+    fsave_sequence(kv_cache, 0, path_0, False)
+    fremove_sequence(kv_cache, 0)
+    fremove_sequence(kv_cache, 2)
+    del cached_k[2], cached_v[2]
+    fadd_sequence(kv_cache, 2)
+    cached_k[2] = np.zeros((num_layers, 0, num_kv_heads, head_dim), dtype)
+    cached_v[2] = np.zeros((num_layers, 0, num_kv_heads, head_dim), dtype)
+    frestore_sequence(kv_cache, 0, path_0)
+    frestore_sequence(kv_cache, 3, path_3)
+    for _ in range(2):
+        apply_attention(kv_cache, rope_mode, list(decode_batch), cached_k, cached_v)
+    verify_cached_kv(kv_cache, [0, 1, 3], cached_k, cached_v)
+
+    for seq_id in range(4):
+        fremove_sequence(kv_cache, seq_id)
+    assert fis_empty(kv_cache), "The KV cache is not empty after removing all sequences"
+
+
+def test_paged_attention_kv_cache_disagg_transfer(kv_cache_and_config):
+    kv_cache, rope_mode, support_sliding_window = kv_cache_and_config
+    if support_sliding_window and rope_mode == RopeMode.NORMAL:
+        return
+    fclear(kv_cache)
+    decode_kv_cache = create_kv_cache(head_dim, dtype, rope_mode, support_sliding_window)
+
+    cached_k = {}
+    cached_v = {}
+    apply_attention(kv_cache, rope_mode, [(0, 35)], cached_k, cached_v)
+    fadd_sequence(decode_kv_cache, 0)
+    recver = tvm.get_global_func("vm.builtin.kv_transport_tcp_listen")("127.0.0.1", 0)
+    port = tvm.get_global_func("vm.builtin.kv_transport_tcp_port")(recver)
+    sender = tvm.get_global_func("vm.builtin.kv_transport_tcp_connect")("127.0.0.1", port)
+    fdisagg_start_recv(decode_kv_cache, 0, recver)
+    assert fdisagg_send_sequence(kv_cache, 0, 0, sender) > 0
+    deadline = time.monotonic() + 60
+    while not fdisagg_poll_recv(decode_kv_cache, 0):
+        assert time.monotonic() < deadline, "The KV data of sequence 0 was not received in 60s"
+        time.sleep(0.001)
+    verify_cached_kv(decode_kv_cache, [0], cached_k, cached_v)
+
+    # The received sequence keeps decoding on the decode side.
+    apply_attention(decode_kv_cache, rope_mode, [(0, 1)], cached_k, cached_v)
+    apply_attention(decode_kv_cache, rope_mode, [(0, 7)], cached_k, cached_v)
+
+
+def test_paged_attention_kv_cache_steady_decode(kv_cache_and_config):
+    kv_cache, rope_mode, support_sliding_window = kv_cache_and_config
+    if support_sliding_window and rope_mode == RopeMode.NORMAL:
+        return
+    fclear(kv_cache)
+
+    cached_k = {}
+    cached_v = {}
+    # Prefill sequences ending right before, at and after page boundaries.
+    apply_attention(kv_cache, rope_mode, [(0, 15), (1, 16), (2, 17), (3, 31)], cached_k, cached_v)
+    # Repeated decode steps of the same batch patch the metadata incrementally,
+    # including the steps where sequences get new pages.
+    decode_batch = [(0, 1), (1, 1), (2, 1), (3, 1)]
+    for _ in range(20):
+        apply_attention(kv_cache, rope_mode, list(decode_batch), cached_k, cached_v)
+    # Popping tokens between decode steps falls back to the full metadata update.
+    fpopn(kv_cache, 1, 3)
+    cached_k[1] = cached_k[1][:, :-3, ...]
+    cached_v[1] = cached_v[1][:, :-3, ...]
+    for _ in range(5):
+        apply_attention(kv_cache, rope_mode, list(decode_batch), cached_k, cached_v)
+    # So does a batch with a different composition.
+    for _ in range(5):
+        apply_attention(kv_cache, rope_mode, [(2, 1), (0, 1), (3, 1)], cached_k, cached_v)
+    for _ in range(5):
+        apply_attention(kv_cache, rope_mode, list(decode_batch), cached_k, cached_v)
+
+
 def test_paged_attention_kv_cache_sliding_window(kv_cache_and_config):
     kv_cache, rope_mode, support_sliding_window = kv_cache_and_config
     if not support_sliding_window or rope_mode == RopeMode.NORMAL:
@@ -961,6 +1093,13 @@ if __name__ == "__main__":
         test_paged_attention_kv_cache_remove_sequence(cache_and_config)
         test_paged_attention_kv_cache_fork_sequence(cache_and_config)
         test_paged_attention_kv_cache_popn(cache_and_config)
+        test_paged_attention_kv_cache_steady_decode(cache_and_config)
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            test_paged_attention_kv_cache_save_restore(cache_and_config, pathlib.Path(tmp_dir))
+            test_paged_attention_kv_cache_restore_between_decode_steps(
+                cache_and_config, pathlib.Path(tmp_dir)
+            )
+        test_paged_attention_kv_cache_disagg_transfer(cache_and_config)
         test_paged_attention_kv_cache_sliding_window(cache_and_config)
         test_paged_attention_kv_cache_tree_attn(cache_and_config)
         test_paged_attention_kv_cache_unlimited_depth(cache_and_config)
@@ -179,6 +179,42 @@ def test_rnn_state_fork_sequence(rnn_state):  # pylint: disable=redefined-outer-
     verify_state(state, [0, 1], [[np_two, np_three], [np_zero, np_one]])
 
 
+@tvm.testing.requires_cuda
+def test_rnn_state_fork_without_copy(rnn_state):  # pylint: disable=redefined-outer-name
+    state = rnn_state
+    f_clear(state)
+
+    f_add_sequence(state, 0)
+    f_begin_forward(state, ShapeTuple([0]), ShapeTuple([1]))
+    f_set(state, 0, 0, tvm.nd.array(np_two.reshape(1, 16, 16), device=device))
+    f_set(state, 0, 1, tvm.nd.array(np_three.reshape(1, 32, 32), device=device))
+    f_end_forward(state)
+    # Forks share the state storage, so there can be more branches than reserved sequences.
+    num_branches = reserved_nseq + 2
+    for seq_id in range(1, num_branches):
+        f_fork_sequence(state, 0, seq_id, -1)
+    verify_state(state, range(num_branches), [[np_two, np_three]] * num_branches)
+
+    # Diverge two branches, the others keep the shared state.
+    np_four = np.full((16, 16), 4.0, "float16")
+    np_five = np.full((32, 32), 5.0, "float32")
+    f_begin_forward(state, ShapeTuple([0, 1]), ShapeTuple([1, 1]))
+    f_set(state, 0, 0, tvm.nd.array(np.stack([np_four, np_zero]), device=device))
+    f_set(state, 0, 1, tvm.nd.array(np.stack([np_five, np_one]), device=device))
+    f_end_forward(state)
+    expected_values = [[np_two, np_three]] * num_branches
+    expected_values[0] = [np_four, np_five]
+    expected_values[1] = [np_zero, np_one]
+    verify_state(state, range(num_branches), expected_values)
+
+    # Roll back both branches to the forked state.
+    f_popn(state, 0, 1)
+    f_popn(state, 1, 1)
+    verify_state(state, range(num_branches), [[np_two, np_three]] * num_branches)
+    for seq_id in range(num_branches):
+        f_remove_sequence(state, seq_id)
+
+
 def rnn_state_get(
     shape: Sequence[int],
     dtype: str,
@@ -260,3 +296,4 @@ if __name__ == "__main__":
     test_rnn_state_set(rnn_state)
     test_rnn_state_popn(rnn_state)
     test_rnn_state_fork_sequence(rnn_state)
+    test_rnn_state_fork_without_copy(rnn_state)
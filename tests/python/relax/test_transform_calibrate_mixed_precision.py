@@ -0,0 +1,76 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import pytest
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.relax.transform import CalibrateMixedPrecision
+from tvm.script import ir as I
+from tvm.script import relax as R
+
+
+@I.ir_module
+class Module:
+    @R.function
+    def main(x: R.Tensor((8, 16), "float32"), w: R.Tensor((16, 16), "float32")):
+        with R.dataflow():
+            h = R.matmul(x, w)
+            # Adding and subtracting a large constant loses the precision of `h` in the
+            # low precision dtypes.
+            s = R.add(h, R.const(4096, "float32"))
+            o = R.subtract(s, R.const(4096, "float32"))
+            R.output(o)
+        return o
+
+
+def _inputs():
+    rng = np.random.default_rng(0)
+    x = rng.standard_normal((8, 16)).astype("float32")
+    w = (rng.standard_normal((16, 16)) / 4).astype("float32")
+    return [x, w]
+
+
+def _run(mod, inputs):
+    vm = relax.VirtualMachine(tvm.compile(mod, "llvm"), tvm.cpu())
+    return vm["main"](*[tvm.nd.array(x) for x in inputs]).numpy()
+
+
+@pytest.mark.parametrize("low_dtype", ["bfloat16", "float16"])
+def test_sensitive_ops_kept_in_float32(low_dtype):
+    inputs = _inputs()
+    calibrate = CalibrateMixedPrecision(inputs, low_dtype=low_dtype, error_budget=0.05)
+    mod = calibrate(Module)
+    assert calibrate.op_dtypes == {"h": low_dtype, "s": "float32", "o": "float32"}
+    assert calibrate.op_errors["h"] < 0.05
+    assert calibrate.op_errors["s"] > 0.05 and calibrate.op_errors["o"] > 0.05
+    assert calibrate.error <= 0.05
+
+    expected = _run(Module, inputs)
+    np.testing.assert_allclose(_run(mod, inputs), expected, rtol=0.05, atol=0.05)
+
+
+def test_zero_budget_keeps_float32():
+    calibrate = CalibrateMixedPrecision(_inputs(), error_budget=0.0)
+    mod = calibrate(Module)
+    assert set(calibrate.op_dtypes.values()) == {"float32"}
+    tvm.ir.assert_structural_equal(mod, Module)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
@@ -0,0 +1,112 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+# pylint: disable=invalid-name, missing-docstring
+
+import numpy as np
+import pytest
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.relax.transform.convert_dense_to_bsr import dense_to_bsr
+from tvm.script import ir as I
+from tvm.script import relax as R
+
+
+def _block_sparse(shape, block_size, sparsity, seed=0):
+    rng = np.random.default_rng(seed)
+    bs_r, bs_c = block_size
+    mask = rng.random((shape[0] // bs_r, shape[1] // bs_c)) >= sparsity
+    mask = np.repeat(np.repeat(mask, bs_r, axis=0), bs_c, axis=1)
+    return (rng.standard_normal(shape) * mask).astype("float32")
+
+
+def test_dense_to_bsr():
+    weight = _block_sparse((32, 24), (8, 4), 0.6)
+    data, indices, indptr = dense_to_bsr(weight, (8, 4))
+    assert data.shape[1:] == (8, 4)
+    assert indices.dtype == "int32" and indptr.dtype == "int32"
+    assert indptr[-1] == data.shape[0] == indices.shape[0]
+    dense = np.zeros_like(weight)
+    for row in range(indptr.shape[0] - 1):
+        for block in range(indptr[row], indptr[row + 1]):
+            col = indices[block]
+            dense[row * 8 : row * 8 + 8, col * 4 : col * 4 + 4] = data[block]
+    np.testing.assert_array_equal(dense, weight)
+
+
+def _linear_module(weight_shape, transposed):
+    x = relax.Var("x", relax.TensorStructInfo((2, 5, 32), "float32"))
+    w = relax.Var("w", relax.TensorStructInfo(weight_shape, "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x, w]):
+        with bb.dataflow():
+            rhs = bb.emit(relax.op.permute_dims(w)) if transposed else w
+            out = bb.emit_output(relax.op.matmul(x, rhs))
+        bb.emit_func_output(out)
+    return bb.get()
+
+
+@pytest.mark.parametrize("transposed", [True, False])
+def test_convert_dense_to_bsr(transposed):
+    weight = _block_sparse((48, 32), (16, 1), 0.8)
+    if not transposed:
+        weight = weight.T.copy()
+    mod = _linear_module(weight.shape, transposed)
+    mod = relax.transform.BindParams("main", {"w": weight})(mod)
+    after = relax.transform.ConvertDenseToBSR((16, 1), 0.7)(mod)
+    calls = [
+        binding.value.op.name
+        for binding in after["main"].body.blocks[0].bindings
+        if isinstance(binding.value, relax.Call)
+    ]
+    assert "relax.sparse_dense" in calls and "relax.matmul" not in calls
+
+    x = np.random.default_rng(1).standard_normal((2, 5, 32)).astype("float32")
+    expected = x @ weight.T if transposed else x @ weight
+    ex = tvm.compile(after, "llvm")
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    tvm.testing.assert_allclose(vm["main"](tvm.nd.array(x)).numpy(), expected, rtol=1e-5, atol=1e-5)
+
+
+def test_convert_dense_to_bsr_below_threshold():
+    weight = _block_sparse((48, 32), (16, 1), 0.3)
+    mod = _linear_module(weight.shape, transposed=True)
+    mod = relax.transform.BindParams("main", {"w": weight})(mod)
+    after = relax.transform.ConvertDenseToBSR((16, 1), 0.7)(mod)
+    tvm.ir.assert_structural_equal(after, mod)
+
+
+def test_convert_dense_to_bsr_skip_non_constant():
+    @I.ir_module
+    class Before:
+        @R.function
+        def main(
+            x: R.Tensor((2, 32), "float32"), w: R.Tensor((48, 32), "float32")
+        ) -> R.Tensor((2, 48), "float32"):
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                y = R.matmul(x, wT)
+                R.output(y)
+            return y
+
+    after = relax.transform.ConvertDenseToBSR()(Before)
+    tvm.ir.assert_structural_equal(after, Before)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
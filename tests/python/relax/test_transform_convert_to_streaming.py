@@ -0,0 +1,78 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import pytest
+
+import tvm
+import tvm.testing
+from tvm import relax
+
+
+def _build(seq_len, conv_padding=(4, 0)):
+    rng = np.random.default_rng(0)
+
+    def weight(*shape):
+        return relax.const(rng.standard_normal(shape).astype("float32"))
+
+    x = relax.Var("x", relax.TensorStructInfo((1, 4, seq_len), "float32"))
+    bb = relax.BlockBuilder()
+    with bb.function("main", [x]):
+        with bb.dataflow():
+            h = bb.emit(relax.op.nn.pad(x, [0, 0, 0, 0, 2, 0]))
+            h = bb.emit(relax.op.nn.conv1d(h, weight(8, 4, 3)))
+            h = bb.emit(relax.op.nn.relu(relax.op.add(h, weight(8, 1))))
+            conv = relax.op.nn.conv1d(
+                h, weight(8, 2, 3), padding=conv_padding, dilation=2, groups=4
+            )
+            h = bb.emit(relax.op.add(h, conv))
+            h = bb.emit(relax.op.nn.max_pool1d(h, pool_size=4, strides=2, padding=(2, 0)))
+            h = bb.emit(
+                relax.op.nn.avg_pool1d(h, pool_size=3, padding=(2, 0), count_include_pad=True)
+            )
+            gv = bb.emit_output(h)
+        bb.emit_func_output(gv)
+    return bb.get()
+
+
+@pytest.mark.parametrize("chunk_size", [2, 8, 64])
+def test_streaming_bit_exact(chunk_size):
+    mod = relax.transform.ConvertToStreaming("main", chunk_size)(_build(64))
+    # The states of the pad and conv, the dilated conv, the max pool and the avg pool.
+    assert len(mod["main_stream"].params) == 5
+    assert len(mod["main_stream_init"].struct_info.ret.fields) == 4
+
+    vm = relax.VirtualMachine(tvm.compile(mod, "llvm"), tvm.cpu())
+    x = np.random.default_rng(1).standard_normal((1, 4, 64)).astype("float32")
+    expected = vm["main"](tvm.nd.array(x)).numpy()
+    runner = relax.StreamingRunner(vm)
+    np.testing.assert_array_equal(runner.run(x, chunk_size), expected)
+    # The runner restarts the states for a new sequence.
+    np.testing.assert_array_equal(runner.run(x, chunk_size), expected)
+
+
+def test_chunk_not_multiple_of_stride():
+    with pytest.raises(tvm.TVMError):
+        relax.transform.ConvertToStreaming("main", 3)(_build(64))
+
+
+def test_non_causal_conv_not_streamed():
+    with pytest.raises(tvm.TVMError):
+        relax.transform.ConvertToStreaming("main", 8)(_build(64, conv_padding=(2, 2)))
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
@@ -0,0 +1,102 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+
+import tvm
+import tvm.testing
+from tvm import relax
+
+
+def _build(emit_body, shapes):
+    params = [
+        relax.Var(f"x{i}", relax.TensorStructInfo(shape, "float32"))
+        for i, shape in enumerate(shapes)
+    ]
+    bb = relax.BlockBuilder()
+    with bb.function("main", params):
+        with bb.dataflow():
+            gv = bb.emit_output(relax.Tuple(emit_body(bb, *params)))
+        bb.emit_func_output(gv)
+    return relax.transform.LegalizeOps()(bb.get())
+
+
+def _call_tir_funcs(mod):
+    return [
+        binding.value.args[0].name_hint
+        for binding in mod["main"].body.blocks[0].bindings
+        if isinstance(binding.value, relax.Call) and binding.value.op.name == "relax.call_tir"
+    ]
+
+
+def _check_numerics(before, after, shapes):
+    rng = np.random.default_rng(0)
+    inputs = [tvm.nd.array(rng.standard_normal(shape).astype("float32")) for shape in shapes]
+    outputs = []
+    for mod in [before, after]:
+        vm = relax.VirtualMachine(tvm.compile(mod, "llvm"), tvm.cpu())
+        outputs.append([out.numpy() for out in vm["main"](*inputs)])
+    for expected, actual in zip(*outputs):
+        tvm.testing.assert_allclose(actual, expected, rtol=1e-5, atol=1e-5)
+
+
+def test_fuse_independent_kernels():
+    shapes = [(1, 16, 32), (1, 16, 32), (1, 8, 64), (4, 64)]
+
+    def body(bb, a, b, x, y):
+        add = bb.emit(relax.op.add(a, b))
+        row_sum = bb.emit(relax.op.sum(x, axis=[2]))
+        full_sum = bb.emit(relax.op.sum(y))
+        exp = bb.emit(relax.op.exp(a))
+        return [add, row_sum, full_sum, exp]
+
+    before = _build(body, shapes)
+    after = relax.transform.HorizontalFuseTIR()(before)
+    assert _call_tir_funcs(after) == ["horizontal_fused"]
+    assert after["horizontal_fused"].attrs["tir.is_scheduled"]
+    _check_numerics(before, after, shapes)
+
+
+def test_dependent_kernels_not_fused_together():
+    shapes = [(1, 16, 32), (1, 16, 32), (1, 16, 32)]
+
+    def body(bb, a, b, c):
+        add = bb.emit(relax.op.add(a, b))
+        # Depends on `add`, so it runs after the fused call.
+        mul = bb.emit(relax.op.multiply(add, c))
+        exp = bb.emit(relax.op.exp(c))
+        relu = bb.emit(relax.op.nn.relu(mul))
+        return [relu, exp]
+
+    before = _build(body, shapes)
+    after = relax.transform.HorizontalFuseTIR()(before)
+    assert _call_tir_funcs(after) == ["horizontal_fused", "multiply", "relu"]
+    _check_numerics(before, after, shapes)
+
+
+def test_large_kernels_not_fused():
+    shapes = [(64, 64), (64, 64)]
+
+    def body(bb, a, b):
+        return [bb.emit(relax.op.add(a, b)), bb.emit(relax.op.exp(b))]
+
+    before = _build(body, shapes)
+    after = relax.transform.HorizontalFuseTIR(max_work=1024)(before)
+    assert _call_tir_funcs(after) == _call_tir_funcs(before)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
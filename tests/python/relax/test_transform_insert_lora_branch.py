@@ -0,0 +1,167 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+# pylint: disable=invalid-name, missing-docstring
+
+import pytest
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import ir as I
+from tvm.script import relax as R
+from tvm.script import tir as T
+
+
+def test_insert_lora_branch():
+    @I.ir_module
+    class Before:
+        @R.function
+        def main(
+            x: R.Tensor((2, 16), "float32"),
+            w: R.Tensor((8, 16), "float32"),
+            v: R.Tensor((8, 16), "float32"),
+        ) -> R.Tensor((2, 8), "float32"):
+            R.func_attr({"num_input": 1})
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                y = R.matmul(x, wT)
+                vT = R.permute_dims(v, [1, 0])
+                z = R.matmul(x, vT)
+                o = R.add(y, z)
+                R.output(o)
+            return o
+
+    @I.ir_module
+    class Expected:
+        @R.function
+        def main(
+            x: R.Tensor((2, 16), "float32"),
+            lora_adapter_ids: R.Tensor(("lora_num_tokens",), "int32"),
+            w: R.Tensor((8, 16), "float32"),
+            v: R.Tensor((8, 16), "float32"),
+            lora_scaling: R.Tensor((4,), "float32"),
+            w_lora_a: R.Tensor((4, 2, 16), "float32"),
+            w_lora_b: R.Tensor((4, 8, 2), "float32"),
+        ) -> R.Tensor((2, 8), "float32"):
+            R.func_attr({"num_input": 2})
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                lora_base = R.matmul(x, wT)
+                lora_delta = R.call_dps_packed(
+                    "vm.builtin.lora_segmented_gemm",
+                    (x, w_lora_a, w_lora_b, lora_scaling, lora_adapter_ids),
+                    out_sinfo=R.Tensor((2, 8), "float32"),
+                )
+                y = R.add(lora_base, lora_delta)
+                vT = R.permute_dims(v, [1, 0])
+                z = R.matmul(x, vT)
+                o = R.add(y, z)
+                R.output(o)
+            return o
+
+    After = relax.transform.InsertLoRABranch(["w"], num_slots=4, max_rank=2)(Before)
+    tvm.ir.assert_structural_equal(After, Expected)
+    param_names = [param.name_hint for param in After["main"].params]
+    assert param_names == [
+        "x",
+        "lora_adapter_ids",
+        "w",
+        "v",
+        "lora_scaling",
+        "w.lora_a",
+        "w.lora_b",
+    ]
+
+
+def test_insert_lora_branch_output_binding():
+    @I.ir_module
+    class Before:
+        @R.function
+        def main(
+            x: R.Tensor(("n", 16), "float32"), w: R.Tensor((8, 16), "float32")
+        ) -> R.Tensor(("n", 8), "float32"):
+            n = T.int64()
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                y = R.matmul(x, wT)
+                R.output(y)
+            return y
+
+    @I.ir_module
+    class Expected:
+        @R.function
+        def main(
+            x: R.Tensor(("n", 16), "float32"),
+            w: R.Tensor((8, 16), "float32"),
+            lora_adapter_ids: R.Tensor(("lora_num_tokens",), "int32"),
+            lora_scaling: R.Tensor((3,), "float32"),
+            w_lora_a: R.Tensor((3, 4, 16), "float32"),
+            w_lora_b: R.Tensor((3, 8, 4), "float32"),
+        ) -> R.Tensor(("n", 8), "float32"):
+            n = T.int64()
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                lora_base = R.matmul(x, wT)
+                lora_delta = R.call_dps_packed(
+                    "vm.builtin.lora_segmented_gemm",
+                    (x, w_lora_a, w_lora_b, lora_scaling, lora_adapter_ids),
+                    out_sinfo=R.Tensor((n, 8), "float32"),
+                )
+                y = R.add(lora_base, lora_delta)
+                R.output(y)
+            return y
+
+    After = relax.transform.InsertLoRABranch(["w"], num_slots=3, max_rank=4)(Before)
+    tvm.ir.assert_structural_equal(After, Expected)
+
+
+def test_insert_lora_branch_no_target():
+    @I.ir_module
+    class Module:
+        @R.function
+        def main(
+            x: R.Tensor((2, 16), "float32"), w: R.Tensor((8, 16), "float32")
+        ) -> R.Tensor((2, 8), "float32"):
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                y = R.matmul(x, wT)
+                R.output(y)
+            return y
+
+    After = relax.transform.InsertLoRABranch(["v"], num_slots=4, max_rank=2)(Module)
+    tvm.ir.assert_structural_equal(After, Module)
+
+
+def test_insert_lora_branch_non_float32_target():
+    @I.ir_module
+    class Module:
+        @R.function
+        def main(
+            x: R.Tensor((2, 16), "float16"), w: R.Tensor((8, 16), "float16")
+        ) -> R.Tensor((2, 8), "float16"):
+            with R.dataflow():
+                wT = R.permute_dims(w)
+                y = R.matmul(x, wT)
+                R.output(y)
+            return y
+
+    with pytest.raises(ValueError, match="must be float32"):
+        relax.transform.InsertLoRABranch(["w"], num_slots=4, max_rank=2)(Module)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
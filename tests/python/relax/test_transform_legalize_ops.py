@@ -437,5 +437,56 @@ def test_legalize_with_vdevice():
     tvm.ir.assert_structural_equal(Expected, After)
 
 
+def test_prim_func_cache():
+    @I.ir_module
+    class Layers:
+        @R.function
+        def main(
+            x: R.Tensor(("n", 16), "float32"),
+            w0: R.Tensor((16, 16), "float32"),
+            w1: R.Tensor((16, 16), "float32"),
+            w2: R.Tensor((16, 32), "float32"),
+        ):
+            with R.dataflow():
+                lv0 = R.nn.relu(R.matmul(x, w0))
+                lv1 = R.nn.relu(R.matmul(lv0, w1))
+                lv2 = R.add(lv1, lv0)
+                lv3 = R.sum(R.matmul(lv2, w2), axis=[1])
+                lv4 = R.sum(lv2, axis=[0])
+                gv = (lv3, lv4)
+                R.output(gv)
+            return gv
+
+    After = LegalizeOps()(Layers)
+    with tvm.transform.PassContext(config={"relax.LegalizeOps.cache_prim_funcs": False}):
+        Uncached = LegalizeOps()(Layers)
+    tvm.ir.assert_structural_equal(After, Uncached)
+    # The matmul and relu shared by both layers, the add, the matmul of another shape and
+    # the sums over each axis.
+    called = [
+        binding.value.args[0].name_hint
+        for binding in After["main"].body.blocks[0].bindings
+        if isinstance(binding.value, relax.Call) and binding.value.op.name == "relax.call_tir"
+    ]
+    assert called[0:2] == called[2:4]
+    assert len(set(called)) == 6
+
+    # Within LegalizeOps, the PrimFunc of the second relu is the one cached for the first.
+    def legalize_relu(bb: relax.BlockBuilder, call: relax.Call):
+        from tvm import te, topi  # pylint: disable=import-outside-toplevel
+
+        x = te.placeholder([te.var("n", "int64"), 16], "float32")
+        relu_funcs.append(te.create_prim_func([x, topi.nn.relu(x)]))
+        return bb.call_te(topi.nn.relu, call.args[0])
+
+    for cache in [True, False]:
+        relu_funcs = []
+        with tvm.transform.PassContext(config={"relax.LegalizeOps.cache_prim_funcs": cache}):
+            LegalizeOps({"relax.nn.relu": legalize_relu})(Layers)
+        assert len(relu_funcs) == 2
+        assert relu_funcs[0].same_as(relu_funcs[1]) == cache
+        tvm.ir.assert_structural_equal(relu_funcs[0], relu_funcs[1])
+
+
 if __name__ == "__main__":
     tvm.testing.main()
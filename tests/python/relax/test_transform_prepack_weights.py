@@ -0,0 +1,113 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import ir as I
+from tvm.script import relax as R
+from tvm.script import tir as T
+
+
+@I.ir_module
+class Tuned:
+    """A matmul whose weight is read in panels after a layout rewrite by tuning."""
+
+    @T.prim_func(private=True)
+    def matmul(
+        X: T.Buffer((16, 64), "float32"),
+        W: T.Buffer((64, 32), "float32"),
+        Out: T.Buffer((16, 32), "float32"),
+    ):
+        T.func_attr({"layout_free_buffers": [1]})
+        W_rewrite = T.alloc_buffer((4, 64, 8))
+        for k, j in T.grid(64, 32):
+            with T.block("W_rewrite"):
+                vk, vj = T.axis.remap("SS", [k, j])
+                T.block_attr({"meta_schedule.layout_rewrite_preproc": True})
+                W_rewrite[vj // 8, vk, vj % 8] = W[vk, vj]
+        for i, j, k in T.grid(16, 32, 64):
+            with T.block("Out"):
+                vi, vj, vk = T.axis.remap("SSR", [i, j, k])
+                with T.init():
+                    Out[vi, vj] = T.float32(0)
+                Out[vi, vj] = Out[vi, vj] + X[vi, vk] * W_rewrite[vj // 8, vk, vj % 8]
+
+    @R.function
+    def main(
+        x: R.Tensor((16, 64), dtype="float32"), w: R.Tensor((64, 32), dtype="float32")
+    ) -> R.Tensor((16, 32), dtype="float32"):
+        R.func_attr({"num_input": 1})
+        cls = Tuned
+        with R.dataflow():
+            gv = R.call_tir(cls.matmul, (x, w), out_sinfo=R.Tensor((16, 32), dtype="float32"))
+            R.output(gv)
+        return gv
+
+
+def _called_funcs(func):
+    return [
+        binding.value.args[0].name_hint
+        for block in func.body.blocks
+        for binding in block.bindings
+        if isinstance(binding.value, relax.Call) and binding.value.op.name == "relax.call_tir"
+    ]
+
+
+def _run(mod, x, params):
+    ex = tvm.compile(mod, "llvm")
+    vm = relax.VirtualMachine(ex, tvm.cpu())
+    return vm["main"](tvm.nd.array(x), *params).numpy()
+
+
+def test_prepack_weights_in_params_attr():
+    rng = np.random.default_rng(0)
+    w = rng.standard_normal((64, 32)).astype("float32")
+    x = rng.standard_normal((16, 64)).astype("float32")
+    mod = Tuned.clone()
+    mod["main"] = mod["main"].with_attr("params", [tvm.nd.array(w)])
+
+    after = relax.transform.PrepackWeights()(mod)
+    assert "main_transform_params" not in after
+    # No transform of the weight is left at runtime.
+    assert _called_funcs(after["main"]) == ["matmul_prepacked"]
+    assert not any("weight_prepack" in g_var.name_hint for g_var in after.get_global_vars())
+
+    after, params = relax.frontend.detach_params(after)
+    packed = params["main"][0].numpy()
+    tvm.testing.assert_allclose(packed, w.reshape(64, 4, 8).transpose(1, 0, 2))
+    tvm.testing.assert_allclose(_run(after, x, params["main"]), x @ w, rtol=1e-5, atol=1e-5)
+
+
+def test_prepack_weights_in_argument():
+    w = np.random.default_rng(1).standard_normal((64, 32)).astype("float32")
+    after = relax.transform.PrepackWeights({"main": [tvm.nd.array(w)]})(Tuned)
+    assert "main_transform_params" not in after
+    assert [int(dim) for dim in after["main"].params[1].struct_info.shape] == [4, 64, 8]
+    assert len(after["main"].attrs["params"]) == 1
+
+
+def test_unknown_weights_transformed_at_runtime():
+    after = relax.transform.PrepackWeights()(Tuned)
+    assert "main_transform_params" in after
+    assert _called_funcs(after["main"]) == ["matmul_prepacked"]
+    assert _called_funcs(after["main_transform_params"]) == ["matmul_weight_prepack"]
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
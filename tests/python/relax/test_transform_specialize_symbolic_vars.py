@@ -0,0 +1,135 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+import pytest
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import ir as I
+from tvm.script import relax as R
+from tvm.script import tir as T
+
+
+@I.ir_module
+class Module:
+    @R.function
+    def main(x: R.Tensor(("n", 64), "float32"), w: R.Tensor((64, 32), "float32")):
+        with R.dataflow():
+            y = R.nn.relu(R.matmul(x, w))
+            R.output(y)
+        return y
+
+
+def _call_tir_funcs(func):
+    return [
+        binding.value.args[0].name_hint
+        for block in func.body.blocks
+        for binding in block.bindings
+        if isinstance(binding.value, relax.Call) and binding.value.op.name == "relax.call_tir"
+    ]
+
+
+def _is_static(prim_func):
+    return all(
+        isinstance(dim, tvm.tir.IntImm)
+        for buffer in prim_func.buffer_map.values()
+        for dim in buffer.shape
+    )
+
+
+@pytest.mark.parametrize("legalize_first", [True, False])
+def test_specialize_hot_values(legalize_first):
+    mod = Module
+    if legalize_first:
+        mod = relax.transform.LegalizeOps()(mod)
+    after = relax.transform.SpecializeSymbolicVars({"n": [1, 128]})(mod)
+    after = relax.transform.LegalizeOps()(after)
+
+    assert "main_n_1" in after and "main_n_128" in after
+    # The entry of main dispatches on the value of `n`.
+    assert isinstance(after["main"].body.blocks[0].bindings[0].value, relax.If)
+    assert "global_symbol" not in after["main_n_1"].attrs
+    for name in ["main_n_1", "main_n_128"]:
+        funcs = _call_tir_funcs(after[name])
+        assert len(funcs) == 2
+        assert all(_is_static(after[func]) for func in funcs)
+        assert [int(dim) for dim in after[name].params[0].struct_info.shape] == [
+            int(name.split("_")[-1]),
+            64,
+        ]
+
+    rng = np.random.default_rng(0)
+    w = rng.standard_normal((64, 32)).astype("float32")
+    vm = relax.VirtualMachine(tvm.compile(after, "llvm"), tvm.cpu())
+    # The hot values run the specialized versions, and the others the generic body.
+    for n in [1, 128, 7]:
+        x = rng.standard_normal((n, 64)).astype("float32")
+        out = vm["main"](tvm.nd.array(x), tvm.nd.array(w)).numpy()
+        tvm.testing.assert_allclose(out, np.maximum(x @ w, 0), rtol=1e-5, atol=1e-5)
+
+
+def test_specialize_by_tir_var():
+    n = Module["main"].params[0].struct_info.shape[0]
+    after = relax.transform.SpecializeSymbolicVars({n: [16]}, func_name="main")(Module)
+    assert "main_n_16" in after
+    tvm.ir.assert_structural_equal(
+        after["main_n_16"].params[0].struct_info, R.Tensor((16, 64), "float32")
+    )
+
+
+def test_specialize_public_prim_func():
+    @I.ir_module
+    class Before:
+        @T.prim_func
+        def add_one(var_x: T.handle, var_y: T.handle):
+            n = T.int64()
+            x = T.match_buffer(var_x, (n, 64))
+            y = T.match_buffer(var_y, (n, 64))
+            for i, j in T.grid(n, 64):
+                with T.block("add"):
+                    vi, vj = T.axis.remap("SS", [i, j])
+                    y[vi, vj] = x[vi, vj] + T.float32(1)
+
+        @R.function
+        def main(x: R.Tensor(("n", 64), "float32")):
+            n = T.int64()
+            cls = Before
+            y = R.call_tir(cls.add_one, (x,), out_sinfo=R.Tensor((n, 64), "float32"))
+            return y
+
+    after = relax.transform.SpecializeSymbolicVars({"n": [8]})(Before)
+    specialized = [
+        gvar.name_hint
+        for gvar, func in after.functions_items()
+        if isinstance(func, tvm.tir.PrimFunc) and gvar.name_hint != "add_one"
+    ]
+    assert len(specialized) == 1
+    # Only the original PrimFunc keeps its public symbol.
+    assert after["add_one"].attrs["global_symbol"] == "add_one"
+    assert "global_symbol" not in after[specialized[0]].attrs
+    assert _is_static(after[specialized[0]])
+    tvm.compile(after, "llvm")
+
+
+def test_error_with_unknown_var():
+    with pytest.raises(tvm.TVMError):
+        relax.transform.SpecializeSymbolicVars({"m": [1]})(Module)
+
+
+if __name__ == "__main__":
+    tvm.testing.main()
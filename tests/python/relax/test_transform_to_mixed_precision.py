@@ -16,6 +16,7 @@
 # under the License.
 
 import numpy as np
+import pytest
 import tvm
 from tvm import relax
 import tvm.testing
@@ -1064,5 +1065,86 @@ def test_call_tir_with_float16_args():
     tvm.ir.assert_structural_equal(Expected, After)
 
 
+def test_gemm_add_silu_bfloat16():
+    @I.ir_module
+    class Input:
+        @R.function
+        def main(
+            x: R.Tensor((2, 320), "float32"),
+            w1: R.Tensor((320, 1280), "float32"),
+            w2: R.Tensor((2, 1280), "float32"),
+        ) -> R.Tensor(None, "float32", ndim=2):
+            with R.dataflow():
+                gv0: R.Tensor((2, 1280), "float32") = R.matmul(x, w1, out_dtype="float32")
+                gv1: R.Tensor((2, 1280), "float32") = R.add(gv0, w2)
+                gv2: R.Tensor((2, 1280), "float32") = R.nn.silu(gv1)
+                R.output(gv2)
+            return gv2
+
+    @I.ir_module
+    class Expected:
+        @R.function
+        def main(
+            x: R.Tensor((2, 320), dtype="float32"),
+            w1: R.Tensor((320, 1280), dtype="float32"),
+            w2: R.Tensor((2, 1280), dtype="float32"),
+        ) -> R.Tensor((2, 1280), dtype="float32"):
+            with R.dataflow():
+                lv: R.Tensor((2, 320), dtype="bfloat16") = R.astype(x, dtype="bfloat16")
+                lv1: R.Tensor((320, 1280), dtype="bfloat16") = R.astype(w1, dtype="bfloat16")
+                lv2: R.Tensor((2, 1280), dtype="float32") = R.matmul(lv, lv1, out_dtype="float32")
+                gv0: R.Tensor((2, 1280), dtype="bfloat16") = R.astype(lv2, dtype="bfloat16")
+                lv3: R.Tensor((2, 1280), dtype="float32") = R.astype(gv0, dtype="float32")
+                gv1: R.Tensor((2, 1280), dtype="float32") = R.add(lv3, w2)
+                gv2: R.Tensor((2, 1280), dtype="float32") = R.nn.silu(gv1)
+                R.output(gv2)
+            return gv2
+
+    mod = ToMixedPrecision(low_dtype="bfloat16")(Input)
+    tvm.ir.assert_structural_equal(mod, Expected)
+
+
+def test_op_dtypes():
+    @I.ir_module
+    class Input:
+        @R.function
+        def main(
+            x: R.Tensor((2, 320), "float32"),
+            w1: R.Tensor((320, 1280), "float32"),
+            w2: R.Tensor((2, 1280), "float32"),
+        ) -> R.Tensor(None, "float32", ndim=2):
+            with R.dataflow():
+                gv0: R.Tensor((2, 1280), "float32") = R.matmul(x, w1, out_dtype="float32")
+                gv1: R.Tensor((2, 1280), "float32") = R.add(gv0, w2)
+                gv2: R.Tensor((2, 1280), "float32") = R.nn.silu(gv1)
+                R.output(gv2)
+            return gv2
+
+    # The matmul is kept in float32 and the add runs in float16, against their policies.
+    @I.ir_module
+    class Expected:
+        @R.function
+        def main(
+            x: R.Tensor((2, 320), dtype="float32"),
+            w1: R.Tensor((320, 1280), dtype="float32"),
+            w2: R.Tensor((2, 1280), dtype="float32"),
+        ) -> R.Tensor((2, 1280), dtype="float32"):
+            with R.dataflow():
+                lv: R.Tensor((2, 1280), dtype="float16") = R.astype(w2, dtype="float16")
+                gv0: R.Tensor((2, 1280), dtype="float32") = R.matmul(x, w1, out_dtype="float32")
+                lv1: R.Tensor((2, 1280), dtype="float16") = R.astype(gv0, dtype="float16")
+                gv1: R.Tensor((2, 1280), dtype="float16") = R.add(lv1, lv)
+                lv2: R.Tensor((2, 1280), dtype="float16") = R.nn.silu(gv1)
+                gv2: R.Tensor((2, 1280), dtype="float32") = R.astype(lv2, dtype="float32")
+                R.output(gv2)
+            return gv2
+
+    mod = ToMixedPrecision(op_dtypes={"gv0": "float32", "gv1": "float16"})(Input)
+    tvm.ir.assert_structural_equal(mod, Expected)
+
+    with pytest.raises(tvm.TVMError):
+        ToMixedPrecision(op_dtypes={"gv0": "bfloat16"})(Input)
+
+
 if __name__ == "__main__":
     tvm.testing.main()
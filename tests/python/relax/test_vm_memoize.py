@@ -0,0 +1,135 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import numpy as np
+
+import tvm
+import tvm.testing
+from tvm import relax
+from tvm.script import ir as I
+from tvm.script import relax as R
+
+num_encode_calls = 0
+
+
+@tvm.register_func("test_vm_memoize.encode", override=True)
+def _encode(x):
+    global num_encode_calls
+    num_encode_calls += 1
+    return tvm.nd.array(x.numpy() * 2)
+
+
+@I.ir_module
+class Module:
+    @R.function(private=True)
+    def encode(x: R.Tensor((4,), "float32")) -> R.Tensor((4,), "float32"):
+        R.func_attr({"relax.memoize": 1024})
+        y = R.call_pure_packed("test_vm_memoize.encode", x, sinfo_args=R.Tensor((4,), "float32"))
+        return y
+
+    @R.function
+    def main(
+        x: R.Tensor((4,), "float32"), y: R.Tensor((4,), "float32")
+    ) -> R.Tensor((4,), "float32"):
+        cls = Module
+        e = cls.encode(x)
+        z = R.add(e, y)
+        return z
+
+    @R.function
+    def encode_only(x: R.Tensor((4,), "float32")) -> R.Tensor((4,), "float32"):
+        cls = Module
+        e = cls.encode(x)
+        return e
+
+
+def _build(capacity):
+    mod = Module.clone()
+    mod["encode"] = mod["encode"].with_attr("relax.memoize", capacity)
+    return relax.VirtualMachine(tvm.compile(mod, "llvm"), tvm.cpu())
+
+
+def _run(vm, x, y):
+    out = vm["main"](tvm.nd.array(x), tvm.nd.array(y)).numpy()
+    tvm.testing.assert_allclose(out, x * 2 + y)
+
+
+def test_lower_to_memoize_builtin():
+    mod = relax.transform.LowerRuntimeBuiltin()(Module)
+    call = mod["main"].body.blocks[0].bindings[0].value
+    assert call.op.name == "relax.call_builtin_with_ctx"
+    assert call.args[0].global_symbol == "vm.builtin.memoize.call"
+    assert call.args[1].fields[0].same_as(mod.get_global_var("encode"))
+    assert call.args[1].fields[1].value.value == 1024
+
+
+def test_repeated_inputs_hit_cache():
+    global num_encode_calls
+    num_encode_calls = 0
+    vm = _build(1024)
+    rng = np.random.default_rng(0)
+    x0, x1 = [rng.standard_normal(4).astype("float32") for _ in range(2)]
+    for _ in range(3):
+        _run(vm, x0, rng.standard_normal(4).astype("float32"))
+    assert num_encode_calls == 1
+    _run(vm, x1, rng.standard_normal(4).astype("float32"))
+    assert num_encode_calls == 2
+    _run(vm, x0, rng.standard_normal(4).astype("float32"))
+    assert num_encode_calls == 2
+
+
+def test_lru_eviction():
+    global num_encode_calls
+    num_encode_calls = 0
+    # Fits the outputs and the inputs of two calls.
+    vm = _build(128)
+    rng = np.random.default_rng(1)
+    x0, x1, x2 = [rng.standard_normal(4).astype("float32") for _ in range(3)]
+    y = rng.standard_normal(4).astype("float32")
+    for x in [x0, x1, x0, x2]:
+        _run(vm, x, y)
+    # `x1` is the least recently used when the output of `x2` is cached.
+    assert num_encode_calls == 3
+    _run(vm, x0, y)
+    assert num_encode_calls == 3
+    _run(vm, x1, y)
+    assert num_encode_calls == 4
+
+
+def test_updating_output_keeps_cache():
+    global num_encode_calls
+    num_encode_calls = 0
+    vm = _build(1024)
+    x = np.arange(4).astype("float32")
+    for _ in range(2):
+        out = vm["encode_only"](tvm.nd.array(x))
+        tvm.testing.assert_allclose(out.numpy(), x * 2)
+        out.copyfrom(np.zeros(4, "float32"))
+    assert num_encode_calls == 1
+
+
+def test_output_larger_than_capacity_not_cached():
+    global num_encode_calls
+    num_encode_calls = 0
+    vm = _build(8)
+    x = np.arange(4).astype("float32")
+    for _ in range(2):
+        _run(vm, x, x)
+    assert num_encode_calls == 2
+
+
+if __name__ == "__main__":
+    tvm.testing.main()